@@ -0,0 +1,27 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Depth pre-pass counterpart of unlit_instanced.vert, reading only the
+// position-only vertex stream.
+layout(location = 0) in vec3 inPosition;
+
+layout(location = 8) in vec4 inModel0;
+layout(location = 9) in vec4 inModel1;
+layout(location = 10) in vec4 inModel2;
+layout(location = 11) in vec4 inModel3;
+
+layout(set = 0, binding = 0) uniform Camera {
+    mat4x4 view;
+    mat4x4 projection;
+} camera;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+invariant gl_Position;
+
+void main() {
+    mat4x4 model = mat4x4(inModel0, inModel1, inModel2, inModel3);
+    gl_Position = camera.projection * camera.view * model * vec4(inPosition, 1.0);
+}
@@ -1,6 +1,15 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+// Material features, specialized per pipeline by PipelineCache (the IDs
+// are PipelineState's feature bits). Branches on them are folded away
+// when the pipeline is created.
+layout(constant_id = 0) const bool TEXTURED = true;
+layout(constant_id = 1) const bool VERTEX_COLOR = true;
+layout(constant_id = 2) const bool ALPHA_TEST = false;
+
+const float ALPHA_CUTOFF = 0.5;
+
 layout(location = 0) in vec3 inColor;
 layout(location = 1) in vec2 inTex;
 
@@ -9,5 +18,15 @@ layout(binding = 1) uniform sampler2D unifTexture;
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    outColor = vec4(inColor * texture(unifTexture, inTex).rgb, 1.0);
+    vec4 color = vec4(1.0);
+    if (VERTEX_COLOR) {
+        color.rgb *= inColor;
+    }
+    if (TEXTURED) {
+        color *= texture(unifTexture, inTex);
+    }
+    if (ALPHA_TEST && color.a < ALPHA_CUTOFF) {
+        discard;
+    }
+    outColor = color;
 }
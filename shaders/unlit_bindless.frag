@@ -0,0 +1,30 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec3 inColor;
+layout(location = 1) in vec2 inTex;
+layout(location = 2) flat in uint inMaterial;
+
+// Must match gfx::MaterialRecord.
+struct Material {
+    vec4 color;
+    uint texture;
+    uint pad0;
+    uint pad1;
+    uint pad2;
+};
+
+layout(set = 1, binding = 0) readonly buffer Materials {
+    Material materials[];
+};
+
+layout(set = 1, binding = 2) uniform sampler2D textures[];
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    Material material = materials[inMaterial];
+    vec4 texel = texture(textures[nonuniformEXT(material.texture)], inTex);
+    outColor = vec4(inColor * material.color.rgb * texel.rgb, material.color.a);
+}
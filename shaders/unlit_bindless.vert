@@ -0,0 +1,43 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inTex;
+
+// Shared by every draw in a frame.
+layout(set = 0, binding = 0) uniform Camera {
+    mat4x4 view;
+    mat4x4 projection;
+} camera;
+
+// Must match gfx::ObjectRecord.
+struct Object {
+    mat4x4 model;
+    uint material;
+    uint pad0;
+    uint pad1;
+    uint pad2;
+};
+
+layout(set = 1, binding = 1) readonly buffer Objects {
+    Object objects[];
+};
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+layout(location = 0) out vec3 outColor;
+layout(location = 1) out vec2 outTex;
+layout(location = 2) flat out uint outMaterial;
+
+// Each draw is a single instance whose firstInstance is its object index,
+// so a whole batch of draws can go out in one multi-draw-indirect call.
+void main() {
+    Object object = objects[gl_InstanceIndex];
+    gl_Position = camera.projection * camera.view * object.model * vec4(inPosition, 1.0);
+    outColor = inColor;
+    outTex = inTex;
+    outMaterial = object.material;
+}
@@ -0,0 +1,39 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inTex;
+
+// Per instance, from gfx::DrawList's instance stream (binding 1). Locations
+// 8 and up are per-instance; see PipelineCache::FIRST_INSTANCE_LOCATION.
+// Must match gfx::DrawData.
+layout(location = 8) in vec4 inModel0;
+layout(location = 9) in vec4 inModel1;
+layout(location = 10) in vec4 inModel2;
+layout(location = 11) in vec4 inModel3;
+
+// Shared by every draw in a frame.
+layout(set = 0, binding = 0) uniform Camera {
+    mat4x4 view;
+    mat4x4 projection;
+} camera;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+// The depth pre-pass computes the same position in depth_instanced.vert;
+// both must produce bit-identical depths for the EQUAL test in the color
+// pass.
+invariant gl_Position;
+
+layout(location = 0) out vec3 outColor;
+layout(location = 1) out vec2 outTex;
+
+void main() {
+    mat4x4 model = mat4x4(inModel0, inModel1, inModel2, inModel3);
+    gl_Position = camera.projection * camera.view * model * vec4(inPosition, 1.0);
+    outColor = inColor;
+    outTex = inTex;
+}
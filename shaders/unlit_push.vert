@@ -0,0 +1,30 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inTex;
+
+// Shared by every draw in a frame.
+layout(set = 0, binding = 0) uniform Camera {
+    mat4x4 view;
+    mat4x4 projection;
+} camera;
+
+// Per draw, straight from vkCmdPushConstants. Must match gfx::DrawData.
+layout(push_constant) uniform Draw {
+    mat4x4 model;
+} draw;
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+layout(location = 0) out vec3 outColor;
+layout(location = 1) out vec2 outTex;
+
+void main() {
+    gl_Position = camera.projection * camera.view * draw.model * vec4(inPosition, 1.0);
+    outColor = inColor;
+    outTex = inTex;
+}
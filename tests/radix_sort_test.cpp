@@ -0,0 +1,83 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+// Checks RadixSorter against std::stable_sort, on one thread and split
+// across a JobSystem, around the sizes where it starts splitting.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "../vgraphplay/JobSystem.h"
+#include "../vgraphplay/gfx/RadixSort.h"
+
+using vgraphplay::JobSystem;
+using vgraphplay::gfx::RadixSorter;
+
+static int failures = 0;
+
+static void check(RadixSorter &sorter, size_t n, uint64_t key_mask, std::mt19937_64 &rng) {
+    std::vector<uint64_t> keys(n);
+    std::vector<uint32_t> values(n);
+    for (size_t i = 0; i < n; ++i) {
+        keys[i] = rng() & key_mask;
+        values[i] = static_cast<uint32_t>(i);
+    }
+
+    std::vector<std::pair<uint64_t, uint32_t>> expected(n);
+    for (size_t i = 0; i < n; ++i) {
+        expected[i] = {keys[i], values[i]};
+    }
+    std::ranges::stable_sort(expected, {}, &std::pair<uint64_t, uint32_t>::first);
+
+    sorter.sort(keys, values);
+
+    for (size_t i = 0; i < n; ++i) {
+        if (keys[i] != expected[i].first || values[i] != expected[i].second) {
+            std::fprintf(stderr, "FAIL: %zu keys (mask %#llx, %u chunks): mismatch at %zu\n",
+                         n, static_cast<unsigned long long>(key_mask), sorter.chunks(n), i);
+            ++failures;
+            return;
+        }
+    }
+}
+
+int main() {
+    std::mt19937_64 rng{12345};
+
+    JobSystem jobs{JobSystem::Config{.workers = 3}};
+    RadixSorter serial{};
+    RadixSorter parallel{&jobs};
+
+    if (parallel.chunks(RadixSorter::PARALLEL_THRESHOLD) < 2) {
+        std::fprintf(stderr, "FAIL: %zu keys aren't split\n", RadixSorter::PARALLEL_THRESHOLD);
+        ++failures;
+    }
+
+    const size_t sizes[] = {
+        0, 1, 2, 100,
+        RadixSorter::PARALLEL_THRESHOLD - 1,
+        RadixSorter::PARALLEL_THRESHOLD,
+        RadixSorter::PARALLEL_THRESHOLD + 1,
+        RadixSorter::MIN_CHUNK * 3 + 7,
+        16384,
+        100000,
+    };
+    // Full keys, keys with few distinct values (lots of ties, so stability
+    // matters), and keys with only high bytes set (skipped passes).
+    const uint64_t masks[] = {~uint64_t{0}, 0x3, 0xff00000000000000ull};
+
+    for (size_t n : sizes) {
+        for (uint64_t mask : masks) {
+            check(serial, n, mask, rng);
+            check(parallel, n, mask, rng);
+        }
+    }
+
+    if (failures == 0) {
+        std::printf("radix sort: ok\n");
+    }
+    return failures == 0 ? 0 : 1;
+}
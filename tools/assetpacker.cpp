@@ -0,0 +1,191 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include "AssetPackFormat.h"
+
+using namespace vgraphplay;
+
+// Defined (but not declared) by stb_image_write.h.
+unsigned char *stbi_zlib_compress(unsigned char *data, int data_len, int *out_len, int quality);
+
+struct InputAsset {
+    std::string name;
+    boost::filesystem::path path;
+    std::vector<unsigned char> stored;
+    uint64_t size;
+    AssetCompression compression;
+};
+
+static bool readFile(const boost::filesystem::path &path, std::vector<unsigned char> &contents);
+static void compressAsset(InputAsset &asset);
+
+int main(int argc, char **argv) {
+    bool compress = false;
+    std::vector<const char *> positional;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--compress") == 0) {
+            compress = true;
+        } else {
+            positional.push_back(argv[i]);
+        }
+    }
+
+    if (positional.size() < 2) {
+        fprintf(stderr, "USAGE: %s [--compress] {pack} {name=file}...\n\n"
+                        "  Creates the asset pack {pack} containing each {file}, looked\n"
+                        "  up at runtime by {name}. With --compress, entries are stored\n"
+                        "  zlib-compressed when that saves at least an eighth of their size.\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    boost::filesystem::path dst{positional[0]};
+
+    std::vector<InputAsset> assets;
+    for (size_t i = 1; i < positional.size(); ++i) {
+        std::string arg{positional[i]};
+        size_t eq = arg.find('=');
+        if (eq == std::string::npos || eq == 0) {
+            fprintf(stderr, "Expected {name}={file}, got %s\n", arg.c_str());
+            return EXIT_FAILURE;
+        }
+
+        InputAsset asset{arg.substr(0, eq), arg.substr(eq + 1), {}, 0, AssetCompression::None};
+        if (!readFile(asset.path, asset.stored)) {
+            fprintf(stderr, "Unable to read %s\n", asset.path.string().c_str());
+            return EXIT_FAILURE;
+        }
+        asset.size = asset.stored.size();
+
+        if (compress) {
+            compressAsset(asset);
+        }
+
+        assets.push_back(std::move(asset));
+    }
+
+    uint32_t bucket_count = 1;
+    while (bucket_count < assets.size() * 2) {
+        bucket_count *= 2;
+    }
+
+    AssetPackHeader header{};
+    std::memcpy(header.magic, ASSET_PACK_MAGIC, sizeof(header.magic));
+    header.version = ASSET_PACK_VERSION;
+    header.entry_count = static_cast<uint32_t>(assets.size());
+    header.bucket_count = bucket_count;
+    header.entries_offset = sizeof(AssetPackHeader);
+    header.buckets_offset = header.entries_offset + sizeof(AssetPackEntry) * assets.size();
+    header.names_offset = header.buckets_offset + sizeof(uint32_t) * bucket_count;
+
+    std::string names;
+    std::vector<AssetPackEntry> entries(assets.size());
+    std::vector<uint32_t> buckets(bucket_count, 0);
+
+    for (size_t i = 0; i < assets.size(); ++i) {
+        AssetPackEntry &entry = entries[i];
+        entry.name_hash = assetNameHash(assets[i].name);
+        entry.name_offset = static_cast<uint32_t>(names.size());
+        entry.name_length = static_cast<uint32_t>(assets[i].name.size());
+        entry.stored_size = assets[i].stored.size();
+        entry.size = assets[i].size;
+        entry.compression = assets[i].compression;
+        names += assets[i].name;
+
+        uint32_t bucket = static_cast<uint32_t>(entry.name_hash) & (bucket_count - 1);
+        while (buckets[bucket] != 0) {
+            const AssetPackEntry &other = entries[buckets[bucket] - 1];
+            if (other.name_hash == entry.name_hash && names.compare(other.name_offset, other.name_length, assets[i].name) == 0) {
+                fprintf(stderr, "Duplicate asset name %s\n", assets[i].name.c_str());
+                return EXIT_FAILURE;
+            }
+            bucket = (bucket + 1) & (bucket_count - 1);
+        }
+        buckets[bucket] = static_cast<uint32_t>(i + 1);
+    }
+
+    header.names_size = names.size();
+
+    uint64_t offset = header.names_offset + header.names_size;
+    for (auto &entry : entries) {
+        offset = (offset + 15) & ~uint64_t{15};
+        entry.offset = offset;
+        offset += entry.stored_size;
+    }
+
+    if (dst.has_parent_path()) {
+        boost::filesystem::create_directories(dst.parent_path());
+    }
+
+    FILE *out = std::fopen(dst.string().c_str(), "wb");
+    if (out == nullptr) {
+        fprintf(stderr, "Unable to open %s for writing\n", dst.string().c_str());
+        return EXIT_FAILURE;
+    }
+
+    static const unsigned char padding[16] = {};
+    uint64_t written = 0;
+    written += std::fwrite(&header, 1, sizeof(header), out);
+    written += std::fwrite(entries.data(), 1, sizeof(AssetPackEntry) * entries.size(), out);
+    written += std::fwrite(buckets.data(), 1, sizeof(uint32_t) * buckets.size(), out);
+    written += std::fwrite(names.data(), 1, names.size(), out);
+    for (size_t i = 0; i < entries.size(); ++i) {
+        written += std::fwrite(padding, 1, entries[i].offset - written, out);
+        written += std::fwrite(assets[i].stored.data(), 1, assets[i].stored.size(), out);
+    }
+
+    bool ok = written == offset && std::fclose(out) == 0;
+    if (!ok) {
+        fprintf(stderr, "Error writing %s\n", dst.string().c_str());
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static bool readFile(const boost::filesystem::path &path, std::vector<unsigned char> &contents) {
+    FILE *in = std::fopen(path.string().c_str(), "rb");
+    if (in == nullptr) {
+        return false;
+    }
+
+    std::fseek(in, 0, SEEK_END);
+    long size = std::ftell(in);
+    std::fseek(in, 0, SEEK_SET);
+
+    contents.resize(size < 0 ? 0 : static_cast<size_t>(size));
+    bool ok = size >= 0 && std::fread(contents.data(), 1, contents.size(), in) == contents.size();
+    std::fclose(in);
+    return ok;
+}
+
+static void compressAsset(InputAsset &asset) {
+    if (asset.stored.empty()) {
+        return;
+    }
+
+    int compressed_size = 0;
+    unsigned char *compressed = stbi_zlib_compress(asset.stored.data(), static_cast<int>(asset.stored.size()), &compressed_size, 8);
+    if (compressed == nullptr) {
+        return;
+    }
+
+    if (static_cast<uint64_t>(compressed_size) <= asset.size - asset.size / 8) {
+        asset.stored.assign(compressed, compressed + compressed_size);
+        asset.compression = AssetCompression::Zlib;
+    }
+
+    std::free(compressed);
+}
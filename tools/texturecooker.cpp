@@ -0,0 +1,199 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include <stb_image_resize.h>
+
+#define STB_DXT_IMPLEMENTATION
+#include <stb_dxt.h>
+
+#include "gfx/TextureFormat.h"
+
+using namespace vgraphplay::gfx;
+
+struct Level {
+    uint32_t width;
+    uint32_t height;
+    std::vector<unsigned char> rgba;
+};
+
+static std::vector<Level> buildMipChain(const unsigned char *pixels, uint32_t width, uint32_t height, bool srgb);
+static std::vector<unsigned char> compressLevel(const Level &level, CookedTextureFormat format);
+static bool hasTransparency(const Level &level);
+
+int main(int argc, char **argv) {
+    bool srgb = false;
+    bool force_bc1 = false, force_bc3 = false;
+    std::vector<const char *> positional;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--srgb") == 0) {
+            srgb = true;
+        } else if (std::strcmp(argv[i], "--bc1") == 0) {
+            force_bc1 = true;
+        } else if (std::strcmp(argv[i], "--bc3") == 0) {
+            force_bc3 = true;
+        } else {
+            positional.push_back(argv[i]);
+        }
+    }
+
+    if (positional.size() != 2 || (force_bc1 && force_bc3)) {
+        fprintf(stderr, "USAGE: %s [--srgb] [--bc1 | --bc3] {dst} {src}\n\n"
+                        "  Decodes {src}, generates a full mip chain, block-compresses\n"
+                        "  it and writes a GPU-ready cooked texture to {dst}. Without\n"
+                        "  --bc1 or --bc3 the format is BC1 for opaque images and BC3\n"
+                        "  for images with any non-opaque texel.\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    boost::filesystem::path dst{positional[0]};
+    boost::filesystem::path src{positional[1]};
+
+    int width, height, channels;
+    stbi_uc *pixels = stbi_load(src.string().c_str(), &width, &height, &channels, STBI_rgb_alpha);
+    if (pixels == nullptr) {
+        fprintf(stderr, "Unable to decode %s: %s\n", src.string().c_str(), stbi_failure_reason());
+        return EXIT_FAILURE;
+    }
+
+    std::vector<Level> levels = buildMipChain(pixels, width, height, srgb);
+    stbi_image_free(pixels);
+
+    CookedTextureFormat format = CookedTextureFormat::BC1;
+    if (force_bc3 || (!force_bc1 && hasTransparency(levels[0]))) {
+        format = CookedTextureFormat::BC3;
+    }
+
+    CookedTextureHeader header{};
+    std::memcpy(header.magic, COOKED_TEXTURE_MAGIC, sizeof(header.magic));
+    header.version = COOKED_TEXTURE_VERSION;
+    header.format = format;
+    header.flags = srgb ? static_cast<uint32_t>(COOKED_TEXTURE_SRGB) : uint32_t{0};
+    header.width = levels[0].width;
+    header.height = levels[0].height;
+    header.mip_levels = static_cast<uint32_t>(levels.size());
+
+    std::vector<CookedTextureMip> mips(levels.size());
+    std::vector<std::vector<unsigned char>> blocks(levels.size());
+    uint64_t offset = sizeof(CookedTextureHeader) + sizeof(CookedTextureMip) * mips.size();
+    for (size_t i = 0; i < levels.size(); ++i) {
+        offset = (offset + 15) & ~uint64_t{15};
+        blocks[i] = compressLevel(levels[i], format);
+        mips[i].width = levels[i].width;
+        mips[i].height = levels[i].height;
+        mips[i].offset = offset;
+        mips[i].size = blocks[i].size();
+        offset += blocks[i].size();
+    }
+
+    if (dst.has_parent_path()) {
+        boost::filesystem::create_directories(dst.parent_path());
+    }
+
+    FILE *out = std::fopen(dst.string().c_str(), "wb");
+    if (out == nullptr) {
+        fprintf(stderr, "Unable to open %s for writing\n", dst.string().c_str());
+        return EXIT_FAILURE;
+    }
+
+    static const unsigned char padding[16] = {};
+    uint64_t written = 0;
+    written += std::fwrite(&header, 1, sizeof(header), out);
+    written += std::fwrite(mips.data(), 1, sizeof(CookedTextureMip) * mips.size(), out);
+    for (size_t i = 0; i < mips.size(); ++i) {
+        written += std::fwrite(padding, 1, mips[i].offset - written, out);
+        written += std::fwrite(blocks[i].data(), 1, blocks[i].size(), out);
+    }
+
+    bool ok = written == offset && std::fclose(out) == 0;
+    if (!ok) {
+        fprintf(stderr, "Error writing %s\n", dst.string().c_str());
+        return EXIT_FAILURE;
+    }
+
+    printf("Cooked %s: %ux%u, %u mips, %s, %llu bytes (%llu bytes as RGBA8)\n",
+           src.string().c_str(), header.width, header.height, header.mip_levels,
+           format == CookedTextureFormat::BC1 ? "BC1" : "BC3",
+           static_cast<unsigned long long>(offset),
+           static_cast<unsigned long long>(header.width) * header.height * 4);
+
+    return EXIT_SUCCESS;
+}
+
+static std::vector<Level> buildMipChain(const unsigned char *pixels, uint32_t width, uint32_t height, bool srgb) {
+    std::vector<Level> levels;
+    levels.push_back({width, height, std::vector<unsigned char>(pixels, pixels + static_cast<size_t>(width) * height * 4)});
+
+    while (levels.back().width > 1 || levels.back().height > 1) {
+        const Level &prev = levels.back();
+        Level next{std::max(prev.width / 2, 1u), std::max(prev.height / 2, 1u), {}};
+        next.rgba.resize(static_cast<size_t>(next.width) * next.height * 4);
+
+        // Each level is filtered from the one above it, which is a box-ish
+        // filter over the original at a fraction of the cost.
+        if (srgb) {
+            stbir_resize_uint8_srgb(prev.rgba.data(), prev.width, prev.height, 0,
+                                    next.rgba.data(), next.width, next.height, 0,
+                                    4, 3, 0);
+        } else {
+            stbir_resize_uint8(prev.rgba.data(), prev.width, prev.height, 0,
+                               next.rgba.data(), next.width, next.height, 0,
+                               4);
+        }
+
+        levels.push_back(std::move(next));
+    }
+
+    return levels;
+}
+
+static std::vector<unsigned char> compressLevel(const Level &level, CookedTextureFormat format) {
+    const uint32_t blocks_x = (level.width + 3) / 4;
+    const uint32_t blocks_y = (level.height + 3) / 4;
+    const uint32_t block_bytes = cookedTextureBlockBytes(format);
+    const int alpha = format == CookedTextureFormat::BC3 ? 1 : 0;
+
+    std::vector<unsigned char> rv(cookedTextureMipSize(format, level.width, level.height));
+    unsigned char block[16 * 4];
+
+    for (uint32_t by = 0; by < blocks_y; ++by) {
+        for (uint32_t bx = 0; bx < blocks_x; ++bx) {
+            // Levels smaller than a block (or not a multiple of 4) are
+            // padded by clamping to the edge texel.
+            for (uint32_t y = 0; y < 4; ++y) {
+                uint32_t sy = std::min(by * 4 + y, level.height - 1);
+                for (uint32_t x = 0; x < 4; ++x) {
+                    uint32_t sx = std::min(bx * 4 + x, level.width - 1);
+                    std::memcpy(&block[(y * 4 + x) * 4], &level.rgba[(static_cast<size_t>(sy) * level.width + sx) * 4], 4);
+                }
+            }
+
+            unsigned char *dest = &rv[(static_cast<size_t>(by) * blocks_x + bx) * block_bytes];
+            stb_compress_dxt_block(dest, block, alpha, STB_DXT_HIGHQUAL);
+        }
+    }
+
+    return rv;
+}
+
+static bool hasTransparency(const Level &level) {
+    for (size_t i = 3; i < level.rgba.size(); i += 4) {
+        if (level.rgba[i] != 255) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -1,21 +1,73 @@
 // -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
 
+#include <algorithm>
+#include <exception>
 #include <format>
 #include <print>
 #include <vector>
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/trigonometric.hpp>
+
+#include <boost/log/trivial.hpp>
 
 #include "vulkan.h"
 
 #include "Application.h"
+#include "Log.h"
 #include "Resource.h"
 #include "gfx/System.h"
 
-vgraphplay::Application::Application(GLFWwindow *window, bool debug)
+// One worker per remaining hardware thread, once the main and render
+// threads have theirs.
+static vgraphplay::JobSystem::Config jobConfig(const vgraphplay::RunConfig &config) {
+    if (!config.pin_threads) {
+        return vgraphplay::JobSystem::Config{};
+    }
+
+    const unsigned first_core = vgraphplay::Application::RENDER_CORE + 1;
+    const unsigned hardware = std::thread::hardware_concurrency();
+    return vgraphplay::JobSystem::Config{
+        .workers = hardware > first_core + 1 ? hardware - first_core : 1,
+        .pin_workers = true,
+        .first_core = first_core,
+    };
+}
+
+vgraphplay::Application::Application(GLFWwindow *window, const RunConfig &config)
   : m_window{window},
-    m_gfx{window, debug},
+    m_config{config},
+    m_main_thread{std::this_thread::get_id()},
+    m_jobs{jobConfig(config)},
+    m_gfx{window, config, m_jobs},
     m_window_width{0},
-    m_window_height{0}
+    m_window_height{0},
+    m_clock{},
+    m_previous{},
+    m_current{Transform{}},
+    m_sequence{0},
+    m_animating{true},
+    m_depth_prepass{true},
+    m_render_mode{config.on_demand ? gfx::RenderMode::OnDemand : gfx::RenderMode::Continuous},
+    m_frame_limit{config.max_fps},
+    m_dirty{DIRTY_SETTINGS},
+    m_input_events{},
+    m_render_events{},
+    m_packets{},
+    m_render_stats{},
+    m_render_signal{0},
+    m_limiter{},
+    m_frame_times{},
+    m_render_thread{}
 {
+    // Home jobs would otherwise wait for the next event.
+    m_jobs.setHomeWake([] { glfwPostEmptyEvent(); });
+
+    if (config.pin_threads && !JobSystem::pinCurrentThread(MAIN_CORE)) {
+        BOOST_LOG_TRIVIAL(info) << "Couldn't pin the main thread";
+    }
+
     glfwGetFramebufferSize(m_window, &m_window_width, &m_window_height);
     glfwSetWindowUserPointer(window, this);
     glfwSetKeyCallback(m_window, vgraphplay::Application::keyCallback);
@@ -26,8 +78,8 @@ vgraphplay::Application::~Application() {}
 
 void vgraphplay::Application::keyCallback(GLFWwindow *window, int key, int scancode, int action, int mode) {
     Application *app = (Application*)glfwGetWindowUserPointer(window);
-    if (app != nullptr) {
-        app->handleKey(key, scancode, action, mode);
+    if (app != nullptr && !app->m_input_events.push(InputEvent{InputEvent::Type::Key, key, scancode, action, mode, 0, 0})) {
+        VGRAPHPLAY_LOG(warning, "Input queue is full; dropped key {}", key);
     }
 }
 
@@ -36,6 +88,60 @@ void vgraphplay::Application::handleKey(int key, int scancode, int action, int m
     case GLFW_KEY_ESCAPE:
         glfwSetWindowShouldClose(m_window, GLFW_TRUE);
         break;
+    case GLFW_KEY_Z:
+        if (action == GLFW_PRESS) {
+            m_render_stats.acquire();
+            const gfx::OverdrawStats &stats = m_render_stats.front().overdraw;
+            m_depth_prepass = !m_depth_prepass;
+            m_dirty.fetch_or(DIRTY_SETTINGS);
+            std::println(stderr, "Depth pre-pass {} (overdraw was {:.2f}: {} fragments for {} pixels)",
+                         m_depth_prepass ? "on" : "off", stats.overdraw(), stats.color_fragments, stats.pixels);
+        }
+        break;
+    case GLFW_KEY_B:
+        if (action == GLFW_PRESS) {
+            m_render_stats.acquire();
+            const gfx::BindStats &before = m_render_stats.front().unsorted_binds;
+            const gfx::BindStats &after = m_render_stats.front().sorted_binds;
+            std::println(stderr, "{} draws: {} -> {} draw calls, {} -> {} pipeline binds, {} -> {} descriptor binds, {} -> {} vertex buffer binds",
+                         after.draws, before.draw_calls, after.draw_calls, before.pipeline_binds, after.pipeline_binds,
+                         before.descriptor_binds, after.descriptor_binds, before.vertex_binds, after.vertex_binds);
+        }
+        break;
+    case GLFW_KEY_H:
+        if (action == GLFW_PRESS) {
+            m_render_stats.acquire();
+            const gfx::HostAllocationStats &stats = m_render_stats.front().host_allocations;
+            if (!stats.enabled) {
+                std::println(stderr, "Host allocations aren't tracked (run with --track-allocations)");
+                break;
+            }
+            std::println(stderr, "Host allocations: {} last frame, {} frames allocating since warm-up, {} from the command arena",
+                         stats.frame_allocations, stats.allocating_frames, stats.arena_allocations);
+            for (size_t i = 0; i < stats.scopes.size(); ++i) {
+                const gfx::HostScopeStats &scope = stats.scopes[i];
+                std::println(stderr, "  {}: {} allocations, {} frees, {} bytes live (peak {}), {} internal bytes",
+                             vk::to_string(static_cast<vk::SystemAllocationScope>(i)), scope.allocations, scope.frees,
+                             scope.live_bytes, scope.peak_bytes, scope.internal_bytes);
+            }
+        }
+        break;
+    case GLFW_KEY_SPACE:
+        if (action == GLFW_PRESS) {
+            m_animating = !m_animating;
+            // Freeze where it's drawn now, rather than between two steps.
+            m_previous = m_current;
+            m_dirty.fetch_or(DIRTY_ANIMATION);
+            std::println(stderr, "Animation {}", m_animating ? "running" : "paused");
+        }
+        break;
+    case GLFW_KEY_O:
+        if (action == GLFW_PRESS) {
+            const gfx::RenderMode mode = m_render_mode.load() == gfx::RenderMode::OnDemand ? gfx::RenderMode::Continuous : gfx::RenderMode::OnDemand;
+            setRenderMode(mode);
+            std::println(stderr, "Rendering {}", mode == gfx::RenderMode::OnDemand ? "on demand" : "continuously");
+        }
+        break;
     default:
         std::println(stderr, "Key: {} scancode: {} action: {} mode: {}", key, scancode, action, mode);
     }
@@ -43,20 +149,217 @@ void vgraphplay::Application::handleKey(int key, int scancode, int action, int m
 
 void vgraphplay::Application::resizeCallback(GLFWwindow *window, int width, int height) {
     Application *app = (Application*)glfwGetWindowUserPointer(window);
-    if (app != nullptr) {
-        app->handleResize(width, height);
+    if (app != nullptr && !app->m_input_events.push(InputEvent{InputEvent::Type::Resize, 0, 0, 0, 0, width, height})) {
+        VGRAPHPLAY_LOG(warning, "Input queue is full; dropped resize to {}x{}", width, height);
     }
 }
 
 void vgraphplay::Application::handleResize(int width, int height) {
     m_window_width = width;
     m_window_height = height;
-    m_gfx.setFramebufferResized();
+    m_dirty.fetch_or(DIRTY_RESIZE);
+    if (!m_render_events.push(InputEvent{InputEvent::Type::Resize, 0, 0, 0, 0, width, height})) {
+        VGRAPHPLAY_LOG(warning, "Render queue is full; dropped resize to {}x{}", width, height);
+    }
+    wakeRenderer();
+}
+
+void vgraphplay::Application::markDirty(uint32_t flags) {
+    m_dirty.fetch_or(flags);
+    if (std::this_thread::get_id() != m_main_thread) {
+        // It may be blocked waiting for events.
+        glfwPostEmptyEvent();
+    }
+}
+
+void vgraphplay::Application::setRenderMode(gfx::RenderMode mode) {
+    m_render_mode.store(mode);
+    markDirty(DIRTY_SETTINGS);
+}
+
+void vgraphplay::Application::setFrameLimit(double max_frame_rate) {
+    m_frame_limit.store(max_frame_rate);
+    markDirty(DIRTY_SETTINGS);
 }
 
 void vgraphplay::Application::run() {
+    m_render_thread = std::jthread{[this](std::stop_token stop) { renderMain(stop); }};
+
     while (!glfwWindowShouldClose(m_window)) {
+        waitEvents();
+        while (std::optional<InputEvent> event = m_input_events.pop()) {
+            if (event->type == InputEvent::Type::Key) {
+                m_dirty.fetch_or(DIRTY_INPUT);
+                handleKey(event->key, event->scancode, event->action, event->mode);
+            } else {
+                handleResize(event->width, event->height);
+            }
+        }
+        m_jobs.runHomeJobs();
+        simulate();
+    }
+
+    m_render_thread.request_stop();
+    m_render_thread.join();
+
+    if (m_config.mode == RunMode::Profile) {
+        reportFrameTimes();
+    }
+}
+
+void vgraphplay::Application::reportFrameTimes() const {
+    if (m_frame_times.empty()) {
+        std::println(stderr, "No frames rendered");
+        return;
+    }
+
+    std::vector<float> sorted = m_frame_times;
+    std::ranges::sort(sorted);
+    auto percentile = [&sorted](double p) {
+        return sorted[std::min(sorted.size() - 1, static_cast<size_t>(p * static_cast<double>(sorted.size())))];
+    };
+
+    double total = 0.0;
+    for (float ms : sorted) {
+        total += ms;
+    }
+    const double mean = total / static_cast<double>(sorted.size());
+
+    std::println(stderr, "{} frames: mean {:.3f} ms ({:.1f} fps), p50 {:.3f} ms, p95 {:.3f} ms, p99 {:.3f} ms, max {:.3f} ms",
+                 sorted.size(), mean, 1000.0 / mean, percentile(0.50), percentile(0.95), percentile(0.99), sorted.back());
+}
+
+// Blocks until there's an event to handle or, while animating, the next
+// simulation step is due. markDirty() and home jobs post an empty event
+// to cut it short.
+void vgraphplay::Application::waitEvents() {
+    if (!m_animating) {
+        glfwWaitEvents();
+        return;
+    }
+
+    const double timeout = std::chrono::duration<double>(m_clock.untilNextStep()).count();
+    if (timeout > 0.0) {
+        glfwWaitEventsTimeout(timeout);
+    } else {
         glfwPollEvents();
-        m_gfx.drawFrame();
+    }
+}
+
+// Runs however many fixed steps are due and, if anything changed,
+// publishes a packet for the render thread.
+void vgraphplay::Application::simulate() {
+    // The clock keeps running while paused, so it doesn't have a backlog
+    // of steps to catch up on when it resumes.
+    const uint32_t steps = m_clock.advance();
+    if (m_animating && steps > 0) {
+        for (uint32_t i = 0; i < steps; ++i) {
+            m_previous = m_current;
+            step(m_clock.stepSeconds());
+        }
+        m_dirty.fetch_or(DIRTY_ANIMATION);
+    }
+
+    if (m_dirty.exchange(0) == 0) {
+        return;
+    }
+
+    const float aspect = static_cast<float>(std::max(m_window_width, 1)) / static_cast<float>(std::max(m_window_height, 1));
+
+    gfx::FramePacket &packet = m_packets.back();
+    packet.sequence = ++m_sequence;
+    packet.camera.view = glm::lookAt(glm::vec3{2.0f, 2.0f, 2.0f}, glm::vec3{0.0f, 0.0f, 0.0f}, glm::vec3{0.0f, 0.0f, 1.0f});
+    packet.camera.projection = glm::perspectiveRH_ZO(glm::radians(45.0f), aspect, 0.1f, 10.0f);
+    packet.camera.projection[1][1] *= -1;
+    packet.previous = m_previous;
+    packet.current = m_current;
+    packet.advanced = m_clock.lastAdvance();
+    packet.alpha = m_clock.alpha();
+    packet.step_seconds = m_clock.stepSeconds();
+    packet.depth_prepass = m_depth_prepass;
+    packet.render_mode = m_render_mode.load();
+    packet.max_frame_rate = m_frame_limit.load();
+    m_packets.publish();
+    wakeRenderer();
+}
+
+// One fixed step of the simulation: a quarter turn a second.
+void vgraphplay::Application::step(float seconds) {
+    const glm::quat spin = glm::angleAxis(seconds * glm::radians(90.0f), glm::vec3{0.0f, 0.0f, 1.0f});
+    for (Transform &object : m_current) {
+        object.rotation = glm::normalize(spin * object.rotation);
+    }
+}
+
+void vgraphplay::Application::wakeRenderer() {
+    m_render_signal.fetch_add(1);
+    m_render_signal.notify_one();
+}
+
+void vgraphplay::Application::renderMain(std::stop_token stop) {
+    std::stop_callback wake_on_stop{stop, [this] { wakeRenderer(); }};
+
+    if (m_config.pin_threads && !JobSystem::pinCurrentThread(RENDER_CORE)) {
+        BOOST_LOG_TRIVIAL(info) << "Couldn't pin the render thread";
+    }
+
+    const bool profile = m_config.mode == RunMode::Profile;
+    if (profile) {
+        m_frame_times.reserve(m_config.frames != 0 ? m_config.frames : 1 << 16);
+    }
+    std::chrono::steady_clock::time_point last_frame{};
+
+    try {
+        while (!stop.stop_requested()) {
+            // Read before checking for work, so anything that arrives
+            // after the checks changes it and the wait below falls through.
+            const uint32_t seen = m_render_signal.load();
+
+            // Resizes are all it gets so far.
+            bool resized = false;
+            while (std::optional<InputEvent> event = m_render_events.pop()) {
+                m_gfx.setFramebufferSize(event->width, event->height);
+                resized = true;
+            }
+
+            const bool fresh = m_packets.acquire();
+            const gfx::FramePacket &packet = m_packets.front();
+            if (packet.render_mode == gfx::RenderMode::OnDemand && !fresh && !resized) {
+                m_render_signal.wait(seen);
+                continue;
+            }
+
+            // In continuous mode, redraws the last packet if the simulation
+            // hasn't published a new one yet.
+            m_gfx.drawFrame(packet);
+
+            const gfx::RenderStats stats = m_gfx.stats();
+            m_render_stats.back() = stats;
+            m_render_stats.publish();
+
+            if (profile) {
+                const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+                if (last_frame != std::chrono::steady_clock::time_point{}) {
+                    m_frame_times.push_back(std::chrono::duration<float, std::milli>(now - last_frame).count());
+                }
+                last_frame = now;
+            }
+
+            if (m_config.frames != 0 && stats.frames >= m_config.frames) {
+                glfwSetWindowShouldClose(m_window, GLFW_TRUE);
+                glfwPostEmptyEvent();
+                break;
+            }
+
+            if (packet.render_mode == gfx::RenderMode::Continuous) {
+                m_limiter.setRate(packet.max_frame_rate);
+                m_limiter.wait();
+            }
+        }
+    } catch (const std::exception &e) {
+        BOOST_LOG_TRIVIAL(error) << "Render thread stopped: " << e.what();
+        // The main thread may be asleep in glfwWaitEvents.
+        glfwSetWindowShouldClose(m_window, GLFW_TRUE);
+        glfwPostEmptyEvent();
     }
 }
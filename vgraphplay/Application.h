@@ -3,14 +3,72 @@
 #ifndef _VGRAPHPLAY_VGRAPHPLAY_APPLICATION_H_
 #define _VGRAPHPLAY_VGRAPHPLAY_APPLICATION_H_
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
 #include "vulkan.h"
 
+#include "EventQueue.h"
+#include "FrameLimiter.h"
+#include "JobSystem.h"
+#include "RunConfig.h"
+#include "SimulationClock.h"
+#include "Transform.h"
+#include "TripleBuffer.h"
+#include "gfx/FramePacket.h"
 #include "gfx/System.h"
 
 namespace vgraphplay {
+    // A GLFW callback, queued for whichever thread handles it.
+    struct InputEvent {
+        enum class Type : uint8_t {
+            Key,
+            Resize,
+        };
+
+        Type type;
+        int key, scancode, action, mode;
+        int width, height;
+    };
+
+    // Runs input and simulation on the main thread (which GLFW requires
+    // for events) and rendering on a thread of its own, so neither waits
+    // on the other. GLFW callbacks only queue events. Each simulation step
+    // handles the queued input and publishes a FramePacket; the render
+    // thread draws the newest packet it has, sends back RenderStats, and
+    // picks up resizes from its own queue.
+    //
+    // Nothing polls. The main thread blocks in glfwWaitEvents until an
+    // event arrives, or the next simulation step is due while animating,
+    // and only publishes a packet when something marked the frame dirty.
+    // In on-demand mode the render thread draws once per packet and then
+    // sleeps too, so a static scene costs next to nothing; in continuous
+    // mode it redraws the latest packet at up to the frame rate limit.
+    //
+    // With a frame count in the run config, the render thread closes the
+    // window once it has drawn that many; in profile mode it also times
+    // every frame and the summary is printed on the way out.
     class Application {
     public:
-        Application(GLFWwindow *window, bool debug);
+        static constexpr size_t EVENT_QUEUE_SIZE = 256;
+
+        // Reasons to publish a new frame packet.
+        static constexpr uint32_t DIRTY_INPUT = 1 << 0;
+        static constexpr uint32_t DIRTY_RESIZE = 1 << 1;
+        static constexpr uint32_t DIRTY_ANIMATION = 1 << 2;
+        static constexpr uint32_t DIRTY_STREAMING = 1 << 3;
+        static constexpr uint32_t DIRTY_SETTINGS = 1 << 4;
+
+        // With --pin-threads: the main thread's core and the render
+        // thread's. Job workers get the ones after.
+        static constexpr unsigned MAIN_CORE = 0;
+        static constexpr unsigned RENDER_CORE = 1;
+
+        Application(GLFWwindow *window, const RunConfig &config);
         ~Application();
 
         // bool initialize(bool debug);
@@ -24,10 +82,56 @@ namespace vgraphplay {
 
         void run();
 
+        // From any thread, e.g. when a streamed asset finishes loading.
+        void markDirty(uint32_t flags);
+
+        // From any thread; they take effect with the next frame packet.
+        void setRenderMode(gfx::RenderMode mode);
+        void setFrameLimit(double max_frame_rate);
+
     private:
+        void waitEvents();
+        void simulate();
+        void step(float seconds);
+        void renderMain(std::stop_token stop);
+        void wakeRenderer();
+        void reportFrameTimes() const;
+
         GLFWwindow *m_window;
+        RunConfig m_config;
+        std::thread::id m_main_thread;
+        // Shared by every subsystem; created first so it outlives them.
+        JobSystem m_jobs;
         gfx::System m_gfx;
         int m_window_width, m_window_height;
+
+        // Simulation state. Main thread only.
+        SimulationClock m_clock;
+        std::vector<Transform> m_previous; // As of the step before last.
+        std::vector<Transform> m_current;
+        uint64_t m_sequence;
+        bool m_animating;
+        bool m_depth_prepass;
+
+        // Settings, which any thread may change; the simulation picks them
+        // up through m_dirty.
+        std::atomic<gfx::RenderMode> m_render_mode;
+        std::atomic<double> m_frame_limit;
+        std::atomic<uint32_t> m_dirty;
+
+        EventQueue<InputEvent, EVENT_QUEUE_SIZE> m_input_events;  // Callbacks -> simulation.
+        EventQueue<InputEvent, EVENT_QUEUE_SIZE> m_render_events; // Simulation -> render thread.
+        TripleBuffer<gfx::FramePacket> m_packets;
+        TripleBuffer<gfx::RenderStats> m_render_stats;
+
+        // Render thread only, apart from m_render_signal, which is bumped
+        // whenever there's something new for it.
+        std::atomic<uint32_t> m_render_signal;
+        FrameLimiter m_limiter;
+        std::vector<float> m_frame_times; // Milliseconds between frames, when profiling.
+
+        // Last, so it's joined before anything it uses is destroyed.
+        std::jthread m_render_thread;
     };
 }
 
@@ -0,0 +1,180 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <boost/log/trivial.hpp>
+
+#define STB_IMAGE_IMPLEMENTATION
+#define STBI_ONLY_ZLIB
+#define STBI_SUPPORT_ZLIB
+#include <stb_image.h>
+
+#include "AssetPack.h"
+#include "Log.h"
+
+namespace bip = boost::interprocess;
+
+// Whether length bytes at offset fit in size, without overflowing.
+static bool inRange(uint64_t offset, uint64_t length, uint64_t size) {
+    return offset <= size && length <= size - offset;
+}
+
+vgraphplay::AssetPack::AssetPack()
+    : m_file{},
+      m_region{},
+      m_base{nullptr},
+      m_header{nullptr},
+      m_entries{nullptr},
+      m_buckets{nullptr},
+      m_names{nullptr},
+      m_inflate_mutex{},
+      m_inflated{}
+{}
+
+vgraphplay::AssetPack::AssetPack(const std::string &path)
+    : AssetPack{}
+{
+    open(path);
+}
+
+vgraphplay::AssetPack::~AssetPack() {}
+
+void vgraphplay::AssetPack::open(const std::string &path) {
+    m_header = nullptr;
+    m_inflated.clear();
+
+    m_file = bip::file_mapping{path.c_str(), bip::read_only};
+    m_region = bip::mapped_region{m_file, bip::read_only};
+    m_base = static_cast<const unsigned char *>(m_region.get_address());
+    const size_t size = m_region.get_size();
+
+    if (size < sizeof(AssetPackHeader)) {
+        throw std::runtime_error("Asset pack is truncated: " + path);
+    }
+
+    const AssetPackHeader *header = reinterpret_cast<const AssetPackHeader *>(m_base);
+    if (std::memcmp(header->magic, ASSET_PACK_MAGIC, sizeof(ASSET_PACK_MAGIC)) != 0) {
+        throw std::runtime_error("Not an asset pack: " + path);
+    }
+
+    if (header->version != ASSET_PACK_VERSION) {
+        throw std::runtime_error("Unsupported asset pack version " + std::to_string(header->version) + ": " + path);
+    }
+
+    // lookup() stops at the first empty bucket, so there has to be at
+    // least one of those. The tables are read in place, and the mapping
+    // starts on a page, so their offsets have to be aligned for them.
+    if (header->bucket_count == 0 || (header->bucket_count & (header->bucket_count - 1)) != 0 ||
+        header->bucket_count <= header->entry_count ||
+        header->entries_offset % alignof(AssetPackEntry) != 0 ||
+        header->buckets_offset % alignof(uint32_t) != 0 ||
+        !inRange(header->entries_offset, sizeof(AssetPackEntry) * uint64_t{header->entry_count}, size) ||
+        !inRange(header->buckets_offset, sizeof(uint32_t) * uint64_t{header->bucket_count}, size) ||
+        !inRange(header->names_offset, header->names_size, size)) {
+        throw std::runtime_error("Asset pack table of contents is corrupt: " + path);
+    }
+
+    m_entries = reinterpret_cast<const AssetPackEntry *>(m_base + header->entries_offset);
+    m_buckets = reinterpret_cast<const uint32_t *>(m_base + header->buckets_offset);
+    m_names = reinterpret_cast<const char *>(m_base + header->names_offset);
+
+    for (uint32_t i = 0; i < header->bucket_count; ++i) {
+        if (m_buckets[i] > header->entry_count) {
+            throw std::runtime_error("Asset pack bucket " + std::to_string(i) + " is out of range: " + path);
+        }
+    }
+
+    for (uint32_t i = 0; i < header->entry_count; ++i) {
+        const AssetPackEntry &entry = m_entries[i];
+        if (!inRange(entry.offset, entry.stored_size, size) ||
+            !inRange(entry.name_offset, entry.name_length, header->names_size)) {
+            throw std::runtime_error("Asset pack entry " + std::to_string(i) + " is out of range: " + path);
+        }
+
+        // Stored entries are handed out as is, and zlib inflates into an
+        // int-sized buffer.
+        if ((entry.compression == AssetCompression::None && entry.size != entry.stored_size) ||
+            (entry.compression == AssetCompression::Zlib && (entry.size > INT_MAX || entry.stored_size > INT_MAX))) {
+            throw std::runtime_error("Asset pack entry " + std::to_string(i) + " has a bad size: " + path);
+        }
+    }
+
+    m_header = header;
+    m_inflated.resize(header->entry_count);
+    BOOST_LOG_TRIVIAL(trace) << "Mapped asset pack " << path << " with " << header->entry_count << " assets";
+}
+
+std::string_view vgraphplay::AssetPack::name(uint32_t index) const {
+    const AssetPackEntry &entry = m_entries[index];
+    return std::string_view{m_names + entry.name_offset, entry.name_length};
+}
+
+bool vgraphplay::AssetPack::contains(std::string_view name) const {
+    return lookup(name) != nullptr;
+}
+
+std::optional<Resource> vgraphplay::AssetPack::find(std::string_view name) {
+    const AssetPackEntry *entry = lookup(name);
+    if (entry == nullptr) {
+        return std::nullopt;
+    }
+    return load(*entry);
+}
+
+Resource vgraphplay::AssetPack::get(std::string_view name) {
+    const AssetPackEntry *entry = lookup(name);
+    if (entry == nullptr) {
+        throw std::runtime_error("Asset not found: " + std::string{name});
+    }
+    return load(*entry);
+}
+
+const vgraphplay::AssetPackEntry *vgraphplay::AssetPack::lookup(std::string_view name) const {
+    if (m_header == nullptr) {
+        return nullptr;
+    }
+
+    const uint64_t hash = assetNameHash(name);
+    const uint32_t mask = m_header->bucket_count - 1;
+
+    for (uint32_t bucket = static_cast<uint32_t>(hash) & mask; m_buckets[bucket] != 0; bucket = (bucket + 1) & mask) {
+        const AssetPackEntry &entry = m_entries[m_buckets[bucket] - 1];
+        if (entry.name_hash == hash && std::string_view{m_names + entry.name_offset, entry.name_length} == name) {
+            return &entry;
+        }
+    }
+
+    return nullptr;
+}
+
+Resource vgraphplay::AssetPack::load(const AssetPackEntry &entry) {
+    const unsigned char *stored = m_base + entry.offset;
+
+    switch (entry.compression) {
+    case AssetCompression::None:
+        return Resource(stored, entry.size);
+
+    case AssetCompression::Zlib: {
+        const size_t index = &entry - m_entries;
+        std::lock_guard<std::mutex> lock{m_inflate_mutex};
+
+        if (!m_inflated[index]) {
+            auto inflated = std::make_unique<unsigned char[]>(entry.size);
+            int len = stbi_zlib_decode_buffer(reinterpret_cast<char *>(inflated.get()), static_cast<int>(entry.size),
+                                              reinterpret_cast<const char *>(stored), static_cast<int>(entry.stored_size));
+            if (len < 0 || static_cast<uint64_t>(len) != entry.size) {
+                throw std::runtime_error("Unable to inflate asset " + std::string{name(static_cast<uint32_t>(index))});
+            }
+            VGRAPHPLAY_LOG(trace, "Inflated asset {}: {} -> {} bytes", name(static_cast<uint32_t>(index)), entry.stored_size, entry.size);
+            m_inflated[index] = std::move(inflated);
+        }
+
+        return Resource(m_inflated[index].get(), entry.size);
+    }
+    }
+
+    throw std::runtime_error("Unsupported compression for asset " + std::string{name(static_cast<uint32_t>(&entry - m_entries))});
+}
@@ -0,0 +1,64 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_ASSET_PACK_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_ASSET_PACK_H_
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "AssetPackFormat.h"
+#include "Resource.h"
+
+namespace vgraphplay {
+    // Read-only access to an asset pack written by the asset-packer build
+    // tool. The pack is memory-mapped, so opening it costs the same no matter
+    // how many assets it holds, and pages are only read in when an asset is
+    // touched. Uncompressed assets are returned as Resources pointing
+    // straight into the mapping; compressed ones are inflated on first use
+    // and kept for the lifetime of the pack.
+    class AssetPack {
+    public:
+        AssetPack();
+        explicit AssetPack(const std::string &path);
+        ~AssetPack();
+
+        AssetPack(const AssetPack &) = delete;
+        AssetPack &operator=(const AssetPack &) = delete;
+
+        // Maps the pack at path. Throws if it can't be read or isn't a
+        // well-formed pack, and leaves this one closed.
+        void open(const std::string &path);
+
+        bool isOpen() const { return m_header != nullptr; }
+        uint32_t size() const { return m_header != nullptr ? m_header->entry_count : 0; }
+        std::string_view name(uint32_t index) const;
+
+        bool contains(std::string_view name) const;
+        std::optional<Resource> find(std::string_view name);
+        Resource get(std::string_view name);
+
+    private:
+        const AssetPackEntry *lookup(std::string_view name) const;
+        Resource load(const AssetPackEntry &entry);
+
+        boost::interprocess::file_mapping m_file;
+        boost::interprocess::mapped_region m_region;
+        const unsigned char *m_base;
+        const AssetPackHeader *m_header;
+        const AssetPackEntry *m_entries;
+        const uint32_t *m_buckets;
+        const char *m_names;
+
+        std::mutex m_inflate_mutex;
+        std::vector<std::unique_ptr<unsigned char[]>> m_inflated;
+    };
+}
+
+#endif
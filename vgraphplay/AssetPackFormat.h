@@ -0,0 +1,65 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_ASSET_PACK_FORMAT_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_ASSET_PACK_FORMAT_H_
+
+#include <cstdint>
+#include <string_view>
+
+// On-disk layout of an asset pack, shared between the asset-packer build
+// tool and the runtime reader.
+//
+// A pack is an AssetPackHeader, followed by entry_count AssetPackEntry
+// records, then bucket_count uint32_t hash buckets, then the entry names,
+// then the (16-byte aligned) entry payloads. Buckets form an open-addressed
+// table over the entries: bucket_count is a power of two, an entry with
+// name hash h lives in the first non-empty bucket at or after
+// h & (bucket_count - 1), and each bucket holds an entry index plus one
+// (zero marks an empty bucket).
+
+namespace vgraphplay {
+    constexpr char ASSET_PACK_MAGIC[4] = {'V', 'P', 'A', 'K'};
+    constexpr uint32_t ASSET_PACK_VERSION = 1;
+
+    enum class AssetCompression : uint32_t {
+        None = 0,
+        Zlib = 1,
+    };
+
+    struct AssetPackHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t entry_count;
+        uint32_t bucket_count;
+        uint64_t entries_offset;
+        uint64_t buckets_offset;
+        uint64_t names_offset;
+        uint64_t names_size;
+    };
+
+    struct AssetPackEntry {
+        uint64_t name_hash;
+        uint32_t name_offset; // Relative to names_offset.
+        uint32_t name_length;
+        uint64_t offset;      // Relative to the start of the pack.
+        uint64_t stored_size;
+        uint64_t size;
+        AssetCompression compression;
+        uint32_t reserved;
+    };
+
+    static_assert(sizeof(AssetPackHeader) == 48, "AssetPackHeader layout changed");
+    static_assert(sizeof(AssetPackEntry) == 48, "AssetPackEntry layout changed");
+
+    // 64-bit FNV-1a.
+    constexpr uint64_t assetNameHash(std::string_view name) {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (char c : name) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 0x100000001b3ull;
+        }
+        return hash;
+    }
+}
+
+#endif
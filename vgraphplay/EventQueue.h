@@ -0,0 +1,51 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_EVENT_QUEUE_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_EVENT_QUEUE_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+
+namespace vgraphplay {
+    // Bounded single-producer, single-consumer queue. One thread pushes and
+    // one thread pops, with no locks; push fails when it's full.
+    template <typename T, size_t N>
+    class EventQueue {
+    public:
+        static_assert((N & (N - 1)) == 0, "EventQueue capacity must be a power of two");
+
+        EventQueue() : m_head{0}, m_tail{0}, m_events{} {}
+
+        EventQueue(const EventQueue &) = delete;
+        EventQueue &operator=(const EventQueue &) = delete;
+
+        bool push(const T &event) {
+            const size_t head = m_head.load(std::memory_order_relaxed);
+            if (head - m_tail.load(std::memory_order_acquire) == N) {
+                return false;
+            }
+            m_events[head & (N - 1)] = event;
+            m_head.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        std::optional<T> pop() {
+            const size_t tail = m_tail.load(std::memory_order_relaxed);
+            if (tail == m_head.load(std::memory_order_acquire)) {
+                return std::nullopt;
+            }
+            T event = m_events[tail & (N - 1)];
+            m_tail.store(tail + 1, std::memory_order_release);
+            return event;
+        }
+
+    private:
+        alignas(64) std::atomic<size_t> m_head; // Written by the producer.
+        alignas(64) std::atomic<size_t> m_tail; // Written by the consumer.
+        std::array<T, N> m_events;
+    };
+}
+
+#endif
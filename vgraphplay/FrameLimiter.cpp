@@ -0,0 +1,52 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#include <algorithm>
+#include <thread>
+
+#include "FrameLimiter.h"
+
+vgraphplay::FrameLimiter::FrameLimiter(double max_rate)
+    : m_rate{0.0},
+      m_period{Clock::duration::zero()},
+      m_next{},
+      m_spin{std::chrono::milliseconds{1}}
+{
+    setRate(max_rate);
+}
+
+void vgraphplay::FrameLimiter::setRate(double max_rate) {
+    if (max_rate == m_rate) {
+        return;
+    }
+    m_rate = max_rate;
+    m_period = max_rate > 0.0
+        ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / max_rate))
+        : Clock::duration::zero();
+    m_next = Clock::time_point{};
+}
+
+void vgraphplay::FrameLimiter::wait() {
+    if (m_period == Clock::duration::zero()) {
+        return;
+    }
+
+    Clock::time_point now = Clock::now();
+    if (m_next == Clock::time_point{} || now - m_next > m_period) {
+        m_next = now + m_period;
+        return;
+    }
+
+    const Clock::time_point wake = m_next - m_spin;
+    if (now < wake) {
+        std::this_thread::sleep_until(wake);
+        now = Clock::now();
+        const Clock::duration overslept = now - wake;
+        m_spin = std::clamp(std::max(overslept + overslept / 4, m_spin - m_spin / 16), MIN_SPIN, MAX_SPIN);
+    }
+
+    while (now < m_next) {
+        std::this_thread::yield();
+        now = Clock::now();
+    }
+    m_next += m_period;
+}
@@ -0,0 +1,43 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_FRAME_LIMITER_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_FRAME_LIMITER_H_
+
+#include <chrono>
+
+namespace vgraphplay {
+    // Paces a loop to a maximum rate. The OS sleep alone is too coarse
+    // (it can overshoot by a millisecond or more), and spinning the whole
+    // time burns a core, so wait() sleeps until shortly before the
+    // deadline and spins the rest. The spin margin follows the worst
+    // recent oversleep: it grows at once when a sleep overshoots and
+    // shrinks slowly when sleeps are accurate.
+    class FrameLimiter {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        static constexpr Clock::duration MIN_SPIN = std::chrono::microseconds{200};
+        static constexpr Clock::duration MAX_SPIN = std::chrono::milliseconds{4};
+
+        // 0 means unlimited.
+        explicit FrameLimiter(double max_rate = 0.0);
+
+        void setRate(double max_rate);
+        double rate() const { return m_rate; }
+
+        // Returns once the next frame is due. A frame that starts more than
+        // a whole period late restarts the schedule instead of letting the
+        // following frames rush to catch up.
+        void wait();
+
+        Clock::duration spinMargin() const { return m_spin; }
+
+    private:
+        double m_rate;
+        Clock::duration m_period;
+        Clock::time_point m_next;
+        Clock::duration m_spin;
+    };
+}
+
+#endif
@@ -0,0 +1,394 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#include <exception>
+
+#include <boost/log/trivial.hpp>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+#include "JobSystem.h"
+#include "Log.h"
+
+static thread_local const vgraphplay::JobSystem *t_system = nullptr;
+static thread_local int t_index = -1;
+
+vgraphplay::JobCounter::JobCounter()
+    : m_pending{0},
+      m_mutex{},
+      m_waiting{}
+{}
+
+// Only has waiting jobs if the counter never reached zero, e.g. because
+// the JobSystem shut down first; they'll never run.
+vgraphplay::JobCounter::~JobCounter() {
+    for (Job *job : m_waiting) {
+        if (job->owned) {
+            delete job;
+        }
+    }
+}
+
+vgraphplay::JobDeque::JobDeque()
+    : m_top{0},
+      m_bottom{0},
+      m_jobs{new std::atomic<Job *>[CAPACITY]}
+{}
+
+bool vgraphplay::JobDeque::push(Job *job) {
+    const int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+    const int64_t top = m_top.load(std::memory_order_acquire);
+    if (bottom - top >= CAPACITY) {
+        return false;
+    }
+
+    m_jobs[bottom & MASK].store(job, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    return true;
+}
+
+vgraphplay::Job *vgraphplay::JobDeque::pop() {
+    const int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+    m_bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = m_top.load(std::memory_order_relaxed);
+
+    if (top > bottom) {
+        // Empty.
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    Job *job = m_jobs[bottom & MASK].load(std::memory_order_acquire);
+    if (top == bottom) {
+        // The last job; race any thieves for it.
+        if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            job = nullptr;
+        }
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+vgraphplay::Job *vgraphplay::JobDeque::steal() {
+    int64_t top = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t bottom = m_bottom.load(std::memory_order_acquire);
+    if (top >= bottom) {
+        return nullptr;
+    }
+
+    Job *job = m_jobs[top & MASK].load(std::memory_order_acquire);
+    if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        // Lost to the owner or another thief.
+        return nullptr;
+    }
+    return job;
+}
+
+vgraphplay::JobSystem::JobSystem()
+    : JobSystem{Config{}}
+{}
+
+vgraphplay::JobSystem::JobSystem(const Config &config)
+    : m_deques{},
+      m_threads{},
+      m_shared_mutex{},
+      m_shared{},
+      m_home_mutex{},
+      m_home_jobs{},
+      m_home_wake{},
+      m_epoch{0},
+      m_sleepers{0},
+      m_stop{false}
+{
+    unsigned workers = config.workers;
+    if (workers == 0) {
+        const unsigned hardware = std::thread::hardware_concurrency();
+        workers = hardware > 1 ? hardware - 1 : 1;
+    }
+
+    t_system = this;
+    t_index = 0;
+
+    for (unsigned i = 0; i <= workers; ++i) {
+        m_deques.push_back(std::make_unique<JobDeque>());
+    }
+
+    m_threads.reserve(workers);
+    for (unsigned i = 0; i < workers; ++i) {
+        const int self = static_cast<int>(i + 1);
+        const bool pin = config.pin_workers;
+        const unsigned core = config.first_core + i;
+        m_threads.emplace_back([this, self, pin, core] {
+            if (pin && !pinCurrentThread(core)) {
+                BOOST_LOG_TRIVIAL(info) << "Couldn't pin job worker " << self << " to core " << core;
+            }
+            workerMain(self);
+        });
+    }
+
+    BOOST_LOG_TRIVIAL(trace) << "Started job system with " << workers << " workers";
+}
+
+vgraphplay::JobSystem::~JobSystem() {
+    m_stop.store(true);
+    wake(true);
+    m_threads.clear();
+
+    // Whatever's still queued never ran. With the workers gone nothing
+    // else touches the queues, so this thread can empty them all.
+    // (parallelFor's jobs aren't owned, but its caller waits for them, so
+    // none are left.) Jobs still waiting on a counter go with the counter.
+    size_t dropped = 0;
+    auto drop = [&dropped](Job *job) {
+        if (job->owned) {
+            delete job;
+        }
+        ++dropped;
+    };
+    for (auto &deque : m_deques) {
+        while (Job *job = deque->steal()) {
+            drop(job);
+        }
+    }
+    for (Job *job : m_shared) {
+        drop(job);
+    }
+    m_shared.clear();
+    for (Job *job : m_home_jobs) {
+        drop(job);
+    }
+    m_home_jobs.clear();
+    if (dropped != 0) {
+        BOOST_LOG_TRIVIAL(info) << "Dropped " << dropped << " unfinished jobs at shutdown";
+    }
+
+    if (t_system == this) {
+        t_system = nullptr;
+        t_index = -1;
+    }
+}
+
+int vgraphplay::JobSystem::threadIndex() {
+    return t_system != nullptr ? t_index : -1;
+}
+
+bool vgraphplay::JobSystem::pinCurrentThread(unsigned core) {
+#if defined(__linux__)
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(core, &cpus);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+#elif defined(_WIN32)
+    return core < 64 && SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR{1} << core) != 0;
+#else
+    (void)core;
+    return false;
+#endif
+}
+
+void vgraphplay::JobSystem::run(JobFunction fn, JobCounter *signal, JobCounter *after, JobAffinity affinity) {
+    schedule(new Job{std::move(fn), signal, affinity, true}, signal, after);
+}
+
+void vgraphplay::JobSystem::wait(JobCounter &counter) {
+    const int self = t_system == this ? t_index : -1;
+    while (!counter.done()) {
+        const uint32_t seen = m_epoch.load();
+        if (runOne(self)) {
+            continue;
+        }
+        if (counter.done()) {
+            break;
+        }
+
+        m_sleepers.fetch_add(1);
+        if (m_epoch.load() == seen && !counter.done()) {
+            m_epoch.wait(seen);
+        }
+        m_sleepers.fetch_sub(1);
+    }
+
+    // The last finish() may still be holding the lock.
+    std::lock_guard lock{counter.m_mutex};
+}
+
+void vgraphplay::JobSystem::runHomeJobs() {
+    for (;;) {
+        Job *job = nullptr;
+        {
+            std::lock_guard lock{m_home_mutex};
+            if (m_home_jobs.empty()) {
+                return;
+            }
+            job = m_home_jobs.front();
+            m_home_jobs.pop_front();
+        }
+        execute(job);
+    }
+}
+
+void vgraphplay::JobSystem::schedule(Job *job, JobCounter *signal, JobCounter *after) {
+    if (signal != nullptr) {
+        signal->m_pending.fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    if (after != nullptr) {
+        std::lock_guard lock{after->m_mutex};
+        if (after->m_pending.load(std::memory_order_acquire) != 0) {
+            after->m_waiting.push_back(job);
+            return;
+        }
+    }
+
+    enqueue(job);
+}
+
+void vgraphplay::JobSystem::enqueue(Job *job) {
+    if (job->affinity == JobAffinity::Home) {
+        {
+            std::lock_guard lock{m_home_mutex};
+            m_home_jobs.push_back(job);
+        }
+        // Make sure the home thread is among whoever wakes up.
+        wake(true);
+        if (m_home_wake) {
+            m_home_wake();
+        }
+        return;
+    }
+
+    const int self = t_system == this ? t_index : -1;
+    if (self >= 0) {
+        if (!m_deques[self]->push(job)) {
+            // Full: this thread has plenty queued already, so just run it.
+            execute(job);
+            return;
+        }
+    } else {
+        std::lock_guard lock{m_shared_mutex};
+        m_shared.push_back(job);
+    }
+    wake(false);
+}
+
+void vgraphplay::JobSystem::execute(Job *job) {
+    try {
+        job->fn();
+    } catch (const std::exception &e) {
+        VGRAPHPLAY_LOG(error, "Job threw: {}", e.what());
+    }
+
+    // Once the counter is signalled the job may be gone (parallelFor's
+    // are on the waiter's stack), so don't touch it after.
+    JobCounter *signal = job->signal;
+    if (job->owned) {
+        delete job;
+    }
+    if (signal != nullptr) {
+        finish(*signal);
+    }
+}
+
+void vgraphplay::JobSystem::finish(JobCounter &counter) {
+    std::vector<Job *> ready;
+    {
+        std::lock_guard lock{counter.m_mutex};
+        if (counter.m_pending.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+            return;
+        }
+        ready.swap(counter.m_waiting);
+    }
+
+    for (Job *job : ready) {
+        enqueue(job);
+    }
+    // Anyone waiting on the counter.
+    wake(true);
+}
+
+bool vgraphplay::JobSystem::runOne(int self) {
+    Job *job = find(self);
+    if (job == nullptr) {
+        return false;
+    }
+    execute(job);
+    return true;
+}
+
+vgraphplay::Job *vgraphplay::JobSystem::find(int self) {
+    if (self == 0) {
+        std::lock_guard lock{m_home_mutex};
+        if (!m_home_jobs.empty()) {
+            Job *job = m_home_jobs.front();
+            m_home_jobs.pop_front();
+            return job;
+        }
+    }
+
+    if (self >= 0) {
+        if (Job *job = m_deques[self]->pop()) {
+            return job;
+        }
+    }
+
+    {
+        std::lock_guard lock{m_shared_mutex};
+        if (!m_shared.empty()) {
+            Job *job = m_shared.front();
+            m_shared.pop_front();
+            return job;
+        }
+    }
+
+    // Start with the next thread along, so thieves spread out.
+    const size_t count = m_deques.size();
+    const size_t start = self >= 0 ? static_cast<size_t>(self) + 1 : 0;
+    for (size_t i = 0; i < count; ++i) {
+        const size_t victim = (start + i) % count;
+        if (static_cast<int>(victim) == self) {
+            continue;
+        }
+        if (Job *job = m_deques[victim]->steal()) {
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+void vgraphplay::JobSystem::workerMain(int self) {
+    t_system = this;
+    t_index = self;
+
+    while (!m_stop.load()) {
+        const uint32_t seen = m_epoch.load();
+        if (runOne(self)) {
+            continue;
+        }
+
+        m_sleepers.fetch_add(1);
+        if (m_epoch.load() == seen && !m_stop.load()) {
+            m_epoch.wait(seen);
+        }
+        m_sleepers.fetch_sub(1);
+    }
+}
+
+void vgraphplay::JobSystem::wake(bool all) {
+    m_epoch.fetch_add(1);
+    if (m_sleepers.load() == 0) {
+        return;
+    }
+    if (all) {
+        m_epoch.notify_all();
+    } else {
+        m_epoch.notify_one();
+    }
+}
@@ -0,0 +1,209 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_JOB_SYSTEM_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_JOB_SYSTEM_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vgraphplay {
+    class JobCounter;
+    class JobSystem;
+
+    using JobFunction = std::move_only_function<void()>;
+
+    enum class JobAffinity : uint8_t {
+        Any,  // Any worker, or a thread waiting on a counter.
+        Home, // Only the thread that created the JobSystem.
+    };
+
+    struct Job {
+        JobFunction fn;
+        JobCounter *signal;
+        JobAffinity affinity;
+        bool owned; // Deleted by the scheduler once it has run.
+    };
+
+    // Counts unfinished jobs. Jobs that signal a counter increment it when
+    // they're scheduled and decrement it when they finish; jobs scheduled
+    // after a counter don't start until it reaches zero. Don't destroy a
+    // counter, or add jobs to it, until JobSystem::wait on it returns.
+    class JobCounter {
+    public:
+        JobCounter();
+        ~JobCounter();
+
+        JobCounter(const JobCounter &) = delete;
+        JobCounter &operator=(const JobCounter &) = delete;
+
+        uint32_t pending() const { return m_pending.load(std::memory_order_acquire); }
+        bool done() const { return pending() == 0; }
+
+    private:
+        friend class JobSystem;
+
+        std::atomic<uint32_t> m_pending;
+        std::mutex m_mutex;
+        std::vector<Job *> m_waiting; // Scheduled when m_pending reaches zero.
+    };
+
+    // Chase-Lev work-stealing deque of jobs (Lê et al., "Correct and
+    // Efficient Work-Stealing for Weak Memory Models"). Only the owning
+    // thread pushes and pops, at the bottom; any thread steals from the
+    // top. Fixed capacity: push fails when it's full and the caller runs
+    // the job itself. Slots are stored with release and loaded with
+    // acquire on top of the paper's fences, which costs nothing on x86
+    // and keeps ThreadSanitizer able to follow jobs between threads.
+    class JobDeque {
+    public:
+        static constexpr int64_t CAPACITY = 4096;
+
+        JobDeque();
+
+        bool push(Job *job);
+        Job *pop();
+        Job *steal();
+
+    private:
+        static constexpr int64_t MASK = CAPACITY - 1;
+
+        alignas(64) std::atomic<int64_t> m_top;
+        alignas(64) std::atomic<int64_t> m_bottom;
+        std::unique_ptr<std::atomic<Job *>[]> m_jobs;
+    };
+
+    // A fixed pool of worker threads, each with its own deque. Workers
+    // pop their own jobs newest first and, when they run out, steal the
+    // oldest jobs of other threads; idle workers sleep until something is
+    // scheduled. The thread that creates the JobSystem (the home thread)
+    // has a deque too and runs jobs while it waits on a counter, so it
+    // never sits idle; other threads hand jobs to a shared queue.
+    //
+    // Home-affinity jobs only ever run on the home thread, from wait() or
+    // runHomeJobs(), for work tied to it (e.g. GLFW calls).
+    class JobSystem {
+    public:
+        struct Config {
+            // 0 means one per hardware thread, minus the home thread.
+            unsigned workers = 0;
+            // Pins worker N to core first_core + N - 1, leaving the cores
+            // below first_core to the home thread and whoever else asks
+            // for one. Only on platforms that support it.
+            bool pin_workers = false;
+            unsigned first_core = 1;
+        };
+
+        JobSystem();
+        explicit JobSystem(const Config &config);
+        // Jobs that haven't started by now are dropped without running.
+        ~JobSystem();
+
+        JobSystem(const JobSystem &) = delete;
+        JobSystem &operator=(const JobSystem &) = delete;
+
+        // Worker threads, not counting the home thread.
+        unsigned workers() const { return static_cast<unsigned>(m_threads.size()); }
+
+        // Index of the calling thread: 0 for the home thread, 1 and up for
+        // workers, or -1 for any other thread.
+        static int threadIndex();
+
+        // Pins the calling thread to a core. Returns false where that
+        // isn't supported.
+        static bool pinCurrentThread(unsigned core);
+
+        // Schedules fn. If signal isn't null it's incremented now and
+        // decremented when fn returns. If after isn't null, fn won't start
+        // until after reaches zero.
+        void run(JobFunction fn, JobCounter *signal = nullptr, JobCounter *after = nullptr, JobAffinity affinity = JobAffinity::Any);
+
+        // Runs other jobs until counter reaches zero.
+        void wait(JobCounter &counter);
+
+        // Runs the home-affinity jobs scheduled so far. Home thread only.
+        void runHomeJobs();
+
+        // Called whenever a home-affinity job is scheduled, so a home
+        // thread that blocks somewhere other than wait() (e.g. in
+        // glfwWaitEvents) can be woken to run it. Set before scheduling
+        // any.
+        void setHomeWake(std::function<void()> wake) { m_home_wake = std::move(wake); }
+
+        // Calls fn(begin, end) over [0, count) in ranges of at least grain
+        // items, spread across the workers and the calling thread, and
+        // returns once they've all finished, even if the calling thread's
+        // range throws. The jobs go in one vector, so a call makes one
+        // allocation however many ranges it has.
+        template <typename F>
+        void parallelFor(size_t count, size_t grain, F &&fn) {
+            if (count == 0) {
+                return;
+            }
+
+            const size_t max_ranges = static_cast<size_t>(workers()) + 1;
+            const size_t ranges = std::clamp<size_t>(count / std::max<size_t>(grain, 1), 1, max_ranges);
+            const size_t range_size = (count + ranges - 1) / ranges;
+            if (ranges == 1) {
+                fn(size_t{0}, count);
+                return;
+            }
+
+            JobCounter counter;
+            std::vector<Job> jobs(ranges - 1);
+            for (size_t r = 1; r < ranges; ++r) {
+                const size_t begin = std::min(count, r * range_size);
+                const size_t end = std::min(count, begin + range_size);
+                jobs[r - 1] = Job{[&fn, begin, end] { fn(begin, end); }, &counter, JobAffinity::Any, false};
+                schedule(&jobs[r - 1], &counter, nullptr);
+            }
+            // The jobs and counter are in this frame, so it can't be left
+            // while workers are still running them.
+            try {
+                fn(size_t{0}, std::min(count, range_size));
+            } catch (...) {
+                wait(counter);
+                throw;
+            }
+            wait(counter);
+        }
+
+    private:
+        void schedule(Job *job, JobCounter *signal, JobCounter *after);
+        void enqueue(Job *job);
+        void execute(Job *job);
+        void finish(JobCounter &counter);
+
+        // Finds a job for thread index self and runs it. Returns false if
+        // there was nothing to run.
+        bool runOne(int self);
+        Job *find(int self);
+        void workerMain(int self);
+        void wake(bool all);
+
+        std::vector<std::unique_ptr<JobDeque>> m_deques; // [0] is the home thread's.
+        std::vector<std::jthread> m_threads;
+
+        std::mutex m_shared_mutex;
+        std::deque<Job *> m_shared; // From threads without a deque.
+        std::mutex m_home_mutex;
+        std::deque<Job *> m_home_jobs;
+        std::function<void()> m_home_wake;
+
+        // Bumped whenever there's something new to look at: a job
+        // scheduled, a counter reaching zero, or shutdown. Sleepers wait on
+        // it changing.
+        std::atomic<uint32_t> m_epoch;
+        std::atomic<uint32_t> m_sleepers;
+        std::atomic<bool> m_stop;
+    };
+}
+
+#endif
@@ -0,0 +1,130 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#include <algorithm>
+#include <exception>
+
+#include "Log.h"
+
+vgraphplay::LogRing::LogRing()
+    : m_head{0},
+      m_tail{0},
+      m_reserved{0},
+      m_dropped{0},
+      m_data{new std::byte[CAPACITY]}
+{}
+
+std::byte *vgraphplay::LogRing::reserve(size_t size) {
+    size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    const size_t head = m_head.load(std::memory_order_relaxed);
+    const size_t tail = m_tail.load(std::memory_order_acquire);
+    const size_t offset = head & MASK;
+    const size_t before_end = CAPACITY - offset;
+    const size_t needed = size <= before_end ? size : before_end + size;
+
+    if (size > CAPACITY / 2 || head + needed - tail > CAPACITY) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    if (needed != size) {
+        const uint32_t padding = static_cast<uint32_t>(before_end) | PADDING;
+        std::memcpy(m_data.get() + offset, &padding, sizeof(padding));
+    }
+
+    m_reserved = needed;
+    std::byte *record = m_data.get() + ((head + needed - size) & MASK);
+    const uint32_t record_size = static_cast<uint32_t>(size);
+    std::memcpy(record, &record_size, sizeof(record_size));
+    return record;
+}
+
+void vgraphplay::LogRing::commit() {
+    m_head.store(m_head.load(std::memory_order_relaxed) + m_reserved, std::memory_order_release);
+}
+
+// Each thread's ring is shared with the logger, which drains whatever's
+// left once the thread has gone and then lets it go.
+struct ThreadRing {
+    std::shared_ptr<vgraphplay::LogRing> ring;
+};
+
+vgraphplay::Logger::Logger()
+    : m_level{LogLevel::trace},
+      m_rings_mutex{},
+      m_rings{},
+      m_drain_mutex{},
+      m_line{},
+      m_wake_mutex{},
+      m_wake{},
+      m_writer{}
+{
+    m_writer = std::jthread{[this](std::stop_token stop) { writerMain(stop); }};
+}
+
+vgraphplay::Logger::~Logger() {
+    m_writer.request_stop();
+    m_writer.join();
+    drain();
+}
+
+void vgraphplay::Logger::flush() {
+    instance().drain();
+}
+
+vgraphplay::LogRing &vgraphplay::Logger::threadRing() {
+    thread_local ThreadRing t_ring{};
+    if (!t_ring.ring) {
+        t_ring.ring = std::make_shared<LogRing>();
+        std::lock_guard lock{m_rings_mutex};
+        m_rings.push_back(t_ring.ring);
+    }
+    return *t_ring.ring;
+}
+
+// Polls the rings rather than have writers signal it, so logging never
+// makes a system call. It checks often while records are coming in and
+// backs off while they aren't.
+void vgraphplay::Logger::writerMain(std::stop_token stop) {
+    std::chrono::milliseconds interval = MIN_FLUSH_INTERVAL;
+    while (!stop.stop_requested()) {
+        if (drain() > 0) {
+            interval = MIN_FLUSH_INTERVAL;
+        } else {
+            interval = std::min(interval * 2, MAX_FLUSH_INTERVAL);
+        }
+
+        std::unique_lock lock{m_wake_mutex};
+        m_wake.wait_for(lock, stop, interval, [] { return false; });
+    }
+}
+
+size_t vgraphplay::Logger::drain() {
+    std::vector<std::shared_ptr<LogRing>> rings;
+    {
+        std::lock_guard lock{m_rings_mutex};
+        rings = m_rings;
+    }
+
+    std::lock_guard lock{m_drain_mutex};
+    size_t count = 0;
+    for (const std::shared_ptr<LogRing> &ring : rings) {
+        count += ring->drain([this](const LogRecord &record) {
+            m_line.clear();
+            try {
+                record.decode(reinterpret_cast<const std::byte *>(&record + 1), {record.format, record.format_size}, m_line);
+            } catch (const std::exception &e) {
+                m_line.append("(unformattable log record: ").append(e.what()).append(")");
+            }
+            BOOST_LOG_SEV(boost::log::trivial::logger::get(), record.level) << m_line;
+        });
+
+        if (const uint64_t dropped = ring->takeDropped(); dropped > 0) {
+            BOOST_LOG_TRIVIAL(warning) << "Log ring was full; dropped " << dropped << " records";
+        }
+    }
+
+    // Rings whose threads have exited, now that they're empty.
+    std::lock_guard rings_lock{m_rings_mutex};
+    std::erase_if(m_rings, [](const std::shared_ptr<LogRing> &ring) { return ring.use_count() == 2 && ring->empty(); });
+    return count;
+}
@@ -0,0 +1,291 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_LOG_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_LOG_H_
+
+#include <atomic>
+#include <chrono>
+#include <concepts>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include <boost/log/trivial.hpp>
+
+// Levels below this are compiled out, arguments and all: 0 (trace) to 5
+// (fatal), as boost::log::trivial::severity_level. Release builds keep
+// info and up.
+#ifndef VGRAPHPLAY_LOG_LEVEL
+#ifdef NDEBUG
+#define VGRAPHPLAY_LOG_LEVEL 2
+#else
+#define VGRAPHPLAY_LOG_LEVEL 0
+#endif
+#endif
+
+// Logs through the asynchronous logger, e.g.
+//
+//     VGRAPHPLAY_LOG(trace, "Destroyed {} objects", count);
+//
+// level is one of Boost.Log's trivial severities. The format string is
+// checked at compile time.
+#define VGRAPHPLAY_LOG(level, ...)                                                              \
+    do {                                                                                        \
+        if constexpr (::boost::log::trivial::level >= VGRAPHPLAY_LOG_LEVEL) {                   \
+            ::vgraphplay::Logger::log(::boost::log::trivial::level, __VA_ARGS__);               \
+        }                                                                                       \
+    } while (false)
+
+namespace vgraphplay {
+    using LogLevel = boost::log::trivial::severity_level;
+
+    // How a log argument is copied into a ring and read back out on the
+    // logger thread, where it's formatted as Decoded:
+    //
+    // - Strings are copied, and come back as string_views into the ring.
+    // - Vulkan-Hpp handles come back as their raw 64-bit value.
+    // - Anything trivially copyable with a to_string() found by ADL (e.g.
+    //   Vulkan-Hpp enums and flags) is copied as is and converted on the
+    //   logger thread, not the caller's.
+    // - Anything else trivially copyable is copied as is.
+    template <typename T>
+    struct LogArg;
+
+    template <typename T>
+    concept LogString = std::convertible_to<const T &, std::string_view>;
+
+    template <typename T>
+    concept LogHandle = requires {
+        typename T::CType;
+        T::objectType;
+    };
+
+    template <typename T>
+    concept LogStringable = std::is_trivially_copyable_v<T> && requires(const T &t) {
+        { to_string(t) } -> std::convertible_to<std::string>;
+    };
+
+    template <LogString T>
+    struct LogArg<T> {
+        using Decoded = std::string_view;
+
+        static size_t size(const T &value) { return sizeof(uint32_t) + std::string_view{value}.size(); }
+
+        static std::byte *encode(std::byte *out, const T &value) {
+            const std::string_view str{value};
+            const uint32_t length = static_cast<uint32_t>(str.size());
+            std::memcpy(out, &length, sizeof(length));
+            std::memcpy(out + sizeof(length), str.data(), length);
+            return out + sizeof(length) + length;
+        }
+
+        static Decoded decode(const std::byte *&in) {
+            uint32_t length;
+            std::memcpy(&length, in, sizeof(length));
+            const char *data = reinterpret_cast<const char *>(in + sizeof(length));
+            in += sizeof(length) + length;
+            return Decoded{data, length};
+        }
+    };
+
+    template <typename T>
+        requires (!LogString<T> && std::is_trivially_copyable_v<T>)
+    struct LogArg<T> {
+        using Decoded = std::conditional_t<LogHandle<T>, uint64_t, std::conditional_t<LogStringable<T>, std::string, T>>;
+
+        static size_t size(const T &) { return sizeof(T); }
+
+        static std::byte *encode(std::byte *out, const T &value) {
+            std::memcpy(out, &value, sizeof(T));
+            return out + sizeof(T);
+        }
+
+        static Decoded decode(const std::byte *&in) {
+            T value;
+            std::memcpy(&value, in, sizeof(T));
+            in += sizeof(T);
+            if constexpr (LogHandle<T>) {
+                const typename T::CType raw = value;
+                if constexpr (std::is_pointer_v<typename T::CType>) {
+                    return reinterpret_cast<uintptr_t>(raw);
+                } else {
+                    return static_cast<uint64_t>(raw);
+                }
+            } else if constexpr (LogStringable<T>) {
+                return to_string(value);
+            } else {
+                return value;
+            }
+        }
+    };
+
+    // What's stored for an argument of type T, e.g. const char * for a
+    // string literal.
+    template <typename T>
+    using LogValue = std::decay_t<const T &>;
+
+    template <typename T>
+    using LogDecoded = typename LogArg<LogValue<T>>::Decoded;
+
+    // Formats a record's arguments, read back from the ring, onto out.
+    using LogDecodeFn = void (*)(const std::byte *args, std::string_view format, std::string &out);
+
+    // What goes in the ring ahead of each record's arguments.
+    struct LogRecord {
+        uint32_t size; // Of the whole record, padded to LogRing::ALIGNMENT. The top bit marks padding.
+        LogLevel level;
+        LogDecodeFn decode;
+        const char *format; // Always a literal, so it outlives the record.
+        size_t format_size;
+    };
+
+    // One thread's records on their way to the logger thread: a
+    // single-producer, single-consumer ring of variable-size records.
+    // Records never straddle the end; one that doesn't fit before it
+    // leaves padding and starts over at the beginning. When the ring is
+    // full the record is dropped (and counted) rather than blocking.
+    class LogRing {
+    public:
+        static constexpr size_t CAPACITY = 64 * 1024;
+        static constexpr size_t ALIGNMENT = alignof(LogRecord);
+        static constexpr uint32_t PADDING = 0x80000000;
+
+        LogRing();
+
+        // Writer. Returns where to put size bytes, or nullptr if they
+        // don't fit, and then commit() makes them visible.
+        std::byte *reserve(size_t size);
+        void commit();
+
+        // Reader. Calls fn(const LogRecord &) for everything committed so
+        // far, and returns how many records that was.
+        template <typename F>
+        size_t drain(F &&fn) {
+            const size_t head = m_head.load(std::memory_order_acquire);
+            size_t tail = m_tail.load(std::memory_order_relaxed);
+            size_t count = 0;
+            while (tail != head) {
+                const LogRecord *record = reinterpret_cast<const LogRecord *>(m_data.get() + (tail & MASK));
+                if ((record->size & PADDING) == 0) {
+                    fn(*record);
+                    ++count;
+                }
+                tail += record->size & ~PADDING;
+            }
+            m_tail.store(tail, std::memory_order_release);
+            return count;
+        }
+
+        uint64_t takeDropped() { return m_dropped.exchange(0, std::memory_order_relaxed); }
+        bool empty() const { return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire); }
+
+    private:
+        static constexpr size_t MASK = CAPACITY - 1;
+
+        alignas(64) std::atomic<size_t> m_head; // Both only ever increase.
+        alignas(64) std::atomic<size_t> m_tail;
+        size_t m_reserved;                      // Writer only: bytes the pending reserve() takes.
+        std::atomic<uint64_t> m_dropped;
+        std::unique_ptr<std::byte[]> m_data;
+    };
+
+    // Logging that costs the caller about as much as copying its arguments.
+    // Each thread writes binary records (a format string literal, a decode
+    // function, and the raw arguments) into its own LogRing; a background
+    // thread drains the rings, formats the records, and hands them to
+    // Boost.Log, so sinks and filters set up there still apply. Records
+    // from one thread stay in order; records from different threads are
+    // only roughly interleaved.
+    //
+    // Levels below VGRAPHPLAY_LOG_LEVEL are compiled out. Above it,
+    // setLevel() filters at run time before anything is copied.
+    class Logger {
+    public:
+        static constexpr std::chrono::milliseconds MIN_FLUSH_INTERVAL{1};
+        static constexpr std::chrono::milliseconds MAX_FLUSH_INTERVAL{100};
+
+        static Logger &instance() {
+            static Logger logger;
+            return logger;
+        }
+
+        static void setLevel(LogLevel level) { instance().m_level.store(level, std::memory_order_relaxed); }
+        static bool enabled(LogLevel level) { return level >= instance().m_level.load(std::memory_order_relaxed); }
+
+        template <typename... Args>
+        static void log(LogLevel level, std::format_string<LogDecoded<Args>...> format, const Args &...args) {
+            Logger &logger = instance();
+            if (level < logger.m_level.load(std::memory_order_relaxed)) {
+                return;
+            }
+
+            const std::string_view fmt = format.get();
+            const size_t size = sizeof(LogRecord) + (size_t{0} + ... + LogArg<LogValue<Args>>::size(args));
+            LogRing &ring = logger.threadRing();
+            std::byte *out = ring.reserve(size);
+            if (out == nullptr) {
+                return;
+            }
+
+            LogRecord *record = reinterpret_cast<LogRecord *>(out);
+            record->level = level;
+            record->decode = &decode<LogValue<Args>...>;
+            record->format = fmt.data();
+            record->format_size = fmt.size();
+            out += sizeof(LogRecord);
+            ((out = LogArg<LogValue<Args>>::encode(out, args)), ...);
+            ring.commit();
+        }
+
+        // Writes out everything logged so far, from any thread.
+        static void flush();
+
+    private:
+        Logger();
+        ~Logger();
+
+        Logger(const Logger &) = delete;
+        Logger &operator=(const Logger &) = delete;
+
+        template <typename... Args>
+        static void decode(const std::byte *in, std::string_view format, std::string &out) {
+            // Braced initialization reads the arguments in order.
+            std::tuple<typename LogArg<Args>::Decoded...> values{LogArg<Args>::decode(in)...};
+            std::apply([&](auto &...value) {
+                std::vformat_to(std::back_inserter(out), format, std::make_format_args(value...));
+            }, values);
+        }
+
+        LogRing &threadRing();
+        void writerMain(std::stop_token stop);
+
+        // Returns how many records were written.
+        size_t drain();
+
+        std::atomic<LogLevel> m_level;
+
+        std::mutex m_rings_mutex;
+        std::vector<std::shared_ptr<LogRing>> m_rings;
+
+        // Held while draining, so flush() and the logger thread take turns.
+        std::mutex m_drain_mutex;
+        std::string m_line;
+
+        std::mutex m_wake_mutex;
+        std::condition_variable_any m_wake;
+        std::jthread m_writer;
+    };
+}
+
+#endif
@@ -0,0 +1,37 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#include <format>
+#include <iterator>
+#include <utility>
+
+#include <boost/log/trivial.hpp>
+
+#include "PhaseTimer.h"
+
+static double milliseconds(vgraphplay::PhaseTimer::Clock::duration duration) {
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+vgraphplay::PhaseTimer::PhaseTimer(std::string name)
+    : m_name{std::move(name)},
+      m_start{Clock::now()},
+      m_last{m_start},
+      m_phases{}
+{}
+
+void vgraphplay::PhaseTimer::mark(const char *phase) {
+    const Clock::time_point now = Clock::now();
+    m_phases.push_back(Phase{phase, now - m_last});
+    m_last = now;
+}
+
+void vgraphplay::PhaseTimer::report() const {
+    std::string line = std::format("{} took {:.1f} ms:", m_name, milliseconds(m_last - m_start));
+    for (const Phase &phase : m_phases) {
+        std::format_to(std::back_inserter(line), " {} {:.1f} ms,", phase.name, milliseconds(phase.duration));
+    }
+    if (!m_phases.empty()) {
+        line.pop_back();
+    }
+    BOOST_LOG_TRIVIAL(info) << line;
+}
@@ -0,0 +1,39 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_PHASE_TIMER_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_PHASE_TIMER_H_
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace vgraphplay {
+    // Wall-clock time through a sequence of phases, e.g. startup's. Each
+    // phase runs from the end of the one before it (or the timer's
+    // creation) to its mark().
+    class PhaseTimer {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        explicit PhaseTimer(std::string name);
+
+        // Ends the phase in progress. The name has to outlive the timer.
+        void mark(const char *phase);
+
+        // Logs the total and each phase's part of it, at info.
+        void report() const;
+
+    private:
+        struct Phase {
+            const char *name;
+            Clock::duration duration;
+        };
+
+        std::string m_name;
+        Clock::time_point m_start;
+        Clock::time_point m_last;
+        std::vector<Phase> m_phases;
+    };
+}
+
+#endif
@@ -0,0 +1,163 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <print>
+#include <stdexcept>
+#include <string>
+
+#include "RunConfig.h"
+
+template <typename T>
+static T parseNumber(const char *option, const char *value) {
+    T rv{};
+    const char *end = value + std::strlen(value);
+    const auto [ptr, ec] = std::from_chars(value, end, rv);
+    if (ec != std::errc{} || ptr != end) {
+        throw std::runtime_error("Expected a number for " + std::string{option} + ", got " + value);
+    }
+    return rv;
+}
+
+static vgraphplay::RunMode parseMode(const char *value) {
+    if (std::strcmp(value, "debug") == 0) {
+        return vgraphplay::RunMode::Debug;
+    } else if (std::strcmp(value, "release") == 0) {
+        return vgraphplay::RunMode::Release;
+    } else if (std::strcmp(value, "profile") == 0) {
+        return vgraphplay::RunMode::Profile;
+    }
+    throw std::runtime_error("Unknown mode " + std::string{value} + " (expected debug, release or profile)");
+}
+
+vgraphplay::RunConfig vgraphplay::RunConfig::parse(int argc, char **argv) {
+    RunConfig rv{};
+
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        auto value = [&]() -> const char * {
+            if (i + 1 >= argc) {
+                throw std::runtime_error("Missing value for " + std::string{arg});
+            }
+            return argv[++i];
+        };
+
+        if (std::strcmp(arg, "--mode") == 0) {
+            rv.mode = parseMode(value());
+        } else if (std::strcmp(arg, "--debug") == 0) {
+            rv.mode = RunMode::Debug;
+        } else if (std::strcmp(arg, "--release") == 0) {
+            rv.mode = RunMode::Release;
+        } else if (std::strcmp(arg, "--profile") == 0) {
+            rv.mode = RunMode::Profile;
+        } else if (std::strcmp(arg, "--width") == 0) {
+            rv.width = parseNumber<int>(arg, value());
+        } else if (std::strcmp(arg, "--height") == 0) {
+            rv.height = parseNumber<int>(arg, value());
+        } else if (std::strcmp(arg, "--frames") == 0) {
+            rv.frames = parseNumber<uint64_t>(arg, value());
+        } else if (std::strcmp(arg, "--device") == 0) {
+            rv.device = value();
+        } else if (std::strcmp(arg, "--device-cache") == 0) {
+            rv.device_cache = value();
+        } else if (std::strcmp(arg, "--assets") == 0) {
+            rv.asset_pack = value();
+        } else if (std::strcmp(arg, "--max-fps") == 0) {
+            rv.max_fps = parseNumber<double>(arg, value());
+        } else if (std::strcmp(arg, "--on-demand") == 0) {
+            rv.on_demand = true;
+        } else if (std::strcmp(arg, "--pin-threads") == 0) {
+            rv.pin_threads = true;
+        } else if (std::strcmp(arg, "--track-allocations") == 0) {
+            rv.track_allocations = true;
+        } else if (std::strcmp(arg, "--command-arena") == 0) {
+            rv.command_arena = true;
+        } else if (std::strcmp(arg, "--log-vulkan") == 0) {
+            rv.log_vulkan = true;
+        } else if (std::strcmp(arg, "--benchmark-devices") == 0) {
+            rv.benchmark_devices = true;
+        } else if (std::strcmp(arg, "--help") == 0 || std::strcmp(arg, "-h") == 0) {
+            rv.help = true;
+        } else {
+            throw std::runtime_error("Unknown argument " + std::string{arg});
+        }
+    }
+
+    if (rv.width <= 0 || rv.height <= 0) {
+        throw std::runtime_error("Window size must be positive, got " + std::to_string(rv.width) + "x" + std::to_string(rv.height));
+    }
+    if (!std::isfinite(rv.max_fps) || rv.max_fps < 0.0) {
+        throw std::runtime_error("--max-fps must be a finite, non-negative rate");
+    }
+    if (rv.asset_pack.empty()) {
+        // The build puts the pack beside the executable.
+        const std::filesystem::path program{argc > 0 ? argv[0] : ""};
+        rv.asset_pack = (program.parent_path() / DEFAULT_ASSET_PACK).string();
+    }
+
+    return rv;
+}
+
+void vgraphplay::RunConfig::printUsage(const char *program) {
+    std::println(stderr,
+                 "USAGE: {} [options]\n\n"
+                 "  --mode {{debug|release|profile}}\n"
+                 "  --debug, --release, --profile\n"
+                 "      Debug enables the validation layers, the debug messenger and trace\n"
+                 "      logging. Release turns them all off. Profile is release plus a\n"
+                 "      frame time summary at exit. Defaults to {}.\n"
+                 "  --width {{pixels}}, --height {{pixels}}\n"
+                 "      Window size. Defaults to {}x{}.\n"
+                 "  --frames {{count}}\n"
+                 "      Exit after rendering this many frames.\n"
+                 "  --device {{index|name}}\n"
+                 "      Use this physical device: its index, or part of its name. Otherwise\n"
+                 "      the best suitable device is picked by its type, memory, features and\n"
+                 "      queues.\n"
+                 "  --benchmark-devices\n"
+                 "      Measure each suitable device's fill rate, and pick the fastest. With\n"
+                 "      --device-cache, each device is only measured once per driver.\n"
+                 "  --device-cache {{file}}\n"
+                 "      Keep what each device supports here, and only ask again when its\n"
+                 "      driver changes.\n"
+                 "  --assets {{file}}\n"
+                 "      Load assets from this pack. Defaults to {} next to the\n"
+                 "      executable.\n"
+                 "  --max-fps {{rate}}\n"
+                 "      Limit continuous rendering to this frame rate.\n"
+                 "  --on-demand\n"
+                 "      Only render when something changes.\n"
+                 "  --pin-threads\n"
+                 "      Give the main thread, the render thread and each job worker a\n"
+                 "      core of their own.\n"
+                 "  --track-allocations\n"
+                 "      Count the Vulkan driver's host allocations, by scope and per frame.\n"
+                 "  --command-arena\n"
+                 "      Track allocations, and serve short-lived ones from a per-thread arena.\n"
+                 "  --log-vulkan\n"
+                 "      Log every instance extension and layer, and every device's details,\n"
+                 "      at info level, so they show in every mode.",
+                 program, RunConfig{}.modeName(), DEFAULT_WIDTH, DEFAULT_HEIGHT, DEFAULT_ASSET_PACK);
+}
+
+vgraphplay::RunMode vgraphplay::RunConfig::defaultMode() {
+#ifdef NDEBUG
+    return RunMode::Release;
+#else
+    return RunMode::Debug;
+#endif
+}
+
+const char *vgraphplay::RunConfig::modeName() const {
+    switch (mode) {
+    case RunMode::Debug:
+        return "debug";
+    case RunMode::Release:
+        return "release";
+    case RunMode::Profile:
+        return "profile";
+    }
+    return "unknown";
+}
@@ -0,0 +1,49 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_RUN_CONFIG_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_RUN_CONFIG_H_
+
+#include <cstdint>
+#include <string>
+
+namespace vgraphplay {
+    enum class RunMode : uint8_t {
+        Debug,   // Validation layers, debug messenger, trace logging.
+        Release, // None of the above; warnings and errors only.
+        Profile, // Release, plus a frame time summary at exit.
+    };
+
+    // How to run, from the command line. Release builds default to release
+    // mode, everything else to debug mode.
+    struct RunConfig {
+        static constexpr int DEFAULT_WIDTH = 1024;
+        static constexpr int DEFAULT_HEIGHT = 768;
+        static constexpr const char *DEFAULT_ASSET_PACK = "vgraphplay.vpak";
+
+        RunMode mode = defaultMode();
+        int width = DEFAULT_WIDTH;
+        int height = DEFAULT_HEIGHT;
+        uint64_t frames = 0;   // Frames to render before exiting. 0 runs until closed.
+        std::string device;    // Physical device index, or part of its name. Empty picks the best suitable one.
+        std::string device_cache; // Where to keep device profiles between runs. Empty probes every run.
+        std::string asset_pack;   // DEFAULT_ASSET_PACK next to the executable, unless given.
+        double max_fps = 0.0;  // Continuous rendering limit. 0 means unlimited.
+        bool on_demand = false;
+        bool pin_threads = false;       // Pin the main, render and job threads to their own cores.
+        bool track_allocations = false; // Count the Vulkan driver's host allocations.
+        bool command_arena = false;     // Also serve its command-scope ones from an arena.
+        bool log_vulkan = false;        // List the instance's extensions and layers, and the devices.
+        bool benchmark_devices = false; // Measure suitable devices' fill rates, and prefer the fastest.
+        bool help = false;
+
+        // Throws std::runtime_error on a bad argument.
+        static RunConfig parse(int argc, char **argv);
+        static void printUsage(const char *program);
+        static RunMode defaultMode();
+
+        bool validation() const { return mode == RunMode::Debug; }
+        const char *modeName() const;
+    };
+}
+
+#endif
@@ -0,0 +1,51 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "SimulationClock.h"
+
+vgraphplay::SimulationClock::SimulationClock(double rate, uint32_t max_steps)
+    : m_step{std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate))},
+      m_max_steps{max_steps},
+      m_last{Clock::now()},
+      m_accumulator{0},
+      m_dropped{0},
+      m_steps{0}
+{
+    if (rate <= 0.0 || m_step <= Clock::duration::zero()) {
+        throw std::runtime_error("Simulation rate must be positive");
+    }
+}
+
+uint32_t vgraphplay::SimulationClock::advance() {
+    const Clock::time_point now = Clock::now();
+    const Clock::duration elapsed = now - m_last;
+    m_last = now;
+    return advance(elapsed);
+}
+
+uint32_t vgraphplay::SimulationClock::advance(Clock::duration elapsed) {
+    m_accumulator += elapsed;
+
+    uint32_t steps = static_cast<uint32_t>(std::min<Clock::rep>(m_accumulator / m_step, m_max_steps));
+    m_accumulator -= steps * m_step;
+
+    if (steps == m_max_steps && m_accumulator >= m_step) {
+        // Keep the partial step so alpha() stays smooth; drop the rest.
+        const Clock::duration keep = m_accumulator % m_step;
+        m_dropped += m_accumulator - keep;
+        m_accumulator = keep;
+    }
+
+    m_steps += steps;
+    return steps;
+}
+
+float vgraphplay::SimulationClock::alpha() const {
+    return static_cast<float>(std::chrono::duration<double>(m_accumulator) / std::chrono::duration<double>(m_step));
+}
+
+vgraphplay::SimulationClock::Clock::duration vgraphplay::SimulationClock::untilNextStep() const {
+    return std::max(m_step - m_accumulator - (Clock::now() - m_last), Clock::duration::zero());
+}
@@ -0,0 +1,61 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_SIMULATION_CLOCK_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_SIMULATION_CLOCK_H_
+
+#include <chrono>
+#include <cstdint>
+
+namespace vgraphplay {
+    // Fixed-timestep clock for the simulation. Real time goes into an
+    // accumulator, and the simulation runs one fixed step for each whole
+    // step in it, so its cost and results don't depend on the frame rate.
+    // What's left over becomes alpha(), how far the present is between the
+    // last two steps, for interpolating what gets rendered.
+    //
+    // If the simulation falls behind (a breakpoint, a hitch, a step that
+    // costs more than a step's worth of time), advance() runs at most
+    // max_steps at once and drops the rest of the backlog rather than
+    // spiralling.
+    class SimulationClock {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        static constexpr double DEFAULT_RATE = 60.0;
+        static constexpr uint32_t DEFAULT_MAX_STEPS = 5;
+
+        explicit SimulationClock(double rate = DEFAULT_RATE, uint32_t max_steps = DEFAULT_MAX_STEPS);
+
+        // Adds the real time since the last call and returns how many steps
+        // to run now.
+        uint32_t advance();
+
+        // Adds the given time instead. Feeding it a constant makes a run
+        // reproducible, e.g. for benchmarks.
+        uint32_t advance(Clock::duration elapsed);
+
+        float stepSeconds() const { return static_cast<float>(std::chrono::duration<double>(m_step).count()); }
+        Clock::duration step() const { return m_step; }
+        Clock::time_point lastAdvance() const { return m_last; }
+
+        uint64_t steps() const { return m_steps; }
+        double time() const { return static_cast<double>(m_steps) * std::chrono::duration<double>(m_step).count(); }
+        float alpha() const;
+
+        // Real time left until the next step is due, as of now.
+        Clock::duration untilNextStep() const;
+
+        // Real time thrown away by the catch-up cap.
+        Clock::duration dropped() const { return m_dropped; }
+
+    private:
+        Clock::duration m_step;
+        uint32_t m_max_steps;
+        Clock::time_point m_last;
+        Clock::duration m_accumulator;
+        Clock::duration m_dropped;
+        uint64_t m_steps;
+    };
+}
+
+#endif
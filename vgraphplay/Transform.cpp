@@ -0,0 +1,22 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#include <glm/common.hpp>
+
+#include "Transform.h"
+
+glm::mat4x4 vgraphplay::Transform::matrix() const {
+    glm::mat4x4 m = glm::mat4_cast(rotation);
+    m[0] *= scale.x;
+    m[1] *= scale.y;
+    m[2] *= scale.z;
+    m[3] = glm::vec4{position, 1.0f};
+    return m;
+}
+
+vgraphplay::Transform vgraphplay::Transform::interpolate(const Transform &from, const Transform &to, float t) {
+    return Transform{
+        .position = glm::mix(from.position, to.position, t),
+        .rotation = glm::slerp(from.rotation, to.rotation, t),
+        .scale = glm::mix(from.scale, to.scale, t),
+    };
+}
@@ -0,0 +1,25 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_TRANSFORM_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_TRANSFORM_H_
+
+#include <glm/gtc/quaternion.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+namespace vgraphplay {
+    // An object's placement, kept as parts rather than a matrix so it can
+    // be interpolated between simulation steps.
+    struct Transform {
+        glm::vec3 position{0.0f};
+        glm::quat rotation{1.0f, 0.0f, 0.0f, 0.0f};
+        glm::vec3 scale{1.0f};
+
+        glm::mat4x4 matrix() const;
+
+        // Position and scale linearly, rotation along the shortest arc.
+        static Transform interpolate(const Transform &from, const Transform &to, float t);
+    };
+}
+
+#endif
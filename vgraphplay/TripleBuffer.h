@@ -0,0 +1,52 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_TRIPLE_BUFFER_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_TRIPLE_BUFFER_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace vgraphplay {
+    // Hands the latest value from one writer thread to one reader thread
+    // without either waiting on the other. The writer fills back() and
+    // publishes it; the reader picks up the newest published value, if
+    // there is one, and keeps reading front() until the next. Values the
+    // reader never got to are overwritten, and the slots are reused, so
+    // containers in T keep their capacity from one value to the next.
+    template <typename T>
+    class TripleBuffer {
+    public:
+        TripleBuffer() : m_slots{}, m_back{0}, m_middle{1}, m_front{2} {}
+
+        TripleBuffer(const TripleBuffer &) = delete;
+        TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+        // Writer only.
+        T &back() { return m_slots[m_back]; }
+        void publish() {
+            m_back = m_middle.exchange(m_back | FRESH, std::memory_order_acq_rel) & INDEX;
+        }
+
+        // Reader only. Returns true if front() changed.
+        bool acquire() {
+            if ((m_middle.load(std::memory_order_relaxed) & FRESH) == 0) {
+                return false;
+            }
+            m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & INDEX;
+            return true;
+        }
+        const T &front() const { return m_slots[m_front]; }
+
+    private:
+        static constexpr uint8_t INDEX = 0x3;
+        static constexpr uint8_t FRESH = 0x4; // Published and not yet acquired.
+
+        std::array<T, 3> m_slots;
+        uint8_t m_back;
+        std::atomic<uint8_t> m_middle;
+        uint8_t m_front;
+    };
+}
+
+#endif
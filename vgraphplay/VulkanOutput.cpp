@@ -25,7 +25,7 @@ namespace vgraphplay {
         for (const auto& extension : extensions) {
             msg += "\n  - " + extensionMessage(extension);
         }
-        BOOST_LOG_TRIVIAL(trace) << msg;
+        BOOST_LOG_TRIVIAL(info) << msg;
     }
 
     void logInstanceLayers(const vk::raii::Context &context) {
@@ -45,7 +45,7 @@ namespace vgraphplay {
             }
         }
 
-        BOOST_LOG_TRIVIAL(trace) << msg;
+        BOOST_LOG_TRIVIAL(info) << msg;
     }
 
     void logPhysicalDevices(const vk::raii::Instance &instance) {
@@ -88,7 +88,7 @@ namespace vgraphplay {
             // }
         }
 
-        BOOST_LOG_TRIVIAL(trace) << msg;
+        BOOST_LOG_TRIVIAL(info) << msg;
         /*
         for (const auto& device : devices) {
 
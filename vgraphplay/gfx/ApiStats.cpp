@@ -0,0 +1,270 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#include "ApiStats.h"
+
+#if VGRAPHPLAY_VULKAN_API_STATS
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <type_traits>
+
+#include "../Log.h"
+
+// The wrapped entry points: what a frame records and submits, and what
+// streaming and descriptor churn call while running.
+#define VGRAPHPLAY_API_STATS_COMMANDS(X)        \
+    X(vkQueueSubmit2)                           \
+    X(vkQueuePresentKHR)                        \
+    X(vkAcquireNextImageKHR)                    \
+    X(vkWaitSemaphores)                         \
+    X(vkSignalSemaphore)                        \
+    X(vkGetSemaphoreCounterValue)               \
+    X(vkAllocateCommandBuffers)                 \
+    X(vkResetCommandPool)                       \
+    X(vkResetCommandBuffer)                     \
+    X(vkBeginCommandBuffer)                     \
+    X(vkEndCommandBuffer)                       \
+    X(vkCmdBeginRendering)                      \
+    X(vkCmdEndRendering)                        \
+    X(vkCmdPipelineBarrier2)                    \
+    X(vkCmdBindPipeline)                        \
+    X(vkCmdBindDescriptorSets)                  \
+    X(vkCmdBindVertexBuffers)                   \
+    X(vkCmdBindIndexBuffer)                     \
+    X(vkCmdPushConstants)                       \
+    X(vkCmdSetViewport)                         \
+    X(vkCmdSetScissor)                          \
+    X(vkCmdDraw)                                \
+    X(vkCmdDrawIndexed)                         \
+    X(vkCmdDrawIndexedIndirect)                 \
+    X(vkCmdResetQueryPool)                      \
+    X(vkCmdBeginQuery)                          \
+    X(vkCmdEndQuery)                            \
+    X(vkCmdCopyBuffer)                          \
+    X(vkCmdCopyBufferToImage)                   \
+    X(vkGetQueryPoolResults)                    \
+    X(vkAllocateDescriptorSets)                 \
+    X(vkResetDescriptorPool)                    \
+    X(vkUpdateDescriptorSets)                   \
+    X(vkCreateDescriptorPool)                   \
+    X(vkDestroyDescriptorPool)                  \
+    X(vkCreateBuffer)                           \
+    X(vkDestroyBuffer)                          \
+    X(vkCreateImage)                            \
+    X(vkDestroyImage)                           \
+    X(vkCreateImageView)                        \
+    X(vkDestroyImageView)                       \
+    X(vkAllocateMemory)                         \
+    X(vkFreeMemory)                             \
+    X(vkMapMemory)                              \
+    X(vkUnmapMemory)                            \
+    X(vkBindBufferMemory)                       \
+    X(vkBindImageMemory)                        \
+    X(vkCreateGraphicsPipelines)                \
+    X(vkDestroyPipeline)
+
+enum ApiCommand : uint32_t {
+#define VGRAPHPLAY_API_STATS_ENUM(name) API_##name,
+    VGRAPHPLAY_API_STATS_COMMANDS(VGRAPHPLAY_API_STATS_ENUM)
+#undef VGRAPHPLAY_API_STATS_ENUM
+    API_COMMAND_COUNT
+};
+
+using Clock = std::chrono::steady_clock;
+
+struct CommandStats {
+    // Updated by the wrappers, on any thread.
+    std::atomic<uint64_t> calls{0};
+    std::atomic<uint64_t> sampled_ns{0};
+    std::atomic<uint64_t> samples{0};
+
+    // The render thread's view, for the current report window.
+    uint64_t seen_calls = 0;
+    uint64_t seen_sampled_ns = 0;
+    uint64_t seen_samples = 0;
+    uint64_t window_calls = 0;
+    uint64_t window_peak = 0; // Most calls in one frame.
+};
+
+static const char *const COMMAND_NAMES[API_COMMAND_COUNT] = {
+#define VGRAPHPLAY_API_STATS_NAME(name) #name,
+    VGRAPHPLAY_API_STATS_COMMANDS(VGRAPHPLAY_API_STATS_NAME)
+#undef VGRAPHPLAY_API_STATS_NAME
+};
+
+static std::array<CommandStats, API_COMMAND_COUNT> s_commands;
+static PFN_vkGetInstanceProcAddr s_get_instance_proc_addr = nullptr;
+static PFN_vkGetDeviceProcAddr s_get_device_proc_addr = nullptr;
+static std::atomic<uint32_t> s_unwatched{0}; // Live Unwatched scopes.
+static uint64_t s_frames = 0;
+static double s_baseline_calls = 0.0; // Per frame, as of the first report.
+
+template <typename PFN, uint32_t ID>
+struct Hook;
+
+template <typename R, typename... Args, uint32_t ID>
+struct Hook<R (VKAPI_PTR *)(Args...), ID> {
+    static inline R (VKAPI_PTR *s_real)(Args...) = nullptr;
+
+    static R VKAPI_CALL call(Args... args) {
+        CommandStats &stats = s_commands[ID];
+        if (stats.calls.fetch_add(1, std::memory_order_relaxed) % vgraphplay::gfx::ApiStats::SAMPLE_EVERY != 0) {
+            return s_real(args...);
+        }
+
+        struct Sample {
+            CommandStats &stats;
+            Clock::time_point start;
+            ~Sample() {
+                const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+                stats.sampled_ns.fetch_add(static_cast<uint64_t>(ns), std::memory_order_relaxed);
+                stats.samples.fetch_add(1, std::memory_order_relaxed);
+            }
+        } sample{stats, Clock::now()};
+        return s_real(args...);
+    }
+
+    static PFN_vkVoidFunction install(PFN_vkVoidFunction real) {
+        s_real = reinterpret_cast<R (VKAPI_PTR *)(Args...)>(real);
+        return reinterpret_cast<PFN_vkVoidFunction>(&call);
+    }
+};
+
+struct HookEntry {
+    const char *name;
+    PFN_vkVoidFunction (*install)(PFN_vkVoidFunction real);
+};
+
+static const HookEntry HOOKS[API_COMMAND_COUNT] = {
+#define VGRAPHPLAY_API_STATS_HOOK(name) {#name, &Hook<PFN_##name, API_##name>::install},
+    VGRAPHPLAY_API_STATS_COMMANDS(VGRAPHPLAY_API_STATS_HOOK)
+#undef VGRAPHPLAY_API_STATS_HOOK
+};
+
+static PFN_vkVoidFunction wrap(const char *name, PFN_vkVoidFunction real) {
+    if (real == nullptr) {
+        return nullptr;
+    }
+    for (const HookEntry &hook : HOOKS) {
+        if (std::strcmp(hook.name, name) == 0) {
+            // Device-level pointers are loaded after instance-level ones
+            // for the same entry point, so they're the ones that stick.
+            return hook.install(real);
+        }
+    }
+    return real;
+}
+
+static VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL getDeviceProcAddr(VkDevice device, const char *name) {
+    PFN_vkVoidFunction real = s_get_device_proc_addr(device, name);
+    if (s_unwatched.load(std::memory_order_relaxed) > 0) {
+        return real;
+    }
+    return wrap(name, real);
+}
+
+static VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL getInstanceProcAddr(VkInstance instance, const char *name) {
+    PFN_vkVoidFunction real = s_get_instance_proc_addr(instance, name);
+    if (real != nullptr && std::strcmp(name, "vkGetDeviceProcAddr") == 0) {
+        s_get_device_proc_addr = reinterpret_cast<PFN_vkGetDeviceProcAddr>(real);
+        return reinterpret_cast<PFN_vkVoidFunction>(&getDeviceProcAddr);
+    }
+    return wrap(name, real);
+}
+
+void vgraphplay::gfx::ApiStats::install(vk::raii::Context &context) {
+    // The context's dispatcher is only handed out as const, but it's an
+    // ordinary heap object that the instance copies its loader from.
+    using Dispatcher = std::remove_cvref_t<decltype(*context.getDispatcher())>;
+    Dispatcher *dispatcher = const_cast<Dispatcher *>(context.getDispatcher());
+    if (dispatcher->vkGetInstanceProcAddr == &getInstanceProcAddr) {
+        return;
+    }
+    s_get_instance_proc_addr = dispatcher->vkGetInstanceProcAddr;
+    dispatcher->vkGetInstanceProcAddr = &getInstanceProcAddr;
+    BOOST_LOG_TRIVIAL(info) << "Counting calls to " << API_COMMAND_COUNT << " Vulkan entry points";
+}
+
+vgraphplay::gfx::ApiStats::Unwatched::Unwatched() {
+    s_unwatched.fetch_add(1, std::memory_order_relaxed);
+}
+
+vgraphplay::gfx::ApiStats::Unwatched::~Unwatched() {
+    s_unwatched.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void vgraphplay::gfx::ApiStats::nextFrame() {
+    ++s_frames;
+    for (CommandStats &stats : s_commands) {
+        const uint64_t calls = stats.calls.load(std::memory_order_relaxed);
+        const uint64_t frame_calls = calls - stats.seen_calls;
+        stats.seen_calls = calls;
+        stats.window_calls += frame_calls;
+        stats.window_peak = std::max(stats.window_peak, frame_calls);
+    }
+
+    if (s_frames % REPORT_FRAMES != 0) {
+        return;
+    }
+
+    struct Offender {
+        uint32_t command;
+        double calls;   // Per frame.
+        double call_ns; // Average sampled duration.
+        double frame_us;
+    };
+    std::array<Offender, API_COMMAND_COUNT> offenders;
+    double total_calls = 0.0;
+    double total_us = 0.0;
+
+    for (uint32_t i = 0; i < API_COMMAND_COUNT; ++i) {
+        CommandStats &stats = s_commands[i];
+        const uint64_t sampled_ns = stats.sampled_ns.load(std::memory_order_relaxed);
+        const uint64_t samples = stats.samples.load(std::memory_order_relaxed);
+        const uint64_t window_samples = samples - stats.seen_samples;
+        const uint64_t window_ns = sampled_ns - stats.seen_sampled_ns;
+
+        // A rare call may not have been sampled this window; fall back to
+        // its average over the whole run.
+        double call_ns = 0.0;
+        if (window_samples > 0) {
+            call_ns = static_cast<double>(window_ns) / static_cast<double>(window_samples);
+        } else if (samples > 0) {
+            call_ns = static_cast<double>(sampled_ns) / static_cast<double>(samples);
+        }
+
+        const double calls = static_cast<double>(stats.window_calls) / static_cast<double>(REPORT_FRAMES);
+        offenders[i] = Offender{i, calls, call_ns, calls * call_ns / 1000.0};
+        total_calls += calls;
+        total_us += offenders[i].frame_us;
+
+        stats.seen_sampled_ns = sampled_ns;
+        stats.seen_samples = samples;
+    }
+
+    std::ranges::sort(offenders, [](const Offender &a, const Offender &b) { return a.frame_us > b.frame_us; });
+
+    VGRAPHPLAY_LOG(info, "Vulkan API over the last {} frames: {:.1f} calls and ~{:.1f} us per frame",
+                   REPORT_FRAMES, total_calls, total_us);
+    for (size_t i = 0; i < TOP_COUNT && offenders[i].calls > 0.0; ++i) {
+        const Offender &o = offenders[i];
+        VGRAPHPLAY_LOG(info, "  {}: {:.1f} calls per frame (peak {}), {:.0f} ns per call, ~{:.1f} us per frame",
+                       COMMAND_NAMES[o.command], o.calls, s_commands[o.command].window_peak, o.call_ns, o.frame_us);
+    }
+
+    if (s_baseline_calls == 0.0) {
+        s_baseline_calls = total_calls;
+    } else if (total_calls > s_baseline_calls * CREEP_FACTOR) {
+        VGRAPHPLAY_LOG(warning, "Vulkan calls per frame have crept up from {:.1f} to {:.1f}", s_baseline_calls, total_calls);
+    }
+
+    for (CommandStats &stats : s_commands) {
+        stats.window_calls = 0;
+        stats.window_peak = 0;
+    }
+}
+
+#endif
@@ -0,0 +1,64 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_GFX_API_STATS_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_GFX_API_STATS_H_
+
+// Only built with the VGRAPHPLAY_VULKAN_API_STATS CMake option; without it
+// none of this exists and Vulkan calls go straight to the driver.
+#if VGRAPHPLAY_VULKAN_API_STATS
+
+#include <cstddef>
+#include <cstdint>
+
+#include "../vulkan.h"
+
+namespace vgraphplay {
+    namespace gfx {
+        // Counts and times Vulkan calls by wrapping the function pointers
+        // the vk::raii dispatchers load. install() swaps the context's
+        // vkGetInstanceProcAddr (and, through it, vkGetDeviceProcAddr) for
+        // versions that hand back a counting wrapper for each entry point
+        // in the list in ApiStats.cpp, which is the per-frame and
+        // streaming calls; everything else is returned untouched.
+        //
+        // Every call is counted. One in SAMPLE_EVERY is also timed, and
+        // each entry point's cost per frame is estimated from its calls and
+        // average sampled duration. Every REPORT_FRAMES frames the top
+        // TOP_COUNT entry points by estimated cost are logged, with a
+        // warning if calls per frame have grown by more than CREEP_FACTOR
+        // since the first report.
+        //
+        // There's one wrapper per entry point, so this assumes a single
+        // instance and device. Any other device, like DeviceBenchmark's
+        // throwaway ones, should be created inside an Unwatched scope.
+        class ApiStats {
+        public:
+            static constexpr uint64_t SAMPLE_EVERY = 16;
+            static constexpr uint64_t REPORT_FRAMES = 600;
+            static constexpr size_t TOP_COUNT = 8;
+            static constexpr double CREEP_FACTOR = 1.25;
+
+            // Devices created while one of these is alive get the driver's
+            // functions as they are, and leave the wrappers pointing at the
+            // watched device.
+            class Unwatched {
+            public:
+                Unwatched();
+                ~Unwatched();
+
+                Unwatched(const Unwatched &) = delete;
+                Unwatched &operator=(const Unwatched &) = delete;
+            };
+
+            // Before anything is created from the context.
+            static void install(vk::raii::Context &context);
+
+            // Closes the current frame's counts. Render thread only.
+            static void nextFrame();
+        };
+    }
+}
+
+#endif
+
+#endif
@@ -0,0 +1,257 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <boost/log/trivial.hpp>
+
+#include "Bindless.h"
+#include "HostAllocator.h"
+
+bool vgraphplay::gfx::BindlessTable::isSupported(const vk::PhysicalDeviceVulkan12Features &features) {
+    return features.runtimeDescriptorArray &&
+        features.shaderSampledImageArrayNonUniformIndexing &&
+        features.descriptorBindingPartiallyBound &&
+        features.descriptorBindingVariableDescriptorCount &&
+        features.descriptorBindingSampledImageUpdateAfterBind &&
+        features.descriptorBindingStorageBufferUpdateAfterBind;
+}
+
+void vgraphplay::gfx::BindlessTable::enableFeatures(vk::PhysicalDeviceVulkan12Features &features) {
+    features.descriptorIndexing = true;
+    features.runtimeDescriptorArray = true;
+    features.shaderSampledImageArrayNonUniformIndexing = true;
+    features.descriptorBindingPartiallyBound = true;
+    features.descriptorBindingVariableDescriptorCount = true;
+    features.descriptorBindingSampledImageUpdateAfterBind = true;
+    features.descriptorBindingStorageBufferUpdateAfterBind = true;
+}
+
+vgraphplay::gfx::BindlessTable::BindlessTable(std::nullptr_t)
+    : m_device{nullptr},
+      m_resources{nullptr},
+      m_timeline{nullptr},
+      m_texture_capacity{0},
+      m_layout{nullptr},
+      m_allocator{nullptr},
+      m_set{nullptr},
+      m_materials{},
+      m_objects{},
+      m_free_textures{std::make_shared<std::vector<uint32_t>>()},
+      m_free_materials{std::make_shared<std::vector<uint32_t>>()},
+      m_free_objects{std::make_shared<std::vector<uint32_t>>()},
+      m_next_texture{0},
+      m_next_material{0},
+      m_next_object{0}
+{}
+
+vgraphplay::gfx::BindlessTable::BindlessTable(const vk::raii::PhysicalDevice &physical_device, const vk::raii::Device &device, Resources &resources, Timeline &timeline)
+    : BindlessTable{nullptr}
+{
+    m_device = &device;
+    m_resources = &resources;
+    m_timeline = &timeline;
+
+    const auto props = physical_device.template getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceVulkan12Properties>();
+    const auto &props12 = props.template get<vk::PhysicalDeviceVulkan12Properties>();
+    m_texture_capacity = std::min({
+            MAX_TEXTURES,
+            props12.maxDescriptorSetUpdateAfterBindSampledImages,
+            props12.maxDescriptorSetUpdateAfterBindSamplers,
+            props12.maxPerStageDescriptorUpdateAfterBindSampledImages,
+            props12.maxPerStageDescriptorUpdateAfterBindSamplers,
+        });
+
+    std::array<vk::DescriptorSetLayoutBinding, 3> bindings = {{
+        {
+            .binding = MATERIALS_BINDING,
+            .descriptorType = vk::DescriptorType::eStorageBuffer,
+            .descriptorCount = 1,
+            .stageFlags = vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,
+        },
+        {
+            .binding = OBJECTS_BINDING,
+            .descriptorType = vk::DescriptorType::eStorageBuffer,
+            .descriptorCount = 1,
+            .stageFlags = vk::ShaderStageFlagBits::eVertex,
+        },
+        {
+            .binding = TEXTURES_BINDING,
+            .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+            .descriptorCount = m_texture_capacity,
+            .stageFlags = vk::ShaderStageFlagBits::eFragment,
+        },
+    }};
+
+    // The texture array must be the last binding to have a variable count.
+    std::array<vk::DescriptorBindingFlags, 3> binding_flags = {
+        vk::DescriptorBindingFlagBits::eUpdateAfterBind,
+        vk::DescriptorBindingFlagBits::eUpdateAfterBind,
+        vk::DescriptorBindingFlagBits::eUpdateAfterBind |
+            vk::DescriptorBindingFlagBits::ePartiallyBound |
+            vk::DescriptorBindingFlagBits::eVariableDescriptorCount,
+    };
+
+    vk::StructureChain<vk::DescriptorSetLayoutCreateInfo, vk::DescriptorSetLayoutBindingFlagsCreateInfo> layout_ci = {
+        {
+            .flags = vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool,
+            .bindingCount = static_cast<uint32_t>(bindings.size()),
+            .pBindings = bindings.data(),
+        },
+        {
+            .bindingCount = static_cast<uint32_t>(binding_flags.size()),
+            .pBindingFlags = binding_flags.data(),
+        },
+    };
+
+    m_layout = vk::raii::DescriptorSetLayout(device, layout_ci.get<vk::DescriptorSetLayoutCreateInfo>(), HostAllocator::callbacks());
+
+    const DescriptorPoolRatio ratios[] = {
+        {vk::DescriptorType::eStorageBuffer, 2.0f},
+        {vk::DescriptorType::eCombinedImageSampler, static_cast<float>(m_texture_capacity)},
+    };
+    m_allocator = DescriptorAllocator{device, 1, ratios, vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind};
+
+    vk::DescriptorSetVariableDescriptorCountAllocateInfo variable_count{
+        .descriptorSetCount = 1,
+        .pDescriptorCounts = &m_texture_capacity,
+    };
+    m_set = m_allocator.allocate(*m_layout, &variable_count);
+
+    m_materials = resources.createBuffer(sizeof(MaterialRecord) * MAX_MATERIALS,
+                                         vk::BufferUsageFlagBits::eStorageBuffer,
+                                         vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+
+    m_objects = resources.createBuffer(sizeof(ObjectRecord) * MAX_OBJECTS,
+                                       vk::BufferUsageFlagBits::eStorageBuffer,
+                                       vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+
+    const vk::DescriptorBufferInfo materials_info{
+        .buffer = resources.buffer(m_materials),
+        .offset = 0,
+        .range = vk::WholeSize,
+    };
+    const vk::DescriptorBufferInfo objects_info{
+        .buffer = resources.buffer(m_objects),
+        .offset = 0,
+        .range = vk::WholeSize,
+    };
+    const std::array<vk::WriteDescriptorSet, 2> buffer_writes = {{
+        {
+            .dstSet = m_set,
+            .dstBinding = MATERIALS_BINDING,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = vk::DescriptorType::eStorageBuffer,
+            .pBufferInfo = &materials_info,
+        },
+        {
+            .dstSet = m_set,
+            .dstBinding = OBJECTS_BINDING,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = vk::DescriptorType::eStorageBuffer,
+            .pBufferInfo = &objects_info,
+        },
+    }};
+    device.updateDescriptorSets(buffer_writes, {});
+
+    BOOST_LOG_TRIVIAL(trace) << "Created bindless descriptor set " << m_set << " with room for " << m_texture_capacity << " textures";
+}
+
+vgraphplay::gfx::BindlessTable::~BindlessTable() {}
+
+uint32_t vgraphplay::gfx::BindlessTable::addTexture(vk::ImageView view, vk::Sampler sampler) {
+    uint32_t index = takeSlot(*m_free_textures, m_next_texture, m_texture_capacity, "texture");
+
+    vk::DescriptorImageInfo image_info{
+        .sampler = sampler,
+        .imageView = view,
+        .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+    };
+    vk::WriteDescriptorSet write{
+        .dstSet = m_set,
+        .dstBinding = TEXTURES_BINDING,
+        .dstArrayElement = index,
+        .descriptorCount = 1,
+        .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+        .pImageInfo = &image_info,
+    };
+    m_device->updateDescriptorSets(write, {});
+
+    return index;
+}
+
+void vgraphplay::gfx::BindlessTable::removeTexture(uint32_t index) {
+    releaseSlot(m_free_textures, index, m_timeline->nextPoint());
+}
+
+void vgraphplay::gfx::BindlessTable::removeTexture(uint32_t index, uint64_t point) {
+    releaseSlot(m_free_textures, index, point);
+}
+
+uint32_t vgraphplay::gfx::BindlessTable::addMaterial(const MaterialRecord &material) {
+    uint32_t index = takeSlot(*m_free_materials, m_next_material, MAX_MATERIALS, "material");
+    updateMaterial(index, material);
+    return index;
+}
+
+void vgraphplay::gfx::BindlessTable::updateMaterial(uint32_t index, const MaterialRecord &material) {
+    auto *records = static_cast<MaterialRecord *>(m_resources->bufferInfo(m_materials).mapped);
+    std::memcpy(&records[index], &material, sizeof(MaterialRecord));
+}
+
+void vgraphplay::gfx::BindlessTable::removeMaterial(uint32_t index) {
+    releaseSlot(m_free_materials, index, m_timeline->nextPoint());
+}
+
+void vgraphplay::gfx::BindlessTable::removeMaterial(uint32_t index, uint64_t point) {
+    releaseSlot(m_free_materials, index, point);
+}
+
+uint32_t vgraphplay::gfx::BindlessTable::addObject(const ObjectRecord &object) {
+    uint32_t index = takeSlot(*m_free_objects, m_next_object, MAX_OBJECTS, "object");
+    updateObject(index, object);
+    return index;
+}
+
+void vgraphplay::gfx::BindlessTable::updateObject(uint32_t index, const ObjectRecord &object) {
+    auto *records = static_cast<ObjectRecord *>(m_resources->bufferInfo(m_objects).mapped);
+    std::memcpy(&records[index], &object, sizeof(ObjectRecord));
+}
+
+void vgraphplay::gfx::BindlessTable::removeObject(uint32_t index) {
+    releaseSlot(m_free_objects, index, m_timeline->nextPoint());
+}
+
+void vgraphplay::gfx::BindlessTable::removeObject(uint32_t index, uint64_t point) {
+    releaseSlot(m_free_objects, index, point);
+}
+
+uint32_t vgraphplay::gfx::BindlessTable::takeSlot(std::vector<uint32_t> &free_slots, uint32_t &next_slot, uint32_t capacity, const char *what) {
+    m_timeline->poll();
+
+    if (!free_slots.empty()) {
+        uint32_t index = free_slots.back();
+        free_slots.pop_back();
+        return index;
+    }
+
+    if (next_slot >= capacity) {
+        throw std::runtime_error("Bindless table is out of " + std::string{what} + " slots (" + std::to_string(capacity) + ")");
+    }
+
+    return next_slot++;
+}
+
+// Work up to the point may still read the slot, so it goes back on the
+// free list only once the timeline has passed it.
+void vgraphplay::gfx::BindlessTable::releaseSlot(const FreeSlots &free_slots, uint32_t index, uint64_t point) {
+    m_timeline->onComplete(point, [free_slots, index]() {
+        free_slots->push_back(index);
+    });
+}
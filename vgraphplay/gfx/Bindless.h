@@ -0,0 +1,133 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_GFX_BINDLESS_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_GFX_BINDLESS_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+#include "../vulkan.h"
+
+#include "DescriptorAllocator.h"
+#include "Handle.h"
+#include "Resources.h"
+#include "Timeline.h"
+
+namespace vgraphplay {
+    namespace gfx {
+        // One entry in the material storage buffer. Must match Material in
+        // shaders/unlit_bindless.frag (std430).
+        struct MaterialRecord {
+            glm::vec4 color;
+            uint32_t texture;
+            uint32_t pad[3];
+        };
+
+        static_assert(sizeof(MaterialRecord) == 32, "MaterialRecord must match the std430 layout in the shaders");
+
+        // One entry in the object storage buffer: what a single draw needs.
+        // Must match Object in shaders/unlit_bindless.vert (std430).
+        struct ObjectRecord {
+            glm::mat4x4 model;
+            uint32_t material;
+            uint32_t pad[3];
+        };
+
+        static_assert(sizeof(ObjectRecord) == 80, "ObjectRecord must match the std430 layout in the shaders");
+
+        // A single descriptor set holding every texture in one large,
+        // partially bound, update-after-bind array, plus storage buffers of
+        // material records that index into it and of object records (a
+        // transform and a material) that index those. Each draw's
+        // firstInstance is its object index, which unlit_bindless.vert
+        // reads as gl_InstanceIndex, so draws with different transforms
+        // and textures need no binds or push constants between them and
+        // can be merged into multi-draw-indirect calls.
+        //
+        // The set is bound once per command buffer, as set 1. Textures and
+        // materials can be added while it is in use; removed slots are only
+        // handed out again once the GPU has finished every submission that
+        // might still read them. Not thread safe.
+        class BindlessTable {
+        public:
+            static constexpr uint32_t SET = 1;
+            static constexpr uint32_t MATERIALS_BINDING = 0;
+            static constexpr uint32_t OBJECTS_BINDING = 1;
+            static constexpr uint32_t TEXTURES_BINDING = 2;
+            static constexpr uint32_t MAX_TEXTURES = 16384;
+            static constexpr uint32_t MAX_MATERIALS = 4096;
+            static constexpr uint32_t MAX_OBJECTS = 16384;
+
+            // Whether the device's features include the descriptor indexing
+            // bindless needs, and turns them on in a feature struct about to
+            // be passed to device creation.
+            static bool isSupported(const vk::PhysicalDeviceVulkan12Features &features);
+            static void enableFeatures(vk::PhysicalDeviceVulkan12Features &features);
+
+            BindlessTable(std::nullptr_t);
+            BindlessTable(const vk::raii::PhysicalDevice &physical_device, const vk::raii::Device &device, Resources &resources, Timeline &timeline);
+            ~BindlessTable();
+
+            BindlessTable(const BindlessTable &) = delete;
+            BindlessTable &operator=(const BindlessTable &) = delete;
+            BindlessTable(BindlessTable &&) = default;
+            BindlessTable &operator=(BindlessTable &&) = default;
+
+            bool isEnabled() const { return static_cast<bool>(m_set); }
+            const vk::raii::DescriptorSetLayout &layout() const { return m_layout; }
+            vk::DescriptorSet set() const { return m_set; }
+            uint32_t textureCapacity() const { return m_texture_capacity; }
+
+            // Removed slots are reused once the timeline reaches the point,
+            // or by default once the next submission is done.
+            uint32_t addTexture(vk::ImageView view, vk::Sampler sampler);
+            void removeTexture(uint32_t index);
+            void removeTexture(uint32_t index, uint64_t point);
+
+            uint32_t addMaterial(const MaterialRecord &material);
+            // Takes effect immediately, including for frames still in
+            // flight; prefer adding a new record when that matters.
+            void updateMaterial(uint32_t index, const MaterialRecord &material);
+            void removeMaterial(uint32_t index);
+            void removeMaterial(uint32_t index, uint64_t point);
+
+            // The index is the firstInstance to draw the object with. Same
+            // caveat as updateMaterial().
+            uint32_t addObject(const ObjectRecord &object);
+            void updateObject(uint32_t index, const ObjectRecord &object);
+            void removeObject(uint32_t index);
+            void removeObject(uint32_t index, uint64_t point);
+
+        private:
+            // Shared with the timeline callbacks that return slots to them,
+            // so those stay valid when the table is moved or destroyed.
+            using FreeSlots = std::shared_ptr<std::vector<uint32_t>>;
+
+            uint32_t takeSlot(std::vector<uint32_t> &free_slots, uint32_t &next_slot, uint32_t capacity, const char *what);
+            void releaseSlot(const FreeSlots &free_slots, uint32_t index, uint64_t point);
+
+            const vk::raii::Device *m_device;
+            Resources *m_resources;
+            Timeline *m_timeline;
+
+            uint32_t m_texture_capacity;
+            vk::raii::DescriptorSetLayout m_layout;
+            DescriptorAllocator m_allocator;
+            vk::DescriptorSet m_set;
+            BufferHandle m_materials;
+            BufferHandle m_objects;
+
+            FreeSlots m_free_textures;
+            FreeSlots m_free_materials;
+            FreeSlots m_free_objects;
+            uint32_t m_next_texture;
+            uint32_t m_next_material;
+            uint32_t m_next_object;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,57 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "DeletionQueue.h"
+#include "../Log.h"
+
+vgraphplay::gfx::DeletionQueue::DeletionQueue(Timeline &timeline)
+    : m_timeline{&timeline},
+      m_mutex{},
+      m_retired{}
+{}
+
+vgraphplay::gfx::DeletionQueue::~DeletionQueue() {}
+
+void vgraphplay::gfx::DeletionQueue::retire(Object &&object, uint64_t point) {
+    std::lock_guard<std::mutex> lock{m_mutex};
+
+    // Points almost always arrive in order, so keep the queue sorted by
+    // inserting from the back.
+    auto pos = std::find_if(m_retired.rbegin(), m_retired.rend(), [point](const Retired &r) { return r.point <= point; });
+    m_retired.insert(pos.base(), Retired{point, std::move(object)});
+}
+
+void vgraphplay::gfx::DeletionQueue::collect() {
+    destroyThrough(m_timeline->poll());
+}
+
+void vgraphplay::gfx::DeletionQueue::flush() {
+    m_timeline->waitIdle();
+    destroyThrough(std::numeric_limits<uint64_t>::max());
+}
+
+size_t vgraphplay::gfx::DeletionQueue::size() const {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_retired.size();
+}
+
+void vgraphplay::gfx::DeletionQueue::destroyThrough(uint64_t completed) {
+    std::vector<Retired> done;
+
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        while (!m_retired.empty() && m_retired.front().point <= completed) {
+            done.push_back(std::move(m_retired.front()));
+            m_retired.pop_front();
+        }
+    }
+
+    // The objects are destroyed here, outside the lock, when done goes out
+    // of scope.
+    if (!done.empty()) {
+        VGRAPHPLAY_LOG(trace, "Destroying {} retired Vulkan objects (timeline at {})", done.size(), completed);
+    }
+}
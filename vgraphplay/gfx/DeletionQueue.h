@@ -0,0 +1,80 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_GFX_DELETION_QUEUE_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_GFX_DELETION_QUEUE_H_
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <variant>
+
+#include "../vulkan.h"
+
+#include "Timeline.h"
+
+namespace vgraphplay {
+    namespace gfx {
+        // Defers destroying Vulkan objects until the GPU is done with them.
+        // Retiring an object hands it over along with the timeline point of
+        // the last submission that used it; collect() destroys everything
+        // whose point the GPU has passed. Objects can be replaced mid-frame
+        // (e.g. while streaming) without idling the queue or the device.
+        class DeletionQueue {
+        public:
+            using Object = std::variant<
+                vk::raii::Buffer,
+                vk::raii::BufferView,
+                vk::raii::DeviceMemory,
+                vk::raii::Image,
+                vk::raii::ImageView,
+                vk::raii::Sampler,
+                vk::raii::Pipeline,
+                vk::raii::PipelineLayout,
+                vk::raii::DescriptorPool,
+                vk::raii::DescriptorSetLayout,
+                vk::raii::CommandPool,
+                vk::raii::ShaderModule,
+                vk::raii::QueryPool>;
+
+            explicit DeletionQueue(Timeline &timeline);
+            ~DeletionQueue();
+
+            DeletionQueue(const DeletionQueue &) = delete;
+            DeletionQueue &operator=(const DeletionQueue &) = delete;
+
+            // Destroys the object once the timeline reaches the point.
+            void retire(Object &&object, uint64_t point);
+
+            // Destroys the object once the next submission is done, which
+            // covers everything submitted so far and whatever is being
+            // recorded for it. Work that's recorded for a later submission
+            // has to pass its own point.
+            void retire(Object &&object) { retire(std::move(object), nextPoint()); }
+            uint64_t nextPoint() const { return m_timeline->nextPoint(); }
+
+            // Destroys every retired object whose point has been reached.
+            // Call once per frame.
+            void collect();
+
+            // Waits for the GPU to finish with everything, then destroys it,
+            // including objects retired for points not yet submitted.
+            void flush();
+
+            size_t size() const;
+
+        private:
+            struct Retired {
+                uint64_t point;
+                Object object;
+            };
+
+            void destroyThrough(uint64_t completed);
+
+            Timeline *m_timeline;
+            mutable std::mutex m_mutex;
+            std::deque<Retired> m_retired;
+        };
+    }
+}
+
+#endif
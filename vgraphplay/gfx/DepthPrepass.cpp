@@ -0,0 +1,215 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#include <algorithm>
+#include <glm/vec4.hpp>
+
+#include <boost/log/trivial.hpp>
+
+#include "DepthPrepass.h"
+#include "HostAllocator.h"
+
+static void beginRendering(const vk::raii::CommandBuffer &commands, vk::Extent2D extent,
+                           const vk::RenderingAttachmentInfo *color, const vk::RenderingAttachmentInfo &depth) {
+    vk::RenderingInfo rendering_info{
+        .renderArea = {.offset = {0, 0}, .extent = extent},
+        .layerCount = 1,
+        .colorAttachmentCount = color == nullptr ? 0u : 1u,
+        .pColorAttachments = color,
+        .pDepthAttachment = &depth,
+    };
+    commands.beginRendering(rendering_info);
+
+    vk::Viewport viewport{
+        .x = 0.0f,
+        .y = 0.0f,
+        .width = static_cast<float>(extent.width),
+        .height = static_cast<float>(extent.height),
+        .minDepth = 0.0f,
+        .maxDepth = 1.0f,
+    };
+    commands.setViewport(0, viewport);
+    commands.setScissor(0, vk::Rect2D{.offset = {0, 0}, .extent = extent});
+}
+
+vgraphplay::gfx::DepthPrepass::DepthPrepass(std::nullptr_t)
+    : m_pipelines{nullptr},
+      m_depth_program{0},
+      m_color_program{0},
+      m_enabled{true},
+      m_queries{nullptr},
+      m_query_pixels{},
+      m_stats{0, 0}
+{}
+
+vgraphplay::gfx::DepthPrepass::DepthPrepass(const vk::raii::Device &device, PipelineCache &pipelines,
+                                            ProgramId depth_program, ProgramId color_program, uint32_t frames_in_flight, bool counters)
+    : DepthPrepass{nullptr}
+{
+    m_pipelines = &pipelines;
+    m_depth_program = depth_program;
+    m_color_program = color_program;
+    m_query_pixels.assign(frames_in_flight, 0);
+
+    if (counters) {
+        vk::QueryPoolCreateInfo query_ci{
+            .queryType = vk::QueryType::ePipelineStatistics,
+            .queryCount = frames_in_flight,
+            .pipelineStatistics = vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations,
+        };
+        m_queries = vk::raii::QueryPool{device, query_ci, HostAllocator::callbacks()};
+        BOOST_LOG_TRIVIAL(trace) << "Created overdraw query pool: " << *m_queries;
+    } else {
+        BOOST_LOG_TRIVIAL(info) << "Pipeline statistics queries are not supported; overdraw counters are disabled";
+    }
+}
+
+vgraphplay::gfx::DepthPrepass::~DepthPrepass() {}
+
+bool vgraphplay::gfx::DepthPrepass::countersSupported(const vk::PhysicalDeviceFeatures &features) {
+    return features.pipelineStatisticsQuery;
+}
+
+void vgraphplay::gfx::DepthPrepass::addDraw(DrawList &draws, const DrawItem &draw, const glm::mat4x4 &view) {
+    draws.add(draw, draw.features, DrawList::viewDepth(view, draw.draw));
+}
+
+void vgraphplay::gfx::DepthPrepass::addPasses(RenderGraph &graph, uint32_t frame, RenderResource color, RenderResource depth, const DrawList &draws) {
+    const vk::Extent2D extent = graph.imageDesc(color).extent;
+    const vk::Format color_format = graph.imageDesc(color).format;
+    const vk::Format depth_format = graph.imageDesc(depth).format;
+    const TargetsId depth_targets = m_pipelines->addTargets({}, depth_format);
+    const TargetsId color_targets = m_pipelines->addTargets(std::span{&color_format, 1}, depth_format);
+
+    const bool prepass = m_enabled;
+    const bool alpha_tested = std::ranges::any_of(draws.batches(), [](const DrawBatch &b) {
+        return (b.features & PipelineState::ALPHA_TEST) != 0;
+    });
+    // With everything's depth already in place and nothing to add, the
+    // color pass can use the read-only depth layout.
+    const bool read_only_depth = prepass && !alpha_tested;
+
+    if (prepass) {
+        graph.addPass("depth prepass", [this, &draws, depth, depth_targets, extent](const vk::raii::CommandBuffer &commands, const RenderGraph &g) {
+            vk::ClearValue clear{};
+            clear.depthStencil = vk::ClearDepthStencilValue{.depth = 1.0f, .stencil = 0};
+            vk::RenderingAttachmentInfo depth_attachment{
+                .imageView = g.imageView(depth),
+                .imageLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
+                .loadOp = vk::AttachmentLoadOp::eClear,
+                .storeOp = vk::AttachmentStoreOp::eStore,
+                .clearValue = clear,
+            };
+
+            beginRendering(commands, extent, nullptr, depth_attachment);
+            recordDraws(commands, draws, depth_targets, true, false);
+            commands.endRendering();
+        }).write(depth, Access::DepthAttachment);
+    }
+
+    auto color_pass = graph.addPass("opaque", [this, frame, &draws, color, depth, color_targets, extent, prepass, read_only_depth](const vk::raii::CommandBuffer &commands, const RenderGraph &g) {
+        vk::ClearValue color_clear{};
+        color_clear.color.float32[3] = 1.0f;
+        vk::RenderingAttachmentInfo color_attachment{
+            .imageView = g.imageView(color),
+            .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+            .loadOp = vk::AttachmentLoadOp::eClear,
+            .storeOp = vk::AttachmentStoreOp::eStore,
+            .clearValue = color_clear,
+        };
+
+        vk::ClearValue depth_clear{};
+        depth_clear.depthStencil = vk::ClearDepthStencilValue{.depth = 1.0f, .stencil = 0};
+        vk::RenderingAttachmentInfo depth_attachment{
+            .imageView = g.imageView(depth),
+            .imageLayout = read_only_depth ? vk::ImageLayout::eDepthStencilReadOnlyOptimal : vk::ImageLayout::eDepthStencilAttachmentOptimal,
+            .loadOp = prepass ? vk::AttachmentLoadOp::eLoad : vk::AttachmentLoadOp::eClear,
+            .storeOp = read_only_depth ? vk::AttachmentStoreOp::eNone : vk::AttachmentStoreOp::eStore,
+            .clearValue = depth_clear,
+        };
+
+        if (*m_queries) {
+            commands.resetQueryPool(*m_queries, frame, 1);
+        }
+
+        beginRendering(commands, extent, &color_attachment, depth_attachment);
+        if (*m_queries) {
+            commands.beginQuery(*m_queries, frame, {});
+        }
+        recordDraws(commands, draws, color_targets, false, prepass);
+        if (*m_queries) {
+            commands.endQuery(*m_queries, frame);
+        }
+        commands.endRendering();
+    });
+    color_pass.write(color, Access::ColorAttachment);
+
+    if (read_only_depth) {
+        color_pass.read(depth, Access::DepthAttachmentReadOnly);
+    } else {
+        if (prepass) {
+            color_pass.read(depth, Access::DepthAttachment);
+        }
+        color_pass.write(depth, Access::DepthAttachment);
+    }
+
+    m_query_pixels[frame] = static_cast<uint64_t>(extent.width) * extent.height;
+}
+
+void vgraphplay::gfx::DepthPrepass::collect(uint32_t frame) {
+    if (!*m_queries || m_query_pixels[frame] == 0) {
+        return;
+    }
+
+    auto [result, values] = m_queries.getResults<uint64_t>(frame, 1, sizeof(uint64_t), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+    if (result == vk::Result::eSuccess) {
+        m_stats = OverdrawStats{values[0], m_query_pixels[frame]};
+    }
+    m_query_pixels[frame] = 0;
+}
+
+void vgraphplay::gfx::DepthPrepass::recordDraws(const vk::raii::CommandBuffer &commands, const DrawList &draws, TargetsId targets, bool depth_only, bool after_prepass) {
+    const ProgramId program = depth_only ? m_depth_program : m_color_program;
+    const vk::PipelineLayout layout = m_pipelines->layout(program);
+
+    vk::Pipeline bound_pipeline = nullptr;
+    vk::DescriptorSet bound_set = nullptr;
+    const MeshBuffers *bound_mesh = nullptr;
+
+    draws.bindInstances(commands);
+
+    for (const DrawBatch &batch : draws.batches()) {
+        const bool alpha_test = (batch.features & PipelineState::ALPHA_TEST) != 0;
+        if (depth_only && alpha_test) {
+            continue;
+        }
+
+        PipelineState state{};
+        if (depth_only) {
+            state.features = 0;
+            state.color_write = false;
+        } else {
+            state.features = batch.features;
+            if (after_prepass && !alpha_test) {
+                state.depth_write = false;
+                state.depth_compare = vk::CompareOp::eEqual;
+            }
+        }
+
+        const vk::Pipeline pipeline = m_pipelines->pipeline(PipelineKey{program, targets, state});
+        if (pipeline != bound_pipeline) {
+            commands.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);
+            bound_pipeline = pipeline;
+        }
+        if (batch.set != bound_set) {
+            commands.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, layout, 0, batch.set, nullptr);
+            bound_set = batch.set;
+        }
+        if (batch.mesh != bound_mesh) {
+            commands.bindVertexBuffers(0, depth_only ? batch.mesh->positions : batch.mesh->vertices, vk::DeviceSize{0});
+            commands.bindIndexBuffer(batch.mesh->indices, 0, batch.mesh->index_type);
+            bound_mesh = batch.mesh;
+        }
+
+        draws.draw(commands, batch);
+    }
+}
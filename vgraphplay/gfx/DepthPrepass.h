@@ -0,0 +1,85 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_GFX_DEPTH_PREPASS_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_GFX_DEPTH_PREPASS_H_
+
+#include <cstdint>
+#include <vector>
+#include <glm/mat4x4.hpp>
+
+#include "../vulkan.h"
+
+#include "DrawList.h"
+#include "PipelineCache.h"
+#include "RenderGraph.h"
+
+namespace vgraphplay {
+    namespace gfx {
+        // Fragment shader invocations in the color pass over the pixels
+        // covered by the color target: 1.0 means every pixel was shaded
+        // exactly once.
+        struct OverdrawStats {
+            uint64_t color_fragments;
+            uint64_t pixels;
+
+            double overdraw() const { return pixels == 0 ? 0.0 : static_cast<double>(color_fragments) / static_cast<double>(pixels); }
+        };
+
+        // Draws opaque geometry, optionally laying down depth first with a
+        // position-only pipeline that has no color output, then shading
+        // with depth compare EQUAL and depth writes off, so each pixel's
+        // fragment shader runs once. Alpha-tested draws can't go in the
+        // pre-pass (their depth depends on the texture), so they skip it
+        // and depth test normally in the color pass.
+        //
+        // The draws come from a DrawList, so both passes are batched the
+        // same way and go front to back within a batch.
+        //
+        // When the device supports pipeline statistics queries, the color
+        // pass's fragment shader invocations are counted per frame slot.
+        class DepthPrepass {
+        public:
+            DepthPrepass(std::nullptr_t);
+            DepthPrepass(const vk::raii::Device &device, PipelineCache &pipelines, ProgramId depth_program, ProgramId color_program, uint32_t frames_in_flight, bool counters);
+            ~DepthPrepass();
+
+            DepthPrepass(const DepthPrepass &) = delete;
+            DepthPrepass &operator=(const DepthPrepass &) = delete;
+            DepthPrepass(DepthPrepass &&) = default;
+            DepthPrepass &operator=(DepthPrepass &&) = default;
+
+            static bool countersSupported(const vk::PhysicalDeviceFeatures &features);
+
+            bool enabled() const { return m_enabled; }
+            void setEnabled(bool enabled) { m_enabled = enabled; }
+
+            // Adds an opaque draw to the list, keyed by its material
+            // features and view-space depth.
+            static void addDraw(DrawList &draws, const DrawItem &draw, const glm::mat4x4 &view);
+
+            // Adds the pre-pass (if enabled) and the color pass for a built
+            // list. Both the graph and the list must outlive the frame's
+            // command recording.
+            void addPasses(RenderGraph &graph, uint32_t frame, RenderResource color, RenderResource depth, const DrawList &draws);
+
+            // Reads back the frame slot's counters. Call once the GPU has
+            // finished the slot's previous frame.
+            void collect(uint32_t frame);
+            const OverdrawStats &stats() const { return m_stats; }
+
+        private:
+            void recordDraws(const vk::raii::CommandBuffer &commands, const DrawList &draws, TargetsId targets, bool depth_only, bool after_prepass);
+
+            PipelineCache *m_pipelines;
+            ProgramId m_depth_program;
+            ProgramId m_color_program;
+            bool m_enabled;
+
+            vk::raii::QueryPool m_queries;
+            std::vector<uint64_t> m_query_pixels; // Per frame slot; 0 if nothing was recorded.
+            OverdrawStats m_stats;
+        };
+    }
+}
+
+#endif
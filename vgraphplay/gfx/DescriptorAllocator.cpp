@@ -0,0 +1,250 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+#include "DescriptorAllocator.h"
+#include "HostAllocator.h"
+#include "Resources.h"
+#include "../Log.h"
+
+const vgraphplay::gfx::DescriptorPoolRatio DEFAULT_POOL_RATIOS[] = {
+    {vk::DescriptorType::eUniformBuffer, 1.0f},
+    {vk::DescriptorType::eCombinedImageSampler, 1.0f},
+    {vk::DescriptorType::eStorageBuffer, 0.5f},
+    {vk::DescriptorType::eUniformBufferDynamic, 0.5f},
+};
+
+vgraphplay::gfx::DescriptorAllocator::DescriptorAllocator(std::nullptr_t)
+    : m_device{nullptr},
+      m_ratios{},
+      m_flags{},
+      m_sets_per_pool{0},
+      m_current{nullptr},
+      m_ready_pools{},
+      m_full_pools{}
+{}
+
+vgraphplay::gfx::DescriptorAllocator::DescriptorAllocator(const vk::raii::Device &device,
+                                                          uint32_t initial_sets_per_pool,
+                                                          std::span<const DescriptorPoolRatio> ratios,
+                                                          vk::DescriptorPoolCreateFlags flags)
+    : m_device{&device},
+      m_ratios{},
+      m_flags{flags},
+      m_sets_per_pool{std::max(initial_sets_per_pool, 1u)},
+      m_current{nullptr},
+      m_ready_pools{},
+      m_full_pools{}
+{
+    if (ratios.empty()) {
+        m_ratios.assign(std::begin(DEFAULT_POOL_RATIOS), std::end(DEFAULT_POOL_RATIOS));
+    } else {
+        m_ratios.assign(ratios.begin(), ratios.end());
+    }
+}
+
+vgraphplay::gfx::DescriptorAllocator::~DescriptorAllocator() {}
+
+vk::DescriptorSet vgraphplay::gfx::DescriptorAllocator::allocate(vk::DescriptorSetLayout layout, const void *next) {
+    vk::DescriptorSet set;
+
+    for (;;) {
+        // A full pool is set aside and the next one tried. If even a brand
+        // new pool can't hold the set, growing won't help.
+        bool fresh = false;
+        if (!*m_current) {
+            fresh = m_ready_pools.empty();
+            m_current = takePool();
+        }
+        vk::Result result = tryAllocate(m_current, layout, next, set);
+
+        if (!fresh && (result == vk::Result::eErrorOutOfPoolMemory || result == vk::Result::eErrorFragmentedPool)) {
+            m_full_pools.push_back(std::move(m_current));
+            m_current = vk::raii::DescriptorPool{nullptr};
+            continue;
+        }
+
+        if (result != vk::Result::eSuccess) {
+            throw std::runtime_error("Unable to allocate descriptor set: " + vk::to_string(result));
+        }
+        return set;
+    }
+}
+
+void vgraphplay::gfx::DescriptorAllocator::reset() {
+    // Ready pools are already empty, so only the ones used since the last
+    // reset need resetting.
+    if (*m_current) {
+        m_current.reset();
+        m_ready_pools.push_back(std::move(m_current));
+        m_current = vk::raii::DescriptorPool{nullptr};
+    }
+
+    for (auto &pool : m_full_pools) {
+        pool.reset();
+        m_ready_pools.push_back(std::move(pool));
+    }
+
+    m_full_pools.clear();
+}
+
+vk::raii::DescriptorPool vgraphplay::gfx::DescriptorAllocator::takePool() {
+    if (!m_ready_pools.empty()) {
+        vk::raii::DescriptorPool pool = std::move(m_ready_pools.back());
+        m_ready_pools.pop_back();
+        return pool;
+    }
+
+    vk::raii::DescriptorPool pool = createPool(m_sets_per_pool);
+    m_sets_per_pool = std::min(m_sets_per_pool + m_sets_per_pool / 2, MAX_SETS_PER_POOL);
+    return pool;
+}
+
+vk::raii::DescriptorPool vgraphplay::gfx::DescriptorAllocator::createPool(uint32_t max_sets) {
+    std::vector<vk::DescriptorPoolSize> sizes;
+    for (const auto &ratio : m_ratios) {
+        sizes.push_back(vk::DescriptorPoolSize{
+            .type = ratio.type,
+            .descriptorCount = std::max(static_cast<uint32_t>(ratio.per_set * max_sets), 1u),
+        });
+    }
+
+    vk::DescriptorPoolCreateInfo pool_ci{
+        .flags = m_flags,
+        .maxSets = max_sets,
+        .poolSizeCount = static_cast<uint32_t>(sizes.size()),
+        .pPoolSizes = sizes.data(),
+    };
+
+    vk::raii::DescriptorPool pool{*m_device, pool_ci, HostAllocator::callbacks()};
+    VGRAPHPLAY_LOG(trace, "Created descriptor pool {:#x} for {} sets", *pool, max_sets);
+    return pool;
+}
+
+// Allocates through the dispatcher rather than vk::raii::DescriptorSets:
+// those free themselves individually when destroyed, which our pools
+// don't allow. The sets go away when their pool is reset or destroyed.
+vk::Result vgraphplay::gfx::DescriptorAllocator::tryAllocate(const vk::raii::DescriptorPool &pool, vk::DescriptorSetLayout layout, const void *next, vk::DescriptorSet &set) {
+    VkDescriptorSetLayout c_layout = static_cast<VkDescriptorSetLayout>(layout);
+    VkDescriptorSetAllocateInfo alloc_info{
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext = next,
+        .descriptorPool = static_cast<VkDescriptorPool>(*pool),
+        .descriptorSetCount = 1,
+        .pSetLayouts = &c_layout,
+    };
+
+    VkDescriptorSet c_set = VK_NULL_HANDLE;
+    VkResult result = m_device->getDispatcher()->vkAllocateDescriptorSets(static_cast<VkDevice>(**m_device), &alloc_info, &c_set);
+    set = c_set;
+    return static_cast<vk::Result>(result);
+}
+
+vgraphplay::gfx::DescriptorSetKey &vgraphplay::gfx::DescriptorSetKey::buffer(uint32_t binding, vk::DescriptorType type, vk::Buffer buffer, vk::DeviceSize offset, vk::DeviceSize range) {
+    m_bindings.push_back(Binding{
+        .binding = binding,
+        .type = type,
+        .buffer = {.buffer = buffer, .offset = offset, .range = range},
+        .image = {},
+    });
+    return *this;
+}
+
+vgraphplay::gfx::DescriptorSetKey &vgraphplay::gfx::DescriptorSetKey::image(uint32_t binding, vk::DescriptorType type, vk::Sampler sampler, vk::ImageView view, vk::ImageLayout layout) {
+    m_bindings.push_back(Binding{
+        .binding = binding,
+        .type = type,
+        .buffer = {},
+        .image = {.sampler = sampler, .imageView = view, .imageLayout = layout},
+    });
+    return *this;
+}
+
+bool vgraphplay::gfx::DescriptorSetKey::refersTo(uint64_t object) const {
+    return std::ranges::any_of(m_bindings, [object](const Binding &b) {
+        return reinterpret_cast<uint64_t>(static_cast<VkBuffer>(b.buffer.buffer)) == object ||
+            reinterpret_cast<uint64_t>(static_cast<VkImageView>(b.image.imageView)) == object ||
+            reinterpret_cast<uint64_t>(static_cast<VkSampler>(b.image.sampler)) == object;
+    });
+}
+
+void vgraphplay::gfx::DescriptorSetKey::write(const vk::raii::Device &device, vk::DescriptorSet set) const {
+    std::vector<vk::WriteDescriptorSet> writes;
+    writes.reserve(m_bindings.size());
+
+    for (const auto &b : m_bindings) {
+        bool is_image = b.image.imageView || b.image.sampler;
+        writes.push_back(vk::WriteDescriptorSet{
+            .dstSet = set,
+            .dstBinding = b.binding,
+            .dstArrayElement = 0,
+            .descriptorCount = 1,
+            .descriptorType = b.type,
+            .pImageInfo = is_image ? &b.image : nullptr,
+            .pBufferInfo = is_image ? nullptr : &b.buffer,
+        });
+    }
+
+    device.updateDescriptorSets(writes, {});
+}
+
+bool vgraphplay::gfx::DescriptorSetKey::operator==(const DescriptorSetKey &other) const {
+    return m_layout == other.m_layout && m_bindings == other.m_bindings;
+}
+
+size_t vgraphplay::gfx::DescriptorSetKey::hash() const {
+    size_t h = std::hash<uint64_t>{}(reinterpret_cast<uint64_t>(static_cast<VkDescriptorSetLayout>(m_layout)));
+    auto combine = [&h](uint64_t v) { h ^= std::hash<uint64_t>{}(v) + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2); };
+
+    for (const auto &b : m_bindings) {
+        combine((static_cast<uint64_t>(b.binding) << 32) | static_cast<uint32_t>(b.type));
+        combine(reinterpret_cast<uint64_t>(static_cast<VkBuffer>(b.buffer.buffer)));
+        combine(b.buffer.offset);
+        combine(b.buffer.range);
+        combine(reinterpret_cast<uint64_t>(static_cast<VkSampler>(b.image.sampler)));
+        combine(reinterpret_cast<uint64_t>(static_cast<VkImageView>(b.image.imageView)));
+        combine(static_cast<uint64_t>(b.image.imageLayout));
+    }
+
+    return h;
+}
+
+vgraphplay::gfx::DescriptorSetCache::DescriptorSetCache(std::nullptr_t)
+    : m_device{nullptr},
+      m_allocator{nullptr},
+      m_sets{},
+      m_hits{0},
+      m_misses{0}
+{}
+
+vgraphplay::gfx::DescriptorSetCache::DescriptorSetCache(const vk::raii::Device &device, DescriptorAllocator &allocator)
+    : m_device{&device},
+      m_allocator{&allocator},
+      m_sets{},
+      m_hits{0},
+      m_misses{0}
+{}
+
+vk::DescriptorSet vgraphplay::gfx::DescriptorSetCache::get(const DescriptorSetKey &key) {
+    auto it = m_sets.find(key);
+    if (it != m_sets.end()) {
+        ++m_hits;
+        return it->second;
+    }
+
+    ++m_misses;
+    vk::DescriptorSet set = m_allocator->allocate(key.layout());
+    key.write(*m_device, set);
+    m_sets.emplace(key, set);
+    return set;
+}
+
+void vgraphplay::gfx::DescriptorSetCache::invalidate(uint64_t object) {
+    std::erase_if(m_sets, [object](const auto &entry) { return entry.first.refersTo(object); });
+}
+
+void vgraphplay::gfx::DescriptorSetCache::watch(Resources &resources) {
+    resources.onDestroy([this](uint64_t object) { invalidate(object); });
+}
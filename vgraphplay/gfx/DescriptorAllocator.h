@@ -0,0 +1,146 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_GFX_DESCRIPTOR_ALLOCATOR_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_GFX_DESCRIPTOR_ALLOCATOR_H_
+
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "../vulkan.h"
+
+namespace vgraphplay {
+    namespace gfx {
+        class Resources;
+
+        // How many descriptors of each type to reserve per set when sizing
+        // a pool.
+        struct DescriptorPoolRatio {
+            vk::DescriptorType type;
+            float per_set;
+        };
+
+        // Hands out descriptor sets from a growing list of pools. When a pool
+        // runs out (VK_ERROR_OUT_OF_POOL_MEMORY or VK_ERROR_FRAGMENTED_POOL)
+        // it is set aside and a new, larger one is created, so callers never
+        // need to know up front how many sets they will need.
+        //
+        // Sets are never freed individually. reset() resets the pools
+        // allocated from since the last reset, one call each, and makes them
+        // available again; pools left untouched cost nothing. That suits
+        // per-frame (transient) allocators: keep one per frame in flight and
+        // reset it once the GPU is done with that frame.
+        class DescriptorAllocator {
+        public:
+            static constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+
+            DescriptorAllocator(std::nullptr_t);
+            DescriptorAllocator(const vk::raii::Device &device,
+                                uint32_t initial_sets_per_pool = 64,
+                                std::span<const DescriptorPoolRatio> ratios = {},
+                                vk::DescriptorPoolCreateFlags flags = {});
+            ~DescriptorAllocator();
+
+            DescriptorAllocator(const DescriptorAllocator &) = delete;
+            DescriptorAllocator &operator=(const DescriptorAllocator &) = delete;
+            DescriptorAllocator(DescriptorAllocator &&) = default;
+            DescriptorAllocator &operator=(DescriptorAllocator &&) = default;
+
+            // The set lives until the next reset() or until the allocator is
+            // destroyed. next is chained onto the allocate info, e.g. for
+            // variable descriptor counts.
+            vk::DescriptorSet allocate(vk::DescriptorSetLayout layout, const void *next = nullptr);
+            void reset();
+
+            size_t poolCount() const { return m_ready_pools.size() + m_full_pools.size() + (*m_current ? 1 : 0); }
+
+        private:
+            vk::raii::DescriptorPool takePool();
+            vk::raii::DescriptorPool createPool(uint32_t max_sets);
+            vk::Result tryAllocate(const vk::raii::DescriptorPool &pool, vk::DescriptorSetLayout layout, const void *next, vk::DescriptorSet &set);
+
+            const vk::raii::Device *m_device;
+            std::vector<DescriptorPoolRatio> m_ratios;
+            vk::DescriptorPoolCreateFlags m_flags;
+            uint32_t m_sets_per_pool;
+            vk::raii::DescriptorPool m_current;                 // Allocated from since the last reset.
+            std::vector<vk::raii::DescriptorPool> m_ready_pools; // Empty.
+            std::vector<vk::raii::DescriptorPool> m_full_pools;  // Allocated from, and out of space.
+        };
+
+        // What a descriptor set contains: its layout and the resource bound
+        // to each (single-descriptor) binding. Two keys that compare equal
+        // describe interchangeable sets.
+        class DescriptorSetKey {
+        public:
+            explicit DescriptorSetKey(vk::DescriptorSetLayout layout) : m_layout{layout}, m_bindings{} {}
+
+            DescriptorSetKey &buffer(uint32_t binding, vk::DescriptorType type, vk::Buffer buffer, vk::DeviceSize offset = 0, vk::DeviceSize range = vk::WholeSize);
+            DescriptorSetKey &image(uint32_t binding, vk::DescriptorType type, vk::Sampler sampler, vk::ImageView view, vk::ImageLayout layout = vk::ImageLayout::eShaderReadOnlyOptimal);
+
+            vk::DescriptorSetLayout layout() const { return m_layout; }
+            void write(const vk::raii::Device &device, vk::DescriptorSet set) const;
+
+            // Whether any binding uses the buffer, image view or sampler.
+            bool refersTo(uint64_t object) const;
+
+            bool operator==(const DescriptorSetKey &other) const;
+            size_t hash() const;
+
+        private:
+            struct Binding {
+                uint32_t binding;
+                vk::DescriptorType type;
+                vk::DescriptorBufferInfo buffer;
+                vk::DescriptorImageInfo image;
+
+                bool operator==(const Binding &other) const = default;
+            };
+
+            vk::DescriptorSetLayout m_layout;
+            std::vector<Binding> m_bindings;
+        };
+
+        // Reuses descriptor sets whose contents are identical instead of
+        // allocating and writing a new set every time. The cached sets live
+        // in the given allocator, so clear() must be called whenever that
+        // allocator is reset. Sets that refer to a destroyed resource must
+        // be dropped with invalidate() before Vulkan hands the same handle
+        // out again; watch(resources) does that as the resources go.
+        class DescriptorSetCache {
+        public:
+            DescriptorSetCache(std::nullptr_t);
+            DescriptorSetCache(const vk::raii::Device &device, DescriptorAllocator &allocator);
+
+            vk::DescriptorSet get(const DescriptorSetKey &key);
+            void clear() { m_sets.clear(); }
+
+            // Forgets every set that refers to the buffer, image view or
+            // sampler. The sets themselves go with the allocator's next
+            // reset.
+            void invalidate(uint64_t object);
+
+            // Invalidates sets as their resources are destroyed. The cache
+            // must stay where it is while the resources are alive.
+            void watch(Resources &resources);
+
+            size_t size() const { return m_sets.size(); }
+            uint64_t hits() const { return m_hits; }
+            uint64_t misses() const { return m_misses; }
+
+        private:
+            struct KeyHash {
+                size_t operator()(const DescriptorSetKey &key) const { return key.hash(); }
+            };
+
+            const vk::raii::Device *m_device;
+            DescriptorAllocator *m_allocator;
+            std::unordered_map<DescriptorSetKey, vk::DescriptorSet, KeyHash> m_sets;
+            uint64_t m_hits;
+            uint64_t m_misses;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,168 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#include <vector>
+
+#include <boost/log/trivial.hpp>
+
+#include "DeviceBenchmark.h"
+#include "HostAllocator.h"
+
+static const vk::ImageSubresourceRange COLOR_RANGE{
+    .aspectMask = vk::ImageAspectFlagBits::eColor,
+    .baseMipLevel = 0,
+    .levelCount = 1,
+    .baseArrayLayer = 0,
+    .layerCount = 1,
+};
+
+static vk::ImageMemoryBarrier2 clearBarrier(vk::Image image, vk::ImageLayout old_layout) {
+    return vk::ImageMemoryBarrier2{
+        .srcStageMask = vk::PipelineStageFlagBits2::eClear,
+        .srcAccessMask = vk::AccessFlagBits2::eTransferWrite,
+        .dstStageMask = vk::PipelineStageFlagBits2::eClear,
+        .dstAccessMask = vk::AccessFlagBits2::eTransferWrite,
+        .oldLayout = old_layout,
+        .newLayout = vk::ImageLayout::eTransferDstOptimal,
+        .srcQueueFamilyIndex = vk::QueueFamilyIgnored,
+        .dstQueueFamilyIndex = vk::QueueFamilyIgnored,
+        .image = image,
+        .subresourceRange = COLOR_RANGE,
+    };
+}
+
+// Lets go of Vulkan objects without destroying them.
+template <typename... Objects>
+static void leak(Objects &...objects) {
+    (objects.release(), ...);
+}
+
+float vgraphplay::gfx::DeviceBenchmark::measure(const vk::raii::PhysicalDevice &physical_device, const DeviceProfile &profile) {
+    const vk::PhysicalDeviceProperties props = physical_device.getProperties();
+    const uint32_t family = profile.graphics_queue_family;
+    const uint32_t valid_bits = physical_device.getQueueFamilyProperties()[family].timestampValidBits;
+    if (valid_bits == 0 || props.limits.timestampPeriod == 0.0f) {
+        BOOST_LOG_TRIVIAL(info) << "Can't benchmark " << profile.name << ": its graphics queue has no timestamps";
+        return 0.0f;
+    }
+
+    const float priority = 1.0f;
+    const vk::DeviceQueueCreateInfo queue_ci{
+        .queueFamilyIndex = family,
+        .queueCount = 1,
+        .pQueuePriorities = &priority,
+    };
+    vk::PhysicalDeviceVulkan13Features features13{.synchronization2 = true};
+    const vk::DeviceCreateInfo device_ci = vk::DeviceCreateInfo{
+        .pNext = &features13,
+    }.setQueueCreateInfos(queue_ci);
+    vk::raii::Device device{physical_device, device_ci, HostAllocator::callbacks()};
+    vk::raii::Queue queue{device, family, 0};
+
+    vk::raii::Image image{device, vk::ImageCreateInfo{
+        .imageType = vk::ImageType::e2D,
+        .format = vk::Format::eR8G8B8A8Unorm,
+        .extent = {IMAGE_SIZE, IMAGE_SIZE, 1},
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = vk::SampleCountFlagBits::e1,
+        .tiling = vk::ImageTiling::eOptimal,
+        .usage = vk::ImageUsageFlagBits::eTransferDst,
+        .sharingMode = vk::SharingMode::eExclusive,
+        .initialLayout = vk::ImageLayout::eUndefined,
+    }, HostAllocator::callbacks()};
+
+    const vk::MemoryRequirements reqs = image.getMemoryRequirements();
+    const vk::PhysicalDeviceMemoryProperties memory_props = physical_device.getMemoryProperties();
+    uint32_t memory_type = 0;
+    while (memory_type < memory_props.memoryTypeCount &&
+           !((reqs.memoryTypeBits & (1 << memory_type)) &&
+             (memory_props.memoryTypes[memory_type].propertyFlags & vk::MemoryPropertyFlagBits::eDeviceLocal))) {
+        ++memory_type;
+    }
+    if (memory_type == memory_props.memoryTypeCount) {
+        return 0.0f;
+    }
+    vk::raii::DeviceMemory memory{device, vk::MemoryAllocateInfo{
+        .allocationSize = reqs.size,
+        .memoryTypeIndex = memory_type,
+    }, HostAllocator::callbacks()};
+    image.bindMemory(*memory, 0);
+
+    vk::raii::CommandPool pool{device, vk::CommandPoolCreateInfo{.queueFamilyIndex = family}, HostAllocator::callbacks()};
+    vk::raii::CommandBuffers buffers{device, vk::CommandBufferAllocateInfo{
+        .commandPool = *pool,
+        .level = vk::CommandBufferLevel::ePrimary,
+        .commandBufferCount = 1,
+    }};
+    vk::raii::CommandBuffer &commands = buffers.front();
+    vk::raii::QueryPool queries{device, vk::QueryPoolCreateInfo{
+        .queryType = vk::QueryType::eTimestamp,
+        .queryCount = 2,
+    }, HostAllocator::callbacks()};
+    vk::raii::Fence fence{device, vk::FenceCreateInfo{}, HostAllocator::callbacks()};
+
+    // Alternating colors, with a barrier between clears, so none of them
+    // can be skipped or overlapped.
+    commands.begin(vk::CommandBufferBeginInfo{});
+    commands.resetQueryPool(*queries, 0, 2);
+    vk::ImageMemoryBarrier2 barrier = clearBarrier(*image, vk::ImageLayout::eUndefined);
+    commands.pipelineBarrier2(vk::DependencyInfo{.imageMemoryBarrierCount = 1, .pImageMemoryBarriers = &barrier});
+    commands.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, *queries, 0);
+    barrier = clearBarrier(*image, vk::ImageLayout::eTransferDstOptimal);
+    for (uint32_t i = 0; i < CLEARS; ++i) {
+        vk::ClearColorValue color{};
+        color.float32[0] = color.float32[1] = color.float32[2] = static_cast<float>(i & 1);
+        color.float32[3] = 1.0f;
+        commands.clearColorImage(*image, vk::ImageLayout::eTransferDstOptimal, color, COLOR_RANGE);
+        commands.pipelineBarrier2(vk::DependencyInfo{.imageMemoryBarrierCount = 1, .pImageMemoryBarriers = &barrier});
+    }
+    commands.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, *queries, 1);
+    commands.end();
+
+    const vk::CommandBufferSubmitInfo command_info{.commandBuffer = *commands};
+    const vk::SubmitInfo2 submit_info{
+        .commandBufferInfoCount = 1,
+        .pCommandBufferInfos = &command_info,
+    };
+    for (int run = 0; run < 2; ++run) {
+        device.resetFences(*fence);
+        queue.submit2(submit_info, *fence);
+        if (device.waitForFences(*fence, true, TIMEOUT.count()) != vk::Result::eSuccess) {
+            BOOST_LOG_TRIVIAL(info) << "Benchmarking " << profile.name << " timed out";
+            // Nothing the clears use can be destroyed until they're done,
+            // and waitIdle() could wait forever. Give them one more
+            // TIMEOUT, and if that isn't enough leave everything behind.
+            if (device.waitForFences(*fence, true, TIMEOUT.count()) != vk::Result::eSuccess) {
+                BOOST_LOG_TRIVIAL(warning) << "Leaking the benchmark device for " << profile.name << "; it's still busy";
+                leak(fence, queries, commands, pool, memory, image, device);
+            }
+            return 0.0f;
+        }
+    }
+
+    auto [result, stamps] = queries.getResults<uint64_t>(0, 2, 2 * sizeof(uint64_t), sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+    if (result != vk::Result::eSuccess) {
+        return 0.0f;
+    }
+
+    const uint64_t mask = valid_bits >= 64 ? ~uint64_t{0} : (uint64_t{1} << valid_bits) - 1;
+    const double ns = static_cast<double>((stamps[1] - stamps[0]) & mask) * props.limits.timestampPeriod;
+    if (ns <= 0.0) {
+        return 0.0f;
+    }
+    const double pixels = static_cast<double>(IMAGE_SIZE) * IMAGE_SIZE * CLEARS;
+    return static_cast<float>(pixels / ns);
+}
+
+float vgraphplay::gfx::DeviceBenchmark::fillRate(const vk::raii::PhysicalDevice &physical_device, const DeviceProfile &profile) {
+    if (!profile.suitable()) {
+        return 0.0f;
+    }
+
+    try {
+        return measure(physical_device, profile);
+    } catch (const vk::SystemError &e) {
+        BOOST_LOG_TRIVIAL(warning) << "Benchmarking " << profile.name << " failed: " << e.what();
+        return 0.0f;
+    }
+}
@@ -0,0 +1,38 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_GFX_DEVICE_BENCHMARK_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_GFX_DEVICE_BENCHMARK_H_
+
+#include <chrono>
+#include <cstdint>
+
+#include "../vulkan.h"
+#include "DeviceProfile.h"
+
+namespace vgraphplay {
+    namespace gfx {
+        // A quick fill-rate measurement, for telling devices apart when
+        // their properties don't: clears an IMAGE_SIZE square RGBA8 image
+        // CLEARS times on a throwaway device of its own, and times that
+        // on the GPU with timestamps. The first run warms up and the
+        // second is the one measured.
+        //
+        // Returns gigapixels per second, or 0 if the device can't take
+        // timestamps on its graphics queue, a Vulkan call fails, or it
+        // doesn't finish in TIMEOUT. A device that still hasn't finished
+        // after another TIMEOUT is leaked rather than waited on.
+        class DeviceBenchmark {
+        public:
+            static constexpr uint32_t IMAGE_SIZE = 2048;
+            static constexpr uint32_t CLEARS = 16;
+            static constexpr std::chrono::nanoseconds TIMEOUT = std::chrono::seconds{2};
+
+            static float fillRate(const vk::raii::PhysicalDevice &physical_device, const DeviceProfile &profile);
+
+        private:
+            static float measure(const vk::raii::PhysicalDevice &physical_device, const DeviceProfile &profile);
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,232 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+#include <boost/log/trivial.hpp>
+
+#include "DeviceProfile.h"
+#include "Bindless.h"
+#include "DepthPrepass.h"
+#include "DrawList.h"
+
+// The first line of the cache file. Bump the number when the fields change,
+// and old files are ignored.
+static const char *const CACHE_HEADER = "vgraphplay device profiles 2";
+
+// Properties alone, which is all a cached profile needs to be found.
+static vgraphplay::gfx::DeviceProfile identify(const vk::raii::PhysicalDevice &device) {
+    const auto properties = device.getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceIDProperties>();
+    const vk::PhysicalDeviceProperties &props = properties.get<vk::PhysicalDeviceProperties2>().properties;
+
+    vgraphplay::gfx::DeviceProfile rv{
+        .name = props.deviceName.data(),
+        .vendor_id = props.vendorID,
+        .device_id = props.deviceID,
+        .driver_version = props.driverVersion,
+        .api_version = props.apiVersion,
+        .type = props.deviceType,
+    };
+    std::ranges::copy(properties.get<vk::PhysicalDeviceIDProperties>().deviceUUID, rv.uuid.begin());
+    return rv;
+}
+
+vgraphplay::gfx::DeviceProfile vgraphplay::gfx::DeviceProfile::probe(const vk::raii::PhysicalDevice &device) {
+    DeviceProfile rv = identify(device);
+
+    const auto features = device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features, vk::PhysicalDeviceVulkan13Features, vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>();
+    const vk::PhysicalDeviceFeatures &features10 = features.get<vk::PhysicalDeviceFeatures2>().features;
+    const vk::PhysicalDeviceVulkan12Features &features12 = features.get<vk::PhysicalDeviceVulkan12Features>();
+    const vk::PhysicalDeviceVulkan13Features &features13 = features.get<vk::PhysicalDeviceVulkan13Features>();
+
+    auto set = [&rv](uint32_t feature, bool supported) {
+        if (supported) {
+            rv.features |= feature;
+        }
+    };
+
+    const std::vector<vk::ExtensionProperties> extensions = device.enumerateDeviceExtensionProperties();
+    set(VULKAN_13, rv.api_version >= vk::ApiVersion13);
+    set(SWAPCHAIN, std::ranges::any_of(extensions, [](const auto &ext) {
+        return std::strcmp(ext.extensionName, vk::KHRSwapchainExtensionName) == 0;
+    }));
+    set(DYNAMIC_RENDERING, features13.dynamicRendering);
+    set(EXTENDED_DYNAMIC_STATE, features.get<vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>().extendedDynamicState);
+    set(BC_TEXTURES, features10.textureCompressionBC);
+    set(TIMELINE_SEMAPHORES, features12.timelineSemaphore);
+    set(SYNCHRONIZATION_2, features13.synchronization2);
+    set(PIPELINE_STATISTICS, DepthPrepass::countersSupported(features10));
+    set(MULTI_DRAW, DrawList::multiDrawSupported(features10));
+    set(BINDLESS, BindlessTable::isSupported(features12));
+
+    const std::vector<vk::QueueFamilyProperties> queue_families = device.getQueueFamilyProperties();
+    rv.queue_family_count = static_cast<uint32_t>(queue_families.size());
+    for (uint32_t i = 0; i < rv.queue_family_count; ++i) {
+        const vk::QueueFlags flags = queue_families[i].queueFlags;
+        if ((flags & vk::QueueFlagBits::eGraphics) && rv.graphics_queue_family == NO_QUEUE_FAMILY) {
+            rv.graphics_queue_family = i;
+        }
+        set(ASYNC_COMPUTE, (flags & vk::QueueFlagBits::eCompute) && !(flags & vk::QueueFlagBits::eGraphics));
+        set(TRANSFER_QUEUE, (flags & vk::QueueFlagBits::eTransfer) && !(flags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute)));
+    }
+
+    const vk::PhysicalDeviceMemoryProperties memory = device.getMemoryProperties();
+    for (uint32_t i = 0; i < memory.memoryHeapCount; ++i) {
+        if (memory.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal) {
+            rv.device_local_bytes = std::max(rv.device_local_bytes, static_cast<uint64_t>(memory.memoryHeaps[i].size));
+        }
+    }
+
+    return rv;
+}
+
+// Weights for score(). A device's type outweighs anything else about it,
+// so an integrated GPU with a large shared heap still loses to a discrete
+// one; within a type, each doubling of memory is worth half an optional
+// feature.
+static constexpr double TYPE_SCORES[] = {
+    100.0,  // Other
+    500.0,  // Integrated GPU
+    1000.0, // Discrete GPU
+    300.0,  // Virtual GPU
+    1.0,    // CPU
+};
+static constexpr double MEMORY_DOUBLING_SCORE = 20.0; // Over 1 MiB.
+static constexpr double OPTIONAL_FEATURE_SCORE = 40.0;
+static constexpr double QUEUE_SCORE = 20.0;
+
+double vgraphplay::gfx::DeviceProfile::score() const {
+    if (!suitable()) {
+        return 0.0;
+    }
+
+    const size_t type_index = static_cast<size_t>(type);
+    double rv = type_index < std::size(TYPE_SCORES) ? TYPE_SCORES[type_index] : TYPE_SCORES[0];
+
+    const double memory_mib = static_cast<double>(device_local_bytes) / (1024.0 * 1024.0);
+    if (memory_mib > 1.0) {
+        rv += std::log2(memory_mib) * MEMORY_DOUBLING_SCORE;
+    }
+
+    for (uint32_t feature : {BC_TEXTURES, PIPELINE_STATISTICS, MULTI_DRAW, BINDLESS}) {
+        rv += has(feature) ? OPTIONAL_FEATURE_SCORE : 0.0;
+    }
+    for (uint32_t feature : {ASYNC_COMPUTE, TRANSFER_QUEUE}) {
+        rv += has(feature) ? QUEUE_SCORE : 0.0;
+    }
+
+    return rv;
+}
+
+bool vgraphplay::gfx::DeviceProfile::sameDriver(const DeviceProfile &other) const {
+    return uuid == other.uuid &&
+        vendor_id == other.vendor_id &&
+        device_id == other.device_id &&
+        driver_version == other.driver_version &&
+        api_version == other.api_version;
+}
+
+vgraphplay::gfx::DeviceProfileCache::DeviceProfileCache(std::string path)
+    : m_path{std::move(path)},
+      m_profiles{},
+      m_dirty{false}
+{
+    if (!m_path.empty()) {
+        load();
+    }
+}
+
+vgraphplay::gfx::DeviceProfile vgraphplay::gfx::DeviceProfileCache::profile(const vk::raii::PhysicalDevice &device) {
+    if (m_path.empty()) {
+        return DeviceProfile::probe(device);
+    }
+
+    const DeviceProfile identity = identify(device);
+    auto it = std::ranges::find_if(m_profiles, [&identity](const DeviceProfile &p) { return p.uuid == identity.uuid; });
+    if (it != m_profiles.end() && it->sameDriver(identity)) {
+        return *it;
+    }
+
+    BOOST_LOG_TRIVIAL(trace) << "Probing " << identity.name << (it != m_profiles.end() ? "; its driver has changed" : "");
+    DeviceProfile rv = DeviceProfile::probe(device);
+    if (it != m_profiles.end()) {
+        *it = rv;
+    } else {
+        m_profiles.push_back(rv);
+    }
+    m_dirty = true;
+    return rv;
+}
+
+void vgraphplay::gfx::DeviceProfileCache::update(const DeviceProfile &profile) {
+    if (m_path.empty()) {
+        return;
+    }
+
+    auto it = std::ranges::find_if(m_profiles, [&profile](const DeviceProfile &p) { return p.uuid == profile.uuid; });
+    if (it != m_profiles.end()) {
+        *it = profile;
+    } else {
+        m_profiles.push_back(profile);
+    }
+    m_dirty = true;
+}
+
+void vgraphplay::gfx::DeviceProfileCache::load() {
+    std::ifstream in{m_path};
+    std::string line;
+    if (!in || !std::getline(in, line) || line != CACHE_HEADER) {
+        return;
+    }
+
+    while (std::getline(in, line)) {
+        std::istringstream fields{line};
+        DeviceProfile profile;
+        std::string uuid;
+        uint32_t type = 0;
+        fields >> uuid >> profile.vendor_id >> profile.device_id >> profile.driver_version >> profile.api_version >> type
+               >> profile.features >> profile.graphics_queue_family >> profile.queue_family_count >> profile.device_local_bytes
+               >> profile.fill_rate;
+        std::getline(fields >> std::ws, profile.name);
+        if (!fields || uuid.size() != profile.uuid.size() * 2 ||
+            !std::ranges::all_of(uuid, [](unsigned char c) { return std::isxdigit(c); })) {
+            BOOST_LOG_TRIVIAL(warning) << "Ignoring device profile cache " << m_path << ": it's damaged";
+            m_profiles.clear();
+            return;
+        }
+
+        for (size_t i = 0; i < profile.uuid.size(); ++i) {
+            profile.uuid[i] = static_cast<uint8_t>(std::stoul(uuid.substr(i * 2, 2), nullptr, 16));
+        }
+        profile.type = static_cast<vk::PhysicalDeviceType>(type);
+        m_profiles.push_back(std::move(profile));
+    }
+}
+
+void vgraphplay::gfx::DeviceProfileCache::save() const {
+    if (m_path.empty() || !m_dirty) {
+        return;
+    }
+
+    std::ofstream out{m_path, std::ios::trunc};
+    out << CACHE_HEADER << '\n';
+    for (const DeviceProfile &profile : m_profiles) {
+        for (uint8_t byte : profile.uuid) {
+            const char digits[] = "0123456789abcdef";
+            out << digits[byte >> 4] << digits[byte & 0xf];
+        }
+        out << ' ' << profile.vendor_id << ' ' << profile.device_id << ' ' << profile.driver_version << ' ' << profile.api_version
+            << ' ' << static_cast<uint32_t>(profile.type) << ' ' << profile.features << ' ' << profile.graphics_queue_family
+            << ' ' << profile.queue_family_count << ' ' << profile.device_local_bytes << ' ' << profile.fill_rate
+            << ' ' << profile.name << '\n';
+    }
+
+    if (!out) {
+        BOOST_LOG_TRIVIAL(warning) << "Could not write device profile cache " << m_path;
+    }
+}
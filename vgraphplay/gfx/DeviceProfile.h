@@ -0,0 +1,91 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_GFX_DEVICE_PROFILE_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_GFX_DEVICE_PROFILE_H_
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../vulkan.h"
+
+namespace vgraphplay {
+    namespace gfx {
+        // What the renderer needs to know about a physical device, queried
+        // once at startup: who it is, which of the features it cares about
+        // it has, its queues and memory, and optionally how fast it is.
+        struct DeviceProfile {
+            enum Feature : uint32_t {
+                VULKAN_13              = 1 << 0,
+                SWAPCHAIN              = 1 << 1,
+                DYNAMIC_RENDERING      = 1 << 2,
+                EXTENDED_DYNAMIC_STATE = 1 << 3,
+                BC_TEXTURES            = 1 << 4, // Cooked textures as is; decoded on the CPU without it.
+                TIMELINE_SEMAPHORES    = 1 << 5,
+                SYNCHRONIZATION_2      = 1 << 6,
+                PIPELINE_STATISTICS    = 1 << 7, // Overdraw counters.
+                MULTI_DRAW             = 1 << 8, // Indirect batches.
+                BINDLESS               = 1 << 9, // Descriptor indexing.
+                ASYNC_COMPUTE          = 1 << 10, // A compute queue family without graphics.
+                TRANSFER_QUEUE         = 1 << 11, // A transfer-only queue family.
+            };
+
+            static constexpr uint32_t REQUIRED = VULKAN_13 | SWAPCHAIN | DYNAMIC_RENDERING | EXTENDED_DYNAMIC_STATE |
+                TIMELINE_SEMAPHORES | SYNCHRONIZATION_2;
+            static constexpr uint32_t NO_QUEUE_FAMILY = UINT32_MAX;
+
+            std::string name;
+            std::array<uint8_t, vk::UuidSize> uuid{};
+            uint32_t vendor_id = 0;
+            uint32_t device_id = 0;
+            uint32_t driver_version = 0;
+            uint32_t api_version = 0;
+            vk::PhysicalDeviceType type = vk::PhysicalDeviceType::eOther;
+            uint32_t features = 0;
+            uint32_t graphics_queue_family = NO_QUEUE_FAMILY;
+            uint32_t queue_family_count = 0;
+            uint64_t device_local_bytes = 0; // The largest device-local heap.
+            float fill_rate = 0.0f;          // Gigapixels per second, from DeviceBenchmark. 0 until measured.
+
+            static DeviceProfile probe(const vk::raii::PhysicalDevice &device);
+
+            bool has(uint32_t feature) const { return (features & feature) == feature; }
+            bool suitable() const { return has(REQUIRED) && graphics_queue_family != NO_QUEUE_FAMILY; }
+            bool sameDriver(const DeviceProfile &other) const;
+
+            // How much the renderer would like to run on this device, from
+            // its properties alone: its type first, then the size of its
+            // device-local memory, its optional features and its spare
+            // queues. 0 if it isn't suitable.
+            double score() const;
+        };
+
+        // Device profiles kept between runs, in a small text file, so a
+        // warm start only asks each device for its properties. An entry
+        // is only used while its device's driver version is unchanged. With
+        // no path, every device is probed and nothing is saved.
+        class DeviceProfileCache {
+        public:
+            explicit DeviceProfileCache(std::string path);
+
+            // From the file if it's there and current, probed if not.
+            DeviceProfile profile(const vk::raii::PhysicalDevice &device);
+
+            // Replaces a profile, e.g. once its fill rate is measured.
+            void update(const DeviceProfile &profile);
+
+            // Writes the file back, if anything changed.
+            void save() const;
+
+        private:
+            void load();
+
+            std::string m_path;
+            std::vector<DeviceProfile> m_profiles;
+            bool m_dirty;
+        };
+    }
+}
+
+#endif
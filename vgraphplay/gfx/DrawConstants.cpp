@@ -0,0 +1,55 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#include <cstring>
+
+#include <boost/log/trivial.hpp>
+
+#include "DrawConstants.h"
+
+static vk::DeviceSize alignUp(vk::DeviceSize size, vk::DeviceSize alignment) {
+    return alignment == 0 ? size : (size + alignment - 1) / alignment * alignment;
+}
+
+vgraphplay::gfx::DrawConstants::DrawConstants(std::nullptr_t)
+    : m_resources{nullptr},
+      m_camera_buffer{},
+      m_camera_stride{0},
+      m_frame{0},
+      m_draw_count{0}
+{}
+
+vgraphplay::gfx::DrawConstants::DrawConstants(const vk::raii::PhysicalDevice &physical_device, Resources &resources, uint32_t frames_in_flight)
+    : DrawConstants{nullptr}
+{
+    const vk::PhysicalDeviceLimits limits = physical_device.getProperties().limits;
+
+    m_resources = &resources;
+
+    const vk::MemoryPropertyFlags host_visible = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+
+    m_camera_stride = alignUp(sizeof(CameraData), limits.minUniformBufferOffsetAlignment);
+    m_camera_buffer = resources.createBuffer(m_camera_stride * frames_in_flight, vk::BufferUsageFlagBits::eUniformBuffer, host_visible);
+
+    BOOST_LOG_TRIVIAL(trace) << "Per-draw data (" << sizeof(DrawData) << " bytes) goes through push constants"
+                             << "; maxPushConstantsSize is " << limits.maxPushConstantsSize;
+}
+
+vgraphplay::gfx::DrawConstants::~DrawConstants() {}
+
+void vgraphplay::gfx::DrawConstants::beginFrame(uint32_t frame, const CameraData &camera) {
+    m_frame = frame;
+    m_draw_count = 0;
+
+    auto *mapped = static_cast<unsigned char *>(m_resources->bufferInfo(m_camera_buffer).mapped);
+    std::memcpy(mapped + m_camera_stride * frame, &camera, sizeof(CameraData));
+}
+
+vk::DescriptorSet vgraphplay::gfx::DrawConstants::cameraSet(DescriptorSetKey key, DescriptorSetCache &cache) const {
+    key.buffer(CAMERA_BINDING, vk::DescriptorType::eUniformBuffer, m_resources->buffer(m_camera_buffer), m_camera_stride * m_frame, sizeof(CameraData));
+    return cache.get(key);
+}
+
+void vgraphplay::gfx::DrawConstants::push(const vk::raii::CommandBuffer &commands, vk::PipelineLayout layout, const DrawData &draw) {
+    commands.pushConstants<DrawData>(layout, vk::ShaderStageFlagBits::eVertex, 0, draw);
+    ++m_draw_count;
+}
@@ -0,0 +1,75 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_GFX_DRAW_CONSTANTS_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_GFX_DRAW_CONSTANTS_H_
+
+#include <cstdint>
+#include <glm/mat4x4.hpp>
+
+#include "../vulkan.h"
+
+#include "DescriptorAllocator.h"
+#include "Handle.h"
+#include "Resources.h"
+
+namespace vgraphplay {
+    namespace gfx {
+        // Per-frame data shared by every draw. Must match Camera in
+        // shaders/unlit_push.vert.
+        struct CameraData {
+            glm::mat4x4 view;
+            glm::mat4x4 projection;
+        };
+
+        // Per-draw data. Must match Draw in unlit_push.vert.
+        struct DrawData {
+            glm::mat4x4 model;
+        };
+
+        // Every device has at least 128 bytes of push constants
+        // (maxPushConstantsSize), so DrawData always fits.
+        static_assert(sizeof(DrawData) <= 128, "DrawData must fit in the guaranteed push constant space");
+
+        // Gets per-draw data to the vertex shader with a single command per
+        // draw: DrawData is pushed directly (unlit_push.vert). The camera
+        // lives in one uniform buffer per frame, bound once in set 0.
+        class DrawConstants {
+        public:
+            static constexpr uint32_t CAMERA_BINDING = 0;
+
+            DrawConstants(std::nullptr_t);
+            DrawConstants(const vk::raii::PhysicalDevice &physical_device, Resources &resources, uint32_t frames_in_flight);
+            ~DrawConstants();
+
+            DrawConstants(const DrawConstants &) = delete;
+            DrawConstants &operator=(const DrawConstants &) = delete;
+            DrawConstants(DrawConstants &&) = default;
+            DrawConstants &operator=(DrawConstants &&) = default;
+
+            // Writes the frame slot's camera. Only call once the GPU is done
+            // with the slot's previous frame.
+            void beginFrame(uint32_t frame, const CameraData &camera);
+
+            // Set 0 for this frame: the camera, combined with whatever else
+            // the caller has put in the key (e.g. the texture at binding 1).
+            vk::DescriptorSet cameraSet(DescriptorSetKey key, DescriptorSetCache &cache) const;
+
+            // Records the one command that makes the data visible to the
+            // next draw.
+            void push(const vk::raii::CommandBuffer &commands, vk::PipelineLayout layout, const DrawData &draw);
+
+            uint32_t drawsThisFrame() const { return m_draw_count; }
+
+        private:
+            Resources *m_resources;
+
+            BufferHandle m_camera_buffer;
+            vk::DeviceSize m_camera_stride;
+
+            uint32_t m_frame;
+            uint32_t m_draw_count;
+        };
+    }
+}
+
+#endif
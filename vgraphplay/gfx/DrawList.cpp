@@ -0,0 +1,216 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <glm/vec4.hpp>
+
+#include <boost/log/trivial.hpp>
+
+#include "DrawList.h"
+
+static constexpr uint64_t PIPELINE_MASK = 0xfff;
+static constexpr uint64_t SET_MASK = 0xffff;
+static constexpr uint64_t MESH_MASK = 0x3ff;
+static constexpr uint64_t RANGE_MASK = 0x3ff;
+
+// The top 16 bits of a non-negative float sort the same way the float
+// does. Anything behind the camera (or NaN) sorts first.
+static uint64_t depthBits(float depth) {
+    if (!(depth > 0.0f)) {
+        return 0;
+    }
+    return std::bit_cast<uint32_t>(depth) >> 15;
+}
+
+template <typename Map, typename Key>
+static uint64_t intern(Map &ids, const Key &key) {
+    return ids.try_emplace(key, static_cast<uint32_t>(ids.size())).first->second;
+}
+
+vgraphplay::gfx::DrawList::DrawList(std::nullptr_t)
+    : m_resources{nullptr},
+      m_max_draws{0},
+      m_multi_draw{false},
+      m_frame{0},
+      m_instance_buffer{},
+      m_indirect_buffer{},
+      m_items{},
+      m_pipelines{},
+      m_keys{},
+      m_order{},
+      m_sorter{},
+      m_set_ids{},
+      m_mesh_ids{},
+      m_range_ids{},
+      m_commands{},
+      m_batches{},
+      m_unsorted_stats{},
+      m_sorted_stats{}
+{}
+
+vgraphplay::gfx::DrawList::DrawList(Resources &resources, JobSystem &jobs, uint32_t frames_in_flight, uint32_t max_draws_per_frame, bool multi_draw_indirect)
+    : DrawList{nullptr}
+{
+    m_resources = &resources;
+    m_max_draws = max_draws_per_frame;
+    m_multi_draw = multi_draw_indirect;
+    m_sorter = RadixSorter{&jobs};
+
+    const vk::MemoryPropertyFlags host_visible = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+    m_instance_buffer = resources.createBuffer(sizeof(DrawData) * max_draws_per_frame * frames_in_flight,
+                                               vk::BufferUsageFlagBits::eVertexBuffer, host_visible);
+    m_indirect_buffer = resources.createBuffer(sizeof(vk::DrawIndexedIndirectCommand) * max_draws_per_frame * frames_in_flight,
+                                               vk::BufferUsageFlagBits::eIndirectBuffer, host_visible);
+
+    m_items.reserve(max_draws_per_frame);
+    m_pipelines.reserve(max_draws_per_frame);
+    m_keys.reserve(max_draws_per_frame);
+    m_order.reserve(max_draws_per_frame);
+
+    BOOST_LOG_TRIVIAL(trace) << "Draw list batches go out as "
+                             << (m_multi_draw ? "multi-draw indirect calls" : "one instanced draw per index range")
+                             << "; sorting with " << m_sorter.workers() << " threads";
+}
+
+vgraphplay::gfx::DrawList::~DrawList() {}
+
+bool vgraphplay::gfx::DrawList::multiDrawSupported(const vk::PhysicalDeviceFeatures &features) {
+    return features.multiDrawIndirect && features.drawIndirectFirstInstance;
+}
+
+float vgraphplay::gfx::DrawList::viewDepth(const glm::mat4x4 &view, const DrawData &draw) {
+    // The camera looks down -Z in view space.
+    return -(view * draw.model[3]).z;
+}
+
+void vgraphplay::gfx::DrawList::begin(uint32_t frame) {
+    m_frame = frame;
+    m_items.clear();
+    m_pipelines.clear();
+    m_keys.clear();
+    m_order.clear();
+    m_set_ids.clear();
+    m_mesh_ids.clear();
+    m_range_ids.clear();
+    m_commands.clear();
+    m_batches.clear();
+}
+
+void vgraphplay::gfx::DrawList::add(const DrawItem &item, uint16_t pipeline, float view_depth) {
+    if (m_items.size() >= m_max_draws) {
+        throw std::runtime_error("Draw list is full (" + std::to_string(m_max_draws) + " draws per frame)");
+    }
+
+    const uint64_t set_id = intern(m_set_ids, static_cast<VkDescriptorSet>(item.set));
+    const uint64_t mesh_id = intern(m_mesh_ids, item.mesh);
+    const uint64_t range_id = intern(m_range_ids, (static_cast<uint64_t>(item.first_index) << 32) | item.index_count);
+
+    const uint64_t key = ((pipeline & PIPELINE_MASK) << 52)
+        | ((set_id & SET_MASK) << 36)
+        | ((mesh_id & MESH_MASK) << 26)
+        | ((range_id & RANGE_MASK) << 16)
+        | depthBits(view_depth);
+
+    m_order.push_back(static_cast<uint32_t>(m_items.size()));
+    m_items.push_back(item);
+    m_pipelines.push_back(pipeline);
+    m_keys.push_back(key);
+}
+
+void vgraphplay::gfx::DrawList::build() {
+    // What the draws would cost one at a time, as submitted.
+    m_unsorted_stats = BindStats{};
+    for (size_t i = 0; i < m_items.size(); ++i) {
+        const DrawItem &item = m_items[i];
+        const bool first = i == 0;
+        m_unsorted_stats.draws += 1;
+        m_unsorted_stats.draw_calls += 1;
+        m_unsorted_stats.pipeline_binds += (first || m_pipelines[i] != m_pipelines[i - 1] || item.features != m_items[i - 1].features);
+        m_unsorted_stats.descriptor_binds += (first || item.set != m_items[i - 1].set);
+        m_unsorted_stats.vertex_binds += (first || item.mesh != m_items[i - 1].mesh);
+    }
+
+    m_sorter.sort(m_keys, m_order);
+
+    auto *instances = static_cast<unsigned char *>(m_resources->bufferInfo(m_instance_buffer).mapped)
+        + sizeof(DrawData) * m_max_draws * m_frame;
+
+    for (uint32_t i = 0; i < m_order.size(); ++i) {
+        const DrawItem &item = m_items[m_order[i]];
+        const uint16_t pipeline = m_pipelines[m_order[i]];
+        std::memcpy(instances + sizeof(DrawData) * i, &item.draw, sizeof(DrawData));
+
+        if (m_batches.empty()
+            || m_batches.back().pipeline != pipeline
+            || m_batches.back().features != item.features
+            || m_batches.back().set != item.set
+            || m_batches.back().mesh != item.mesh) {
+            m_batches.push_back(DrawBatch{
+                .pipeline = pipeline,
+                .features = item.features,
+                .set = item.set,
+                .mesh = item.mesh,
+                .first_command = static_cast<uint32_t>(m_commands.size()),
+                .command_count = 0,
+            });
+        }
+
+        DrawBatch &batch = m_batches.back();
+        if (batch.command_count > 0
+            && m_commands.back().indexCount == item.index_count
+            && m_commands.back().firstIndex == item.first_index
+            && m_commands.back().vertexOffset == item.vertex_offset) {
+            // Same index range as the previous draw: another instance.
+            m_commands.back().instanceCount += 1;
+        } else {
+            m_commands.push_back(vk::DrawIndexedIndirectCommand{
+                .indexCount = item.index_count,
+                .instanceCount = 1,
+                .firstIndex = item.first_index,
+                .vertexOffset = item.vertex_offset,
+                .firstInstance = i,
+            });
+            batch.command_count += 1;
+        }
+    }
+
+    if (m_multi_draw && !m_commands.empty()) {
+        auto *indirect = static_cast<unsigned char *>(m_resources->bufferInfo(m_indirect_buffer).mapped)
+            + sizeof(vk::DrawIndexedIndirectCommand) * m_max_draws * m_frame;
+        std::memcpy(indirect, m_commands.data(), sizeof(vk::DrawIndexedIndirectCommand) * m_commands.size());
+    }
+
+    // And what the batches cost, including binding the instance stream.
+    m_sorted_stats = BindStats{};
+    m_sorted_stats.draws = static_cast<uint32_t>(m_items.size());
+    m_sorted_stats.vertex_binds = m_batches.empty() ? 0 : 1;
+    for (size_t i = 0; i < m_batches.size(); ++i) {
+        const DrawBatch &batch = m_batches[i];
+        const bool first = i == 0;
+        m_sorted_stats.draw_calls += (m_multi_draw ? 1 : batch.command_count);
+        m_sorted_stats.pipeline_binds += (first || batch.pipeline != m_batches[i - 1].pipeline || batch.features != m_batches[i - 1].features);
+        m_sorted_stats.descriptor_binds += (first || batch.set != m_batches[i - 1].set);
+        m_sorted_stats.vertex_binds += (first || batch.mesh != m_batches[i - 1].mesh);
+    }
+}
+
+void vgraphplay::gfx::DrawList::bindInstances(const vk::raii::CommandBuffer &commands) const {
+    const vk::DeviceSize offset = sizeof(DrawData) * m_max_draws * m_frame;
+    commands.bindVertexBuffers(INSTANCE_BINDING, m_resources->buffer(m_instance_buffer), offset);
+}
+
+void vgraphplay::gfx::DrawList::draw(const vk::raii::CommandBuffer &commands, const DrawBatch &batch) const {
+    if (m_multi_draw && batch.command_count > 1) {
+        constexpr vk::DeviceSize stride = sizeof(vk::DrawIndexedIndirectCommand);
+        const vk::DeviceSize offset = stride * (m_max_draws * m_frame + batch.first_command);
+        commands.drawIndexedIndirect(m_resources->buffer(m_indirect_buffer), offset, batch.command_count, stride);
+        return;
+    }
+
+    for (uint32_t i = batch.first_command; i < batch.first_command + batch.command_count; ++i) {
+        const vk::DrawIndexedIndirectCommand &c = m_commands[i];
+        commands.drawIndexed(c.indexCount, c.instanceCount, c.firstIndex, c.vertexOffset, c.firstInstance);
+    }
+}
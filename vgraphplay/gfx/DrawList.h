@@ -0,0 +1,157 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_GFX_DRAW_LIST_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_GFX_DRAW_LIST_H_
+
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+
+#include "../vulkan.h"
+
+#include "DrawConstants.h"
+#include "Handle.h"
+#include "RadixSort.h"
+#include "Resources.h"
+
+namespace vgraphplay {
+    namespace gfx {
+        // A mesh's buffers. positions holds just the vertex positions,
+        // tightly packed, so depth-only passes fetch 12 bytes per vertex
+        // instead of the whole vertex.
+        struct MeshBuffers {
+            vk::Buffer vertices;
+            vk::Buffer positions;
+            vk::Buffer indices;
+            vk::IndexType index_type;
+        };
+
+        // Builds the position-only stream for a vertex type with a pos
+        // member.
+        template <typename V>
+        std::vector<glm::vec3> positionStream(std::span<const V> vertices) {
+            std::vector<glm::vec3> positions;
+            positions.reserve(vertices.size());
+            for (const V &v : vertices) {
+                positions.push_back(v.pos);
+            }
+            return positions;
+        }
+
+        struct DrawItem {
+            const MeshBuffers *mesh;
+            uint32_t index_count;
+            uint32_t first_index;
+            int32_t vertex_offset;
+            uint8_t features; // PipelineState feature bits.
+            vk::DescriptorSet set; // Set 0: camera (DrawConstants::cameraSet), texture, etc.
+            DrawData draw;
+        };
+
+        // Draws that share a pipeline, descriptor set and mesh buffers,
+        // issued as one multi-draw (or a few instanced draws).
+        struct DrawBatch {
+            uint16_t pipeline;
+            uint8_t features;
+            vk::DescriptorSet set;
+            const MeshBuffers *mesh;
+            uint32_t first_command;
+            uint32_t command_count;
+        };
+
+        struct BindStats {
+            uint32_t draws;
+            uint32_t draw_calls;
+            uint32_t pipeline_binds;
+            uint32_t descriptor_binds;
+            uint32_t vertex_binds;
+        };
+
+        // One frame's draws for a pass. Each draw gets a 64-bit sort key:
+        //
+        //   63..52  pipeline (caller-chosen ID)
+        //   51..36  descriptor set
+        //   35..26  mesh buffers
+        //   25..16  index range within the mesh
+        //   15..0   view depth, nearest first
+        //
+        // build() radix sorts the keys, so draws end up grouped by state
+        // and front to back within a group. It then merges draws of the
+        // same index range into instanced draws and runs of those into
+        // batches. Per-draw data goes into a per-instance vertex stream
+        // (binding 1, see shaders/unlit_instanced.vert), and each batch's
+        // draws into an indirect buffer for vkCmdDrawIndexedIndirect.
+        //
+        // Fields take set, mesh and range IDs in first-use order and wrap
+        // when there are too many. Merging compares the real values, so
+        // wrapping only costs batching, never correctness.
+        class DrawList {
+        public:
+            static constexpr uint32_t INSTANCE_BINDING = 1;
+
+            DrawList(std::nullptr_t);
+            DrawList(Resources &resources, JobSystem &jobs, uint32_t frames_in_flight, uint32_t max_draws_per_frame, bool multi_draw_indirect);
+            ~DrawList();
+
+            DrawList(const DrawList &) = delete;
+            DrawList &operator=(const DrawList &) = delete;
+            DrawList(DrawList &&) = default;
+            DrawList &operator=(DrawList &&) = default;
+
+            // Device features multi_draw_indirect needs.
+            static bool multiDrawSupported(const vk::PhysicalDeviceFeatures &features);
+
+            // The distance in front of the camera of the draw's origin.
+            static float viewDepth(const glm::mat4x4 &view, const DrawData &draw);
+
+            void begin(uint32_t frame);
+            void add(const DrawItem &item, uint16_t pipeline, float view_depth);
+            void build();
+
+            const std::vector<DrawBatch> &batches() const { return m_batches; }
+            size_t size() const { return m_items.size(); }
+
+            // Binds the frame's instance stream. Once per pass.
+            void bindInstances(const vk::raii::CommandBuffer &commands) const;
+
+            // Issues the batch's draws; pipeline, set and mesh buffers must
+            // already be bound.
+            void draw(const vk::raii::CommandBuffer &commands, const DrawBatch &batch) const;
+
+            // What the draws would have cost one by one in submission
+            // order, and what the batches cost. Updated by build().
+            const BindStats &unsortedStats() const { return m_unsorted_stats; }
+            const BindStats &sortedStats() const { return m_sorted_stats; }
+
+        private:
+            Resources *m_resources;
+            uint32_t m_max_draws;
+            bool m_multi_draw;
+            uint32_t m_frame;
+
+            BufferHandle m_instance_buffer;
+            BufferHandle m_indirect_buffer;
+
+            std::vector<DrawItem> m_items;
+            std::vector<uint16_t> m_pipelines;
+            std::vector<uint64_t> m_keys;
+            std::vector<uint32_t> m_order;
+            RadixSorter m_sorter;
+
+            std::unordered_map<VkDescriptorSet, uint32_t> m_set_ids;
+            std::unordered_map<const MeshBuffers *, uint32_t> m_mesh_ids;
+            std::unordered_map<uint64_t, uint32_t> m_range_ids;
+
+            std::vector<vk::DrawIndexedIndirectCommand> m_commands;
+            std::vector<DrawBatch> m_batches;
+
+            BindStats m_unsorted_stats;
+            BindStats m_sorted_stats;
+        };
+    }
+}
+
+#endif
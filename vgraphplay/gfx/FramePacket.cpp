@@ -0,0 +1,20 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#include <algorithm>
+
+#include "FramePacket.h"
+
+void vgraphplay::gfx::FramePacket::interpolate(std::chrono::steady_clock::time_point now, std::vector<DrawData> &objects) const {
+    float t = 1.0f;
+    if (step_seconds > 0.0f) {
+        const float since = std::chrono::duration<float>(now - advanced).count();
+        t = std::clamp(alpha + since / step_seconds, 0.0f, 1.0f);
+    }
+
+    objects.resize(current.size());
+    for (size_t i = 0; i < current.size(); ++i) {
+        // Objects added this step have nothing to come from.
+        const Transform &from = i < previous.size() ? previous[i] : current[i];
+        objects[i].model = Transform::interpolate(from, current[i], t).matrix();
+    }
+}
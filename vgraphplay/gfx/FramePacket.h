@@ -0,0 +1,63 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_GFX_FRAME_PACKET_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_GFX_FRAME_PACKET_H_
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "../Transform.h"
+#include "DepthPrepass.h"
+#include "DrawConstants.h"
+#include "DrawList.h"
+#include "HostAllocator.h"
+
+namespace vgraphplay {
+    namespace gfx {
+        enum class RenderMode : uint8_t {
+            Continuous, // Draw as fast as allowed, new packet or not.
+            OnDemand,   // Draw once per packet, and idle in between.
+        };
+
+        // Everything the render thread needs from the simulation for one
+        // frame, copied so the two never share live state. The draw list
+        // itself is built on the render thread from these transforms,
+        // because its descriptor sets and instance data belong to the
+        // frame slot being recorded.
+        //
+        // Objects come as of the last two simulation steps. The render
+        // thread interpolates between them for the moment it draws, so
+        // motion stays smooth whatever the two threads' rates are.
+        struct FramePacket {
+            uint64_t sequence = 0; // 0 until the simulation publishes one.
+            CameraData camera{glm::mat4x4{1.0f}, glm::mat4x4{1.0f}};
+            std::vector<Transform> previous;
+            std::vector<Transform> current;
+            // When the simulation clock last advanced, how far between the
+            // two steps that was, and the step length.
+            std::chrono::steady_clock::time_point advanced{};
+            float alpha = 1.0f;
+            float step_seconds = 0.0f;
+            bool depth_prepass = true;
+            RenderMode render_mode = RenderMode::Continuous;
+            double max_frame_rate = 0.0; // 0 means unlimited.
+
+            // The objects' model matrices as of now.
+            void interpolate(std::chrono::steady_clock::time_point now, std::vector<DrawData> &objects) const;
+        };
+
+        // Going the other way: what the render thread measured, for the
+        // simulation thread to report.
+        struct RenderStats {
+            uint64_t frames = 0;
+            uint64_t last_sequence = 0; // Of the packet last drawn.
+            OverdrawStats overdraw{0, 0};
+            BindStats unsorted_binds{};
+            BindStats sorted_binds{};
+            HostAllocationStats host_allocations{};
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,45 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_GFX_HANDLE_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_GFX_HANDLE_H_
+
+#include <cstdint>
+#include <functional>
+
+namespace vgraphplay {
+    namespace gfx {
+        // A typed reference to a slot in a ResourcePool. The generation is
+        // bumped every time a slot is freed, so a handle to a destroyed
+        // resource no longer matches its slot and is detected as stale.
+        // Generation 0 is never issued; a default-constructed handle is null.
+        template <typename Tag>
+        struct Handle {
+            uint32_t index = 0;
+            uint32_t generation = 0;
+
+            bool isNull() const { return generation == 0; }
+            explicit operator bool() const { return generation != 0; }
+
+            friend bool operator==(const Handle &, const Handle &) = default;
+        };
+
+        struct BufferTag;
+        struct ImageTag;
+        struct SamplerTag;
+        struct PipelineTag;
+
+        using BufferHandle = Handle<BufferTag>;
+        using ImageHandle = Handle<ImageTag>;
+        using SamplerHandle = Handle<SamplerTag>;
+        using PipelineHandle = Handle<PipelineTag>;
+    }
+}
+
+template <typename Tag>
+struct std::hash<vgraphplay::gfx::Handle<Tag>> {
+    size_t operator()(const vgraphplay::gfx::Handle<Tag> &handle) const {
+        return std::hash<uint64_t>{}((static_cast<uint64_t>(handle.generation) << 32) | handle.index);
+    }
+};
+
+#endif
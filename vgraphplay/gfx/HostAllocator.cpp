@@ -0,0 +1,222 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+
+#include <boost/log/trivial.hpp>
+
+#include "HostAllocator.h"
+
+static vgraphplay::gfx::HostAllocator *s_current = nullptr;
+
+// One thread's command-scope allocations. They're all freed before the
+// Vulkan call that made them returns, on the same thread, so nothing here
+// needs to be shared.
+struct CommandArena {
+    struct Delete {
+        void operator()(std::byte *data) const { ::operator delete(data, std::align_val_t{ALIGNMENT}); }
+    };
+
+    static constexpr size_t ALIGNMENT = 64;
+
+    std::unique_ptr<std::byte, Delete> data{static_cast<std::byte *>(
+        ::operator new(vgraphplay::gfx::HostAllocator::ARENA_SIZE, std::align_val_t{ALIGNMENT}))};
+    size_t offset = 0;
+    size_t live = 0;
+};
+
+// What sits just in front of each block handed to the driver.
+struct alignas(alignof(std::max_align_t)) BlockHeader {
+    size_t size;
+    size_t offset;       // From the start of what was allocated to the block.
+    size_t alignment;    // What it was allocated with.
+    CommandArena *arena; // Or nullptr, if it came from the heap.
+    uint32_t scope;
+};
+
+static size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static BlockHeader *headerOf(void *memory) {
+    return static_cast<BlockHeader *>(memory) - 1;
+}
+
+vgraphplay::gfx::HostAllocator::HostAllocator(bool enabled, bool command_arena)
+    : m_callbacks{
+          .pUserData = this,
+          .pfnAllocation = &HostAllocator::allocate,
+          .pfnReallocation = &HostAllocator::reallocate,
+          .pfnFree = &HostAllocator::free,
+          .pfnInternalAllocation = &HostAllocator::internalAllocated,
+          .pfnInternalFree = &HostAllocator::internalFreed,
+      },
+      m_enabled{enabled},
+      m_command_arena{enabled && command_arena},
+      m_scopes{},
+      m_arena_allocations{0},
+      m_frames{0},
+      m_seen_allocations{0},
+      m_frame_allocations{0},
+      m_allocating_frames{0}
+{
+    if (!m_enabled) {
+        return;
+    }
+    if (s_current != nullptr) {
+        throw std::runtime_error("Only one host allocator can be enabled at a time");
+    }
+    s_current = this;
+    BOOST_LOG_TRIVIAL(info) << "Tracking Vulkan host allocations"
+                            << (m_command_arena ? ", with command-scope allocations from an arena" : "");
+}
+
+vgraphplay::gfx::HostAllocator::~HostAllocator() {
+    if (s_current == this) {
+        s_current = nullptr;
+    }
+}
+
+const vk::AllocationCallbacks *vgraphplay::gfx::HostAllocator::callbacks() {
+    return s_current != nullptr ? &s_current->m_callbacks : nullptr;
+}
+
+void *VKAPI_CALL vgraphplay::gfx::HostAllocator::allocate(void *user_data, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+    return static_cast<HostAllocator *>(user_data)->allocate(size, alignment, scope);
+}
+
+void *VKAPI_CALL vgraphplay::gfx::HostAllocator::reallocate(void *user_data, void *original, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+    HostAllocator *self = static_cast<HostAllocator *>(user_data);
+    if (original == nullptr) {
+        return self->allocate(size, alignment, scope);
+    }
+    if (size == 0) {
+        self->release(original);
+        return nullptr;
+    }
+
+    // On failure the original has to be left as it was.
+    void *memory = self->allocate(size, alignment, scope);
+    if (memory != nullptr) {
+        std::memcpy(memory, original, std::min(size, headerOf(original)->size));
+        self->release(original);
+    }
+    return memory;
+}
+
+void VKAPI_CALL vgraphplay::gfx::HostAllocator::free(void *user_data, void *memory) {
+    if (memory != nullptr) {
+        static_cast<HostAllocator *>(user_data)->release(memory);
+    }
+}
+
+void VKAPI_CALL vgraphplay::gfx::HostAllocator::internalAllocated(void *user_data, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope) {
+    static_cast<HostAllocator *>(user_data)->m_scopes[scope].internal_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+void VKAPI_CALL vgraphplay::gfx::HostAllocator::internalFreed(void *user_data, size_t size, VkInternalAllocationType, VkSystemAllocationScope scope) {
+    static_cast<HostAllocator *>(user_data)->m_scopes[scope].internal_bytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+void *vgraphplay::gfx::HostAllocator::allocate(size_t size, size_t alignment, VkSystemAllocationScope scope) {
+    if (size == 0) {
+        return nullptr;
+    }
+
+    // Whatever the driver asks for, the header in front of the block needs
+    // its own alignment too.
+    alignment = std::max(alignment, alignof(BlockHeader));
+    const size_t offset = alignUp(sizeof(BlockHeader), alignment);
+    std::byte *memory = nullptr;
+    CommandArena *arena = nullptr;
+
+    if (m_command_arena && scope == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND && alignment <= CommandArena::ALIGNMENT) {
+        thread_local CommandArena t_arena{};
+        const size_t start = alignUp(t_arena.offset + sizeof(BlockHeader), alignment);
+        if (start + size <= ARENA_SIZE) {
+            memory = t_arena.data.get() + start;
+            t_arena.offset = start + size;
+            ++t_arena.live;
+            arena = &t_arena;
+            m_arena_allocations.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    if (memory == nullptr) {
+        std::byte *base = static_cast<std::byte *>(::operator new(offset + size, std::align_val_t{alignment}, std::nothrow));
+        if (base == nullptr) {
+            return nullptr;
+        }
+        memory = base + offset;
+    }
+
+    ::new (headerOf(memory)) BlockHeader{size, offset, alignment, arena, static_cast<uint32_t>(scope)};
+
+    ScopeCounters &counters = m_scopes[scope];
+    counters.allocations.fetch_add(1, std::memory_order_relaxed);
+    const uint64_t live = counters.live_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+    uint64_t peak = counters.peak_bytes.load(std::memory_order_relaxed);
+    while (live > peak && !counters.peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+
+    return memory;
+}
+
+void vgraphplay::gfx::HostAllocator::release(void *memory) {
+    const BlockHeader header = *headerOf(memory);
+
+    ScopeCounters &counters = m_scopes[header.scope];
+    counters.frees.fetch_add(1, std::memory_order_relaxed);
+    counters.live_bytes.fetch_sub(header.size, std::memory_order_relaxed);
+
+    if (header.arena != nullptr) {
+        if (--header.arena->live == 0) {
+            header.arena->offset = 0;
+        }
+    } else {
+        ::operator delete(static_cast<std::byte *>(memory) - header.offset, std::align_val_t{header.alignment});
+    }
+}
+
+uint64_t vgraphplay::gfx::HostAllocator::totalAllocations() const {
+    uint64_t rv = 0;
+    for (const ScopeCounters &counters : m_scopes) {
+        rv += counters.allocations.load(std::memory_order_relaxed);
+    }
+    return rv;
+}
+
+void vgraphplay::gfx::HostAllocator::nextFrame() {
+    if (!m_enabled) {
+        return;
+    }
+
+    const uint64_t allocations = totalAllocations();
+    m_frame_allocations = allocations - m_seen_allocations;
+    m_seen_allocations = allocations;
+    if (++m_frames > WARMUP_FRAMES && m_frame_allocations > 0) {
+        ++m_allocating_frames;
+    }
+}
+
+vgraphplay::gfx::HostAllocationStats vgraphplay::gfx::HostAllocator::stats() const {
+    HostAllocationStats rv{
+        .enabled = m_enabled,
+        .frame_allocations = m_frame_allocations,
+        .allocating_frames = m_allocating_frames,
+        .arena_allocations = m_arena_allocations.load(std::memory_order_relaxed),
+    };
+    for (size_t i = 0; i < HostAllocationStats::SCOPE_COUNT; ++i) {
+        const ScopeCounters &counters = m_scopes[i];
+        rv.scopes[i] = HostScopeStats{
+            .allocations = counters.allocations.load(std::memory_order_relaxed),
+            .frees = counters.frees.load(std::memory_order_relaxed),
+            .live_bytes = counters.live_bytes.load(std::memory_order_relaxed),
+            .peak_bytes = counters.peak_bytes.load(std::memory_order_relaxed),
+            .internal_bytes = counters.internal_bytes.load(std::memory_order_relaxed),
+        };
+    }
+    return rv;
+}
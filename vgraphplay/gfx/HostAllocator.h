@@ -0,0 +1,101 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_GFX_HOST_ALLOCATOR_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_GFX_HOST_ALLOCATOR_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "../vulkan.h"
+
+namespace vgraphplay {
+    namespace gfx {
+        // One VkSystemAllocationScope's host memory, as the driver asked
+        // for it. Reallocations count as allocations too.
+        struct HostScopeStats {
+            uint64_t allocations = 0;
+            uint64_t frees = 0;
+            uint64_t live_bytes = 0;
+            uint64_t peak_bytes = 0;
+            uint64_t internal_bytes = 0; // Allocated by the driver itself, and only reported to us.
+        };
+
+        struct HostAllocationStats {
+            static constexpr size_t SCOPE_COUNT = 5; // Command through instance.
+
+            bool enabled = false;
+            std::array<HostScopeStats, SCOPE_COUNT> scopes{};
+            uint64_t frame_allocations = 0; // During the last frame.
+            uint64_t allocating_frames = 0; // Frames since warming up that allocated at all.
+            uint64_t arena_allocations = 0; // Command-scope allocations served by the arena.
+        };
+
+        // Host memory for the Vulkan driver, through VkAllocationCallbacks,
+        // so its allocations can be counted by scope and per frame. Every
+        // Vulkan object is created with callbacks(), which is nullptr (the
+        // driver's own allocator) unless a HostAllocator is enabled; there
+        // can only be one enabled at a time, and it has to outlive every
+        // object created while it was.
+        //
+        // With the command arena on, command-scope allocations, which only
+        // last as long as the Vulkan call that made them, are bumped out of
+        // a per-thread buffer of ARENA_SIZE bytes that's rewound whenever
+        // it empties. Ones that don't fit fall back to the heap.
+        //
+        // Once WARMUP_FRAMES have gone by, a frame that allocates anything
+        // should be the exception; those frames are counted.
+        class HostAllocator {
+        public:
+            static constexpr size_t ARENA_SIZE = 256 * 1024;
+            static constexpr uint64_t WARMUP_FRAMES = 120;
+
+            HostAllocator(bool enabled, bool command_arena);
+            ~HostAllocator();
+
+            HostAllocator(const HostAllocator &) = delete;
+            HostAllocator &operator=(const HostAllocator &) = delete;
+
+            // What to create Vulkan objects with.
+            static const vk::AllocationCallbacks *callbacks();
+
+            // Closes the current frame's count. Render thread only.
+            void nextFrame();
+            HostAllocationStats stats() const;
+
+        private:
+            struct ScopeCounters {
+                std::atomic<uint64_t> allocations{0};
+                std::atomic<uint64_t> frees{0};
+                std::atomic<uint64_t> live_bytes{0};
+                std::atomic<uint64_t> peak_bytes{0};
+                std::atomic<uint64_t> internal_bytes{0};
+            };
+
+            static void *VKAPI_CALL allocate(void *user_data, size_t size, size_t alignment, VkSystemAllocationScope scope);
+            static void *VKAPI_CALL reallocate(void *user_data, void *original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+            static void VKAPI_CALL free(void *user_data, void *memory);
+            static void VKAPI_CALL internalAllocated(void *user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+            static void VKAPI_CALL internalFreed(void *user_data, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+
+            void *allocate(size_t size, size_t alignment, VkSystemAllocationScope scope);
+            void release(void *memory);
+            uint64_t totalAllocations() const;
+
+            vk::AllocationCallbacks m_callbacks;
+            bool m_enabled;
+            bool m_command_arena;
+            std::array<ScopeCounters, HostAllocationStats::SCOPE_COUNT> m_scopes;
+            std::atomic<uint64_t> m_arena_allocations;
+
+            // Render thread only.
+            uint64_t m_frames;
+            uint64_t m_seen_allocations;
+            uint64_t m_frame_allocations;
+            uint64_t m_allocating_frames;
+        };
+    }
+}
+
+#endif
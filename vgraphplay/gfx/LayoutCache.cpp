@@ -0,0 +1,129 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/log/trivial.hpp>
+
+#include "LayoutCache.h"
+#include "HostAllocator.h"
+
+// Cache keys are the layout's contents packed into a byte string, which
+// gives exact comparisons and std::hash for free.
+template <typename T>
+static void appendKey(std::string &key, const T &value) {
+    key.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+vgraphplay::gfx::LayoutCache::LayoutCache(std::nullptr_t)
+    : m_device{nullptr},
+      m_set_layouts{},
+      m_pipeline_layouts{}
+{}
+
+vgraphplay::gfx::LayoutCache::LayoutCache(const vk::raii::Device &device)
+    : m_device{&device},
+      m_set_layouts{},
+      m_pipeline_layouts{}
+{}
+
+vk::DescriptorSetLayout vgraphplay::gfx::LayoutCache::descriptorSetLayout(std::span<const vk::DescriptorSetLayoutBinding> bindings, vk::DescriptorSetLayoutCreateFlags flags) {
+    std::string key;
+    appendKey(key, static_cast<uint32_t>(flags));
+    for (const auto &b : bindings) {
+        if (b.pImmutableSamplers != nullptr) {
+            throw std::runtime_error("LayoutCache does not support immutable samplers");
+        }
+        appendKey(key, b.binding);
+        appendKey(key, b.descriptorType);
+        appendKey(key, b.descriptorCount);
+        appendKey(key, static_cast<uint32_t>(b.stageFlags));
+    }
+
+    auto it = m_set_layouts.find(key);
+    if (it == m_set_layouts.end()) {
+        vk::DescriptorSetLayoutCreateInfo layout_ci{
+            .flags = flags,
+            .bindingCount = static_cast<uint32_t>(bindings.size()),
+            .pBindings = bindings.data(),
+        };
+        it = m_set_layouts.emplace(key, vk::raii::DescriptorSetLayout{*m_device, layout_ci, HostAllocator::callbacks()}).first;
+        BOOST_LOG_TRIVIAL(trace) << "Created descriptor set layout " << *it->second << " with " << bindings.size() << " bindings";
+    }
+
+    return *it->second;
+}
+
+vk::PipelineLayout vgraphplay::gfx::LayoutCache::pipelineLayout(std::span<const vk::DescriptorSetLayout> set_layouts, std::span<const vk::PushConstantRange> push_constants) {
+    std::string key;
+    appendKey(key, static_cast<uint32_t>(set_layouts.size()));
+    for (const auto &layout : set_layouts) {
+        appendKey(key, static_cast<VkDescriptorSetLayout>(layout));
+    }
+    for (const auto &range : push_constants) {
+        appendKey(key, static_cast<uint32_t>(range.stageFlags));
+        appendKey(key, range.offset);
+        appendKey(key, range.size);
+    }
+
+    auto it = m_pipeline_layouts.find(key);
+    if (it == m_pipeline_layouts.end()) {
+        vk::PipelineLayoutCreateInfo layout_ci{
+            .setLayoutCount = static_cast<uint32_t>(set_layouts.size()),
+            .pSetLayouts = set_layouts.data(),
+            .pushConstantRangeCount = static_cast<uint32_t>(push_constants.size()),
+            .pPushConstantRanges = push_constants.data(),
+        };
+        it = m_pipeline_layouts.emplace(key, vk::raii::PipelineLayout{*m_device, layout_ci, HostAllocator::callbacks()}).first;
+        BOOST_LOG_TRIVIAL(trace) << "Created pipeline layout " << *it->second << " with " << set_layouts.size() << " sets";
+    }
+
+    return *it->second;
+}
+
+vk::PipelineLayout vgraphplay::gfx::LayoutCache::pipelineLayout(const PipelineInterface &iface, const std::map<uint32_t, vk::DescriptorSetLayout> &fixed_sets) {
+    return pipelineLayout(setLayouts(iface, fixed_sets), iface.push_constants);
+}
+
+std::vector<vk::DescriptorSetLayout> vgraphplay::gfx::LayoutCache::setLayouts(const PipelineInterface &iface, const std::map<uint32_t, vk::DescriptorSetLayout> &fixed_sets) {
+    uint32_t num_sets = 0;
+    if (!iface.sets.empty()) {
+        num_sets = iface.sets.rbegin()->first + 1;
+    }
+    if (!fixed_sets.empty()) {
+        num_sets = std::max(num_sets, fixed_sets.rbegin()->first + 1);
+    }
+
+    // Set numbers must be contiguous, so gaps get an empty layout.
+    std::vector<vk::DescriptorSetLayout> set_layouts;
+    for (uint32_t set = 0; set < num_sets; ++set) {
+        auto fixed = fixed_sets.find(set);
+        if (fixed != fixed_sets.end()) {
+            set_layouts.push_back(fixed->second);
+            continue;
+        }
+
+        std::vector<vk::DescriptorSetLayoutBinding> bindings;
+        auto reflected = iface.sets.find(set);
+        if (reflected != iface.sets.end()) {
+            for (const ReflectedBinding &b : reflected->second) {
+                if (b.count == 0) {
+                    throw std::runtime_error("Set " + std::to_string(set) + " has a runtime-sized array (" + b.name +
+                                             "); its layout must be supplied");
+                }
+                bindings.push_back(vk::DescriptorSetLayoutBinding{
+                    .binding = b.binding,
+                    .descriptorType = b.type,
+                    .descriptorCount = b.count,
+                    .stageFlags = b.stages,
+                });
+            }
+        }
+
+        set_layouts.push_back(descriptorSetLayout(bindings));
+    }
+
+    return set_layouts;
+}
@@ -0,0 +1,54 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_GFX_LAYOUT_CACHE_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_GFX_LAYOUT_CACHE_H_
+
+#include <map>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../vulkan.h"
+
+#include "ShaderReflection.h"
+
+namespace vgraphplay {
+    namespace gfx {
+        // Creates descriptor set and pipeline layouts on demand, keyed by
+        // their contents, so that pipelines whose shaders declare the same
+        // interface share the same Vulkan objects. Layouts live as long as
+        // the cache.
+        class LayoutCache {
+        public:
+            LayoutCache(std::nullptr_t);
+            explicit LayoutCache(const vk::raii::Device &device);
+
+            LayoutCache(const LayoutCache &) = delete;
+            LayoutCache &operator=(const LayoutCache &) = delete;
+            LayoutCache(LayoutCache &&) = default;
+            LayoutCache &operator=(LayoutCache &&) = default;
+
+            vk::DescriptorSetLayout descriptorSetLayout(std::span<const vk::DescriptorSetLayoutBinding> bindings, vk::DescriptorSetLayoutCreateFlags flags = {});
+            vk::PipelineLayout pipelineLayout(std::span<const vk::DescriptorSetLayout> set_layouts, std::span<const vk::PushConstantRange> push_constants);
+
+            // The layout for a reflected pipeline interface. Sets listed in
+            // fixed_sets use the given layout instead of one built from the
+            // reflected bindings, which is how sets that need binding flags
+            // (e.g. the bindless set) are plugged in.
+            vk::PipelineLayout pipelineLayout(const PipelineInterface &iface, const std::map<uint32_t, vk::DescriptorSetLayout> &fixed_sets = {});
+
+            // Just the set layouts of that pipeline layout, in set order.
+            std::vector<vk::DescriptorSetLayout> setLayouts(const PipelineInterface &iface, const std::map<uint32_t, vk::DescriptorSetLayout> &fixed_sets = {});
+
+            size_t size() const { return m_set_layouts.size() + m_pipeline_layouts.size(); }
+
+        private:
+            const vk::raii::Device *m_device;
+            std::unordered_map<std::string, vk::raii::DescriptorSetLayout> m_set_layouts;
+            std::unordered_map<std::string, vk::raii::PipelineLayout> m_pipeline_layouts;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,306 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#include <algorithm>
+#include <array>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include <boost/log/trivial.hpp>
+
+#include "PipelineCache.h"
+#include "HostAllocator.h"
+#include "../Log.h"
+
+uint32_t vgraphplay::gfx::PipelineState::pack() const {
+    return static_cast<uint32_t>(features) |
+        (static_cast<uint32_t>(topology) << 8) |
+        (static_cast<uint32_t>(cull_mode) << 12) |
+        (static_cast<uint32_t>(front_face) << 14) |
+        (static_cast<uint32_t>(depth_test) << 15) |
+        (static_cast<uint32_t>(depth_write) << 16) |
+        (static_cast<uint32_t>(depth_compare) << 17) |
+        (static_cast<uint32_t>(blend) << 20) |
+        (static_cast<uint32_t>(color_write) << 22);
+}
+
+static vk::PipelineColorBlendAttachmentState blendAttachment(vgraphplay::gfx::BlendMode blend, bool color_write) {
+    using vgraphplay::gfx::BlendMode;
+
+    vk::PipelineColorBlendAttachmentState attachment{
+        .blendEnable = blend != BlendMode::Opaque,
+        .colorBlendOp = vk::BlendOp::eAdd,
+        .alphaBlendOp = vk::BlendOp::eAdd,
+    };
+
+    if (color_write) {
+        attachment.colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+            vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA;
+    }
+
+    switch (blend) {
+    case BlendMode::Opaque:
+        break;
+    case BlendMode::AlphaBlend:
+        attachment.srcColorBlendFactor = vk::BlendFactor::eSrcAlpha;
+        attachment.dstColorBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha;
+        attachment.srcAlphaBlendFactor = vk::BlendFactor::eOne;
+        attachment.dstAlphaBlendFactor = vk::BlendFactor::eOneMinusSrcAlpha;
+        break;
+    case BlendMode::Additive:
+        attachment.srcColorBlendFactor = vk::BlendFactor::eSrcAlpha;
+        attachment.dstColorBlendFactor = vk::BlendFactor::eOne;
+        attachment.srcAlphaBlendFactor = vk::BlendFactor::eZero;
+        attachment.dstAlphaBlendFactor = vk::BlendFactor::eOne;
+        break;
+    }
+
+    return attachment;
+}
+
+vgraphplay::gfx::PipelineCache::PipelineCache(std::nullptr_t)
+    : m_device{nullptr},
+      m_resources{nullptr},
+      m_layouts{nullptr},
+      m_programs{},
+      m_targets{},
+      m_pipelines{}
+{}
+
+vgraphplay::gfx::PipelineCache::PipelineCache(const vk::raii::Device &device, Resources &resources, LayoutCache &layouts)
+    : m_device{&device},
+      m_resources{&resources},
+      m_layouts{&layouts},
+      m_programs{},
+      m_targets{},
+      m_pipelines{}
+{}
+
+vgraphplay::gfx::PipelineCache::~PipelineCache() {
+    clear();
+}
+
+vgraphplay::gfx::ProgramId vgraphplay::gfx::PipelineCache::addProgram(std::span<const Resource> stages, const std::map<uint32_t, vk::DescriptorSetLayout> &fixed_sets) {
+    return insertProgram(stages, nullptr, fixed_sets);
+}
+
+vgraphplay::gfx::ProgramId vgraphplay::gfx::PipelineCache::addProgram(std::span<const Resource> stages, vk::PipelineLayout layout) {
+    return insertProgram(stages, layout, {});
+}
+
+// Builds the layout from the reflected interface unless one is given.
+vgraphplay::gfx::ProgramId vgraphplay::gfx::PipelineCache::insertProgram(std::span<const Resource> stages, vk::PipelineLayout layout, const std::map<uint32_t, vk::DescriptorSetLayout> &fixed_sets) {
+    if (m_programs.size() > std::numeric_limits<ProgramId>::max()) {
+        throw std::runtime_error("Too many shader programs");
+    }
+
+    Program program{
+        .stages = {},
+        .layout = nullptr,
+        .set_layouts = {},
+        .attributes = {},
+        .stride = 0,
+        .instance_stride = 0,
+    };
+
+    std::vector<ShaderReflection> reflections;
+    for (const Resource &spirv : stages) {
+        ShaderReflection reflection = reflectShader(spirv);
+        vk::ShaderModuleCreateInfo module_ci{
+            .codeSize = spirv.size(),
+            .pCode = reinterpret_cast<const uint32_t *>(spirv.data()),
+        };
+        reflections.push_back(reflection);
+        program.stages.push_back(Stage{std::move(reflection), vk::raii::ShaderModule{*m_device, module_ci, HostAllocator::callbacks()}});
+    }
+
+    const PipelineInterface iface = mergeReflections(reflections);
+    if (layout) {
+        program.layout = layout;
+    } else {
+        program.set_layouts = m_layouts->setLayouts(iface, fixed_sets);
+        program.layout = m_layouts->pipelineLayout(program.set_layouts, iface.push_constants);
+    }
+
+    PipelineInterface per_vertex{}, per_instance{};
+    for (const ReflectedVertexInput &input : iface.vertex_inputs) {
+        (input.location < FIRST_INSTANCE_LOCATION ? per_vertex : per_instance).vertex_inputs.push_back(input);
+    }
+    program.attributes = vertexAttributes(per_vertex, 0, program.stride);
+    std::ranges::copy(vertexAttributes(per_instance, 1, program.instance_stride), std::back_inserter(program.attributes));
+
+    m_programs.push_back(std::move(program));
+    BOOST_LOG_TRIVIAL(trace) << "Added shader program " << m_programs.size() - 1 << " with " << stages.size() << " stages";
+    return static_cast<ProgramId>(m_programs.size() - 1);
+}
+
+vgraphplay::gfx::TargetsId vgraphplay::gfx::PipelineCache::addTargets(std::span<const vk::Format> color_formats, vk::Format depth_format) {
+    for (size_t i = 0; i < m_targets.size(); ++i) {
+        if (std::ranges::equal(m_targets[i].color_formats, color_formats) && m_targets[i].depth_format == depth_format) {
+            return static_cast<TargetsId>(i);
+        }
+    }
+
+    if (m_targets.size() > std::numeric_limits<TargetsId>::max()) {
+        throw std::runtime_error("Too many render target combinations");
+    }
+
+    m_targets.push_back(Targets{
+        .color_formats = {color_formats.begin(), color_formats.end()},
+        .depth_format = depth_format,
+    });
+    return static_cast<TargetsId>(m_targets.size() - 1);
+}
+
+vgraphplay::gfx::PipelineHandle vgraphplay::gfx::PipelineCache::get(const PipelineKey &key) {
+    const uint64_t value = key.value();
+
+    auto it = m_pipelines.find(value);
+    if (it != m_pipelines.end()) {
+        return it->second;
+    }
+
+    PipelineHandle handle = m_resources->addPipeline(create(key), m_programs.at(key.program).layout);
+    m_pipelines.emplace(value, handle);
+    VGRAPHPLAY_LOG(trace, "Created pipeline {:x} ({} permutations)", value, m_pipelines.size());
+    return handle;
+}
+
+void vgraphplay::gfx::PipelineCache::clear() {
+    if (m_resources != nullptr) {
+        for (const auto &[value, handle] : m_pipelines) {
+            m_resources->destroyPipeline(handle);
+        }
+    }
+    m_pipelines.clear();
+}
+
+vk::raii::Pipeline vgraphplay::gfx::PipelineCache::create(const PipelineKey &key) const {
+    const Program &program = m_programs.at(key.program);
+    const Targets &targets = m_targets.at(key.targets);
+    const PipelineState &state = key.state;
+
+    // One VkBool32 per feature, indexed by constant ID. Each stage only
+    // gets map entries for the constants it actually declares.
+    std::array<vk::Bool32, PipelineState::NUM_FEATURES> spec_values;
+    for (uint32_t id = 0; id < PipelineState::NUM_FEATURES; ++id) {
+        spec_values[id] = (state.features & (1u << id)) ? vk::True : vk::False;
+    }
+
+    std::vector<std::vector<vk::SpecializationMapEntry>> spec_entries(program.stages.size());
+    std::vector<vk::SpecializationInfo> spec_infos(program.stages.size());
+    std::vector<vk::PipelineShaderStageCreateInfo> stage_cis;
+    for (size_t i = 0; i < program.stages.size(); ++i) {
+        const Stage &stage = program.stages[i];
+        for (const ReflectedSpecConstant &constant : stage.reflection.spec_constants) {
+            if (constant.id < PipelineState::NUM_FEATURES) {
+                spec_entries[i].push_back(vk::SpecializationMapEntry{
+                    .constantID = constant.id,
+                    .offset = static_cast<uint32_t>(constant.id * sizeof(vk::Bool32)),
+                    .size = sizeof(vk::Bool32),
+                });
+            }
+        }
+        spec_infos[i] = vk::SpecializationInfo{
+            .mapEntryCount = static_cast<uint32_t>(spec_entries[i].size()),
+            .pMapEntries = spec_entries[i].data(),
+            .dataSize = sizeof(spec_values),
+            .pData = spec_values.data(),
+        };
+        stage_cis.push_back(vk::PipelineShaderStageCreateInfo{
+            .stage = stage.reflection.stage,
+            .module = *stage.module,
+            .pName = stage.reflection.entry_point.c_str(),
+            .pSpecializationInfo = spec_entries[i].empty() ? nullptr : &spec_infos[i],
+        });
+    }
+
+    std::vector<vk::VertexInputBindingDescription> vertex_bindings;
+    if (program.stride != 0) {
+        vertex_bindings.push_back(vk::VertexInputBindingDescription{
+            .binding = 0,
+            .stride = program.stride,
+            .inputRate = vk::VertexInputRate::eVertex,
+        });
+    }
+    if (program.instance_stride != 0) {
+        vertex_bindings.push_back(vk::VertexInputBindingDescription{
+            .binding = 1,
+            .stride = program.instance_stride,
+            .inputRate = vk::VertexInputRate::eInstance,
+        });
+    }
+    vk::PipelineVertexInputStateCreateInfo vertex_input_ci{
+        .vertexBindingDescriptionCount = static_cast<uint32_t>(vertex_bindings.size()),
+        .pVertexBindingDescriptions = vertex_bindings.data(),
+        .vertexAttributeDescriptionCount = static_cast<uint32_t>(program.attributes.size()),
+        .pVertexAttributeDescriptions = program.attributes.data(),
+    };
+
+    vk::PipelineInputAssemblyStateCreateInfo input_assembly_ci{
+        .topology = state.topology,
+    };
+
+    vk::PipelineViewportStateCreateInfo viewport_ci{
+        .viewportCount = 1,
+        .scissorCount = 1,
+    };
+
+    vk::PipelineRasterizationStateCreateInfo raster_ci{
+        .polygonMode = vk::PolygonMode::eFill,
+        .cullMode = state.cull_mode,
+        .frontFace = state.front_face,
+        .lineWidth = 1.0f,
+    };
+
+    vk::PipelineMultisampleStateCreateInfo multisample_ci{
+        .rasterizationSamples = vk::SampleCountFlagBits::e1,
+    };
+
+    vk::PipelineDepthStencilStateCreateInfo depth_ci{
+        .depthTestEnable = state.depth_test,
+        .depthWriteEnable = state.depth_write,
+        .depthCompareOp = state.depth_compare,
+        .minDepthBounds = 0.0f,
+        .maxDepthBounds = 1.0f,
+    };
+
+    std::vector<vk::PipelineColorBlendAttachmentState> blend_attachments(targets.color_formats.size(), blendAttachment(state.blend, state.color_write));
+    vk::PipelineColorBlendStateCreateInfo blend_ci{
+        .attachmentCount = static_cast<uint32_t>(blend_attachments.size()),
+        .pAttachments = blend_attachments.data(),
+    };
+
+    const vk::DynamicState dynamic_states[] = {
+        vk::DynamicState::eViewport,
+        vk::DynamicState::eScissor,
+    };
+    vk::PipelineDynamicStateCreateInfo dynamic_ci{
+        .dynamicStateCount = static_cast<uint32_t>(std::size(dynamic_states)),
+        .pDynamicStates = dynamic_states,
+    };
+
+    vk::PipelineRenderingCreateInfo rendering_ci{
+        .colorAttachmentCount = static_cast<uint32_t>(targets.color_formats.size()),
+        .pColorAttachmentFormats = targets.color_formats.data(),
+        .depthAttachmentFormat = targets.depth_format,
+    };
+
+    vk::GraphicsPipelineCreateInfo pipeline_ci{
+        .pNext = &rendering_ci,
+        .stageCount = static_cast<uint32_t>(stage_cis.size()),
+        .pStages = stage_cis.data(),
+        .pVertexInputState = &vertex_input_ci,
+        .pInputAssemblyState = &input_assembly_ci,
+        .pViewportState = &viewport_ci,
+        .pRasterizationState = &raster_ci,
+        .pMultisampleState = &multisample_ci,
+        .pDepthStencilState = targets.depth_format == vk::Format::eUndefined ? nullptr : &depth_ci,
+        .pColorBlendState = &blend_ci,
+        .pDynamicState = &dynamic_ci,
+        .layout = program.layout,
+    };
+
+    return vk::raii::Pipeline{*m_device, nullptr, pipeline_ci, HostAllocator::callbacks()};
+}
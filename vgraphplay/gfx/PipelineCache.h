@@ -0,0 +1,148 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_GFX_PIPELINE_CACHE_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_GFX_PIPELINE_CACHE_H_
+
+#include <cstdint>
+#include <map>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "../vulkan.h"
+
+#include "Handle.h"
+#include "LayoutCache.h"
+#include "Resource.h"
+#include "Resources.h"
+#include "ShaderReflection.h"
+
+namespace vgraphplay {
+    namespace gfx {
+        enum class BlendMode : uint8_t {
+            Opaque,
+            AlphaBlend,
+            Additive,
+        };
+
+        // The fixed-function state and material features of one pipeline
+        // permutation. Packs into 32 bits.
+        struct PipelineState {
+            // Feature bit N is the shader's specialization constant N (see
+            // shaders/unlit.frag). Shaders that don't declare a feature's
+            // constant ignore it.
+            static constexpr uint8_t TEXTURED = 1 << 0;
+            static constexpr uint8_t VERTEX_COLOR = 1 << 1;
+            static constexpr uint8_t ALPHA_TEST = 1 << 2;
+            static constexpr uint32_t NUM_FEATURES = 3;
+
+            uint8_t features = TEXTURED | VERTEX_COLOR;
+            vk::PrimitiveTopology topology = vk::PrimitiveTopology::eTriangleList;
+            vk::CullModeFlagBits cull_mode = vk::CullModeFlagBits::eBack;
+            vk::FrontFace front_face = vk::FrontFace::eCounterClockwise;
+            bool depth_test = true;
+            bool depth_write = true;
+            vk::CompareOp depth_compare = vk::CompareOp::eLess;
+            BlendMode blend = BlendMode::Opaque;
+            bool color_write = true;
+
+            uint32_t pack() const;
+        };
+
+        // Shader programs and render target formats are registered with the
+        // cache up front and referred to by these small IDs, so a whole
+        // pipeline key fits in 64 bits.
+        using ProgramId = uint16_t;
+        using TargetsId = uint16_t;
+
+        struct PipelineKey {
+            ProgramId program;
+            TargetsId targets;
+            PipelineState state;
+
+            uint64_t value() const {
+                return (static_cast<uint64_t>(program) << 48) | (static_cast<uint64_t>(targets) << 32) | state.pack();
+            }
+        };
+
+        // Creates graphics pipelines on first use, one per distinct key.
+        // Material features become specialization constants, so each
+        // permutation only contains the shader code it uses. Viewport and
+        // scissor are dynamic; everything else is baked in. Pipelines are
+        // owned by Resources and live until clear() or the cache goes away.
+        class PipelineCache {
+        public:
+            PipelineCache(std::nullptr_t);
+            PipelineCache(const vk::raii::Device &device, Resources &resources, LayoutCache &layouts);
+            ~PipelineCache();
+
+            PipelineCache(const PipelineCache &) = delete;
+            PipelineCache &operator=(const PipelineCache &) = delete;
+            PipelineCache(PipelineCache &&) = default;
+            PipelineCache &operator=(PipelineCache &&) = default;
+
+            // Vertex shader inputs at this location and above are per
+            // instance, read from binding 1.
+            static constexpr uint32_t FIRST_INSTANCE_LOCATION = 8;
+
+            // Reflects the stages, creates their shader modules and builds
+            // the pipeline layout. Vertex attributes are taken from the
+            // vertex shader's inputs, tightly packed in binding 0 (or 1 for
+            // per-instance inputs). Sets in fixed_sets are passed through
+            // to LayoutCache.
+            ProgramId addProgram(std::span<const Resource> stages, const std::map<uint32_t, vk::DescriptorSetLayout> &fixed_sets = {});
+
+            // Uses an existing layout instead, e.g. so that a depth-only
+            // program can share descriptor sets with the color program it
+            // mirrors. The layout must be a superset of the stages' needs.
+            ProgramId addProgram(std::span<const Resource> stages, vk::PipelineLayout layout);
+            vk::PipelineLayout layout(ProgramId program) const { return m_programs.at(program).layout; }
+
+            // For allocating the program's descriptor sets. Only programs
+            // that built their own layout know their set layouts.
+            vk::DescriptorSetLayout setLayout(ProgramId program, uint32_t set) const { return m_programs.at(program).set_layouts.at(set); }
+
+            // Depth format eUndefined means no depth attachment.
+            TargetsId addTargets(std::span<const vk::Format> color_formats, vk::Format depth_format = vk::Format::eUndefined);
+
+            PipelineHandle get(const PipelineKey &key);
+            vk::Pipeline pipeline(const PipelineKey &key) { return m_resources->pipeline(get(key)); }
+
+            void clear();
+            size_t size() const { return m_pipelines.size(); }
+
+        private:
+            struct Stage {
+                ShaderReflection reflection;
+                vk::raii::ShaderModule module;
+            };
+
+            struct Program {
+                std::vector<Stage> stages;
+                vk::PipelineLayout layout;
+                std::vector<vk::DescriptorSetLayout> set_layouts; // Empty if the layout was given.
+                std::vector<vk::VertexInputAttributeDescription> attributes;
+                uint32_t stride;
+                uint32_t instance_stride;
+            };
+
+            struct Targets {
+                std::vector<vk::Format> color_formats;
+                vk::Format depth_format;
+            };
+
+            ProgramId insertProgram(std::span<const Resource> stages, vk::PipelineLayout layout, const std::map<uint32_t, vk::DescriptorSetLayout> &fixed_sets);
+            vk::raii::Pipeline create(const PipelineKey &key) const;
+
+            const vk::raii::Device *m_device;
+            Resources *m_resources;
+            LayoutCache *m_layouts;
+
+            std::vector<Program> m_programs;
+            std::vector<Targets> m_targets;
+            std::unordered_map<uint64_t, PipelineHandle> m_pipelines;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,108 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "RadixSort.h"
+
+vgraphplay::gfx::RadixSorter::RadixSorter(JobSystem *jobs)
+    : m_jobs{jobs},
+      m_workers{jobs == nullptr ? 1 : jobs->workers() + 1},
+      m_key_scratch{},
+      m_value_scratch{},
+      m_histograms{}
+{}
+
+unsigned vgraphplay::gfx::RadixSorter::chunks(size_t n) const {
+    if (n < PARALLEL_THRESHOLD) {
+        return 1;
+    }
+    return static_cast<unsigned>(std::min<size_t>(m_workers, n / MIN_CHUNK));
+}
+
+void vgraphplay::gfx::RadixSorter::sort(std::vector<uint64_t> &keys, std::vector<uint32_t> &values) {
+    if (keys.size() != values.size()) {
+        throw std::runtime_error("Radix sort keys and values differ in length");
+    }
+
+    const size_t n = keys.size();
+    if (n < 2) {
+        return;
+    }
+
+    const unsigned chunks = this->chunks(n);
+    const size_t chunk_size = (n + chunks - 1) / chunks;
+    auto chunkBegin = [&](unsigned c) { return std::min(n, c * chunk_size); };
+
+    // Runs fn(chunk) for every chunk, the first on this thread.
+    auto forEachChunk = [&](auto &&fn) {
+        if (chunks == 1) {
+            fn(0u);
+            return;
+        }
+        m_jobs->parallelFor(chunks, 1, [&fn](size_t begin, size_t end) {
+            for (size_t c = begin; c < end; ++c) {
+                fn(static_cast<unsigned>(c));
+            }
+        });
+    };
+
+    m_key_scratch.resize(n);
+    m_value_scratch.resize(n);
+    m_histograms.resize(chunks);
+
+    uint64_t *src_keys = keys.data();
+    uint32_t *src_values = values.data();
+    uint64_t *dst_keys = m_key_scratch.data();
+    uint32_t *dst_values = m_value_scratch.data();
+
+    for (unsigned shift = 0; shift < 64; shift += 8) {
+        forEachChunk([&](unsigned c) {
+            Histogram &hist = m_histograms[c];
+            hist.fill(0);
+            for (size_t i = chunkBegin(c), end = chunkBegin(c + 1); i < end; ++i) {
+                ++hist[(src_keys[i] >> shift) & 0xff];
+            }
+        });
+
+        // Every key has the same byte here, so this pass wouldn't move
+        // anything.
+        const unsigned first_digit = static_cast<unsigned>((src_keys[0] >> shift) & 0xff);
+        uint32_t with_first_digit = 0;
+        for (const Histogram &hist : m_histograms) {
+            with_first_digit += hist[first_digit];
+        }
+        if (with_first_digit == n) {
+            continue;
+        }
+
+        // Turn the counts into where each chunk starts writing each digit:
+        // after all smaller digits, and after earlier chunks' keys with the
+        // same digit.
+        uint32_t offset = 0;
+        for (unsigned digit = 0; digit < 256; ++digit) {
+            for (Histogram &hist : m_histograms) {
+                uint32_t count = hist[digit];
+                hist[digit] = offset;
+                offset += count;
+            }
+        }
+
+        forEachChunk([&](unsigned c) {
+            Histogram &next = m_histograms[c];
+            for (size_t i = chunkBegin(c), end = chunkBegin(c + 1); i < end; ++i) {
+                uint32_t dst = next[(src_keys[i] >> shift) & 0xff]++;
+                dst_keys[dst] = src_keys[i];
+                dst_values[dst] = src_values[i];
+            }
+        });
+
+        std::swap(src_keys, dst_keys);
+        std::swap(src_values, dst_values);
+    }
+
+    if (src_keys != keys.data()) {
+        std::copy(src_keys, src_keys + n, keys.data());
+        std::copy(src_values, src_values + n, values.data());
+    }
+}
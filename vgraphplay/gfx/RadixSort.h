@@ -0,0 +1,53 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_GFX_RADIX_SORT_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_GFX_RADIX_SORT_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "../JobSystem.h"
+
+namespace vgraphplay {
+    namespace gfx {
+        // Stable LSD radix sort of 64-bit keys, carrying a 32-bit value
+        // (usually an index) along with each key. Sorts a byte per pass and
+        // skips passes where every key has the same byte, which is common
+        // when the high fields of a sort key only take a few values. Given a
+        // JobSystem, large arrays are split across its threads: each counts
+        // its chunk, the counts are turned into per-chunk offsets, and each
+        // scatters its chunk. Keeps its scratch buffers between calls.
+        //
+        // Arrays of PARALLEL_THRESHOLD keys or more are split, into chunks
+        // of at least MIN_CHUNK keys each, so a frame's draw list (up to
+        // System::MAX_DRAWS_PER_FRAME) is spread across every worker well
+        // before it's full.
+        class RadixSorter {
+        public:
+            static constexpr size_t PARALLEL_THRESHOLD = 2048;
+            static constexpr size_t MIN_CHUNK = PARALLEL_THRESHOLD / 2;
+
+            explicit RadixSorter(JobSystem *jobs = nullptr);
+
+            void sort(std::vector<uint64_t> &keys, std::vector<uint32_t> &values);
+
+            unsigned workers() const { return m_workers; }
+
+            // How many chunks sort() splits n keys into.
+            unsigned chunks(size_t n) const;
+
+        private:
+            using Histogram = std::array<uint32_t, 256>;
+
+            JobSystem *m_jobs;
+            unsigned m_workers;
+            std::vector<uint64_t> m_key_scratch;
+            std::vector<uint32_t> m_value_scratch;
+            std::vector<Histogram> m_histograms;
+        };
+    }
+}
+
+#endif
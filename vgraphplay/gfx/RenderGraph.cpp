@@ -0,0 +1,611 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+#include "RenderGraph.h"
+#include "HostAllocator.h"
+#include "../Log.h"
+
+namespace {
+    struct AccessInfo {
+        vk::PipelineStageFlags2 stages;
+        vk::AccessFlags2 read;
+        vk::AccessFlags2 write;
+        vk::ImageLayout layout;
+        vk::ImageUsageFlags usage;
+    };
+
+    AccessInfo accessInfo(vgraphplay::gfx::Access access) {
+        using vgraphplay::gfx::Access;
+        using Stage = vk::PipelineStageFlagBits2;
+        using Acc = vk::AccessFlagBits2;
+
+        switch (access) {
+        case Access::ColorAttachment:
+            return {Stage::eColorAttachmentOutput, Acc::eColorAttachmentRead, Acc::eColorAttachmentWrite,
+                    vk::ImageLayout::eColorAttachmentOptimal, vk::ImageUsageFlagBits::eColorAttachment};
+        case Access::DepthAttachment:
+            return {Stage::eEarlyFragmentTests | Stage::eLateFragmentTests, Acc::eDepthStencilAttachmentRead, Acc::eDepthStencilAttachmentWrite,
+                    vk::ImageLayout::eDepthStencilAttachmentOptimal, vk::ImageUsageFlagBits::eDepthStencilAttachment};
+        case Access::DepthAttachmentReadOnly:
+            return {Stage::eEarlyFragmentTests | Stage::eLateFragmentTests, Acc::eDepthStencilAttachmentRead, {},
+                    vk::ImageLayout::eDepthStencilReadOnlyOptimal, vk::ImageUsageFlagBits::eDepthStencilAttachment};
+        case Access::SampledFragment:
+            return {Stage::eFragmentShader, Acc::eShaderSampledRead, {},
+                    vk::ImageLayout::eShaderReadOnlyOptimal, vk::ImageUsageFlagBits::eSampled};
+        case Access::SampledCompute:
+            return {Stage::eComputeShader, Acc::eShaderSampledRead, {},
+                    vk::ImageLayout::eShaderReadOnlyOptimal, vk::ImageUsageFlagBits::eSampled};
+        case Access::StorageCompute:
+            return {Stage::eComputeShader, Acc::eShaderStorageRead, Acc::eShaderStorageWrite,
+                    vk::ImageLayout::eGeneral, vk::ImageUsageFlagBits::eStorage};
+        case Access::TransferSrc:
+            return {Stage::eAllTransfer, Acc::eTransferRead, {},
+                    vk::ImageLayout::eTransferSrcOptimal, vk::ImageUsageFlagBits::eTransferSrc};
+        case Access::TransferDst:
+            return {Stage::eAllTransfer, {}, Acc::eTransferWrite,
+                    vk::ImageLayout::eTransferDstOptimal, vk::ImageUsageFlagBits::eTransferDst};
+        case Access::VertexBuffer:
+            return {Stage::eVertexAttributeInput, Acc::eVertexAttributeRead, {}, vk::ImageLayout::eUndefined, {}};
+        case Access::IndexBuffer:
+            return {Stage::eIndexInput, Acc::eIndexRead, {}, vk::ImageLayout::eUndefined, {}};
+        case Access::IndirectBuffer:
+            return {Stage::eDrawIndirect, Acc::eIndirectCommandRead, {}, vk::ImageLayout::eUndefined, {}};
+        case Access::UniformBuffer:
+            return {Stage::eVertexShader | Stage::eFragmentShader | Stage::eComputeShader, Acc::eUniformRead, {}, vk::ImageLayout::eUndefined, {}};
+        }
+
+        throw std::runtime_error("Unknown render graph access");
+    }
+
+    // Where a resource stands partway through the frame: its layout, the
+    // last write and the reads since then, and which stages and accesses
+    // have already been made to wait for that write.
+    struct ResourceState {
+        vk::ImageLayout layout;
+        vk::PipelineStageFlags2 write_stages;
+        vk::AccessFlags2 write_access;
+        vk::PipelineStageFlags2 read_stages;
+        vk::PipelineStageFlags2 visible_stages;
+        vk::AccessFlags2 visible_access;
+    };
+
+    template <typename T>
+    void appendKey(std::string &key, const T &value) {
+        key.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    void recordBarriers(const vk::raii::CommandBuffer &commands, const std::vector<vk::ImageMemoryBarrier2> &images, const std::vector<vk::BufferMemoryBarrier2> &buffers) {
+        if (images.empty() && buffers.empty()) {
+            return;
+        }
+
+        commands.pipelineBarrier2(vk::DependencyInfo{
+            .bufferMemoryBarrierCount = static_cast<uint32_t>(buffers.size()),
+            .pBufferMemoryBarriers = buffers.data(),
+            .imageMemoryBarrierCount = static_cast<uint32_t>(images.size()),
+            .pImageMemoryBarriers = images.data(),
+        });
+    }
+}
+
+vgraphplay::gfx::RenderGraph::PassBuilder &vgraphplay::gfx::RenderGraph::PassBuilder::read(RenderResource resource, Access access) {
+    if (!accessInfo(access).read) {
+        throw std::runtime_error("Pass " + m_graph->m_passes[m_pass].name + " reads " + m_graph->m_nodes.at(resource).name + " with a write-only access");
+    }
+    m_graph->m_passes[m_pass].uses.push_back(Use{resource, access, false});
+    return *this;
+}
+
+vgraphplay::gfx::RenderGraph::PassBuilder &vgraphplay::gfx::RenderGraph::PassBuilder::write(RenderResource resource, Access access) {
+    if (!accessInfo(access).write) {
+        throw std::runtime_error("Pass " + m_graph->m_passes[m_pass].name + " writes " + m_graph->m_nodes.at(resource).name + " with a read-only access");
+    }
+    m_graph->m_passes[m_pass].uses.push_back(Use{resource, access, true});
+    return *this;
+}
+
+vgraphplay::gfx::RenderGraph::PassBuilder &vgraphplay::gfx::RenderGraph::PassBuilder::sideEffects() {
+    m_graph->m_passes[m_pass].side_effects = true;
+    return *this;
+}
+
+vgraphplay::gfx::RenderGraph::RenderGraph(std::nullptr_t)
+    : m_device{nullptr},
+      m_resources{nullptr},
+      m_deletion_queue{nullptr},
+      m_passes{},
+      m_nodes{},
+      m_transient_key{},
+      m_transients{},
+      m_blocks{},
+      m_block_stages{},
+      m_block_access{},
+      m_final_barriers{},
+      m_culled_passes{0},
+      m_barrier_batches{0},
+      m_barrier_count{0},
+      m_transient_bytes{0},
+      m_aliased_bytes{0}
+{}
+
+vgraphplay::gfx::RenderGraph::RenderGraph(const vk::raii::Device &device, const Resources &resources, DeletionQueue &deletion_queue)
+    : RenderGraph{nullptr}
+{
+    m_device = &device;
+    m_resources = &resources;
+    m_deletion_queue = &deletion_queue;
+}
+
+vgraphplay::gfx::RenderGraph::~RenderGraph() {
+    if (m_deletion_queue != nullptr) {
+        for (TransientImage &transient : m_transients) {
+            m_deletion_queue->retire(std::move(transient.view));
+            m_deletion_queue->retire(std::move(transient.image));
+        }
+        for (vk::raii::DeviceMemory &block : m_blocks) {
+            m_deletion_queue->retire(std::move(block));
+        }
+    }
+}
+
+void vgraphplay::gfx::RenderGraph::reset() {
+    m_passes.clear();
+    m_nodes.clear();
+    m_final_barriers = {};
+}
+
+vgraphplay::gfx::RenderResource vgraphplay::gfx::RenderGraph::importImage(const std::string &name, vk::Image image, vk::ImageView view, const RenderImageDesc &desc,
+                                                                          vk::ImageLayout initial_layout, vk::PipelineStageFlags2 initial_stages, vk::ImageLayout final_layout) {
+    m_nodes.push_back(Node{
+        .name = name,
+        .imported = true,
+        .is_image = true,
+        .desc = desc,
+        .image = image,
+        .view = view,
+        .buffer = nullptr,
+        .size = 0,
+        .initial_layout = initial_layout,
+        .final_layout = final_layout,
+        .initial_stages = initial_stages,
+        .initial_access = {},
+        .usage = {},
+        .first_use = 0,
+        .last_use = 0,
+        .transient = 0,
+    });
+    return static_cast<RenderResource>(m_nodes.size() - 1);
+}
+
+vgraphplay::gfx::RenderResource vgraphplay::gfx::RenderGraph::importBuffer(const std::string &name, vk::Buffer buffer, vk::DeviceSize size,
+                                                                           vk::PipelineStageFlags2 initial_stages, vk::AccessFlags2 initial_access) {
+    m_nodes.push_back(Node{
+        .name = name,
+        .imported = true,
+        .is_image = false,
+        .desc = {},
+        .image = nullptr,
+        .view = nullptr,
+        .buffer = buffer,
+        .size = size,
+        .initial_layout = vk::ImageLayout::eUndefined,
+        .final_layout = vk::ImageLayout::eUndefined,
+        .initial_stages = initial_stages,
+        .initial_access = initial_access,
+        .usage = {},
+        .first_use = 0,
+        .last_use = 0,
+        .transient = 0,
+    });
+    return static_cast<RenderResource>(m_nodes.size() - 1);
+}
+
+vgraphplay::gfx::RenderResource vgraphplay::gfx::RenderGraph::createImage(const std::string &name, const RenderImageDesc &desc) {
+    m_nodes.push_back(Node{
+        .name = name,
+        .imported = false,
+        .is_image = true,
+        .desc = desc,
+        .image = nullptr,
+        .view = nullptr,
+        .buffer = nullptr,
+        .size = 0,
+        .initial_layout = vk::ImageLayout::eUndefined,
+        .final_layout = vk::ImageLayout::eUndefined,
+        .initial_stages = {},
+        .initial_access = {},
+        .usage = {},
+        .first_use = 0,
+        .last_use = 0,
+        .transient = 0,
+    });
+    return static_cast<RenderResource>(m_nodes.size() - 1);
+}
+
+vgraphplay::gfx::RenderGraph::PassBuilder vgraphplay::gfx::RenderGraph::addPass(const std::string &name, Execute execute) {
+    m_passes.push_back(Pass{
+        .name = name,
+        .execute = std::move(execute),
+        .uses = {},
+        .side_effects = false,
+        .live = false,
+        .barriers = {},
+    });
+    return PassBuilder{*this, static_cast<uint32_t>(m_passes.size() - 1)};
+}
+
+vk::Image vgraphplay::gfx::RenderGraph::image(RenderResource resource) const {
+    const Node &node = m_nodes.at(resource);
+    return node.imported ? node.image : *m_transients.at(node.transient).image;
+}
+
+vk::ImageView vgraphplay::gfx::RenderGraph::imageView(RenderResource resource) const {
+    const Node &node = m_nodes.at(resource);
+    return node.imported ? node.view : *m_transients.at(node.transient).view;
+}
+
+void vgraphplay::gfx::RenderGraph::compile() {
+    cull();
+
+    for (Node &node : m_nodes) {
+        node.usage = {};
+        node.first_use = std::numeric_limits<uint32_t>::max();
+        node.last_use = 0;
+    }
+
+    for (uint32_t p = 0; p < m_passes.size(); ++p) {
+        if (!m_passes[p].live) {
+            continue;
+        }
+        for (const Use &use : m_passes[p].uses) {
+            Node &node = m_nodes.at(use.resource);
+            node.usage |= accessInfo(use.access).usage;
+            node.first_use = std::min(node.first_use, p);
+            node.last_use = std::max(node.last_use, p);
+        }
+    }
+
+    std::vector<RenderResource> transients;
+    for (RenderResource r = 0; r < m_nodes.size(); ++r) {
+        if (!m_nodes[r].imported && m_nodes[r].is_image && m_nodes[r].first_use != std::numeric_limits<uint32_t>::max()) {
+            transients.push_back(r);
+        }
+    }
+    allocateTransients(transients);
+
+    buildBarriers();
+}
+
+void vgraphplay::gfx::RenderGraph::execute(const vk::raii::CommandBuffer &commands) const {
+    for (const Pass &pass : m_passes) {
+        if (!pass.live) {
+            continue;
+        }
+        recordBarriers(commands, pass.barriers.images, pass.barriers.buffers);
+        pass.execute(commands, *this);
+    }
+    recordBarriers(commands, m_final_barriers.images, m_final_barriers.buffers);
+}
+
+// Walks the passes backwards from the imported resources, keeping a pass
+// only if something later needs what it writes.
+void vgraphplay::gfx::RenderGraph::cull() {
+    std::vector<bool> needed(m_nodes.size(), false);
+    for (RenderResource r = 0; r < m_nodes.size(); ++r) {
+        needed[r] = m_nodes[r].imported;
+    }
+
+    m_culled_passes = 0;
+    for (size_t p = m_passes.size(); p-- > 0;) {
+        Pass &pass = m_passes[p];
+        pass.live = pass.side_effects || std::ranges::any_of(pass.uses, [&needed](const Use &use) {
+            return use.write && needed[use.resource];
+        });
+
+        if (!pass.live) {
+            VGRAPHPLAY_LOG(trace, "Culled render pass {}", pass.name);
+            ++m_culled_passes;
+            continue;
+        }
+
+        for (const Use &use : pass.uses) {
+            if (!use.write) {
+                needed[use.resource] = true;
+            }
+        }
+    }
+}
+
+// Gives each transient image its own block of memory unless an existing
+// block is only used by transients whose lifetimes don't overlap its own.
+// Largest images are placed first, so smaller ones fill in behind them.
+void vgraphplay::gfx::RenderGraph::allocateTransients(const std::vector<RenderResource> &transients) {
+    std::string key;
+    for (RenderResource r : transients) {
+        const Node &node = m_nodes[r];
+        appendKey(key, node.desc.format);
+        appendKey(key, node.desc.extent.width);
+        appendKey(key, node.desc.extent.height);
+        appendKey(key, static_cast<uint32_t>(node.desc.aspect));
+        appendKey(key, static_cast<uint32_t>(node.usage));
+        appendKey(key, node.first_use);
+        appendKey(key, node.last_use);
+    }
+
+    if (key != m_transient_key || m_transients.size() != transients.size()) {
+        for (TransientImage &transient : m_transients) {
+            m_deletion_queue->retire(std::move(transient.view));
+            m_deletion_queue->retire(std::move(transient.image));
+        }
+        for (vk::raii::DeviceMemory &block : m_blocks) {
+            m_deletion_queue->retire(std::move(block));
+        }
+        m_transients.clear();
+        m_blocks.clear();
+
+        std::vector<vk::MemoryRequirements> reqs;
+        for (RenderResource r : transients) {
+            const Node &node = m_nodes[r];
+            vk::ImageCreateInfo image_ci{
+                .imageType = vk::ImageType::e2D,
+                .format = node.desc.format,
+                .extent = {node.desc.extent.width, node.desc.extent.height, 1},
+                .mipLevels = 1,
+                .arrayLayers = 1,
+                .samples = vk::SampleCountFlagBits::e1,
+                .tiling = vk::ImageTiling::eOptimal,
+                .usage = node.usage,
+                .sharingMode = vk::SharingMode::eExclusive,
+                .initialLayout = vk::ImageLayout::eUndefined,
+            };
+            vk::raii::Image image{*m_device, image_ci, HostAllocator::callbacks()};
+            reqs.push_back(image.getMemoryRequirements());
+            m_transients.push_back(TransientImage{std::move(image), nullptr, 0});
+        }
+
+        std::vector<uint32_t> order(transients.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::ranges::stable_sort(order, std::greater{}, [&reqs](uint32_t i) { return reqs[i].size; });
+
+        struct Block {
+            vk::DeviceSize size;
+            uint32_t type_bits;
+            std::vector<uint32_t> members;
+        };
+        std::vector<Block> blocks;
+
+        for (uint32_t i : order) {
+            const Node &node = m_nodes[transients[i]];
+            auto fits = [&](const Block &block) {
+                return (block.type_bits & reqs[i].memoryTypeBits) != 0 &&
+                    std::ranges::none_of(block.members, [&](uint32_t j) {
+                        const Node &other = m_nodes[transients[j]];
+                        return node.first_use <= other.last_use && other.first_use <= node.last_use;
+                    });
+            };
+
+            auto block = std::ranges::find_if(blocks, fits);
+            if (block == blocks.end()) {
+                blocks.push_back(Block{0, reqs[i].memoryTypeBits, {}});
+                block = std::prev(blocks.end());
+            }
+            block->size = std::max(block->size, reqs[i].size);
+            block->type_bits &= reqs[i].memoryTypeBits;
+            block->members.push_back(i);
+            m_transients[i].block = static_cast<uint32_t>(std::distance(blocks.begin(), block));
+        }
+
+        vk::DeviceSize requested = 0;
+        for (const vk::MemoryRequirements &r : reqs) {
+            requested += r.size;
+        }
+
+        m_transient_bytes = 0;
+        for (const Block &block : blocks) {
+            vk::MemoryAllocateInfo alloc_info{
+                .allocationSize = block.size,
+                .memoryTypeIndex = m_resources->chooseMemoryTypeIndex(block.type_bits, vk::MemoryPropertyFlagBits::eDeviceLocal),
+            };
+            m_blocks.emplace_back(*m_device, alloc_info, HostAllocator::callbacks());
+            m_transient_bytes += block.size;
+        }
+        m_aliased_bytes = requested - m_transient_bytes;
+
+        for (uint32_t i = 0; i < transients.size(); ++i) {
+            const Node &node = m_nodes[transients[i]];
+            TransientImage &transient = m_transients[i];
+            transient.image.bindMemory(*m_blocks[transient.block], 0);
+
+            vk::ImageViewCreateInfo view_ci{
+                .image = *transient.image,
+                .viewType = vk::ImageViewType::e2D,
+                .format = node.desc.format,
+                .subresourceRange = {
+                    .aspectMask = node.desc.aspect,
+                    .baseMipLevel = 0,
+                    .levelCount = 1,
+                    .baseArrayLayer = 0,
+                    .layerCount = 1,
+                },
+            };
+            transient.view = vk::raii::ImageView{*m_device, view_ci, HostAllocator::callbacks()};
+        }
+
+        m_transient_key = std::move(key);
+        VGRAPHPLAY_LOG(trace, "Allocated {} transient images in {} blocks ({} bytes, {} saved by aliasing)",
+                       transients.size(), m_blocks.size(), m_transient_bytes, m_aliased_bytes);
+    }
+
+    for (uint32_t i = 0; i < transients.size(); ++i) {
+        m_nodes[transients[i]].transient = i;
+    }
+}
+
+// Steps through the live passes tracking each resource's state, and adds a
+// barrier only for a layout change, a write after earlier reads or writes,
+// or a read in a stage or access the last write hasn't been made visible
+// to yet. A pass's barriers are batched into one vkCmdPipelineBarrier2.
+void vgraphplay::gfx::RenderGraph::buildBarriers() {
+    m_block_stages.assign(m_blocks.size(), {});
+    m_block_access.assign(m_blocks.size(), {});
+    for (const Pass &pass : m_passes) {
+        if (!pass.live) {
+            continue;
+        }
+        for (const Use &use : pass.uses) {
+            const Node &node = m_nodes[use.resource];
+            if (!node.imported && node.is_image) {
+                const AccessInfo info = accessInfo(use.access);
+                uint32_t block = m_transients[node.transient].block;
+                m_block_stages[block] |= info.stages;
+                m_block_access[block] |= info.write;
+            }
+        }
+    }
+
+    // A transient's first use has to wait for whatever last used its
+    // memory, which could be an alias earlier in this frame or in the
+    // previous one.
+    std::vector<ResourceState> states;
+    for (const Node &node : m_nodes) {
+        ResourceState state{
+            .layout = node.initial_layout,
+            .write_stages = node.initial_stages,
+            .write_access = node.initial_access,
+            .read_stages = {},
+            .visible_stages = {},
+            .visible_access = {},
+        };
+        if (!node.imported && node.is_image && node.first_use != std::numeric_limits<uint32_t>::max()) {
+            uint32_t block = m_transients[node.transient].block;
+            state.write_stages = m_block_stages[block];
+            state.write_access = m_block_access[block];
+        }
+        states.push_back(state);
+    }
+
+    auto imageBarrier = [this](RenderResource r, const ResourceState &from, vk::ImageLayout new_layout,
+                               vk::PipelineStageFlags2 dst_stages, vk::AccessFlags2 dst_access) {
+        return vk::ImageMemoryBarrier2{
+            .srcStageMask = from.write_stages | from.read_stages,
+            .srcAccessMask = from.write_access,
+            .dstStageMask = dst_stages,
+            .dstAccessMask = dst_access,
+            .oldLayout = from.layout,
+            .newLayout = new_layout,
+            .srcQueueFamilyIndex = vk::QueueFamilyIgnored,
+            .dstQueueFamilyIndex = vk::QueueFamilyIgnored,
+            .image = image(r),
+            .subresourceRange = {
+                .aspectMask = m_nodes[r].desc.aspect,
+                .baseMipLevel = 0,
+                .levelCount = vk::RemainingMipLevels,
+                .baseArrayLayer = 0,
+                .layerCount = vk::RemainingArrayLayers,
+            },
+        };
+    };
+
+    m_barrier_batches = 0;
+    m_barrier_count = 0;
+
+    for (Pass &pass : m_passes) {
+        pass.barriers = {};
+        if (!pass.live) {
+            continue;
+        }
+
+        // Merge a pass's uses of the same resource first, so that e.g. a
+        // depth read and write become one barrier.
+        struct Merged {
+            RenderResource resource;
+            vk::PipelineStageFlags2 stages;
+            vk::AccessFlags2 access;
+            vk::ImageLayout layout;
+            bool write;
+        };
+        std::vector<Merged> merged;
+        for (const Use &use : pass.uses) {
+            const AccessInfo info = accessInfo(use.access);
+            const vk::AccessFlags2 access = use.write ? (info.read | info.write) : info.read;
+            auto it = std::ranges::find(merged, use.resource, &Merged::resource);
+            if (it == merged.end()) {
+                merged.push_back(Merged{use.resource, info.stages, access, info.layout, use.write});
+            } else {
+                if (m_nodes[use.resource].is_image && it->layout != info.layout) {
+                    throw std::runtime_error("Pass " + pass.name + " uses " + m_nodes[use.resource].name + " in two different layouts");
+                }
+                it->stages |= info.stages;
+                it->access |= access;
+                it->write = it->write || use.write;
+            }
+        }
+
+        for (const Merged &m : merged) {
+            const Node &node = m_nodes[m.resource];
+            ResourceState &state = states[m.resource];
+            const bool layout_change = node.is_image && state.layout != m.layout;
+
+            bool barrier;
+            if (m.write || layout_change) {
+                barrier = layout_change || state.write_stages || state.read_stages;
+            } else {
+                barrier = state.write_stages && ((m.stages & ~state.visible_stages) || (m.access & ~state.visible_access));
+            }
+
+            if (barrier) {
+                if (node.is_image) {
+                    pass.barriers.images.push_back(imageBarrier(m.resource, state, m.layout, m.stages, m.access));
+                } else {
+                    pass.barriers.buffers.push_back(vk::BufferMemoryBarrier2{
+                        .srcStageMask = state.write_stages | state.read_stages,
+                        .srcAccessMask = state.write_access,
+                        .dstStageMask = m.stages,
+                        .dstAccessMask = m.access,
+                        .srcQueueFamilyIndex = vk::QueueFamilyIgnored,
+                        .dstQueueFamilyIndex = vk::QueueFamilyIgnored,
+                        .buffer = node.buffer,
+                        .offset = 0,
+                        .size = vk::WholeSize,
+                    });
+                }
+            }
+
+            if (m.write) {
+                state = ResourceState{m.layout, m.stages, m.access, {}, {}, {}};
+            } else if (layout_change) {
+                // The transition itself counts as a write that only this
+                // pass's stages have waited for.
+                state = ResourceState{m.layout, m.stages, {}, m.stages, m.stages, m.access};
+            } else {
+                state.read_stages |= m.stages;
+                if (barrier) {
+                    state.visible_stages |= m.stages;
+                    state.visible_access |= m.access;
+                }
+            }
+        }
+
+        if (!pass.barriers.images.empty() || !pass.barriers.buffers.empty()) {
+            ++m_barrier_batches;
+            m_barrier_count += static_cast<uint32_t>(pass.barriers.images.size() + pass.barriers.buffers.size());
+        }
+    }
+
+    m_final_barriers = {};
+    for (RenderResource r = 0; r < m_nodes.size(); ++r) {
+        const Node &node = m_nodes[r];
+        if (node.imported && node.is_image && node.final_layout != vk::ImageLayout::eUndefined && states[r].layout != node.final_layout) {
+            m_final_barriers.images.push_back(imageBarrier(r, states[r], node.final_layout, vk::PipelineStageFlagBits2::eBottomOfPipe, {}));
+        }
+    }
+    if (!m_final_barriers.images.empty()) {
+        ++m_barrier_batches;
+        m_barrier_count += static_cast<uint32_t>(m_final_barriers.images.size());
+    }
+}
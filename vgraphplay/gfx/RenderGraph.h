@@ -0,0 +1,197 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_GFX_RENDER_GRAPH_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_GFX_RENDER_GRAPH_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "../vulkan.h"
+
+#include "DeletionQueue.h"
+#include "Resources.h"
+
+namespace vgraphplay {
+    namespace gfx {
+        // How a pass uses a resource. Each maps to the pipeline stages,
+        // access flags and (for images) layout the barriers are built from.
+        enum class Access : uint8_t {
+            ColorAttachment,
+            DepthAttachment,
+            DepthAttachmentReadOnly,
+            SampledFragment,
+            SampledCompute,
+            StorageCompute,
+            TransferSrc,
+            TransferDst,
+            VertexBuffer,
+            IndexBuffer,
+            IndirectBuffer,
+            UniformBuffer,
+        };
+
+        // Index of an image or buffer within the graph being built. Only
+        // valid until the next reset().
+        using RenderResource = uint32_t;
+
+        struct RenderImageDesc {
+            vk::Format format;
+            vk::Extent2D extent;
+            vk::ImageAspectFlags aspect;
+        };
+
+        // One frame's passes and the resources they use. Passes run in the
+        // order they are added. compile() drops passes whose results
+        // nothing uses, works out the barriers between the rest and
+        // allocates the transient images, letting transients whose
+        // lifetimes don't overlap share memory. execute() then records
+        // everything, with at most one vkCmdPipelineBarrier2 before each
+        // pass.
+        //
+        // Rebuild the graph every frame with reset(). Transient images are
+        // kept as long as the set of transients and their lifetimes stays
+        // the same; when it changes the old ones are retired into the
+        // deletion queue.
+        class RenderGraph {
+        public:
+            using Execute = std::function<void(const vk::raii::CommandBuffer &commands, const RenderGraph &graph)>;
+
+            class PassBuilder {
+            public:
+                PassBuilder &read(RenderResource resource, Access access);
+                PassBuilder &write(RenderResource resource, Access access);
+
+                // Keeps the pass even if nothing reads what it writes.
+                PassBuilder &sideEffects();
+
+            private:
+                friend class RenderGraph;
+                PassBuilder(RenderGraph &graph, uint32_t pass) : m_graph{&graph}, m_pass{pass} {}
+
+                RenderGraph *m_graph;
+                uint32_t m_pass;
+            };
+
+            RenderGraph(std::nullptr_t);
+            RenderGraph(const vk::raii::Device &device, const Resources &resources, DeletionQueue &deletion_queue);
+            ~RenderGraph();
+
+            RenderGraph(const RenderGraph &) = delete;
+            RenderGraph &operator=(const RenderGraph &) = delete;
+            RenderGraph(RenderGraph &&) = default;
+            RenderGraph &operator=(RenderGraph &&) = default;
+
+            // Forgets the passes and resources, keeping transient memory.
+            void reset();
+
+            // External images (e.g. the swapchain image) start out in
+            // initial_layout, after work in initial_stages, and are left in
+            // final_layout (unless that's eUndefined). Writes to imported
+            // resources always count as used.
+            RenderResource importImage(const std::string &name, vk::Image image, vk::ImageView view, const RenderImageDesc &desc,
+                                       vk::ImageLayout initial_layout, vk::PipelineStageFlags2 initial_stages, vk::ImageLayout final_layout);
+            RenderResource importBuffer(const std::string &name, vk::Buffer buffer, vk::DeviceSize size,
+                                        vk::PipelineStageFlags2 initial_stages = {}, vk::AccessFlags2 initial_access = {});
+
+            // An image that only lives within the frame. Its contents are
+            // undefined at its first use.
+            RenderResource createImage(const std::string &name, const RenderImageDesc &desc);
+
+            PassBuilder addPass(const std::string &name, Execute execute);
+
+            void compile();
+            void execute(const vk::raii::CommandBuffer &commands) const;
+
+            vk::Image image(RenderResource resource) const;
+            vk::ImageView imageView(RenderResource resource) const;
+            vk::Buffer buffer(RenderResource resource) const { return m_nodes[resource].buffer; }
+            const RenderImageDesc &imageDesc(RenderResource resource) const { return m_nodes[resource].desc; }
+
+            // Stats from the last compile().
+            uint32_t culledPasses() const { return m_culled_passes; }
+            uint32_t barrierBatches() const { return m_barrier_batches; }
+            uint32_t barriers() const { return m_barrier_count; }
+            vk::DeviceSize transientBytes() const { return m_transient_bytes; }
+            vk::DeviceSize aliasedBytes() const { return m_aliased_bytes; }
+
+        private:
+            struct Use {
+                RenderResource resource;
+                Access access;
+                bool write;
+            };
+
+            struct Barriers {
+                std::vector<vk::ImageMemoryBarrier2> images;
+                std::vector<vk::BufferMemoryBarrier2> buffers;
+            };
+
+            struct Pass {
+                std::string name;
+                Execute execute;
+                std::vector<Use> uses;
+                bool side_effects;
+                bool live;
+                Barriers barriers;
+            };
+
+            struct Node {
+                std::string name;
+                bool imported;
+                bool is_image;
+                RenderImageDesc desc;
+                vk::Image image;
+                vk::ImageView view;
+                vk::Buffer buffer;
+                vk::DeviceSize size;
+                vk::ImageLayout initial_layout;
+                vk::ImageLayout final_layout;
+                vk::PipelineStageFlags2 initial_stages;
+                vk::AccessFlags2 initial_access;
+
+                // Filled in by compile() for transients.
+                vk::ImageUsageFlags usage;
+                uint32_t first_use;
+                uint32_t last_use;
+                uint32_t transient; // Index into m_transients.
+            };
+
+            struct TransientImage {
+                vk::raii::Image image;
+                vk::raii::ImageView view;
+                uint32_t block;
+            };
+
+            void cull();
+            void allocateTransients(const std::vector<RenderResource> &transients);
+            void buildBarriers();
+
+            const vk::raii::Device *m_device;
+            const Resources *m_resources;
+            DeletionQueue *m_deletion_queue;
+
+            std::vector<Pass> m_passes;
+            std::vector<Node> m_nodes;
+
+            // Transient images and the memory blocks they alias in, along
+            // with the stages and writes of everything sharing each block.
+            std::string m_transient_key;
+            std::vector<TransientImage> m_transients;
+            std::vector<vk::raii::DeviceMemory> m_blocks;
+            std::vector<vk::PipelineStageFlags2> m_block_stages;
+            std::vector<vk::AccessFlags2> m_block_access;
+
+            Barriers m_final_barriers;
+
+            uint32_t m_culled_passes;
+            uint32_t m_barrier_batches;
+            uint32_t m_barrier_count;
+            vk::DeviceSize m_transient_bytes;
+            vk::DeviceSize m_aliased_bytes;
+        };
+    }
+}
+
+#endif
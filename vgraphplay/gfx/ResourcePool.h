@@ -0,0 +1,119 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_GFX_RESOURCE_POOL_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_GFX_RESOURCE_POOL_H_
+
+#include <cstdint>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "Handle.h"
+
+namespace vgraphplay {
+    namespace gfx {
+        // Dense structure-of-arrays storage addressed by generational
+        // handles. Each column type gets its own vector, indexed by the
+        // handle's slot, and columns are accessed by type, so every column
+        // type must be distinct. Freed slots go on a free list and are
+        // reused by later inserts; nothing is allocated per resource once
+        // the vectors have grown to the working set.
+        //
+        // Not thread safe; the renderer owns its pools.
+        template <typename Tag, typename... Columns>
+        class ResourcePool {
+        public:
+            using HandleType = Handle<Tag>;
+
+            HandleType insert(Columns... values) {
+                uint32_t index;
+
+                if (m_free.empty()) {
+                    index = static_cast<uint32_t>(m_generations.size());
+                    (std::get<std::vector<Columns>>(m_columns).push_back(std::move(values)), ...);
+                    m_generations.push_back(1);
+                    m_alive.push_back(true);
+                } else {
+                    index = m_free.back();
+                    m_free.pop_back();
+                    ((std::get<std::vector<Columns>>(m_columns)[index] = std::move(values)), ...);
+                    m_alive[index] = true;
+                }
+
+                ++m_live;
+                return HandleType{index, m_generations[index]};
+            }
+
+            // Frees the slot and hands back its contents (e.g. to retire
+            // Vulkan objects into a DeletionQueue). Every outstanding handle
+            // to the slot becomes stale.
+            std::tuple<Columns...> erase(HandleType handle) {
+                check(handle);
+
+                uint32_t &generation = m_generations[handle.index];
+                generation = generation == UINT32_MAX ? 1 : generation + 1;
+                m_free.push_back(handle.index);
+                m_alive[handle.index] = false;
+                --m_live;
+
+                return std::tuple<Columns...>{std::move(std::get<std::vector<Columns>>(m_columns)[handle.index])...};
+            }
+
+            bool contains(HandleType handle) const {
+                return handle.index < m_generations.size() && handle.generation != 0 && m_generations[handle.index] == handle.generation;
+            }
+
+            template <typename Column>
+            Column &get(HandleType handle) {
+                check(handle);
+                return std::get<std::vector<Column>>(m_columns)[handle.index];
+            }
+
+            template <typename Column>
+            const Column &get(HandleType handle) const {
+                check(handle);
+                return std::get<std::vector<Column>>(m_columns)[handle.index];
+            }
+
+            template <typename Column>
+            Column *find(HandleType handle) {
+                return contains(handle) ? &std::get<std::vector<Column>>(m_columns)[handle.index] : nullptr;
+            }
+
+            // Calls fn(handle, columns...) for every live slot.
+            template <typename Fn>
+            void forEach(Fn &&fn) {
+                for (uint32_t i = 0; i < m_generations.size(); ++i) {
+                    if (m_alive[i]) {
+                        fn(HandleType{i, m_generations[i]}, std::get<std::vector<Columns>>(m_columns)[i]...);
+                    }
+                }
+            }
+
+            void reserve(size_t capacity) {
+                (std::get<std::vector<Columns>>(m_columns).reserve(capacity), ...);
+                m_generations.reserve(capacity);
+                m_alive.reserve(capacity);
+            }
+
+            size_t size() const { return m_live; }
+            size_t capacity() const { return m_generations.size(); }
+
+        private:
+            void check(HandleType handle) const {
+                if (!contains(handle)) {
+                    throw std::runtime_error("Stale or invalid resource handle");
+                }
+            }
+
+            std::tuple<std::vector<Columns>...> m_columns;
+            std::vector<uint32_t> m_generations;
+            std::vector<bool> m_alive;
+            std::vector<uint32_t> m_free;
+            size_t m_live = 0;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,148 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#include <stdexcept>
+#include <utility>
+
+#include "Resources.h"
+#include "HostAllocator.h"
+#include "../Log.h"
+
+vgraphplay::gfx::Resources::Resources(std::nullptr_t)
+    : m_device{nullptr},
+      m_deletion_queue{nullptr},
+      m_memory_properties{},
+      m_buffers{},
+      m_images{},
+      m_samplers{},
+      m_pipelines{},
+      m_destroy_listeners{}
+{}
+
+vgraphplay::gfx::Resources::Resources(const vk::raii::PhysicalDevice &physical_device, const vk::raii::Device &device, DeletionQueue &deletion_queue)
+    : m_device{&device},
+      m_deletion_queue{&deletion_queue},
+      m_memory_properties{physical_device.getMemoryProperties()},
+      m_buffers{},
+      m_images{},
+      m_samplers{},
+      m_pipelines{},
+      m_destroy_listeners{}
+{}
+
+vgraphplay::gfx::Resources::~Resources() {}
+
+vgraphplay::gfx::BufferHandle vgraphplay::gfx::Resources::createBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags mem_props) {
+    vk::BufferCreateInfo buffer_ci{
+        .size = size,
+        .usage = usage,
+        .sharingMode = vk::SharingMode::eExclusive,
+    };
+
+    vk::raii::Buffer buffer{*m_device, buffer_ci, HostAllocator::callbacks()};
+    vk::raii::DeviceMemory memory = allocate(buffer.getMemoryRequirements(), mem_props);
+    buffer.bindMemory(*memory, 0);
+
+    void *mapped = nullptr;
+    if (mem_props & vk::MemoryPropertyFlagBits::eHostVisible) {
+        mapped = memory.mapMemory(0, size);
+    }
+
+    BufferHandle handle = m_buffers.insert(std::move(buffer), std::move(memory), BufferInfo{size, usage, mapped});
+    VGRAPHPLAY_LOG(trace, "Created buffer {}/{} ({} bytes)", handle.index, handle.generation, size);
+    return handle;
+}
+
+void vgraphplay::gfx::Resources::destroyBuffer(BufferHandle handle, uint64_t point) {
+    auto [buffer, memory, info] = m_buffers.erase(handle);
+    destroyed(reinterpret_cast<uint64_t>(static_cast<VkBuffer>(*buffer)));
+    m_deletion_queue->retire(std::move(buffer), point);
+    m_deletion_queue->retire(std::move(memory), point);
+}
+
+vgraphplay::gfx::ImageHandle vgraphplay::gfx::Resources::createImage(const vk::ImageCreateInfo &image_ci, vk::ImageAspectFlags aspect, vk::MemoryPropertyFlags mem_props) {
+    vk::raii::Image image{*m_device, image_ci, HostAllocator::callbacks()};
+    vk::raii::DeviceMemory memory = allocate(image.getMemoryRequirements(), mem_props);
+    image.bindMemory(*memory, 0);
+
+    vk::ImageViewType view_type = vk::ImageViewType::e2D;
+    if (image_ci.imageType == vk::ImageType::e3D) {
+        view_type = vk::ImageViewType::e3D;
+    } else if (image_ci.arrayLayers > 1) {
+        view_type = vk::ImageViewType::e2DArray;
+    }
+
+    vk::ImageViewCreateInfo view_ci{
+        .image = *image,
+        .viewType = view_type,
+        .format = image_ci.format,
+        .subresourceRange = {
+            .aspectMask = aspect,
+            .baseMipLevel = 0,
+            .levelCount = image_ci.mipLevels,
+            .baseArrayLayer = 0,
+            .layerCount = image_ci.arrayLayers,
+        },
+    };
+    vk::raii::ImageView view{*m_device, view_ci, HostAllocator::callbacks()};
+
+    ImageInfo info{image_ci.format, image_ci.extent, image_ci.mipLevels, image_ci.arrayLayers};
+    ImageHandle handle = m_images.insert(std::move(image), std::move(memory), std::move(view), info);
+    VGRAPHPLAY_LOG(trace, "Created image {}/{} ({}x{} {})", handle.index, handle.generation,
+                   image_ci.extent.width, image_ci.extent.height, image_ci.format);
+    return handle;
+}
+
+void vgraphplay::gfx::Resources::destroyImage(ImageHandle handle, uint64_t point) {
+    auto [image, memory, view, info] = m_images.erase(handle);
+    destroyed(reinterpret_cast<uint64_t>(static_cast<VkImageView>(*view)));
+    m_deletion_queue->retire(std::move(view), point);
+    m_deletion_queue->retire(std::move(image), point);
+    m_deletion_queue->retire(std::move(memory), point);
+}
+
+vgraphplay::gfx::SamplerHandle vgraphplay::gfx::Resources::createSampler(const vk::SamplerCreateInfo &sampler_ci) {
+    return m_samplers.insert(vk::raii::Sampler{*m_device, sampler_ci, HostAllocator::callbacks()});
+}
+
+void vgraphplay::gfx::Resources::destroySampler(SamplerHandle handle, uint64_t point) {
+    auto [sampler] = m_samplers.erase(handle);
+    destroyed(reinterpret_cast<uint64_t>(static_cast<VkSampler>(*sampler)));
+    m_deletion_queue->retire(std::move(sampler), point);
+}
+
+vgraphplay::gfx::PipelineHandle vgraphplay::gfx::Resources::addPipeline(vk::raii::Pipeline &&pipeline, vk::PipelineLayout layout, vk::PipelineBindPoint bind_point) {
+    return m_pipelines.insert(std::move(pipeline), PipelineInfo{layout, bind_point});
+}
+
+void vgraphplay::gfx::Resources::destroyPipeline(PipelineHandle handle, uint64_t point) {
+    auto [pipeline, info] = m_pipelines.erase(handle);
+    m_deletion_queue->retire(std::move(pipeline), point);
+}
+
+uint32_t vgraphplay::gfx::Resources::chooseMemoryTypeIndex(uint32_t type_filter, vk::MemoryPropertyFlags mem_props) const {
+    for (uint32_t i = 0; i < m_memory_properties.memoryTypeCount; ++i) {
+        if ((type_filter & (1 << i)) && (m_memory_properties.memoryTypes[i].propertyFlags & mem_props) == mem_props) {
+            return i;
+        }
+    }
+
+    throw std::runtime_error("No suitable memory type for " + vk::to_string(mem_props));
+}
+
+vk::raii::DeviceMemory vgraphplay::gfx::Resources::allocate(const vk::MemoryRequirements &reqs, vk::MemoryPropertyFlags mem_props) {
+    vk::MemoryAllocateInfo alloc_info{
+        .allocationSize = reqs.size,
+        .memoryTypeIndex = chooseMemoryTypeIndex(reqs.memoryTypeBits, mem_props),
+    };
+    return vk::raii::DeviceMemory{*m_device, alloc_info, HostAllocator::callbacks()};
+}
+
+void vgraphplay::gfx::Resources::onDestroy(std::function<void(uint64_t)> listener) {
+    m_destroy_listeners.push_back(std::move(listener));
+}
+
+void vgraphplay::gfx::Resources::destroyed(uint64_t object) {
+    for (const auto &listener : m_destroy_listeners) {
+        listener(object);
+    }
+}
@@ -0,0 +1,112 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_GFX_RESOURCES_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_GFX_RESOURCES_H_
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "../vulkan.h"
+
+#include "DeletionQueue.h"
+#include "Handle.h"
+#include "ResourcePool.h"
+
+namespace vgraphplay {
+    namespace gfx {
+        struct BufferInfo {
+            vk::DeviceSize size;
+            vk::BufferUsageFlags usage;
+            void *mapped; // Persistently mapped if host visible, else null.
+        };
+
+        struct ImageInfo {
+            vk::Format format;
+            vk::Extent3D extent;
+            uint32_t mip_levels;
+            uint32_t array_layers;
+        };
+
+        struct PipelineInfo {
+            vk::PipelineLayout layout; // Not owned; layouts are shared.
+            vk::PipelineBindPoint bind_point;
+        };
+
+        using BufferPool = ResourcePool<BufferTag, vk::raii::Buffer, vk::raii::DeviceMemory, BufferInfo>;
+        using ImagePool = ResourcePool<ImageTag, vk::raii::Image, vk::raii::DeviceMemory, vk::raii::ImageView, ImageInfo>;
+        using SamplerPool = ResourcePool<SamplerTag, vk::raii::Sampler>;
+        using PipelinePool = ResourcePool<PipelineTag, vk::raii::Pipeline, PipelineInfo>;
+
+        // Owns the renderer's buffers, images, samplers and pipelines, handed
+        // out as generational handles rather than named members. Destroying
+        // a resource frees its handle immediately and retires the Vulkan
+        // objects into the deletion queue, so the GPU may keep using them
+        // until the given timeline point, or by default until the next
+        // submission, finishes.
+        class Resources {
+        public:
+            Resources(std::nullptr_t);
+            Resources(const vk::raii::PhysicalDevice &physical_device, const vk::raii::Device &device, DeletionQueue &deletion_queue);
+            ~Resources();
+
+            Resources(const Resources &) = delete;
+            Resources &operator=(const Resources &) = delete;
+            Resources(Resources &&) = default;
+            Resources &operator=(Resources &&) = default;
+
+            BufferHandle createBuffer(vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags mem_props);
+            void destroyBuffer(BufferHandle handle) { destroyBuffer(handle, m_deletion_queue->nextPoint()); }
+            void destroyBuffer(BufferHandle handle, uint64_t point);
+            vk::Buffer buffer(BufferHandle handle) const { return *m_buffers.get<vk::raii::Buffer>(handle); }
+            const BufferInfo &bufferInfo(BufferHandle handle) const { return m_buffers.get<BufferInfo>(handle); }
+
+            ImageHandle createImage(const vk::ImageCreateInfo &image_ci, vk::ImageAspectFlags aspect, vk::MemoryPropertyFlags mem_props = vk::MemoryPropertyFlagBits::eDeviceLocal);
+            void destroyImage(ImageHandle handle) { destroyImage(handle, m_deletion_queue->nextPoint()); }
+            void destroyImage(ImageHandle handle, uint64_t point);
+            vk::Image image(ImageHandle handle) const { return *m_images.get<vk::raii::Image>(handle); }
+            vk::ImageView imageView(ImageHandle handle) const { return *m_images.get<vk::raii::ImageView>(handle); }
+            const ImageInfo &imageInfo(ImageHandle handle) const { return m_images.get<ImageInfo>(handle); }
+
+            SamplerHandle createSampler(const vk::SamplerCreateInfo &sampler_ci);
+            void destroySampler(SamplerHandle handle) { destroySampler(handle, m_deletion_queue->nextPoint()); }
+            void destroySampler(SamplerHandle handle, uint64_t point);
+            vk::Sampler sampler(SamplerHandle handle) const { return *m_samplers.get<vk::raii::Sampler>(handle); }
+
+            PipelineHandle addPipeline(vk::raii::Pipeline &&pipeline, vk::PipelineLayout layout, vk::PipelineBindPoint bind_point = vk::PipelineBindPoint::eGraphics);
+            void destroyPipeline(PipelineHandle handle) { destroyPipeline(handle, m_deletion_queue->nextPoint()); }
+            void destroyPipeline(PipelineHandle handle, uint64_t point);
+            vk::Pipeline pipeline(PipelineHandle handle) const { return *m_pipelines.get<vk::raii::Pipeline>(handle); }
+            const PipelineInfo &pipelineInfo(PipelineHandle handle) const { return m_pipelines.get<PipelineInfo>(handle); }
+
+            bool contains(BufferHandle handle) const { return m_buffers.contains(handle); }
+            bool contains(ImageHandle handle) const { return m_images.contains(handle); }
+            bool contains(SamplerHandle handle) const { return m_samplers.contains(handle); }
+            bool contains(PipelineHandle handle) const { return m_pipelines.contains(handle); }
+
+            uint32_t chooseMemoryTypeIndex(uint32_t type_filter, vk::MemoryPropertyFlags mem_props) const;
+
+            // Called with the raw handle of each buffer, image view and
+            // sampler as it's destroyed, so anything keyed on those handles
+            // (e.g. cached descriptor sets) can drop its entries before the
+            // handle is reused.
+            void onDestroy(std::function<void(uint64_t)> listener);
+
+        private:
+            vk::raii::DeviceMemory allocate(const vk::MemoryRequirements &reqs, vk::MemoryPropertyFlags mem_props);
+            void destroyed(uint64_t object);
+
+            const vk::raii::Device *m_device;
+            DeletionQueue *m_deletion_queue;
+            vk::PhysicalDeviceMemoryProperties m_memory_properties;
+
+            BufferPool m_buffers;
+            ImagePool m_images;
+            SamplerPool m_samplers;
+            PipelinePool m_pipelines;
+            std::vector<std::function<void(uint64_t)>> m_destroy_listeners;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,549 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include "ShaderReflection.h"
+
+// The handful of SPIR-V enumerants reflection cares about, from the SPIR-V
+// specification. (spirv.hpp isn't part of every Vulkan SDK install.)
+namespace spv {
+    const uint32_t MAGIC = 0x07230203;
+
+    enum Op : uint32_t {
+        OpName = 5,
+        OpEntryPoint = 15,
+        OpTypeVoid = 19,
+        OpTypeBool = 20,
+        OpTypeInt = 21,
+        OpTypeFloat = 22,
+        OpTypeVector = 23,
+        OpTypeMatrix = 24,
+        OpTypeImage = 25,
+        OpTypeSampler = 26,
+        OpTypeSampledImage = 27,
+        OpTypeArray = 28,
+        OpTypeRuntimeArray = 29,
+        OpTypeStruct = 30,
+        OpTypePointer = 32,
+        OpConstant = 43,
+        OpSpecConstantTrue = 48,
+        OpSpecConstantFalse = 49,
+        OpSpecConstant = 50,
+        OpVariable = 59,
+        OpDecorate = 71,
+        OpMemberDecorate = 72,
+        OpTypeAccelerationStructureKHR = 5341,
+    };
+
+    enum Decoration : uint32_t {
+        DecorationSpecId = 1,
+        DecorationBlock = 2,
+        DecorationBufferBlock = 3,
+        DecorationArrayStride = 6,
+        DecorationMatrixStride = 7,
+        DecorationBuiltIn = 11,
+        DecorationLocation = 30,
+        DecorationBinding = 33,
+        DecorationDescriptorSet = 34,
+        DecorationOffset = 35,
+    };
+
+    enum StorageClass : uint32_t {
+        StorageClassUniformConstant = 0,
+        StorageClassInput = 1,
+        StorageClassUniform = 2,
+        StorageClassPushConstant = 9,
+        StorageClassStorageBuffer = 12,
+    };
+
+    enum ExecutionModel : uint32_t {
+        ExecutionModelVertex = 0,
+        ExecutionModelTessellationControl = 1,
+        ExecutionModelTessellationEvaluation = 2,
+        ExecutionModelGeometry = 3,
+        ExecutionModelFragment = 4,
+        ExecutionModelGLCompute = 5,
+    };
+
+    const uint32_t DimBuffer = 5;
+    const uint32_t DimSubpassData = 6;
+}
+
+namespace {
+    const uint32_t NONE = UINT32_MAX;
+
+    struct Decorations {
+        uint32_t set = NONE;
+        uint32_t binding = NONE;
+        uint32_t location = NONE;
+        uint32_t spec_id = NONE;
+        uint32_t array_stride = 0;
+        bool block = false;
+        bool buffer_block = false;
+        bool builtin = false;
+    };
+
+    struct MemberDecorations {
+        uint32_t offset = 0;
+        uint32_t matrix_stride = 0;
+    };
+
+    struct Variable {
+        uint32_t id;
+        uint32_t type;
+        uint32_t storage;
+    };
+
+    // The module, indexed by result id. Types are kept as their operand
+    // words following the result id.
+    class Module {
+    public:
+        explicit Module(const Resource &spirv);
+
+        vk::ShaderStageFlagBits stage() const;
+        const std::string &entryPoint() const { return m_entry_point; }
+        const std::vector<Variable> &variables() const { return m_variables; }
+        bool isInterface(uint32_t id) const { return std::ranges::find(m_interface, id) != m_interface.end(); }
+
+        std::string name(uint32_t id) const;
+        const Decorations &decorations(uint32_t id) const;
+        const std::vector<uint32_t> &type(uint32_t id) const;
+        uint32_t constant(uint32_t id) const;
+
+        uint32_t pointee(uint32_t pointer_type) const;
+        uint32_t size(uint32_t type_id, uint32_t matrix_stride = 0) const;
+        const std::vector<uint32_t> &specConstantIds() const { return m_spec_constants; }
+        const MemberDecorations &memberDecorations(uint32_t id, uint32_t member) const;
+
+    private:
+        static std::string readString(const uint32_t *words, size_t count);
+
+        uint32_t m_execution_model;
+        std::string m_entry_point;
+        std::vector<uint32_t> m_interface;
+
+        std::unordered_map<uint32_t, std::string> m_names;
+        std::unordered_map<uint32_t, Decorations> m_decorations;
+        std::unordered_map<uint64_t, MemberDecorations> m_member_decorations;
+        std::unordered_map<uint32_t, std::vector<uint32_t>> m_types;
+        std::unordered_map<uint32_t, uint32_t> m_constants;
+        std::vector<Variable> m_variables;
+        std::vector<uint32_t> m_spec_constants;
+    };
+
+    uint64_t memberKey(uint32_t id, uint32_t member) {
+        return (static_cast<uint64_t>(id) << 32) | member;
+    }
+}
+
+Module::Module(const Resource &spirv)
+    : m_execution_model{NONE},
+      m_entry_point{},
+      m_interface{}
+{
+    if (spirv.size() % 4 != 0 || spirv.size() < 20) {
+        throw std::runtime_error("SPIR-V module is truncated");
+    }
+
+    std::vector<uint32_t> words(spirv.size() / 4);
+    std::memcpy(words.data(), spirv.data(), spirv.size());
+    if (words[0] != spv::MAGIC) {
+        throw std::runtime_error("Not a SPIR-V module");
+    }
+
+    for (size_t i = 5; i < words.size(); ) {
+        const uint32_t op = words[i] & 0xffff;
+        const uint32_t count = words[i] >> 16;
+        if (count == 0 || i + count > words.size()) {
+            throw std::runtime_error("SPIR-V instruction at word " + std::to_string(i) + " is truncated");
+        }
+
+        const uint32_t *operands = &words[i + 1];
+        const size_t num_operands = count - 1;
+
+        switch (op) {
+        case spv::OpName:
+            m_names[operands[0]] = readString(operands + 1, num_operands - 1);
+            break;
+
+        case spv::OpEntryPoint:
+            if (m_execution_model == NONE) {
+                m_execution_model = operands[0];
+                m_entry_point = readString(operands + 2, num_operands - 2);
+                // Interface ids follow the nul-terminated, word-padded name.
+                size_t name_words = m_entry_point.size() / 4 + 1;
+                m_interface.assign(operands + 2 + name_words, operands + num_operands);
+            }
+            break;
+
+        case spv::OpDecorate: {
+            Decorations &d = m_decorations[operands[0]];
+            switch (operands[1]) {
+            case spv::DecorationSpecId: d.spec_id = operands[2]; break;
+            case spv::DecorationBlock: d.block = true; break;
+            case spv::DecorationBufferBlock: d.buffer_block = true; break;
+            case spv::DecorationArrayStride: d.array_stride = operands[2]; break;
+            case spv::DecorationBuiltIn: d.builtin = true; break;
+            case spv::DecorationLocation: d.location = operands[2]; break;
+            case spv::DecorationBinding: d.binding = operands[2]; break;
+            case spv::DecorationDescriptorSet: d.set = operands[2]; break;
+            }
+            break;
+        }
+
+        case spv::OpMemberDecorate: {
+            MemberDecorations &d = m_member_decorations[memberKey(operands[0], operands[1])];
+            switch (operands[2]) {
+            case spv::DecorationOffset: d.offset = operands[3]; break;
+            case spv::DecorationMatrixStride: d.matrix_stride = operands[3]; break;
+            }
+            break;
+        }
+
+        case spv::OpTypeVoid:
+        case spv::OpTypeBool:
+        case spv::OpTypeInt:
+        case spv::OpTypeFloat:
+        case spv::OpTypeVector:
+        case spv::OpTypeMatrix:
+        case spv::OpTypeImage:
+        case spv::OpTypeSampler:
+        case spv::OpTypeSampledImage:
+        case spv::OpTypeArray:
+        case spv::OpTypeRuntimeArray:
+        case spv::OpTypeStruct:
+        case spv::OpTypePointer:
+        case spv::OpTypeAccelerationStructureKHR: {
+            std::vector<uint32_t> &t = m_types[operands[0]];
+            t.push_back(op);
+            t.insert(t.end(), operands + 1, operands + num_operands);
+            break;
+        }
+
+        case spv::OpConstant:
+        case spv::OpSpecConstant:
+            m_constants[operands[1]] = operands[2];
+            if (op == spv::OpSpecConstant) {
+                m_spec_constants.push_back(operands[1]);
+            }
+            break;
+
+        case spv::OpSpecConstantTrue:
+        case spv::OpSpecConstantFalse:
+            m_constants[operands[1]] = op == spv::OpSpecConstantTrue ? 1 : 0;
+            m_spec_constants.push_back(operands[1]);
+            break;
+
+        case spv::OpVariable:
+            m_variables.push_back(Variable{operands[1], operands[0], operands[2]});
+            break;
+        }
+
+        i += count;
+    }
+
+    if (m_execution_model == NONE) {
+        throw std::runtime_error("SPIR-V module has no entry point");
+    }
+}
+
+vk::ShaderStageFlagBits Module::stage() const {
+    switch (m_execution_model) {
+    case spv::ExecutionModelVertex: return vk::ShaderStageFlagBits::eVertex;
+    case spv::ExecutionModelTessellationControl: return vk::ShaderStageFlagBits::eTessellationControl;
+    case spv::ExecutionModelTessellationEvaluation: return vk::ShaderStageFlagBits::eTessellationEvaluation;
+    case spv::ExecutionModelGeometry: return vk::ShaderStageFlagBits::eGeometry;
+    case spv::ExecutionModelFragment: return vk::ShaderStageFlagBits::eFragment;
+    case spv::ExecutionModelGLCompute: return vk::ShaderStageFlagBits::eCompute;
+    }
+    throw std::runtime_error("Unsupported SPIR-V execution model " + std::to_string(m_execution_model));
+}
+
+std::string Module::name(uint32_t id) const {
+    auto it = m_names.find(id);
+    return it == m_names.end() ? std::string{} : it->second;
+}
+
+const Decorations &Module::decorations(uint32_t id) const {
+    static const Decorations none{};
+    auto it = m_decorations.find(id);
+    return it == m_decorations.end() ? none : it->second;
+}
+
+const MemberDecorations &Module::memberDecorations(uint32_t id, uint32_t member) const {
+    static const MemberDecorations none{};
+    auto it = m_member_decorations.find(memberKey(id, member));
+    return it == m_member_decorations.end() ? none : it->second;
+}
+
+const std::vector<uint32_t> &Module::type(uint32_t id) const {
+    auto it = m_types.find(id);
+    if (it == m_types.end()) {
+        throw std::runtime_error("SPIR-V type %" + std::to_string(id) + " is not defined");
+    }
+    return it->second;
+}
+
+uint32_t Module::constant(uint32_t id) const {
+    auto it = m_constants.find(id);
+    if (it == m_constants.end()) {
+        throw std::runtime_error("SPIR-V constant %" + std::to_string(id) + " is not defined");
+    }
+    return it->second;
+}
+
+uint32_t Module::pointee(uint32_t pointer_type) const {
+    const std::vector<uint32_t> &t = type(pointer_type);
+    if (t[0] != spv::OpTypePointer) {
+        throw std::runtime_error("SPIR-V variable type %" + std::to_string(pointer_type) + " is not a pointer");
+    }
+    return t[2];
+}
+
+// Byte size of a type as laid out in a block (explicit offsets and strides
+// win; otherwise tightly packed).
+uint32_t Module::size(uint32_t type_id, uint32_t matrix_stride) const {
+    const std::vector<uint32_t> &t = type(type_id);
+
+    switch (t[0]) {
+    case spv::OpTypeBool:
+        return 4;
+    case spv::OpTypeInt:
+    case spv::OpTypeFloat:
+        return t[1] / 8;
+    case spv::OpTypeVector:
+        return t[2] * size(t[1]);
+    case spv::OpTypeMatrix:
+        return t[2] * (matrix_stride != 0 ? matrix_stride : size(t[1]));
+    case spv::OpTypeArray: {
+        uint32_t stride = decorations(type_id).array_stride;
+        return constant(t[2]) * (stride != 0 ? stride : size(t[1], matrix_stride));
+    }
+    case spv::OpTypeRuntimeArray:
+        return 0;
+    case spv::OpTypeStruct: {
+        uint32_t end = 0;
+        for (uint32_t m = 0; m + 1 < t.size(); ++m) {
+            const MemberDecorations &md = memberDecorations(type_id, m);
+            end = std::max(end, md.offset + size(t[m + 1], md.matrix_stride));
+        }
+        return end;
+    }
+    }
+
+    throw std::runtime_error("Cannot size SPIR-V type %" + std::to_string(type_id));
+}
+
+std::string Module::readString(const uint32_t *words, size_t count) {
+    const char *chars = reinterpret_cast<const char *>(words);
+    return std::string{chars, strnlen(chars, count * 4)};
+}
+
+static vk::DescriptorType descriptorType(const Module &module, const Variable &var, uint32_t type_id) {
+    const std::vector<uint32_t> &t = module.type(type_id);
+
+    switch (var.storage) {
+    case spv::StorageClassUniformConstant:
+        switch (t[0]) {
+        case spv::OpTypeSampledImage:
+            return vk::DescriptorType::eCombinedImageSampler;
+        case spv::OpTypeSampler:
+            return vk::DescriptorType::eSampler;
+        case spv::OpTypeAccelerationStructureKHR:
+            return vk::DescriptorType::eAccelerationStructureKHR;
+        case spv::OpTypeImage: {
+            // Operands: sampled type, dim, depth, arrayed, ms, sampled, format.
+            uint32_t dim = t[2], sampled = t[6];
+            if (dim == spv::DimBuffer) {
+                return sampled == 2 ? vk::DescriptorType::eStorageTexelBuffer : vk::DescriptorType::eUniformTexelBuffer;
+            } else if (dim == spv::DimSubpassData) {
+                return vk::DescriptorType::eInputAttachment;
+            }
+            return sampled == 2 ? vk::DescriptorType::eStorageImage : vk::DescriptorType::eSampledImage;
+        }
+        }
+        break;
+
+    case spv::StorageClassUniform:
+        return module.decorations(type_id).buffer_block ? vk::DescriptorType::eStorageBuffer : vk::DescriptorType::eUniformBuffer;
+
+    case spv::StorageClassStorageBuffer:
+        return vk::DescriptorType::eStorageBuffer;
+    }
+
+    throw std::runtime_error("Unsupported descriptor type for shader variable " + module.name(var.id));
+}
+
+static vk::Format vertexFormat(const Module &module, uint32_t type_id, uint32_t &size) {
+    const std::vector<uint32_t> &t = module.type(type_id);
+    uint32_t components = 1;
+    uint32_t scalar_id = type_id;
+
+    if (t[0] == spv::OpTypeVector) {
+        scalar_id = t[1];
+        components = t[2];
+    }
+
+    const std::vector<uint32_t> &scalar = module.type(scalar_id);
+    if ((scalar[0] != spv::OpTypeFloat && scalar[0] != spv::OpTypeInt) || scalar[1] != 32 || components > 4) {
+        throw std::runtime_error("Unsupported vertex input type %" + std::to_string(type_id));
+    }
+
+    static const vk::Format FLOAT_FORMATS[] = {vk::Format::eR32Sfloat, vk::Format::eR32G32Sfloat, vk::Format::eR32G32B32Sfloat, vk::Format::eR32G32B32A32Sfloat};
+    static const vk::Format SINT_FORMATS[] = {vk::Format::eR32Sint, vk::Format::eR32G32Sint, vk::Format::eR32G32B32Sint, vk::Format::eR32G32B32A32Sint};
+    static const vk::Format UINT_FORMATS[] = {vk::Format::eR32Uint, vk::Format::eR32G32Uint, vk::Format::eR32G32B32Uint, vk::Format::eR32G32B32A32Uint};
+
+    size = 4 * components;
+    if (scalar[0] == spv::OpTypeFloat) {
+        return FLOAT_FORMATS[components - 1];
+    }
+    return scalar[2] ? SINT_FORMATS[components - 1] : UINT_FORMATS[components - 1];
+}
+
+vgraphplay::gfx::ShaderReflection vgraphplay::gfx::reflectShader(const Resource &spirv) {
+    Module module{spirv};
+
+    ShaderReflection result{
+        .stage = module.stage(),
+        .entry_point = module.entryPoint(),
+        .bindings = {},
+        .push_constants = {},
+        .vertex_inputs = {},
+        .spec_constants = {},
+    };
+
+    for (const Variable &var : module.variables()) {
+        const Decorations &decorations = module.decorations(var.id);
+
+        if (var.storage == spv::StorageClassPushConstant) {
+            uint32_t type_id = module.pointee(var.type);
+            const std::vector<uint32_t> &t = module.type(type_id);
+            uint32_t begin = UINT32_MAX;
+            for (uint32_t m = 0; m + 1 < t.size(); ++m) {
+                begin = std::min(begin, module.memberDecorations(type_id, m).offset);
+            }
+            if (begin == UINT32_MAX) {
+                begin = 0;
+            }
+            result.push_constants.push_back(vk::PushConstantRange{
+                .stageFlags = result.stage,
+                .offset = begin,
+                .size = module.size(type_id) - begin,
+            });
+        } else if (var.storage == spv::StorageClassInput) {
+            if (result.stage != vk::ShaderStageFlagBits::eVertex || decorations.builtin || decorations.location == NONE ||
+                !module.isInterface(var.id)) {
+                continue;
+            }
+            uint32_t size = 0;
+            vk::Format format = vertexFormat(module, module.pointee(var.type), size);
+            result.vertex_inputs.push_back(ReflectedVertexInput{decorations.location, format, size, module.name(var.id)});
+        } else if (decorations.binding != NONE) {
+            uint32_t type_id = module.pointee(var.type);
+            uint32_t count = 1;
+
+            // Arrays of descriptors; runtime arrays are left unsized (0).
+            for (;;) {
+                const std::vector<uint32_t> &t = module.type(type_id);
+                if (t[0] == spv::OpTypeArray) {
+                    count *= module.constant(t[2]);
+                    type_id = t[1];
+                } else if (t[0] == spv::OpTypeRuntimeArray) {
+                    count = 0;
+                    type_id = t[1];
+                } else {
+                    break;
+                }
+            }
+
+            std::string name = module.name(var.id);
+            if (name.empty()) {
+                name = module.name(type_id);
+            }
+
+            result.bindings.push_back(ReflectedBinding{
+                .set = decorations.set == NONE ? 0 : decorations.set,
+                .binding = decorations.binding,
+                .type = descriptorType(module, var, type_id),
+                .count = count,
+                .stages = result.stage,
+                .name = name,
+            });
+        }
+    }
+
+    for (uint32_t id : module.specConstantIds()) {
+        const Decorations &decorations = module.decorations(id);
+        if (decorations.spec_id != NONE) {
+            result.spec_constants.push_back(ReflectedSpecConstant{decorations.spec_id, 4, module.name(id)});
+        }
+    }
+
+    std::ranges::sort(result.bindings, {}, [](const ReflectedBinding &b) { return std::pair{b.set, b.binding}; });
+    std::ranges::sort(result.vertex_inputs, {}, &ReflectedVertexInput::location);
+    std::ranges::sort(result.spec_constants, {}, &ReflectedSpecConstant::id);
+    return result;
+}
+
+vgraphplay::gfx::PipelineInterface vgraphplay::gfx::mergeReflections(std::span<const ShaderReflection> stages) {
+    PipelineInterface iface;
+
+    for (const ShaderReflection &stage : stages) {
+        for (const ReflectedBinding &binding : stage.bindings) {
+            std::vector<ReflectedBinding> &set = iface.sets[binding.set];
+            auto existing = std::ranges::find(set, binding.binding, &ReflectedBinding::binding);
+
+            if (existing == set.end()) {
+                set.push_back(binding);
+            } else if (existing->type != binding.type || existing->count != binding.count) {
+                throw std::runtime_error("Shader stages disagree about set " + std::to_string(binding.set) +
+                                         " binding " + std::to_string(binding.binding));
+            } else {
+                existing->stages |= binding.stages;
+            }
+        }
+
+        for (const vk::PushConstantRange &range : stage.push_constants) {
+            auto existing = std::ranges::find_if(iface.push_constants, [&range](const vk::PushConstantRange &r) {
+                return r.offset == range.offset && r.size == range.size;
+            });
+
+            if (existing == iface.push_constants.end()) {
+                iface.push_constants.push_back(range);
+            } else {
+                existing->stageFlags |= range.stageFlags;
+            }
+        }
+
+        if (stage.stage == vk::ShaderStageFlagBits::eVertex) {
+            iface.vertex_inputs = stage.vertex_inputs;
+        }
+    }
+
+    for (auto &[set, bindings] : iface.sets) {
+        std::ranges::sort(bindings, {}, &ReflectedBinding::binding);
+    }
+
+    return iface;
+}
+
+std::vector<vk::VertexInputAttributeDescription> vgraphplay::gfx::vertexAttributes(const PipelineInterface &iface, uint32_t binding, uint32_t &stride) {
+    std::vector<vk::VertexInputAttributeDescription> attributes;
+    stride = 0;
+
+    for (const ReflectedVertexInput &input : iface.vertex_inputs) {
+        attributes.push_back(vk::VertexInputAttributeDescription{
+            .location = input.location,
+            .binding = binding,
+            .format = input.format,
+            .offset = stride,
+        });
+        stride += input.size;
+    }
+
+    return attributes;
+}
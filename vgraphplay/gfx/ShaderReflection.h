@@ -0,0 +1,73 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_GFX_SHADER_REFLECTION_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_GFX_SHADER_REFLECTION_H_
+
+#include <cstdint>
+#include <map>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "../vulkan.h"
+
+#include "Resource.h"
+
+namespace vgraphplay {
+    namespace gfx {
+        struct ReflectedBinding {
+            uint32_t set;
+            uint32_t binding;
+            vk::DescriptorType type;
+            uint32_t count; // 0 for a runtime-sized array.
+            vk::ShaderStageFlags stages;
+            std::string name;
+        };
+
+        struct ReflectedVertexInput {
+            uint32_t location;
+            vk::Format format;
+            uint32_t size;
+            std::string name;
+        };
+
+        struct ReflectedSpecConstant {
+            uint32_t id;
+            uint32_t size;
+            std::string name;
+        };
+
+        // What a pipeline needs to know about one shader stage, read
+        // straight from its SPIR-V.
+        struct ShaderReflection {
+            vk::ShaderStageFlagBits stage;
+            std::string entry_point;
+            std::vector<ReflectedBinding> bindings;
+            std::vector<vk::PushConstantRange> push_constants;
+            std::vector<ReflectedVertexInput> vertex_inputs; // Vertex shaders only, by location.
+            std::vector<ReflectedSpecConstant> spec_constants;
+        };
+
+        // Parses the SPIR-V module (first entry point only). Throws
+        // std::runtime_error if it isn't valid SPIR-V or uses a descriptor
+        // type this doesn't know.
+        ShaderReflection reflectShader(const Resource &spirv);
+
+        // The interface of a whole pipeline: every stage's bindings merged
+        // per set (stage flags OR-ed together), and its push constant
+        // ranges.
+        struct PipelineInterface {
+            std::map<uint32_t, std::vector<ReflectedBinding>> sets;
+            std::vector<vk::PushConstantRange> push_constants;
+            std::vector<ReflectedVertexInput> vertex_inputs;
+        };
+
+        PipelineInterface mergeReflections(std::span<const ShaderReflection> stages);
+
+        // Vertex attributes for the reflected inputs, tightly packed in
+        // location order in a single binding, and that binding's stride.
+        std::vector<vk::VertexInputAttributeDescription> vertexAttributes(const PipelineInterface &iface, uint32_t binding, uint32_t &stride);
+    }
+}
+
+#endif
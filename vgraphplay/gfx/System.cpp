@@ -1,8 +1,14 @@
 // -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
 
-// #include <chrono>
-// #include <set>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
 #include <format>
+#include <limits>
+#include <optional>
+// #include <set>
 #include <vector>
 
 #include <boost/log/trivial.hpp>
@@ -11,23 +17,32 @@
 // #include <glm/glm.hpp>
 // #include <glm/gtc/matrix_transform.hpp>
 
-// #define STB_IMAGE_IMPLEMENTATION
-// #include <stb_image.h>
-
 #include "../vulkan.h"
 
+#include "ApiStats.h"
+#include "DeviceBenchmark.h"
+#include "EmbeddedResources.h"
+#include "HostAllocator.h"
 #include "System.h"
+#include "Texture.h"
+#include "../Log.h"
+#include "../PhaseTimer.h"
 #include "../VulkanOutput.h"
 
 bool hasExtension(std::vector<vk::ExtensionProperties> &all_extensions, const char *extension_name);
 bool hasLayer(std::vector<vk::LayerProperties> &all_layers, const char *layer_name);
 std::vector<const char *> buildInstanceExtensionList(vk::raii::Context &context, bool debug);
 std::vector<const char *> buildInstanceLayerList(vk::raii::Context &context, bool debug);
+bool deviceMatches(const std::string &selector, size_t index, const char *name);
 
-const Resource UNLIT_VERT_BYTECODE = LOAD_RESOURCE(unlit_vert_spv);
-const Resource UNLIT_FRAG_BYTECODE = LOAD_RESOURCE(unlit_frag_spv);
-
-const Resource WARREN_TEXTURE = LOAD_RESOURCE(warren_jpg);
+// Looked up at compile time, so a renamed or missing shader fails the build.
+constexpr Resource UNLIT_VERT_BYTECODE = EMBEDDED_RESOURCES.at("shaders/unlit.vert.spv").resource();
+constexpr Resource UNLIT_FRAG_BYTECODE = EMBEDDED_RESOURCES.at("shaders/unlit.frag.spv").resource();
+constexpr Resource UNLIT_BINDLESS_VERT_BYTECODE = EMBEDDED_RESOURCES.at("shaders/unlit_bindless.vert.spv").resource();
+constexpr Resource UNLIT_BINDLESS_FRAG_BYTECODE = EMBEDDED_RESOURCES.at("shaders/unlit_bindless.frag.spv").resource();
+constexpr Resource UNLIT_PUSH_VERT_BYTECODE = EMBEDDED_RESOURCES.at("shaders/unlit_push.vert.spv").resource();
+constexpr Resource UNLIT_INSTANCED_VERT_BYTECODE = EMBEDDED_RESOURCES.at("shaders/unlit_instanced.vert.spv").resource();
+constexpr Resource DEPTH_INSTANCED_VERT_BYTECODE = EMBEDDED_RESOURCES.at("shaders/depth_instanced.vert.spv").resource();
 
 const uint16_t NUM_RECTANGLE_VERTICES = 8;
 const vgraphplay::gfx::Vertex RECTANGLE_VERTICES[NUM_RECTANGLE_VERTICES] = {
@@ -48,179 +63,158 @@ const uint16_t RECTANGLE_INDICES[NUM_RECTANGLE_INDICES] = {
     4, 5, 6, 6, 7, 4,
 };
 
+// Cooked into the asset pack by the build; see cook_textures in
+// CMakeLists.txt.
+constexpr std::string_view TEXTURE_ASSET = "textures/warren.jpg.vtex";
+
+// unifTexture in shaders/unlit.frag. Binding 0 is the camera.
+constexpr uint32_t TEXTURE_BINDING = 1;
+
 static VKAPI_ATTR vk::Bool32 VKAPI_CALL handleDebugMessage(
     vk::DebugUtilsMessageSeverityFlagBitsEXT severity,
     vk::DebugUtilsMessageTypeFlagsEXT type,
     const vk::DebugUtilsMessengerCallbackDataEXT *pCallbackData,
     void *pUserData
 ) {
-    std::string msg = std::format("Vulkan debug message: type: {} msg: {}", to_string(type), pCallbackData->pMessage);
-    if (severity & vk::DebugUtilsMessageSeverityFlagBitsEXT::eError) {
-        BOOST_LOG_TRIVIAL(error) << msg;
-    } else if (severity & vk::DebugUtilsMessageSeverityFlagBitsEXT::eWarning) {
-        BOOST_LOG_TRIVIAL(warning) << msg;
+    // Runs inside whichever Vulkan call the message is about. Errors and
+    // warnings are written before it returns, after everything logged
+    // before them, so they're on screen if the call goes on to crash and
+    // line up with a debugger stopped here. The chattier levels only copy
+    // the message, and the type is turned into a string on the logger
+    // thread.
+    if (severity & (vk::DebugUtilsMessageSeverityFlagBitsEXT::eError | vk::DebugUtilsMessageSeverityFlagBitsEXT::eWarning)) {
+        Logger::flush();
+        const LogLevel level = (severity & vk::DebugUtilsMessageSeverityFlagBitsEXT::eError) ? LogLevel::error : LogLevel::warning;
+        BOOST_LOG_SEV(boost::log::trivial::logger::get(), level)
+            << "Vulkan debug message: type: " << vk::to_string(type) << " msg: " << pCallbackData->pMessage;
     } else if (severity & vk::DebugUtilsMessageSeverityFlagBitsEXT::eInfo) {
-        BOOST_LOG_TRIVIAL(info) << msg;
+        VGRAPHPLAY_LOG(info, "Vulkan debug message: type: {} msg: {}", type, pCallbackData->pMessage);
     } else if (severity & vk::DebugUtilsMessageSeverityFlagBitsEXT::eVerbose) {
-        BOOST_LOG_TRIVIAL(debug) << msg;
+        VGRAPHPLAY_LOG(debug, "Vulkan debug message: type: {} msg: {}", type, pCallbackData->pMessage);
     } else {
-        BOOST_LOG_TRIVIAL(warning) << msg << " (unknown severity: " << to_string(severity) << ")";
+        VGRAPHPLAY_LOG(warning, "Vulkan debug message: type: {} msg: {} (unknown severity: {})", type, pCallbackData->pMessage, severity);
     }
 
     return vk::False;
 }
 
-vgraphplay::gfx::System::System(GLFWwindow *window, bool debug)
-    : m_debug{debug},
+vgraphplay::gfx::System::System(GLFWwindow *window, const RunConfig &config, JobSystem &jobs)
+    : m_debug{config.validation()},
+      m_log_vulkan{config.log_vulkan},
+      m_benchmark_devices{config.benchmark_devices},
+      m_device_name{config.device},
+      m_device_cache{config.device_cache},
       m_window{window},
+      m_jobs{&jobs},
+      m_assets{},
+      m_host_allocator{config.track_allocations || config.command_arena, config.command_arena},
       m_context{},
       m_instance{nullptr},
       m_debug_messenger{nullptr},
+      m_surface{nullptr},
       m_device{nullptr},
       m_physical_device{nullptr},
+      m_device_profile{},
       m_graphics_queue_family{0},
-      // m_present_queue_family{0},
-      m_graphics_queue{nullptr}
-      // m_present_queue{VK_NULL_HANDLE},
-      /* m_command_pool{VK_NULL_HANDLE},
-      m_command_buffers{},
-      m_vertex_buffer{VK_NULL_HANDLE},
-      m_index_buffer{VK_NULL_HANDLE},
-      m_uniform_buffers{},
-      m_vertex_buffer_memory{VK_NULL_HANDLE},
-      m_index_buffer_memory{VK_NULL_HANDLE},
-      m_uniform_buffers_memory{},
-      m_texture_image{VK_NULL_HANDLE},
-      m_texture_image_memory{VK_NULL_HANDLE},
-      m_texture_image_view{VK_NULL_HANDLE},
-      m_texture_sampler{VK_NULL_HANDLE},
-      m_surface{VK_NULL_HANDLE},
-      m_swapchain{VK_NULL_HANDLE},
+      m_graphics_queue{nullptr},
+      m_swapchain{nullptr},
       m_swapchain_images{},
-      m_swapchain_image_views{},
-      m_swapchain_format{VK_FORMAT_UNDEFINED, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR},
+      m_swapchain_views{},
+      m_swapchain_format{.format = vk::Format::eUndefined, .colorSpace = vk::ColorSpaceKHR::eSrgbNonlinear},
       m_swapchain_extent{0, 0},
+      m_framebuffer_size{0, 0},
       m_framebuffer_resized{false},
-      m_depth_image{VK_NULL_HANDLE},
-      m_depth_image_memory{VK_NULL_HANDLE},
-      m_depth_image_view{VK_NULL_HANDLE},
-      m_vertex_shader_module{VK_NULL_HANDLE},
-      m_fragment_shader_module{VK_NULL_HANDLE},
-      m_pipeline_layout{VK_NULL_HANDLE},
-      m_descriptor_set_layout{VK_NULL_HANDLE},
-      m_descriptor_pool{VK_NULL_HANDLE},
-      m_descriptor_sets{},
-      m_render_pass{VK_NULL_HANDLE},
-      m_pipeline{VK_NULL_HANDLE},
-      m_swapchain_framebuffers{},
-      m_image_available_semaphore{VK_NULL_HANDLE},
-      m_render_finished_semaphore{VK_NULL_HANDLE} */
+      m_depth_format{vk::Format::eUndefined},
+      m_timeline{nullptr},
+      m_current_frame{0},
+      m_frame_count{0},
+      m_last_sequence{0},
+      m_frame_points{},
+      m_command_pools{},
+      m_command_buffers{},
+      m_image_available{},
+      m_render_finished{},
+      m_deletion_queue{m_timeline},
+      m_resources{nullptr},
+      m_descriptors{nullptr},
+      m_descriptor_cache{nullptr},
+      m_frame_descriptors{},
+      m_bindless{nullptr},
+      m_layouts{nullptr},
+      m_camera{glm::mat4x4{1.0f}, glm::mat4x4{1.0f}},
+      m_objects{},
+      m_draw_constants{nullptr},
+      m_vertex_buffer{},
+      m_position_buffer{},
+      m_index_buffer{},
+      m_mesh{},
+      m_texture{},
+      m_sampler{},
+      m_pipelines{nullptr},
+      m_unlit_program{0},
+      m_unlit_bindless_program{0},
+      m_unlit_instanced_program{0},
+      m_depth_program{0},
+      m_draw_list{nullptr},
+      m_depth_prepass{nullptr},
+      m_render_graph{nullptr}
 {
+    PhaseTimer startup{"Graphics startup"};
+    initAssets(config.asset_pack);
+    startup.mark("assets");
+#if VGRAPHPLAY_VULKAN_API_STATS
+    ApiStats::install(m_context);
+#endif
     initInstance();
+    startup.mark("instance");
     initDebugMessenger();
+    startup.mark("debug messenger");
+    initSurface();
+    startup.mark("surface");
+    initPhysicalDevice();
+    startup.mark("physical device");
     initDevice();
-}
-
-vgraphplay::gfx::System::~System() {}
-
-/* bool vgraphplay::gfx::System::initialize(bool debug) {
-    bool rv = initInstance(debug);
-
-    if (rv && debug) {
-        rv = rv && initDebugCallback();
+    startup.mark("device");
+    initSwapchain();
+    initFrames();
+    startup.mark("swapchain");
+    initPipelines();
+    startup.mark("pipelines");
+    initScene();
+    startup.mark("scene");
+    startup.report();
+}
+
+vgraphplay::gfx::System::~System() {
+    if (m_device != nullptr) {
+        // Presents aren't on the timeline, so its waitIdle() doesn't cover
+        // them.
+        m_device.waitIdle();
+        m_deletion_queue.flush();
     }
-
-    rv = rv && initSurface();
-    rv = rv && initDevice();
-    rv = rv && initSwapchain();
-    rv = rv && initShaderModules();
-    rv = rv && initRenderPass();
-    rv = rv && initDescriptorSetLayout();
-    rv = rv && initPipelineLayout();
-    rv = rv && initPipeline();
-    rv = rv && initSemaphores();
-    rv = rv && initCommandPool();
-    rv = rv && initDepthResources();
-    rv = rv && initSwapchainFramebuffers();
-    rv = rv && initTextureImage();
-    rv = rv && initTextureImageView();
-    rv = rv && initTextureSampler();
-    rv = rv && initVertexBuffer();
-    rv = rv && initIndexBuffer();
-    rv = rv && initUniformBuffers();
-    rv = rv && initDescriptorPool();
-    rv = rv && initDescriptorSets();
-    rv = rv && initCommandBuffers();
-    rv = rv && recordCommandBuffers();
-
-    return rv;
 }
 
-void vgraphplay::gfx::System::dispose() {
-    if (m_device != VK_NULL_HANDLE) {
-        vkDeviceWaitIdle(m_device);
+void vgraphplay::gfx::System::initAssets(const std::string &path) {
+    // The only asset is the texture, which has a stand-in, so run without
+    // them rather than not at all. A pack that's there but damaged is still
+    // an error.
+    if (!std::filesystem::exists(path)) {
+        BOOST_LOG_TRIVIAL(warning) << "No asset pack at " << path << "; running without assets";
+        return;
     }
-
-    cleanupCommandPool();
-    cleanupSemaphores();
-    cleanupSwapchainFramebuffers();
-    cleanupPipeline();
-    cleanupPipelineLayout();
-    cleanupDescriptorSetLayout();
-    cleanupRenderPass();
-    cleanupShaderModules();
-    cleanupSwapchain();
-    cleanupDescriptorPool();
-    cleanupUniformBuffers();
-    cleanupIndexBuffer();
-    cleanupVertexBuffer();
-    cleanupTextureSampler();
-    cleanupTextureImageView();
-    cleanupTextureImage();
-    cleanupDepthResources();
-    cleanupDevice();
-    cleanupSurface();
-    cleanupDebugCallback();
-    cleanupInstance();
+    m_assets.open(path);
 }
 
-void vgraphplay::gfx::System::recreateSwapchain() {
-    int width{0}, height{0};
-
-    while (width == 0 && height == 0) {
-        glfwGetFramebufferSize(m_window, &width, &height);
-        glfwWaitEvents();
-    }
-
-    if (m_device != VK_NULL_HANDLE) {
-        vkDeviceWaitIdle(m_device);
-    }
-
-    cleanupCommandBuffers();
-    cleanupSwapchainFramebuffers();
-    cleanupPipeline();
-    cleanupPipelineLayout();
-    cleanupRenderPass();
-    cleanupSwapchain();
-    cleanupDepthResources();
-
-    bool rv = initSwapchain();
-    rv = rv && initRenderPass();
-    rv = rv && initPipelineLayout();
-    rv = rv && initPipeline();
-    rv = rv && initDepthResources();
-    rv = rv && initSwapchainFramebuffers();
-    rv = rv && initCommandBuffers();
-    rv = rv && recordCommandBuffers();
-} */
-
 void vgraphplay::gfx::System::initInstance() {
     if (m_instance != nullptr) {
         return;
     }
 
-    // logInstanceExtensions(m_context);
-    // logInstanceLayers(m_context);
+    // Enumerating every layer's extensions is slow, so only on request.
+    if (m_log_vulkan) {
+        logInstanceExtensions(m_context);
+        logInstanceLayers(m_context);
+    }
 
     vk::InstanceCreateFlags flags;
     std::vector<const char *> extension_names = buildInstanceExtensionList(m_context, m_debug);
@@ -249,7 +243,7 @@ void vgraphplay::gfx::System::initInstance() {
         .ppEnabledExtensionNames = extension_names.data(),
     };
 
-    m_instance = vk::raii::Instance(m_context, inst_ci);
+    m_instance = vk::raii::Instance(m_context, inst_ci, HostAllocator::callbacks());
     BOOST_LOG_TRIVIAL(trace) << "Vulkan instance created: " << *m_instance;
 }
 
@@ -259,7 +253,7 @@ void vgraphplay::gfx::System::initDebugMessenger() {
     }
 
     if (m_instance == nullptr) {
-        throw new std::runtime_error("Cannot create debug messenger; Vulkan instance is null");
+        throw std::runtime_error("Cannot create debug messenger; Vulkan instance is null");
     }
 
     vk::DebugUtilsMessengerCreateInfoEXT dm_ci{
@@ -274,1983 +268,728 @@ void vgraphplay::gfx::System::initDebugMessenger() {
         .pfnUserCallback = handleDebugMessage,
     };
 
-    m_debug_messenger = m_instance.createDebugUtilsMessengerEXT(dm_ci);
+    m_debug_messenger = m_instance.createDebugUtilsMessengerEXT(dm_ci, HostAllocator::callbacks());
     BOOST_LOG_TRIVIAL(trace) << "Created debug messenger: " << *m_debug_messenger;
 }
 
-void vgraphplay::gfx::System::initDevice() {
-    if (m_device != nullptr) {
+// Runs on the main thread, like the rest of the constructor, so it can ask
+// GLFW for the framebuffer size. Later sizes come in through
+// setFramebufferSize().
+void vgraphplay::gfx::System::initSurface() {
+    if (m_surface != nullptr) {
         return;
     }
 
     if (m_instance == nullptr) {
-        throw new std::runtime_error("Cannot create device; Vulkan instance is null");
-    }
-
-    logPhysicalDevices(m_instance);
-    const std::vector<vk::raii::PhysicalDevice> physical_devices = m_instance.enumeratePhysicalDevices();
-    m_physical_device = choosePhysicalDevice(physical_devices);
-    BOOST_LOG_TRIVIAL(trace) << "Chose physical device " << m_physical_device.getProperties().deviceName;
-
-    const std::vector<vk::QueueFamilyProperties> qfps = m_physical_device.getQueueFamilyProperties();
-    auto graphics_qfp = std::ranges::find_if(qfps, [](auto const &qfp) { return !!(qfp.queueFlags & vk::QueueFlagBits::eGraphics); });
-    m_graphics_queue_family = std::distance(qfps.begin(), graphics_qfp);
-    float graphics_queue_priority = 0.5f;
-    vk::DeviceQueueCreateInfo graphics_queue_ci{
-        .queueFamilyIndex = m_graphics_queue_family,
-        .queueCount = 1,
-        .pQueuePriorities = &graphics_queue_priority,
-    };
-
-    vk::StructureChain<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan13Features, vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT> feature_chain = {
-        {},                             // vk::PhysicalDeviceFeatures2, empty (for now)
-        {.dynamicRendering = true},     // Enable dynamic rendering from Vulkan 1.3
-        {.extendedDynamicState = true}, // Enable extended dynamic state from the extension
-    };
-
-    std::vector<const char *> required_device_extensions = {
-        vk::KHRSwapchainExtensionName,
-    };
-
-    vk::DeviceCreateInfo device_ci = vk::DeviceCreateInfo{
-        .pNext = &feature_chain.get<vk::PhysicalDeviceFeatures2>(),
-    }.setQueueCreateInfos(graphics_queue_ci)
-        .setPEnabledExtensionNames(required_device_extensions);
-
-    m_device = vk::raii::Device(m_physical_device, device_ci);
-    BOOST_LOG_TRIVIAL(trace) << "Created device: " << *m_device;
-    m_graphics_queue = vk::raii::Queue(m_device, m_graphics_queue_family, 0);
-    BOOST_LOG_TRIVIAL(trace) << "Created graphics queue: " << *m_graphics_queue;
-
-    /* float queue_priority = 1.0;
-    std::vector<VkDeviceQueueCreateInfo> queue_cis;
-    VkDeviceQueueCreateInfo queue_ci;
-    queue_ci.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-    queue_ci.pNext = nullptr;
-    queue_ci.flags = 0;
-    queue_ci.queueFamilyIndex = chosen.graphics_queue_family;
-    queue_ci.queueCount = 1;
-    queue_ci.pQueuePriorities = &queue_priority;
-    queue_cis.push_back(queue_ci);
-
-    if (chosen.present_queue_family != chosen.graphics_queue_family) {
-        VkDeviceQueueCreateInfo queue_ci;
-        queue_ci.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-        queue_ci.pNext = nullptr;
-        queue_ci.flags = 0;
-        queue_ci.queueFamilyIndex = chosen.present_queue_family;
-        queue_ci.queueCount = 1;
-        queue_ci.pQueuePriorities = &queue_priority;
-        queue_cis.push_back(queue_ci);
-    }
-
-    std::vector<const char*> extension_names;
-    extension_names.emplace_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
-
-    VkPhysicalDeviceFeatures device_features{};
-    device_features.samplerAnisotropy = VK_TRUE;
-
-    VkDeviceCreateInfo device_ci;
-    device_ci.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-    device_ci.pNext = nullptr;
-    device_ci.flags = 0;
-    device_ci.queueCreateInfoCount = (uint32_t)queue_cis.size();
-    device_ci.pQueueCreateInfos = queue_cis.data();
-    device_ci.enabledLayerCount = 0;
-    device_ci.ppEnabledLayerNames = nullptr;
-    device_ci.pEnabledFeatures = &device_features;
-    device_ci.enabledExtensionCount = (uint32_t)extension_names.size();
-    device_ci.ppEnabledExtensionNames = extension_names.data();
-
-    VkResult rslt = vkCreateDevice(m_physical_device, &device_ci, nullptr, &m_device);
-    if (rslt == VK_SUCCESS) {
-        BOOST_LOG_TRIVIAL(trace) << "Device created: " << m_device;
-        m_graphics_queue_family = chosen.graphics_queue_family;
-        m_present_queue_family = chosen.present_queue_family;
-        vkGetDeviceQueue(m_device, m_graphics_queue_family, 0, &m_graphics_queue);
-        BOOST_LOG_TRIVIAL(trace) << "Graphics queue: " << m_graphics_queue;
-        vkGetDeviceQueue(m_device, m_present_queue_family, 0, &m_present_queue);
-        BOOST_LOG_TRIVIAL(trace) << "Present queue: " << m_present_queue;
-        return true;
-    } else {
-        BOOST_LOG_TRIVIAL(error) << "Error creating device " << rslt;
-        return false;
-    } */
-}
-
-vk::raii::PhysicalDevice vgraphplay::gfx::System::choosePhysicalDevice(const std::vector<vk::raii::PhysicalDevice> &devices /*, vk::SurfaceKHR &surface */) {
-    std::vector<const char *> required_extensions{
-        vk::KHRSwapchainExtensionName
-    };
-
-    for (auto &dev : devices) {
-        const vk::PhysicalDeviceProperties props = dev.getProperties();
-        const auto features = dev.template getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan13Features, vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>();
-        const std::vector<vk::ExtensionProperties> all_extensions = dev.enumerateDeviceExtensionProperties();
-        const std::vector<vk::QueueFamilyProperties> queue_families = dev.getQueueFamilyProperties();
-
-        bool supports_vulkan_13 = props.apiVersion >= vk::ApiVersion13;
-        bool supports_graphics = std::ranges::any_of(
-            queue_families, 
-            [](const auto &qfp) { return !!(qfp.queueFlags & vk::QueueFlagBits::eGraphics); }
-        );
-        bool supports_all_extensions = std::ranges::all_of(
-            required_extensions,
-            [&all_extensions](const auto &this_req_ext) {
-                return std::ranges::any_of(
-                    all_extensions,
-                    [this_req_ext](const auto &ext) {
-                        return strcmp(ext.extensionName, this_req_ext) == 0;
-                    }
-                );
-            }
-        );
-        bool supports_dynamic_rendering = features.template get<vk::PhysicalDeviceVulkan13Features>().dynamicRendering;
-        bool supports_dynamic_state = features.template get<vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT>().extendedDynamicState;
-        
-        if (supports_vulkan_13 && supports_graphics && supports_all_extensions && supports_dynamic_rendering && supports_dynamic_state) {
-            return dev;
-        }
-    }
-    
-    throw std::runtime_error{"Could not find a suitable GPU"};
-}
-
-/* bool vgraphplay::gfx::System::initSurface() {
-    if (m_surface != VK_NULL_HANDLE) {
-        return true;
-    }
-
-    if (m_instance == VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(error) << "Things have been initialized out of order. Cannot create surface.";
-        return false;
-    }
-
-    VkResult rslt = glfwCreateWindowSurface(m_instance, m_window, nullptr, &m_surface);
-    if (rslt == VK_SUCCESS) {
-        BOOST_LOG_TRIVIAL(trace) << "Created surface: " << m_surface;
-        return true;
-    } else {
-        BOOST_LOG_TRIVIAL(error) << "Error creating surface: " << rslt;
-        return false;
-    }
-}
-
-void vgraphplay::gfx::System::cleanupSurface() {
-    if (m_instance != VK_NULL_HANDLE && m_surface != VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(trace) << "Destroying surface: " << m_surface;
-        vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
-        m_surface = VK_NULL_HANDLE;
-    }
-}
-
-bool vgraphplay::gfx::System::initSwapchain() {
-    if (m_swapchain != VK_NULL_HANDLE) {
-        return true;
-    }
-
-    if (m_physical_device == VK_NULL_HANDLE || m_surface == VK_NULL_HANDLE || m_device == VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(error) << "Things have been initialized out of order. Cannot create swapchain.";
-        return false;
-    }
-
-    logSurfaceCapabilities(m_physical_device, m_surface);
-
-    VkSurfaceCapabilitiesKHR surf_caps;
-    vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_physical_device, m_surface, &surf_caps);
-
-    m_swapchain_extent = chooseSwapExtent(surf_caps);
-
-    // Use one more than the minimum, unless that would
-    // put us over the maximum.
-    uint32_t image_count = surf_caps.minImageCount + 1;
-    if (surf_caps.maxImageCount > 0 && image_count > surf_caps.maxImageCount) {
-        image_count = surf_caps.maxImageCount;
-    }
-
-    uint32_t num_formats;
-    vkGetPhysicalDeviceSurfaceFormatsKHR(m_physical_device, m_surface, &num_formats, nullptr);
-    std::vector<VkSurfaceFormatKHR> formats(num_formats);
-    vkGetPhysicalDeviceSurfaceFormatsKHR(m_physical_device, m_surface, &num_formats, formats.data());
-
-    m_swapchain_format = chooseSurfaceFormat(formats);
-
-    uint32_t num_modes;
-    vkGetPhysicalDeviceSurfacePresentModesKHR(m_physical_device, m_surface, &num_modes, nullptr);
-    std::vector<VkPresentModeKHR> modes(num_modes);
-    vkGetPhysicalDeviceSurfacePresentModesKHR(m_physical_device, m_surface, &num_modes, modes.data());
-
-    VkPresentModeKHR present_mode = choosePresentMode(modes);
-
-    std::vector<uint32_t> queue_families;
-    VkSharingMode sharing_mode = VK_SHARING_MODE_EXCLUSIVE;
-    queue_families.emplace_back(m_graphics_queue_family);
-    if (m_graphics_queue_family != m_present_queue_family) {
-        queue_families.emplace_back(m_present_queue_family);
-        sharing_mode = VK_SHARING_MODE_CONCURRENT;
-    }
-
-    VkSwapchainCreateInfoKHR swapchain_ci;
-    swapchain_ci.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
-    swapchain_ci.pNext = nullptr;
-    swapchain_ci.flags = 0;
-    swapchain_ci.surface = m_surface;
-    swapchain_ci.minImageCount = image_count;
-    swapchain_ci.imageFormat = m_swapchain_format.format;
-    swapchain_ci.imageColorSpace = m_swapchain_format.colorSpace;
-    swapchain_ci.imageExtent = m_swapchain_extent;
-    swapchain_ci.imageArrayLayers = 1;
-    swapchain_ci.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-    swapchain_ci.imageSharingMode = sharing_mode;
-    swapchain_ci.queueFamilyIndexCount = (uint32_t)queue_families.size();
-    swapchain_ci.pQueueFamilyIndices = queue_families.data();
-    swapchain_ci.preTransform = surf_caps.currentTransform;
-    swapchain_ci.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-    swapchain_ci.presentMode = present_mode;
-    swapchain_ci.clipped = VK_TRUE;
-    swapchain_ci.oldSwapchain = VK_NULL_HANDLE;
-
-    VkResult rslt = vkCreateSwapchainKHR(m_device, &swapchain_ci, nullptr, &m_swapchain);
-    if (rslt == VK_SUCCESS) {
-        BOOST_LOG_TRIVIAL(trace) << "Created swapchain: " << m_swapchain;
-    } else {
-        BOOST_LOG_TRIVIAL(error) << "Error creating swapchain: " << rslt;
-        return false;
-    }
-
-    uint32_t num_swapchain_images = 0;
-    vkGetSwapchainImagesKHR(m_device, m_swapchain, &num_swapchain_images, nullptr);
-    m_swapchain_images.resize(num_swapchain_images, VK_NULL_HANDLE);
-    vkGetSwapchainImagesKHR(m_device, m_swapchain, &num_swapchain_images, m_swapchain_images.data());
-
-    m_swapchain_image_views.resize(num_swapchain_images, VK_NULL_HANDLE);
-    for (unsigned int i = 0; i < m_swapchain_images.size(); ++i) {
-        m_swapchain_image_views[i] = createImageView(m_swapchain_images[i], m_swapchain_format.format, VK_IMAGE_ASPECT_COLOR_BIT);
-        if (m_swapchain_image_views[i] == VK_NULL_HANDLE) {
-            BOOST_LOG_TRIVIAL(trace) << "Error creating swapchain image view " << i;
-        } else {
-            BOOST_LOG_TRIVIAL(trace) << "Created swapchain image view " << i << ": " << m_swapchain_image_views[i];
-        }
-    }
-
-    return true;
-}
-
-void vgraphplay::gfx::System::cleanupSwapchain() {
-    if (m_device != VK_NULL_HANDLE) {
-        for (auto&& view : m_swapchain_image_views) {
-            if (view != VK_NULL_HANDLE) {
-                BOOST_LOG_TRIVIAL(trace) << "Destroying swapchain image view: " << view;
-                vkDestroyImageView(m_device, view, nullptr);
-            }
-        }
-        m_swapchain_image_views.clear();
-    }
-
-    if (m_device != VK_NULL_HANDLE && m_swapchain != VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(trace) << "Destroying swapchain: " << m_swapchain;
-        vkDestroySwapchainKHR(m_device, m_swapchain, nullptr);
-        m_swapchain = VK_NULL_HANDLE;
-    }
-
-    m_swapchain_images.clear();
-    m_swapchain_format = { VK_FORMAT_UNDEFINED, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR };
-    m_swapchain_extent = { 0, 0 };
-}
-
-VkSurfaceFormatKHR vgraphplay::gfx::System::chooseSurfaceFormat(const std::vector<VkSurfaceFormatKHR> &formats) {
-    // If it doesn't care, go with what we want.
-    if (formats.size() == 1 && formats[0].format == VK_FORMAT_UNDEFINED) {
-        return { VK_FORMAT_B8G8R8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR };
-    }
-
-    // If what we want is available, go with it.
-    for (const auto &format : formats) {
-        if (format.format == VK_FORMAT_B8G8R8A8_UNORM && format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
-            return format;
-        }
-    }
-
-    // Otherwise, just settle for the first one?
-    return formats[0];
-}
-
-VkPresentModeKHR vgraphplay::gfx::System::choosePresentMode(const std::vector<VkPresentModeKHR> &modes) {
-    // Prefer mailbox over fifo, if it's available.
-    for (const auto &mode: modes) {
-        if (mode == VK_PRESENT_MODE_MAILBOX_KHR) {
-            return mode;
-        }
+        throw std::runtime_error("Cannot create surface; Vulkan instance is null");
     }
 
-    return VK_PRESENT_MODE_FIFO_KHR;
-}
-
-VkExtent2D vgraphplay::gfx::System::chooseSwapExtent(const VkSurfaceCapabilitiesKHR &surf_caps) {
-    if (surf_caps.currentExtent.width != UINT32_MAX) {
-        return surf_caps.currentExtent;
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
+    const VkResult result = glfwCreateWindowSurface(static_cast<VkInstance>(*m_instance), m_window,
+                                                    reinterpret_cast<const VkAllocationCallbacks *>(HostAllocator::callbacks()), &surface);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("Could not create window surface: " + vk::to_string(static_cast<vk::Result>(result)));
     }
+    m_surface = vk::raii::SurfaceKHR(m_instance, surface, HostAllocator::callbacks());
+    BOOST_LOG_TRIVIAL(trace) << "Created surface: " << *m_surface;
 
-    int width, height;
+    int width = 0, height = 0;
     glfwGetFramebufferSize(m_window, &width, &height);
-
-    VkExtent2D extent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height) };
-    extent.width  = std::max(surf_caps.minImageExtent.width,  std::min(surf_caps.maxImageExtent.width,  extent.width));
-    extent.height = std::max(surf_caps.minImageExtent.height, std::min(surf_caps.maxImageExtent.height, extent.height));
-    return extent;
+    setFramebufferSize(width, height);
+    m_framebuffer_resized = false;
 }
 
-bool vgraphplay::gfx::System::initRenderPass() {
-    if (m_render_pass != VK_NULL_HANDLE) {
-        return true;
-    }
-
-    if (m_device == VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(error) << "Things have been initialized out of order. Cannot create render pass.";
-        return false;
-    }
-
-    std::array<VkAttachmentDescription, 2> attachments{};
-
-    attachments[0].flags = 0;
-    attachments[0].format = m_swapchain_format.format;
-    attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
-    attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-    attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-    attachments[1].flags = 0;
-    attachments[1].format = chooseDepthFormat();
-    attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
-    attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-    attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-    VkAttachmentReference color_ref;
-    color_ref.attachment = 0;
-    color_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-    VkAttachmentReference depth_ref;
-    depth_ref.attachment = 1;
-    depth_ref.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-    VkSubpassDescription subpass;
-    subpass.flags = 0;
-    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpass.inputAttachmentCount = 0;
-    subpass.pInputAttachments = nullptr;
-    subpass.colorAttachmentCount = 1;
-    subpass.pColorAttachments = &color_ref;
-    subpass.pResolveAttachments = nullptr;
-    subpass.pDepthStencilAttachment = &depth_ref;
-    subpass.preserveAttachmentCount = 0;
-    subpass.pPreserveAttachments = nullptr;
-
-    VkSubpassDependency sd;
-    sd.dependencyFlags = 0;
-    sd.srcSubpass = VK_SUBPASS_EXTERNAL;
-    sd.dstSubpass = 0;
-    sd.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    sd.srcAccessMask = 0;
-    sd.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    sd.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-    VkRenderPassCreateInfo rp_ci;
-    rp_ci.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    rp_ci.pNext = nullptr;
-    rp_ci.flags = 0;
-    rp_ci.attachmentCount = static_cast<uint32_t>(attachments.size());
-    rp_ci.pAttachments = attachments.data();
-    rp_ci.subpassCount = 1;
-    rp_ci.pSubpasses = &subpass;
-    rp_ci.dependencyCount = 1;
-    rp_ci.pDependencies = &sd;
-
-    VkResult rslt = vkCreateRenderPass(m_device, &rp_ci, nullptr, &m_render_pass);
-    if (rslt == VK_SUCCESS) {
-        BOOST_LOG_TRIVIAL(trace) << "Created render pass: " << m_render_pass;
-        return true;
-    } else {
-        BOOST_LOG_TRIVIAL(error) << "Error creating render pass: " << rslt;
-        return false;
+// Everything device selection and creation need to know about each
+// physical device is queried once, here, or read back from the cache.
+void vgraphplay::gfx::System::initPhysicalDevice() {
+    if (m_physical_device != nullptr) {
+        return;
     }
-}
 
-void vgraphplay::gfx::System::cleanupRenderPass() {
-    if (m_device != VK_NULL_HANDLE && m_render_pass != VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(trace) << "Destroying render pass: " << m_render_pass;
-        vkDestroyRenderPass(m_device, m_render_pass, nullptr);
-        m_render_pass = VK_NULL_HANDLE;
+    if (m_instance == nullptr || m_surface == nullptr) {
+        throw std::runtime_error("Cannot choose a physical device; Vulkan instance or surface is null");
     }
-}
 
-bool vgraphplay::gfx::System::initShaderModules() {
-    m_vertex_shader_module = createShaderModule(UNLIT_VERT_BYTECODE);
-    m_fragment_shader_module = createShaderModule(UNLIT_FRAG_BYTECODE);
-
-    if (m_vertex_shader_module == VK_NULL_HANDLE || m_fragment_shader_module == VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(trace) << "Unable to create all of the shader modules.";
-        return false;
-    } else {
-        return true;
+    if (m_log_vulkan) {
+        logPhysicalDevices(m_instance);
     }
-}
 
-void vgraphplay::gfx::System::cleanupShaderModules() {
-    if (m_device != VK_NULL_HANDLE && m_vertex_shader_module != VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(trace) << "Destroying vertex shader module: " << m_vertex_shader_module;
-        vkDestroyShaderModule(m_device, m_vertex_shader_module, nullptr);
-        m_vertex_shader_module = VK_NULL_HANDLE;
+    const std::vector<vk::raii::PhysicalDevice> physical_devices = m_instance.enumeratePhysicalDevices();
+    DeviceProfileCache cache{m_device_cache};
+    std::vector<DeviceProfile> profiles;
+    std::vector<bool> presentable;
+    profiles.reserve(physical_devices.size());
+    for (const vk::raii::PhysicalDevice &dev : physical_devices) {
+        profiles.push_back(cache.profile(dev));
+        DeviceProfile &profile = profiles.back();
+        // Depends on the window, so it isn't part of the cached profile.
+        presentable.push_back(profile.suitable() && dev.getSurfaceSupportKHR(profile.graphics_queue_family, *m_surface));
+        if (m_benchmark_devices && profile.suitable() && profile.fill_rate == 0.0f) {
+#if VGRAPHPLAY_VULKAN_API_STATS
+            const ApiStats::Unwatched unwatched;
+#endif
+            profile.fill_rate = DeviceBenchmark::fillRate(dev, profile);
+            cache.update(profile);
+        }
     }
+    cache.save();
 
-    if (m_device != VK_NULL_HANDLE && m_fragment_shader_module != VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(trace) << "Destroying fragment shader module: " << m_fragment_shader_module;
-        vkDestroyShaderModule(m_device, m_fragment_shader_module, nullptr);
-        m_fragment_shader_module = VK_NULL_HANDLE;
-    }
+    const size_t chosen = choosePhysicalDevice(profiles, presentable);
+    m_physical_device = physical_devices[chosen];
+    m_device_profile = profiles[chosen];
+    BOOST_LOG_TRIVIAL(info) << "Chose physical device " << m_device_profile.name;
 }
 
-VkShaderModule vgraphplay::gfx::System::createShaderModule(const Resource &rsrc) {
-    VkShaderModule rv = VK_NULL_HANDLE;
-
-    if (m_device == VK_NULL_HANDLE) {
-        return rv;
-    }
-
-    VkShaderModuleCreateInfo sm_ci;
-    sm_ci.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    sm_ci.pNext = nullptr;
-    sm_ci.flags = 0;
-    sm_ci.codeSize = rsrc.size();
-    sm_ci.pCode = reinterpret_cast<const uint32_t*>(rsrc.data());
-
-    VkResult rslt = vkCreateShaderModule(m_device, &sm_ci, nullptr, &rv);
-    if (rslt == VK_SUCCESS) {
-        BOOST_LOG_TRIVIAL(trace) << "Created shader module: " << rv;
-    } else {
-        BOOST_LOG_TRIVIAL(trace) << "Failed to create shader module: " << rslt;
+void vgraphplay::gfx::System::initDevice() {
+    if (m_device != nullptr) {
+        return;
     }
 
-    return rv;
-}
-
-bool vgraphplay::gfx::System::initPipelineLayout() {
-    if (m_pipeline_layout != VK_NULL_HANDLE) {
-        return true;
+    if (m_physical_device == nullptr) {
+        throw std::runtime_error("Cannot create device; no physical device was chosen");
     }
 
-    if (m_device == VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(error) << "Things have been initialized out of order. Cannot create pipeline layout.";
-        return false;
-    }
+    m_graphics_queue_family = m_device_profile.graphics_queue_family;
+    float graphics_queue_priority = 0.5f;
+    vk::DeviceQueueCreateInfo graphics_queue_ci{
+        .queueFamilyIndex = m_graphics_queue_family,
+        .queueCount = 1,
+        .pQueuePriorities = &graphics_queue_priority,
+    };
 
-    VkPipelineLayoutCreateInfo pl_layout_ci;
-    pl_layout_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pl_layout_ci.pNext = nullptr;
-    pl_layout_ci.flags = 0;
-    pl_layout_ci.setLayoutCount = 1;
-    pl_layout_ci.pSetLayouts = &m_descriptor_set_layout;
-    pl_layout_ci.pushConstantRangeCount = 0;
-    pl_layout_ci.pPushConstantRanges = nullptr;
-
-    VkResult rslt = vkCreatePipelineLayout(m_device, &pl_layout_ci, nullptr, &m_pipeline_layout);
-    if (rslt == VK_SUCCESS) {
-        BOOST_LOG_TRIVIAL(trace) << "Created pipeline layout: " << m_pipeline_layout;
-        return true;
-    } else {
-        BOOST_LOG_TRIVIAL(error) << "Error creating pipeline layout: " << rslt;
-        return false;
-    }
-}
+    vk::StructureChain<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan12Features, vk::PhysicalDeviceVulkan13Features, vk::PhysicalDeviceExtendedDynamicStateFeaturesEXT> feature_chain = {
+        {.features = {.textureCompressionBC = m_device_profile.has(DeviceProfile::BC_TEXTURES)}}, // Cooked textures are BC1/BC3; see CookedTexture::decode
+        {.timelineSemaphore = true},                                // All GPU/CPU sync goes through a Timeline
+        {.synchronization2 = true, .dynamicRendering = true},       // Enable submit2 and dynamic rendering from Vulkan 1.3
+        {.extendedDynamicState = true},                             // Enable extended dynamic state from the extension
+    };
 
-void vgraphplay::gfx::System::cleanupPipelineLayout() {
-    if (m_device != VK_NULL_HANDLE && m_pipeline_layout != VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(trace) << "Destroying pipeline layout: " << m_pipeline_layout;
-        vkDestroyPipelineLayout(m_device, m_pipeline_layout, nullptr);
-        m_pipeline_layout = VK_NULL_HANDLE;
-    }
-}
+    // Only needed for the overdraw counters.
+    feature_chain.get<vk::PhysicalDeviceFeatures2>().features.pipelineStatisticsQuery = m_device_profile.has(DeviceProfile::PIPELINE_STATISTICS);
 
-bool vgraphplay::gfx::System::initDescriptorSetLayout() {
-    if (m_descriptor_set_layout != VK_NULL_HANDLE) {
-        return true;
-    }
+    // Lets the draw list issue each batch as one indirect draw.
+    const bool multi_draw = m_device_profile.has(DeviceProfile::MULTI_DRAW);
+    feature_chain.get<vk::PhysicalDeviceFeatures2>().features.multiDrawIndirect = multi_draw;
+    feature_chain.get<vk::PhysicalDeviceFeatures2>().features.drawIndirectFirstInstance = multi_draw;
 
-    if (m_device == VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(error) << "Things have been initialized out of order. Unable to create descriptor set layout.";
-        return false;
+    bool bindless = m_device_profile.has(DeviceProfile::BINDLESS);
+    if (bindless) {
+        BindlessTable::enableFeatures(feature_chain.get<vk::PhysicalDeviceVulkan12Features>());
     }
 
-    std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
-
-    // UBO binding.
-    bindings[0].binding = 0;
-    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    bindings[0].descriptorCount = 1;
-    bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-    bindings[0].pImmutableSamplers = nullptr;
-
-    // Sampler binding.
-    bindings[1].binding = 1;
-    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    bindings[1].descriptorCount = 1;
-    bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-    bindings[1].pImmutableSamplers = nullptr;
-
-    VkDescriptorSetLayoutCreateInfo dsl_ci;
-    dsl_ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    dsl_ci.pNext = nullptr;
-    dsl_ci.flags = 0;
-    dsl_ci.bindingCount = static_cast<uint32_t>(bindings.size());
-    dsl_ci.pBindings = bindings.data();
-
-    VkResult rslt = vkCreateDescriptorSetLayout(m_device, &dsl_ci, nullptr, &m_descriptor_set_layout);
-    if (rslt == VK_SUCCESS) {
-        BOOST_LOG_TRIVIAL(trace) << "Created descriptor set layout: " << m_descriptor_set_layout;
-        return true;
-    } else {
-        BOOST_LOG_TRIVIAL(error) << "Error creating descriptor set layout " << rslt;
-        return false;
-    }
-}
+    std::vector<const char *> required_device_extensions = {
+        vk::KHRSwapchainExtensionName,
+    };
 
-void vgraphplay::gfx::System::cleanupDescriptorSetLayout() {
-    if (m_device != VK_NULL_HANDLE && m_descriptor_set_layout != VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(trace) << "Destroying descriptor set layout: " << m_descriptor_set_layout;
-        vkDestroyDescriptorSetLayout(m_device, m_descriptor_set_layout, nullptr);
-        m_descriptor_set_layout = VK_NULL_HANDLE;
-    }
-}
+    vk::DeviceCreateInfo device_ci = vk::DeviceCreateInfo{
+        .pNext = &feature_chain.get<vk::PhysicalDeviceFeatures2>(),
+    }.setQueueCreateInfos(graphics_queue_ci)
+        .setPEnabledExtensionNames(required_device_extensions);
 
-bool vgraphplay::gfx::System::initPipeline() {
-    if (m_pipeline != VK_NULL_HANDLE) {
-        return true;
+    m_device = vk::raii::Device(m_physical_device, device_ci, HostAllocator::callbacks());
+    BOOST_LOG_TRIVIAL(trace) << "Created device: " << *m_device;
+    m_graphics_queue = vk::raii::Queue(m_device, m_graphics_queue_family, 0);
+    BOOST_LOG_TRIVIAL(trace) << "Created graphics queue: " << *m_graphics_queue;
+    m_timeline = Timeline{m_device};
+    m_resources = Resources{m_physical_device, m_device, m_deletion_queue};
+    m_descriptors = DescriptorAllocator{m_device};
+    m_descriptor_cache = DescriptorSetCache{m_device, m_descriptors};
+    m_descriptor_cache.watch(m_resources);
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        m_frame_descriptors.emplace_back(m_device);
     }
 
-    if (m_device == VK_NULL_HANDLE ||
-        m_vertex_shader_module == VK_NULL_HANDLE ||
-        m_fragment_shader_module == VK_NULL_HANDLE ||
-        m_pipeline_layout == VK_NULL_HANDLE ||
-        m_render_pass == VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(error) << "Things have been initialized out of order. Cannot create pipeline.";
-    }
+    m_draw_constants = DrawConstants{m_physical_device, m_resources, MAX_FRAMES_IN_FLIGHT};
+    m_draw_list = DrawList{m_resources, *m_jobs, MAX_FRAMES_IN_FLIGHT, MAX_DRAWS_PER_FRAME, multi_draw};
+    m_render_graph = RenderGraph{m_device, m_resources, m_deletion_queue};
 
-    VkPipelineShaderStageCreateInfo ss_ci[2];
-    ss_ci[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    ss_ci[0].pNext = nullptr;
-    ss_ci[0].flags = 0;
-    ss_ci[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-    ss_ci[0].module = m_vertex_shader_module;
-    ss_ci[0].pName = "main";
-    ss_ci[0].pSpecializationInfo = nullptr;
-
-    ss_ci[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    ss_ci[1].pNext = nullptr;
-    ss_ci[1].flags = 0;
-    ss_ci[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    ss_ci[1].module = m_fragment_shader_module;
-    ss_ci[1].pName = "main";
-    ss_ci[1].pSpecializationInfo = nullptr;
-
-    auto bind_desc = Vertex::bindingDescription();
-    auto attr_desc = Vertex::attributeDescription();
-
-    VkPipelineVertexInputStateCreateInfo vert_in_ci;
-    vert_in_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vert_in_ci.pNext = nullptr;
-    vert_in_ci.flags = 0;
-    vert_in_ci.vertexBindingDescriptionCount = 1;
-    vert_in_ci.pVertexBindingDescriptions = &bind_desc;
-    vert_in_ci.vertexAttributeDescriptionCount = 3;
-    vert_in_ci.pVertexAttributeDescriptions = attr_desc.data();
-
-    VkPipelineInputAssemblyStateCreateInfo input_asm_ci;
-    input_asm_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    input_asm_ci.pNext = nullptr;
-    input_asm_ci.flags = 0;
-    input_asm_ci.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-    input_asm_ci.primitiveRestartEnable = VK_FALSE;
-
-    VkViewport viewport;
-    viewport.x = 0.0;
-    viewport.y = 0.0;
-    viewport.width = static_cast<float>(m_swapchain_extent.width);
-    viewport.height = static_cast<float>(m_swapchain_extent.height);
-    viewport.minDepth = 0.0;
-    viewport.maxDepth = 1.0;
-
-    VkRect2D scissor;
-    scissor.offset = { 0, 0 };
-    scissor.extent = m_swapchain_extent;
-
-    VkPipelineViewportStateCreateInfo vp_ci;
-    vp_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    vp_ci.pNext = nullptr;
-    vp_ci.flags = 0;
-    vp_ci.viewportCount = 1;
-    vp_ci.pViewports = &viewport;
-    vp_ci.scissorCount = 1;
-    vp_ci.pScissors = &scissor;
-
-    VkPipelineRasterizationStateCreateInfo raster_ci;
-    raster_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    raster_ci.pNext = nullptr;
-    raster_ci.flags = 0;
-    raster_ci.depthClampEnable = VK_FALSE;
-    raster_ci.rasterizerDiscardEnable = VK_FALSE;
-    raster_ci.polygonMode = VK_POLYGON_MODE_FILL;
-    raster_ci.cullMode = VK_CULL_MODE_BACK_BIT;
-    raster_ci.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-    raster_ci.depthBiasEnable = VK_FALSE;
-    raster_ci.depthBiasConstantFactor = 0.0;
-    raster_ci.depthBiasClamp = 0.0;
-    raster_ci.depthBiasSlopeFactor = 0.0;
-    raster_ci.lineWidth = 1.0;
-
-    VkPipelineMultisampleStateCreateInfo msamp_ci;
-    msamp_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    msamp_ci.pNext = nullptr;
-    msamp_ci.flags = 0;
-    msamp_ci.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-    msamp_ci.sampleShadingEnable = VK_FALSE;
-    msamp_ci.minSampleShading = 0.0;
-    msamp_ci.pSampleMask = nullptr;
-    msamp_ci.alphaToCoverageEnable = VK_FALSE;
-    msamp_ci.alphaToOneEnable = VK_FALSE;
-
-    VkPipelineDepthStencilStateCreateInfo depth_ci;
-    depth_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-    depth_ci.pNext = nullptr;
-    depth_ci.flags = 0;
-    depth_ci.depthTestEnable = VK_TRUE;
-    depth_ci.depthWriteEnable = VK_TRUE;
-    depth_ci.depthCompareOp = VK_COMPARE_OP_LESS;
-    depth_ci.depthBoundsTestEnable = VK_FALSE;
-    depth_ci.stencilTestEnable = VK_FALSE;
-    depth_ci.front = {};
-    depth_ci.back = {};
-    depth_ci.minDepthBounds = 0.0;
-    depth_ci.maxDepthBounds = 1.0;
-
-    VkPipelineColorBlendAttachmentState blender;
-    blender.blendEnable = VK_FALSE;
-    blender.srcColorBlendFactor = VK_BLEND_FACTOR_ZERO;
-    blender.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
-    blender.colorBlendOp = VK_BLEND_OP_ADD;
-    blender.srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-    blender.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-    blender.alphaBlendOp = VK_BLEND_OP_ADD;
-    blender.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-
-    VkPipelineColorBlendStateCreateInfo blend_ci;
-    blend_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    blend_ci.pNext = nullptr;
-    blend_ci.flags = 0;
-    blend_ci.logicOpEnable = VK_FALSE;
-    blend_ci.logicOp = VK_LOGIC_OP_COPY;
-    blend_ci.attachmentCount = 1;
-    blend_ci.pAttachments = &blender;
-    blend_ci.blendConstants[0] = 0.0;
-    blend_ci.blendConstants[1] = 0.0;
-    blend_ci.blendConstants[2] = 0.0;
-    blend_ci.blendConstants[3] = 0.0;
-
-    // VkPipelineDynamicStateCreateInfo dyn_state_ci;
-    // dyn_state_ci.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-    // dyn_state_ci.pNext = nullptr;
-    // dyn_state_ci.flags = 0;
-
-    VkGraphicsPipelineCreateInfo pipeline_ci;
-    pipeline_ci.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipeline_ci.pNext = nullptr;
-    pipeline_ci.flags = 0;
-    pipeline_ci.stageCount = 2;
-    pipeline_ci.pStages = ss_ci;
-    pipeline_ci.pVertexInputState = &vert_in_ci;
-    pipeline_ci.pInputAssemblyState = &input_asm_ci;
-    pipeline_ci.pTessellationState = nullptr;
-    pipeline_ci.pViewportState = &vp_ci;
-    pipeline_ci.pRasterizationState = &raster_ci;
-    pipeline_ci.pMultisampleState = &msamp_ci;
-    pipeline_ci.pDepthStencilState = &depth_ci;
-    pipeline_ci.pColorBlendState = &blend_ci;
-    pipeline_ci.pDynamicState = nullptr;
-    pipeline_ci.layout = m_pipeline_layout;
-    pipeline_ci.renderPass = m_render_pass;
-    pipeline_ci.subpass = 0;
-    pipeline_ci.basePipelineHandle = VK_NULL_HANDLE;
-    pipeline_ci.basePipelineIndex = -1;
-
-    VkResult rslt = vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &pipeline_ci, nullptr, &m_pipeline);
-    if (rslt == VK_SUCCESS) {
-        BOOST_LOG_TRIVIAL(trace) << "Created graphics pipeline: " << m_pipeline;
-        return true;
+    if (bindless) {
+        m_bindless = BindlessTable{m_physical_device, m_device, m_resources, m_timeline};
     } else {
-        BOOST_LOG_TRIVIAL(error) << "Error creating graphics pipeline: " << rslt;
-        return false;
+        BOOST_LOG_TRIVIAL(info) << "Descriptor indexing is not supported; bindless rendering is disabled";
     }
-}
 
-void vgraphplay::gfx::System::cleanupPipeline() {
-    if (m_device != VK_NULL_HANDLE && m_pipeline != VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(trace) << "Destroying pipeline: " << m_pipeline;
-        vkDestroyPipeline(m_device, m_pipeline, nullptr);
-        m_pipeline = VK_NULL_HANDLE;
-    }
+    m_depth_format = chooseDepthFormat();
 }
 
-bool vgraphplay::gfx::System::initSwapchainFramebuffers() {
-    if (m_swapchain_framebuffers.size() > 0) {
-        return true;
-    }
-
-    if (m_device == VK_NULL_HANDLE || m_render_pass == VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(error) << "Things have been initialized out of order. Cannot create framebuffer.";
-        return false;
-    }
-
-    m_swapchain_framebuffers.resize(m_swapchain_image_views.size());
-    for (unsigned int i = 0; i < m_swapchain_image_views.size(); ++i) {
-        std::array<VkImageView, 2> attachments{
-            m_swapchain_image_views[i],
-            m_depth_image_view,
-        };
-
-        VkFramebufferCreateInfo fb_ci;
-        fb_ci.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-        fb_ci.pNext = nullptr;
-        fb_ci.flags = 0;
-        fb_ci.renderPass = m_render_pass;
-        fb_ci.attachmentCount = attachments.size();
-        fb_ci.pAttachments = attachments.data();
-        fb_ci.width = m_swapchain_extent.width;
-        fb_ci.height = m_swapchain_extent.height;
-        fb_ci.layers = 1;
-
-        VkResult rslt = vkCreateFramebuffer(m_device, &fb_ci, nullptr, &m_swapchain_framebuffers[i]);
-        if (rslt == VK_SUCCESS) {
-            BOOST_LOG_TRIVIAL(trace) << "Created swapchain framebuffer " << i << ": " << m_swapchain_framebuffers[i];
-        } else {
-            BOOST_LOG_TRIVIAL(error) << "Error creating swapchain framebuffer " << i << ": " << rslt;
-            return false;
-        }
-    }
-
-    return true;
-}
-
-void vgraphplay::gfx::System::cleanupSwapchainFramebuffers() {
-    if (m_device != VK_NULL_HANDLE && m_swapchain_framebuffers.size() > 0) {
-        for (unsigned int i = 0; i < m_swapchain_framebuffers.size(); ++i) {
-            if (m_swapchain_framebuffers[i] != VK_NULL_HANDLE) {
-                BOOST_LOG_TRIVIAL(trace) << "Destroying swapchain framebuffer " << i << ": " << m_swapchain_framebuffers[i];
-                vkDestroyFramebuffer(m_device, m_swapchain_framebuffers[i], nullptr);
+// An explicitly requested device is used if it's suitable and can present.
+// Otherwise the devices that are and can are ranked: by measured fill rate,
+// when every one of them has been measured, and then by score. Ties go to
+// the one enumerated first, so the same machine always makes the same
+// choice.
+size_t vgraphplay::gfx::System::choosePhysicalDevice(const std::vector<DeviceProfile> &profiles, const std::vector<bool> &presentable) {
+    if (!m_device_name.empty()) {
+        for (size_t i = 0; i < profiles.size(); ++i) {
+            if (!deviceMatches(m_device_name, i, profiles[i].name.c_str())) {
+                continue;
             }
+            if (!profiles[i].suitable()) {
+                throw std::runtime_error{"Requested GPU " + profiles[i].name + " is not suitable"};
+            }
+            if (!presentable[i]) {
+                throw std::runtime_error{"Requested GPU " + profiles[i].name + " can't present to the window"};
+            }
+            return i;
         }
-        m_swapchain_framebuffers.clear();
-    }
-}
-
-bool vgraphplay::gfx::System::initSemaphores() {
-    if (m_image_available_semaphore != VK_NULL_HANDLE &&
-        m_render_finished_semaphore != VK_NULL_HANDLE) {
-        return true;
-    }
-
-    if (m_device == VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(error) << "Things have been initialized out of order. Cannot create semaphores.";
-        return false;
-    }
-
-    VkSemaphoreCreateInfo sem_ci;
-    sem_ci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-    sem_ci.pNext = nullptr;
-    sem_ci.flags = 0;
-
-    if (m_image_available_semaphore == VK_NULL_HANDLE) {
-        VkResult rslt = vkCreateSemaphore(m_device, &sem_ci, nullptr, &m_image_available_semaphore);
-        if (rslt == VK_SUCCESS) {
-            BOOST_LOG_TRIVIAL(trace) << "Created image available semaphore: " << m_image_available_semaphore;
+        throw std::runtime_error{"No GPU matches " + m_device_name};
+    }
+
+    bool measured = true;
+    for (size_t i = 0; i < profiles.size(); ++i) {
+        measured = measured && (!presentable[i] || profiles[i].fill_rate > 0.0f);
+    }
+    size_t best = profiles.size();
+    for (size_t i = 0; i < profiles.size(); ++i) {
+        const DeviceProfile &profile = profiles[i];
+        std::string summary = std::format("GPU {}: {} ({}, {} MiB)", i, profile.name, vk::to_string(profile.type),
+                                          profile.device_local_bytes / (1024 * 1024));
+        if (!profile.suitable()) {
+            summary += ", not suitable";
+        } else if (!presentable[i]) {
+            summary += ", can't present";
         } else {
-            BOOST_LOG_TRIVIAL(error) << "Error creating image available semaphore: " << rslt;
-            return false;
+            summary += std::format(", score {:.0f}", profile.score());
         }
-    }
-
-    if (m_render_finished_semaphore == VK_NULL_HANDLE) {
-        VkResult rslt = vkCreateSemaphore(m_device, &sem_ci, nullptr, &m_render_finished_semaphore);
-        if (rslt == VK_SUCCESS) {
-            BOOST_LOG_TRIVIAL(trace) << "Created render finished semaphore: " << m_render_finished_semaphore;
-        } else {
-            BOOST_LOG_TRIVIAL(error) << "Error creating render finished semaphore: " << rslt;
-            return false;
+        if (profile.fill_rate > 0.0f) {
+            summary += std::format(", {:.1f} Gpixel/s", profile.fill_rate);
         }
-    }
-
-    return true;
-}
-
-void vgraphplay::gfx::System::cleanupSemaphores() {
-    if (m_device != VK_NULL_HANDLE && m_image_available_semaphore != VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(trace) << "Destroying image available semaphore: " << m_image_available_semaphore;
-        vkDestroySemaphore(m_device, m_image_available_semaphore, nullptr);
-        m_image_available_semaphore = VK_NULL_HANDLE;
-    }
-
-    if (m_device != VK_NULL_HANDLE && m_render_finished_semaphore != VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(trace) << "Destroying render finished semaphore: " << m_render_finished_semaphore;
-        vkDestroySemaphore(m_device, m_render_finished_semaphore, nullptr);
-        m_render_finished_semaphore = VK_NULL_HANDLE;
-    }
-}
-
-bool vgraphplay::gfx::System::initCommandPool() {
-    if (m_command_pool != VK_NULL_HANDLE) {
-        return true;
-    }
-
-    if (m_device == VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(error) << "Things have been initialized out of order. Cannot create command pool.";
-        return false;
-    }
-
-    VkCommandPoolCreateInfo cp_ci;
-    cp_ci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    cp_ci.pNext = nullptr;
-    cp_ci.flags = 0;
-    cp_ci.queueFamilyIndex = m_graphics_queue_family;
-
-    VkResult rslt = vkCreateCommandPool(m_device, &cp_ci, nullptr, &m_command_pool);
-    if (rslt == VK_SUCCESS) {
-        BOOST_LOG_TRIVIAL(trace) << "Created command pool: " << m_command_pool;
-        return true;
-    } else {
-        BOOST_LOG_TRIVIAL(error) << "Error creating command pool " << rslt;
-        return false;
-    }
-}
-
-void vgraphplay::gfx::System::cleanupCommandPool() {
-    if (m_device != VK_NULL_HANDLE && m_command_pool != VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(trace) << "Destroying command pool: " << m_command_pool;
-        vkDestroyCommandPool(m_device, m_command_pool, nullptr);
-        m_command_pool = VK_NULL_HANDLE;
-    }
-}
-
-bool vgraphplay::gfx::System::initDepthResources() {
-    VkFormat depth_format = chooseDepthFormat();
-    bool brslt = createImage(m_swapchain_extent.width, m_swapchain_extent.height,
-                depth_format,
-                VK_IMAGE_TILING_OPTIMAL,
-                VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                m_depth_image, m_depth_image_memory);
-    if (brslt) {
-        BOOST_LOG_TRIVIAL(trace) << "Created depth image: " << m_depth_image << " and memory: " << m_depth_image_memory;
-    } else {
-        BOOST_LOG_TRIVIAL(error) << "Error creating depth image";
-        return false;
-    }
-
-    m_depth_image_view = createImageView(m_depth_image, depth_format, VK_IMAGE_ASPECT_DEPTH_BIT);
-    if (m_depth_image_view == VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(error) << "Error creating depth image view";
-        return false;
-    } else {
-        BOOST_LOG_TRIVIAL(trace) << "Created depth image view: " << m_depth_image_view;
-    }
-
-    transitionImageLayout(m_depth_image, depth_format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
-
-    return true;
-}
-
-void vgraphplay::gfx::System::cleanupDepthResources() {
-    if (m_device != VK_NULL_HANDLE) {
-        if (m_depth_image_view != VK_NULL_HANDLE) {
-            BOOST_LOG_TRIVIAL(trace) << "Destroying depth image view: " << m_depth_image_view;
-            vkDestroyImageView(m_device, m_depth_image_view, nullptr);
-            m_depth_image_view = VK_NULL_HANDLE;
+        BOOST_LOG_TRIVIAL(info) << summary;
+        if (!presentable[i]) {
+            continue;
         }
 
-        if (m_depth_image != VK_NULL_HANDLE) {
-            BOOST_LOG_TRIVIAL(trace) << "Destroying depth image: " << m_depth_image;
-            vkDestroyImage(m_device, m_depth_image, nullptr);
-            m_depth_image = VK_NULL_HANDLE;
+        if (best == profiles.size()) {
+            best = i;
+            continue;
         }
-
-        if (m_depth_image_memory != VK_NULL_HANDLE) {
-            BOOST_LOG_TRIVIAL(trace) << "Freeing depth image memory: " << m_depth_image_memory;
-            vkFreeMemory(m_device, m_depth_image_memory, nullptr);
-            m_depth_image_memory = VK_NULL_HANDLE;
+        const DeviceProfile &current = profiles[best];
+        if (measured && profile.fill_rate != current.fill_rate) {
+            if (profile.fill_rate > current.fill_rate) {
+                best = i;
+            }
+        } else if (profile.score() > current.score()) {
+            best = i;
         }
     }
-}
 
-VkFormat vgraphplay::gfx::System::chooseDepthFormat() {
-    std::array<VkFormat, 3> candidates{
-        VK_FORMAT_D32_SFLOAT,
-        VK_FORMAT_D32_SFLOAT_S8_UINT,
-        VK_FORMAT_D24_UNORM_S8_UINT,
-    };
-    return chooseFormat(candidates.data(), candidates.size(),
-                        VK_IMAGE_TILING_OPTIMAL,
-                        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
-}
-
-bool vgraphplay::gfx::System::initTextureImage() {
-    if (m_texture_image != VK_NULL_HANDLE && m_texture_image_memory != VK_NULL_HANDLE) {
-        return true;
-    }
-
-    if (m_device == VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(error) << "Things have been initialized out of order. Cannot create texture image";
-        return false;
+    if (best == profiles.size()) {
+        throw std::runtime_error{"Could not find a suitable GPU"};
     }
+    return best;
+}
 
-    int tex_width, tex_height, tex_channels;
-    stbi_uc *pixels = stbi_load_from_memory(WARREN_TEXTURE.begin(), WARREN_TEXTURE.size(),
-                                            &tex_width, &tex_height, &tex_channels,
-                                            STBI_rgb_alpha);
-    VkDeviceSize tex_size = tex_width * tex_height * 4;
-
-    VkBuffer staging_buffer;
-    VkDeviceMemory staging_buffer_memory;
-    bool brslt = createBuffer(tex_size,
-                              VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                              staging_buffer,
-                              staging_buffer_memory);
-
-    if (!brslt) {
-        BOOST_LOG_TRIVIAL(error) << "Unable to create staging buffer for texture image";
-        return false;
+// Creates the swapchain, or replaces it at the current size. While the
+// window has no area (e.g. it's minimized) there's nothing to create, so
+// m_framebuffer_resized is left set to try again next frame.
+void vgraphplay::gfx::System::initSwapchain() {
+    if (m_device == nullptr || m_surface == nullptr) {
+        throw std::runtime_error("Cannot create swapchain; device or surface is null");
     }
 
-    void *data;
-    VkResult rslt = vkMapMemory(m_device, staging_buffer_memory, 0, tex_size, 0, &data);
-    if (rslt == VK_SUCCESS) {
-        BOOST_LOG_TRIVIAL(trace) << "Mapped memory for staging buffer for texture image: " << staging_buffer_memory;
-    } else {
-        BOOST_LOG_TRIVIAL(error) << "Unable to map memory for staging buffer for texture image "<< rslt;
-        return false;
+    const vk::SurfaceCapabilitiesKHR surf_caps = m_physical_device.getSurfaceCapabilitiesKHR(*m_surface);
+    const vk::Extent2D extent = chooseSwapExtent(surf_caps);
+    if (extent.width == 0 || extent.height == 0) {
+        m_framebuffer_resized = true;
+        return;
     }
 
-    std::memcpy(data, pixels, static_cast<size_t>(tex_size));
-    vkUnmapMemory(m_device, staging_buffer_memory);
-    BOOST_LOG_TRIVIAL(trace) << "Unmapped memory for staging buffer for texture image";
-    stbi_image_free(pixels);
-
-    brslt = createImage(static_cast<uint32_t>(tex_width), static_cast<uint32_t>(tex_height),
-                        VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL,
-                        VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                        m_texture_image, m_texture_image_memory);
-    if (brslt) {
-        BOOST_LOG_TRIVIAL(trace) << "Created texture image " << m_texture_image << " with memory " << m_texture_image_memory;
-    } else {
-        BOOST_LOG_TRIVIAL(error) << "Unable to create texture image";
-        return false;
+    // Use one more than the minimum, unless that would put us over the
+    // maximum.
+    uint32_t image_count = surf_caps.minImageCount + 1;
+    if (surf_caps.maxImageCount > 0 && image_count > surf_caps.maxImageCount) {
+        image_count = surf_caps.maxImageCount;
     }
 
-    brslt = transitionImageLayout(m_texture_image, VK_FORMAT_R8G8B8A8_UNORM,
-                                  VK_IMAGE_LAYOUT_UNDEFINED,
-                                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    if (brslt) {
-        BOOST_LOG_TRIVIAL(trace) << "Transitioned texture image " << m_texture_image << " layout for transfer";
-    } else {
-        BOOST_LOG_TRIVIAL(error) << "Unable to transition image layout";
-        return false;
+    const vk::SurfaceFormatKHR format = chooseSurfaceFormat(m_physical_device.getSurfaceFormatsKHR(*m_surface));
+    const vk::PresentModeKHR present_mode = choosePresentMode(m_physical_device.getSurfacePresentModesKHR(*m_surface));
+
+    // Nothing may still be using the old swapchain's images, or the
+    // semaphores their presents wait on.
+    if (m_swapchain != nullptr) {
+        m_device.waitIdle();
+    }
+
+    const vk::SwapchainCreateInfoKHR swapchain_ci{
+        .surface = *m_surface,
+        .minImageCount = image_count,
+        .imageFormat = format.format,
+        .imageColorSpace = format.colorSpace,
+        .imageExtent = extent,
+        .imageArrayLayers = 1,
+        .imageUsage = vk::ImageUsageFlagBits::eColorAttachment,
+        .imageSharingMode = vk::SharingMode::eExclusive,
+        .preTransform = surf_caps.currentTransform,
+        .compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque,
+        .presentMode = present_mode,
+        .clipped = true,
+        .oldSwapchain = *m_swapchain,
+    };
+    vk::raii::SwapchainKHR swapchain{m_device, swapchain_ci, HostAllocator::callbacks()};
+    m_swapchain_views.clear();
+    m_swapchain = std::move(swapchain);
+    m_swapchain_images = m_swapchain.getImages();
+    m_swapchain_format = format;
+    m_swapchain_extent = extent;
+    m_framebuffer_resized = false;
+
+    for (vk::Image image : m_swapchain_images) {
+        const vk::ImageViewCreateInfo view_ci{
+            .image = image,
+            .viewType = vk::ImageViewType::e2D,
+            .format = format.format,
+            .subresourceRange = {
+                .aspectMask = vk::ImageAspectFlagBits::eColor,
+                .baseMipLevel = 0,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
+        };
+        m_swapchain_views.emplace_back(m_device, view_ci, HostAllocator::callbacks());
     }
 
-    brslt = copyBufferToImage(staging_buffer, m_texture_image, tex_width, tex_height);
-    if (brslt) {
-        BOOST_LOG_TRIVIAL(trace) << "Copied staging buffer " << staging_buffer << " to texture image " << m_texture_image;
-    } else {
-        BOOST_LOG_TRIVIAL(error) << "Unable to copy staging buffer to texture image";
-        return false;
+    while (m_render_finished.size() < m_swapchain_images.size()) {
+        m_render_finished.emplace_back(m_device, vk::SemaphoreCreateInfo{}, HostAllocator::callbacks());
     }
 
-    brslt = transitionImageLayout(m_texture_image, VK_FORMAT_R8G8B8A8_UNORM,
-                                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                  VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-    if (brslt) {
-        BOOST_LOG_TRIVIAL(trace) << "Transitioned texture image " << m_texture_image << " layout for sampling";
-    } else {
-        BOOST_LOG_TRIVIAL(error) << "Unable to transition image layout for sampling";
-        return false;
-    }
-
-    vkDestroyBuffer(m_device, staging_buffer, nullptr);
-    BOOST_LOG_TRIVIAL(trace) << "Destroyed staging buffer for texture image";
-    vkFreeMemory(m_device, staging_buffer_memory, nullptr);
-    BOOST_LOG_TRIVIAL(trace) << "Freed staging buffer memory for texture image";
-
-    return true;
+    BOOST_LOG_TRIVIAL(trace) << "Created swapchain: " << *m_swapchain << " (" << extent.width << "x" << extent.height << ", "
+                             << m_swapchain_images.size() << " images, " << vk::to_string(present_mode) << ")";
 }
 
-void vgraphplay::gfx::System::cleanupTextureImage() {
-    if (m_device != VK_NULL_HANDLE) {
-        if (m_texture_image != VK_NULL_HANDLE) {
-            BOOST_LOG_TRIVIAL(trace) << "Destroying texture image: " << m_texture_image;
-            vkDestroyImage(m_device, m_texture_image, nullptr);
-            m_texture_image = VK_NULL_HANDLE;
-        }
-
-        if (m_texture_image_memory != VK_NULL_HANDLE) {
-            BOOST_LOG_TRIVIAL(trace) << "Freeing texture image memory: " << m_texture_image_memory;
-            vkFreeMemory(m_device, m_texture_image_memory, nullptr);
-            m_texture_image_memory = VK_NULL_HANDLE;
+// The shaders write linear color, so a format that encodes it to sRGB is
+// preferred; otherwise whatever the surface lists first.
+vk::SurfaceFormatKHR vgraphplay::gfx::System::chooseSurfaceFormat(const std::vector<vk::SurfaceFormatKHR> &formats) const {
+    for (const vk::SurfaceFormatKHR &format : formats) {
+        if (format.format == vk::Format::eB8G8R8A8Srgb && format.colorSpace == vk::ColorSpaceKHR::eSrgbNonlinear) {
+            return format;
         }
     }
+    return formats.front();
 }
 
-bool vgraphplay::gfx::System::initTextureImageView() {
-    if (m_texture_image_view != VK_NULL_HANDLE) {
-        return true;
-    }
-
-    if (m_device == VK_NULL_HANDLE || m_texture_image == VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(error) << "Things have been initialized out of order. Could not create texture image view.";
-        return false;
-    }
-
-    m_texture_image_view = createImageView(m_texture_image, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT);
-    if (m_texture_image_view == VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(error) << "Unable to create texture image view";
-        return false;
-    } else {
-        BOOST_LOG_TRIVIAL(trace) << "Created texture image view: " << m_texture_image_view;
-    }
-
-    return true;
-}
-
-void vgraphplay::gfx::System::cleanupTextureImageView() {
-    if (m_device != VK_NULL_HANDLE && m_texture_image_view != VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(trace) << "Destroying texture image view: " << m_texture_image_view;
-        vkDestroyImageView(m_device, m_texture_image_view, nullptr);
-        m_texture_image_view = VK_NULL_HANDLE;
-    }
-}
-
-bool vgraphplay::gfx::System::initTextureSampler() {
-    if (m_texture_sampler != VK_NULL_HANDLE) {
-        return true;
-    }
-
-    if (m_device == VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(error) << "Things have been initialized out of order. Cannot create texture sampler.";
-        return false;
-    }
-
-    VkSamplerCreateInfo smp_ci;
-    smp_ci.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-    smp_ci.pNext = nullptr;
-    smp_ci.flags = 0;
-    smp_ci.magFilter = VK_FILTER_LINEAR;
-    smp_ci.minFilter = VK_FILTER_LINEAR;
-    smp_ci.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-    smp_ci.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    smp_ci.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    smp_ci.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-    smp_ci.mipLodBias = 0.0;
-    smp_ci.anisotropyEnable = VK_TRUE;
-    smp_ci.maxAnisotropy = 16.0;
-    smp_ci.compareEnable = VK_FALSE;
-    smp_ci.compareOp = VK_COMPARE_OP_ALWAYS;
-    smp_ci.minLod = 0.0;
-    smp_ci.maxLod = 0.0;
-    smp_ci.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
-    smp_ci.unnormalizedCoordinates = VK_FALSE;
-
-    VkResult rslt = vkCreateSampler(m_device, &smp_ci, nullptr, &m_texture_sampler);
-    if (rslt == VK_SUCCESS) {
-        BOOST_LOG_TRIVIAL(trace) << "Created texture sampler: " << m_texture_sampler;
-    } else {
-        BOOST_LOG_TRIVIAL(error) << "Unable to create texture sampler " << rslt;
-        return false;
-    }
-
-    return true;
-}
-
-void vgraphplay::gfx::System::cleanupTextureSampler() {
-    if (m_device != VK_NULL_HANDLE && m_texture_sampler != VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(trace) << "Destroying texture sampler: " << m_texture_sampler;
-        vkDestroySampler(m_device, m_texture_sampler, nullptr);
-        m_texture_sampler = VK_NULL_HANDLE;
+vk::PresentModeKHR vgraphplay::gfx::System::choosePresentMode(const std::vector<vk::PresentModeKHR> &modes) const {
+    // Prefer mailbox over fifo, if it's available.
+    if (std::ranges::find(modes, vk::PresentModeKHR::eMailbox) != modes.end()) {
+        return vk::PresentModeKHR::eMailbox;
     }
+    return vk::PresentModeKHR::eFifo;
 }
 
-bool vgraphplay::gfx::System::initVertexBuffer() {
-    if (m_vertex_buffer != VK_NULL_HANDLE &&
-        m_vertex_buffer_memory != VK_NULL_HANDLE)
-    {
-        return true;
-    }
-
-    VkDeviceSize buffer_size = sizeof(RECTANGLE_VERTICES);
-    VkBuffer staging_buffer;
-    VkDeviceMemory staging_buffer_memory;
-    bool rslt_b = createBuffer(buffer_size,
-                               VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                               staging_buffer,
-                               staging_buffer_memory);
-
-    if (!rslt_b) {
-        BOOST_LOG_TRIVIAL(error) << "Unable to create staging buffer for vertex buffer";
-        return false;
-    }
-
-    void *buffer_data;
-    VkResult rslt = vkMapMemory(m_device, staging_buffer_memory, 0, buffer_size, 0, &buffer_data);
-    if (rslt == VK_SUCCESS) {
-        BOOST_LOG_TRIVIAL(trace) << "Mapped staging buffer memory " << staging_buffer_memory;
-    } else {
-        BOOST_LOG_TRIVIAL(error) << "Unable to map staging buffer memory " << rslt;
-        return false;
-    }
-
-    Vertex *vertices = static_cast<Vertex*>(buffer_data);
-    std::copy(RECTANGLE_VERTICES, RECTANGLE_VERTICES + NUM_RECTANGLE_VERTICES, vertices);
-
-    vkUnmapMemory(m_device, staging_buffer_memory);
-    BOOST_LOG_TRIVIAL(trace) << "Unmapped staging buffer memory " << staging_buffer_memory;
-
-    rslt_b = createBuffer(buffer_size,
-                          VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                          VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                          m_vertex_buffer,
-                          m_vertex_buffer_memory);
-
-    if (!rslt_b) {
-        BOOST_LOG_TRIVIAL(error) << "Unable to create vertex buffer";
-        return false;
+vk::Extent2D vgraphplay::gfx::System::chooseSwapExtent(const vk::SurfaceCapabilitiesKHR &surf_caps) const {
+    if (surf_caps.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
+        return surf_caps.currentExtent;
     }
-
-    rslt_b = copyBuffer(staging_buffer, m_vertex_buffer, buffer_size);
-    if (!rslt_b) {
-        BOOST_LOG_TRIVIAL(error) << "Unable to copy data to vertex buffer";
-        return false;
+    if (m_framebuffer_size.width == 0 || m_framebuffer_size.height == 0) {
+        return m_framebuffer_size;
     }
 
-    BOOST_LOG_TRIVIAL(trace) << "Destroying staging buffer: " << staging_buffer;
-    vkDestroyBuffer(m_device, staging_buffer, nullptr);
-    staging_buffer = VK_NULL_HANDLE;
-
-    BOOST_LOG_TRIVIAL(trace) << "Freeing staging buffer memory: " << staging_buffer_memory;
-    vkFreeMemory(m_device, staging_buffer_memory, nullptr);
-    staging_buffer_memory = VK_NULL_HANDLE;
-
-    return true;
+    return vk::Extent2D{
+        .width = std::clamp(m_framebuffer_size.width, surf_caps.minImageExtent.width, surf_caps.maxImageExtent.width),
+        .height = std::clamp(m_framebuffer_size.height, surf_caps.minImageExtent.height, surf_caps.maxImageExtent.height),
+    };
 }
 
-void vgraphplay::gfx::System::cleanupVertexBuffer() {
-    if (m_device != VK_NULL_HANDLE) {
-        if (m_vertex_buffer != VK_NULL_HANDLE) {
-            BOOST_LOG_TRIVIAL(trace) << "Destroying vertex buffer: " << m_vertex_buffer;
-            vkDestroyBuffer(m_device, m_vertex_buffer, nullptr);
-            m_vertex_buffer = VK_NULL_HANDLE;
-        }
-
-        if (m_vertex_buffer_memory != VK_NULL_HANDLE) {
-            BOOST_LOG_TRIVIAL(trace) << "Freeing vertex buffer memory: " << m_vertex_buffer_memory;
-            vkFreeMemory(m_device, m_vertex_buffer_memory, nullptr);
-            m_vertex_buffer_memory = VK_NULL_HANDLE;
+// Every device can render depth to one of these with optimal tiling.
+vk::Format vgraphplay::gfx::System::chooseDepthFormat() const {
+    for (vk::Format format : {vk::Format::eD32Sfloat, vk::Format::eD24UnormS8Uint, vk::Format::eD32SfloatS8Uint}) {
+        const vk::FormatProperties props = m_physical_device.getFormatProperties(format);
+        if (props.optimalTilingFeatures & vk::FormatFeatureFlagBits::eDepthStencilAttachment) {
+            return format;
         }
     }
+    throw std::runtime_error("Could not find a depth format to render to");
 }
 
-bool vgraphplay::gfx::System::initIndexBuffer() {
-    if (m_index_buffer != VK_NULL_HANDLE && m_index_buffer_memory != VK_NULL_HANDLE) {
-        return true;
-    }
-
-    if (m_device == VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(error) << "Things have been initialized out of order. Cannot create index buffer.";
-        return false;
-    }
-
-    VkDeviceSize buffer_size = sizeof(RECTANGLE_INDICES);
-    VkBuffer staging_buffer;
-    VkDeviceMemory staging_buffer_memory;
-
-    bool brslt = createBuffer(buffer_size,
-                              VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                              staging_buffer,
-                              staging_buffer_memory);
-    if (!brslt) {
-        BOOST_LOG_TRIVIAL(error) << "Unable to create staging buffer for the index buffer";
-        return false;
-    }
-
-    void *buffer_data = nullptr;
-    VkResult rslt = vkMapMemory(m_device, staging_buffer_memory, 0, buffer_size, 0, &buffer_data);
-    if (rslt == VK_SUCCESS) {
-        BOOST_LOG_TRIVIAL(trace) << "Mapped memory for staging buffer for index buffer";
-    } else {
-        BOOST_LOG_TRIVIAL(error) << "Unable to map memory for staging buffer for index buffer " << rslt;
-        return false;
-    }
-
-    uint16_t *indices = static_cast<uint16_t*>(buffer_data);
-    std::copy(RECTANGLE_INDICES, RECTANGLE_INDICES + NUM_RECTANGLE_INDICES, indices);
-
-    vkUnmapMemory(m_device, staging_buffer_memory);
-    BOOST_LOG_TRIVIAL(trace) << "Unmapped staging buffer memory for index buffer";
-
-    brslt = createBuffer(buffer_size,
-                         VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                         m_index_buffer,
-                         m_index_buffer_memory);
-    if (!brslt) {
-        BOOST_LOG_TRIVIAL(error) << "Unable to create index buffer";
-        return false;
-    }
-
-    brslt = copyBuffer(staging_buffer, m_index_buffer, buffer_size);
-
-    if (!brslt) {
-        BOOST_LOG_TRIVIAL(error) << "Unable to copy index data to index buffer";
-        return false;
-    }
-
-    BOOST_LOG_TRIVIAL(trace) << "Destroying staging buffer for index buffer";
-    vkDestroyBuffer(m_device, staging_buffer, nullptr);
-    staging_buffer = VK_NULL_HANDLE;
-
-    BOOST_LOG_TRIVIAL(trace) << "Freeing staging buffer memory for index buffer";
-    vkFreeMemory(m_device, staging_buffer_memory, nullptr);
-    staging_buffer_memory = VK_NULL_HANDLE;
-
-    return true;
-}
+// A command pool, its one command buffer, and an acquire semaphore for each
+// frame slot.
+void vgraphplay::gfx::System::initFrames() {
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        const vk::CommandPoolCreateInfo pool_ci{
+            .flags = vk::CommandPoolCreateFlagBits::eTransient,
+            .queueFamilyIndex = m_graphics_queue_family,
+        };
+        m_command_pools.emplace_back(m_device, pool_ci, HostAllocator::callbacks());
 
-void vgraphplay::gfx::System::cleanupIndexBuffer() {
-    if (m_device != VK_NULL_HANDLE) {
-        if (m_index_buffer != VK_NULL_HANDLE) {
-            BOOST_LOG_TRIVIAL(trace) << "Destroying index buffer: " << m_index_buffer;
-            vkDestroyBuffer(m_device, m_index_buffer, nullptr);
-            m_index_buffer = VK_NULL_HANDLE;
-        }
+        vk::raii::CommandBuffers buffers{m_device, vk::CommandBufferAllocateInfo{
+            .commandPool = *m_command_pools.back(),
+            .level = vk::CommandBufferLevel::ePrimary,
+            .commandBufferCount = 1,
+        }};
+        m_command_buffers.push_back(std::move(buffers.front()));
 
-        if (m_index_buffer_memory != VK_NULL_HANDLE) {
-            BOOST_LOG_TRIVIAL(trace) << "Freeing index buffer memory: " << m_index_buffer_memory;
-            vkFreeMemory(m_device, m_index_buffer_memory, nullptr);
-            m_index_buffer_memory = VK_NULL_HANDLE;
-        }
+        m_image_available.emplace_back(m_device, vk::SemaphoreCreateInfo{}, HostAllocator::callbacks());
     }
 }
 
-bool vgraphplay::gfx::System::initUniformBuffers() {
-    if (m_uniform_buffers.size() > 0 && m_uniform_buffers_memory.size() > 0) {
-        return true;
-    }
+// Registers the shader programs. Their pipelines are created lazily by
+// m_pipelines as draws ask for each combination of program, render targets
+// and state.
+void vgraphplay::gfx::System::initPipelines() {
+    m_layouts = LayoutCache{m_device};
+    m_pipelines = PipelineCache{m_device, m_resources, m_layouts};
 
-    if (m_device == VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(error) << "Things have been initialized out of order. Unable to create uniform buffers.";
-        return false;
-    }
+    const Resource unlit[] = {
+        UNLIT_PUSH_VERT_BYTECODE,
+        UNLIT_FRAG_BYTECODE,
+    };
+    m_unlit_program = m_pipelines.addProgram(unlit);
 
-    int num_buffers = m_swapchain_framebuffers.size();
-    VkDeviceSize buffer_size = sizeof(Transormations);
-    m_uniform_buffers.resize(num_buffers, VK_NULL_HANDLE);
-    m_uniform_buffers_memory.resize(num_buffers, VK_NULL_HANDLE);
-    bool brslt = false;
-    for (int i = 0; i < num_buffers; ++i) {
-        brslt = createBuffer(buffer_size,
-                             VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                             m_uniform_buffers[i],
-                             m_uniform_buffers_memory[i]);
-        if (!brslt) {
-            BOOST_LOG_TRIVIAL(error) << "Unable to create uniform buffer";
-            return false;
-        }
+    // Set 1 is the bindless table's, which reflection alone can't size.
+    if (m_bindless.isEnabled()) {
+        const Resource unlit_bindless[] = {
+            UNLIT_BINDLESS_VERT_BYTECODE,
+            UNLIT_BINDLESS_FRAG_BYTECODE,
+        };
+        m_unlit_bindless_program = m_pipelines.addProgram(unlit_bindless, {{BindlessTable::SET, *m_bindless.layout()}});
     }
 
-    return true;
-}
-
-void vgraphplay::gfx::System::cleanupUniformBuffers() {
-    if (m_device != VK_NULL_HANDLE) {
-        for (const auto &buffer : m_uniform_buffers) {
-            if (buffer != VK_NULL_HANDLE) {
-                BOOST_LOG_TRIVIAL(trace) << "Destroying uniform buffer: " << buffer;
-                vkDestroyBuffer(m_device, buffer, nullptr);
-            }
-        }
-        m_uniform_buffers.clear();
+    // Draw list batches read per-draw data from the instance stream.
+    const Resource unlit_instanced[] = {
+        UNLIT_INSTANCED_VERT_BYTECODE,
+        UNLIT_FRAG_BYTECODE,
+    };
+    m_unlit_instanced_program = m_pipelines.addProgram(unlit_instanced);
 
-        for (const auto &memory : m_uniform_buffers_memory) {
-            if (memory != VK_NULL_HANDLE) {
-                BOOST_LOG_TRIVIAL(trace) << "Freeing uniform buffer memory: " << memory;
-                vkFreeMemory(m_device, memory, nullptr);
-            }
-        }
-        m_uniform_buffers_memory.clear();
-    }
-}
+    // Shares the instanced layout so the pre-pass can use the same set 0.
+    const Resource depth[] = {
+        DEPTH_INSTANCED_VERT_BYTECODE,
+    };
+    m_depth_program = m_pipelines.addProgram(depth, m_pipelines.layout(m_unlit_instanced_program));
 
-void vgraphplay::gfx::System::updateUniformBuffer(uint32_t current_image) {
-    static auto start_time = std::chrono::high_resolution_clock::now();
-    auto current_time = std::chrono::high_resolution_clock::now();
-    float time = std::chrono::duration<float, std::chrono::seconds::period>(current_time - start_time).count();
-    Transormations xform{};
-
-    xform.model = glm::rotate(glm::mat4x4{1.0f}, time * glm::radians(90.0f), glm::vec3{0.0f, 0.0f, 1.0f});
-    xform.view = glm::lookAt(glm::vec3{2.0f, 2.0f, 2.0f}, glm::vec3{0.0f, 0.0f, 0.0f}, glm::vec3{0.0f, 0.0f, 1.0f});
-    xform.projection = glm::perspective(glm::radians(45.0f), m_swapchain_extent.width / static_cast<float>(m_swapchain_extent.height), 0.1f, 10.0f);
-    xform.projection[1][1] *= -1;
-
-    void *data{nullptr};
-    vkMapMemory(m_device, m_uniform_buffers_memory[current_image], 0, sizeof(Transormations), 0, &data);
-    Transormations *buf_xform = static_cast<Transormations*>(data);
-    std::copy(&xform, &xform + 1, buf_xform);
-    vkUnmapMemory(m_device, m_uniform_buffers_memory[current_image]);
+    m_depth_prepass = DepthPrepass{m_device, m_pipelines, m_depth_program, m_unlit_instanced_program,
+                                   MAX_FRAMES_IN_FLIGHT, m_device_profile.has(DeviceProfile::PIPELINE_STATISTICS)};
 }
 
-bool vgraphplay::gfx::System::initDescriptorPool() {
-    if (m_descriptor_pool != VK_NULL_HANDLE) {
-        return true;
-    }
+// The mesh every object is drawn with, and its texture.
+void vgraphplay::gfx::System::initScene() {
+    const vk::MemoryPropertyFlags host_visible = vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+    auto createFilled = [this, host_visible](const void *data, vk::DeviceSize size, vk::BufferUsageFlags usage) {
+        const BufferHandle buffer = m_resources.createBuffer(size, usage, host_visible);
+        std::memcpy(m_resources.bufferInfo(buffer).mapped, data, size);
+        return buffer;
+    };
 
-    if (m_device == VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(error) << "Things have been initialized out of order. Could not create descriptor pool.";
-        return false;
-    }
+    const std::vector<glm::vec3> positions = positionStream<Vertex>(RECTANGLE_VERTICES);
+    m_vertex_buffer = createFilled(RECTANGLE_VERTICES, sizeof(RECTANGLE_VERTICES), vk::BufferUsageFlagBits::eVertexBuffer);
+    m_position_buffer = createFilled(positions.data(), positions.size() * sizeof(glm::vec3), vk::BufferUsageFlagBits::eVertexBuffer);
+    m_index_buffer = createFilled(RECTANGLE_INDICES, sizeof(RECTANGLE_INDICES), vk::BufferUsageFlagBits::eIndexBuffer);
+    m_mesh = MeshBuffers{
+        .vertices = m_resources.buffer(m_vertex_buffer),
+        .positions = m_resources.buffer(m_position_buffer),
+        .indices = m_resources.buffer(m_index_buffer),
+        .index_type = vk::IndexType::eUint16,
+    };
 
-    std::array<VkDescriptorPoolSize, 2> pool_sizes{};
-    pool_sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    pool_sizes[0].descriptorCount = static_cast<uint32_t>(m_swapchain_images.size());
-    pool_sizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    pool_sizes[1].descriptorCount = static_cast<uint32_t>(m_swapchain_images.size());
-
-    VkDescriptorPoolCreateInfo dp_ci;
-    dp_ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    dp_ci.pNext = nullptr;
-    dp_ci.flags = 0;
-    dp_ci.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
-    dp_ci.pPoolSizes = pool_sizes.data();
-    dp_ci.maxSets = m_swapchain_images.size();
-
-    VkResult rslt = vkCreateDescriptorPool(m_device, &dp_ci, nullptr, &m_descriptor_pool);
-    if (rslt == VK_SUCCESS) {
-        BOOST_LOG_TRIVIAL(trace) << "Created descriptor pool: " << m_descriptor_pool;
-        return true;
-    } else {
-        BOOST_LOG_TRIVIAL(error) << "Could not create descriptor pool " << rslt;
-        return false;
+    m_texture = loadTexture(TEXTURE_ASSET);
+    m_sampler = m_resources.createSampler(vk::SamplerCreateInfo{
+        .magFilter = vk::Filter::eLinear,
+        .minFilter = vk::Filter::eLinear,
+        .mipmapMode = vk::SamplerMipmapMode::eLinear,
+        .addressModeU = vk::SamplerAddressMode::eRepeat,
+        .addressModeV = vk::SamplerAddressMode::eRepeat,
+        .addressModeW = vk::SamplerAddressMode::eRepeat,
+        .maxLod = vk::LodClampNone,
+    });
+}
+
+// A cooked texture from the asset pack, uploaded as its BC blocks where the
+// device can sample them and decoded on the CPU where it can't. Without the
+// pack, or the texture in it, a single white texel stands in.
+vgraphplay::gfx::ImageHandle vgraphplay::gfx::System::loadTexture(std::string_view name) {
+    const std::optional<Resource> cooked = m_assets.isOpen() ? m_assets.find(name) : std::nullopt;
+    if (!cooked) {
+        BOOST_LOG_TRIVIAL(warning) << "No texture " << name << "; drawing untextured";
+        const unsigned char white[] = {255, 255, 255, 255};
+        const vk::ImageCreateInfo image_ci{
+            .imageType = vk::ImageType::e2D,
+            .format = vk::Format::eR8G8B8A8Unorm,
+            .extent = {1, 1, 1},
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = vk::SampleCountFlagBits::e1,
+            .tiling = vk::ImageTiling::eOptimal,
+            .usage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
+            .sharingMode = vk::SharingMode::eExclusive,
+            .initialLayout = vk::ImageLayout::eUndefined,
+        };
+        const vk::BufferImageCopy region{
+            .bufferOffset = 0,
+            .imageSubresource = {.aspectMask = vk::ImageAspectFlagBits::eColor, .mipLevel = 0, .baseArrayLayer = 0, .layerCount = 1},
+            .imageExtent = {1, 1, 1},
+        };
+        return uploadImage(image_ci, white, std::span{&region, 1});
     }
-}
 
-void vgraphplay::gfx::System::cleanupDescriptorPool() {
-    if (m_device != VK_NULL_HANDLE && m_descriptor_pool != VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(trace) << "Destroying descriptor pool: " << m_descriptor_pool;
-        vkDestroyDescriptorPool(m_device, m_descriptor_pool, nullptr);
-        m_descriptor_pool = VK_NULL_HANDLE;
+    const CookedTexture texture{*cooked};
+    if (m_device_profile.has(DeviceProfile::BC_TEXTURES)) {
+        return uploadImage(texture.imageCreateInfo(), std::span{texture.data(), texture.size()}, texture.copyRegions());
     }
+    const std::vector<unsigned char> decoded = texture.decode();
+    return uploadImage(texture.imageCreateInfo(false), decoded, texture.copyRegions(0, false));
 }
 
-bool vgraphplay::gfx::System::initDescriptorSets() {
-    if (m_descriptor_sets.size() > 0) {
-        return true;
-    }
-
-    if (m_device == VK_NULL_HANDLE || m_descriptor_pool == VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(error) << "Things have been initialized out of order. Cannot allocate descriptor sets.";
-        return false;
-    }
-
-    int num_images = m_swapchain_images.size();
-    std::vector<VkDescriptorSetLayout> layouts{m_swapchain_images.size(), m_descriptor_set_layout};
-
-    VkDescriptorSetAllocateInfo ds_ai;
-    ds_ai.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    ds_ai.pNext = nullptr;
-    ds_ai.descriptorPool = m_descriptor_pool;
-    ds_ai.descriptorSetCount = num_images;
-    ds_ai.pSetLayouts = layouts.data();
-
-    m_descriptor_sets.resize(num_images, VK_NULL_HANDLE);
-    VkResult rslt = vkAllocateDescriptorSets(m_device, &ds_ai, m_descriptor_sets.data());
-    if (rslt == VK_SUCCESS) {
-        BOOST_LOG_TRIVIAL(trace) << "Allocated " << num_images << " descriptor sets";
-    } else {
-        BOOST_LOG_TRIVIAL(error) << "Unable to allocate descriptor sets;";
-        return false;
-    }
-
-    for (int i = 0; i < num_images; ++i) {
-        VkDescriptorBufferInfo dbi;
-        dbi.buffer = m_uniform_buffers[i];
-        dbi.offset = 0;
-        dbi.range = sizeof(Transormations);
-
-        VkDescriptorImageInfo dii;
-        dii.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        dii.imageView = m_texture_image_view;
-        dii.sampler = m_texture_sampler;
-
-        std::array<VkWriteDescriptorSet, 2> dsc_writes{};
-
-        dsc_writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        dsc_writes[0].pNext = nullptr;
-        dsc_writes[0].dstSet = m_descriptor_sets[i];
-        dsc_writes[0].dstBinding = 0;
-        dsc_writes[0].dstArrayElement = 0;
-        dsc_writes[0].descriptorCount = 1;
-        dsc_writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        dsc_writes[0].pBufferInfo = &dbi;
-        dsc_writes[0].pImageInfo = nullptr;
-        dsc_writes[0].pTexelBufferView = nullptr;
-
-        dsc_writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        dsc_writes[1].pNext = nullptr;
-        dsc_writes[1].dstSet = m_descriptor_sets[i];
-        dsc_writes[1].dstBinding = 1;
-        dsc_writes[1].dstArrayElement = 0;
-        dsc_writes[1].descriptorCount = 1;
-        dsc_writes[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        dsc_writes[1].pBufferInfo = nullptr;
-        dsc_writes[1].pImageInfo = &dii;
-        dsc_writes[1].pTexelBufferView = nullptr;
-
-        vkUpdateDescriptorSets(m_device, static_cast<uint32_t>(dsc_writes.size()), dsc_writes.data(), 0, nullptr);
-        BOOST_LOG_TRIVIAL(trace) << "Updated descriptor set " << m_descriptor_sets[i];
-    }
+// Copies the data into a new device-local image through a staging buffer,
+// leaving it ready to sample. Waits for the copy, so it's for startup.
+vgraphplay::gfx::ImageHandle vgraphplay::gfx::System::uploadImage(const vk::ImageCreateInfo &image_ci, std::span<const unsigned char> data,
+                                                                  std::span<const vk::BufferImageCopy> regions) {
+    const BufferHandle staging = m_resources.createBuffer(data.size(), vk::BufferUsageFlagBits::eTransferSrc,
+                                                          vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+    std::memcpy(m_resources.bufferInfo(staging).mapped, data.data(), data.size());
+    const ImageHandle image = m_resources.createImage(image_ci, vk::ImageAspectFlagBits::eColor);
 
-    return true;
-}
-
-void vgraphplay::gfx::System::cleanupDescriptorSets() {
-}
+    const vk::raii::CommandPool pool{m_device, vk::CommandPoolCreateInfo{
+        .flags = vk::CommandPoolCreateFlagBits::eTransient,
+        .queueFamilyIndex = m_graphics_queue_family,
+    }, HostAllocator::callbacks()};
+    vk::raii::CommandBuffers buffers{m_device, vk::CommandBufferAllocateInfo{
+        .commandPool = *pool,
+        .level = vk::CommandBufferLevel::ePrimary,
+        .commandBufferCount = 1,
+    }};
+    const vk::raii::CommandBuffer &commands = buffers.front();
+
+    vk::ImageMemoryBarrier2 barrier{
+        .srcStageMask = vk::PipelineStageFlagBits2::eNone,
+        .srcAccessMask = vk::AccessFlagBits2::eNone,
+        .dstStageMask = vk::PipelineStageFlagBits2::eCopy,
+        .dstAccessMask = vk::AccessFlagBits2::eTransferWrite,
+        .oldLayout = vk::ImageLayout::eUndefined,
+        .newLayout = vk::ImageLayout::eTransferDstOptimal,
+        .srcQueueFamilyIndex = vk::QueueFamilyIgnored,
+        .dstQueueFamilyIndex = vk::QueueFamilyIgnored,
+        .image = m_resources.image(image),
+        .subresourceRange = {
+            .aspectMask = vk::ImageAspectFlagBits::eColor,
+            .baseMipLevel = 0,
+            .levelCount = image_ci.mipLevels,
+            .baseArrayLayer = 0,
+            .layerCount = image_ci.arrayLayers,
+        },
+    };
 
-bool vgraphplay::gfx::System::initCommandBuffers() {
-    if (m_command_buffers.size() > 0) {
-        return true;
+    commands.begin(vk::CommandBufferBeginInfo{.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    commands.pipelineBarrier2(vk::DependencyInfo{.imageMemoryBarrierCount = 1, .pImageMemoryBarriers = &barrier});
+    commands.copyBufferToImage(m_resources.buffer(staging), m_resources.image(image), vk::ImageLayout::eTransferDstOptimal, regions);
+    barrier.srcStageMask = vk::PipelineStageFlagBits2::eCopy;
+    barrier.srcAccessMask = vk::AccessFlagBits2::eTransferWrite;
+    barrier.dstStageMask = vk::PipelineStageFlagBits2::eFragmentShader;
+    barrier.dstAccessMask = vk::AccessFlagBits2::eShaderSampledRead;
+    barrier.oldLayout = vk::ImageLayout::eTransferDstOptimal;
+    barrier.newLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+    commands.pipelineBarrier2(vk::DependencyInfo{.imageMemoryBarrierCount = 1, .pImageMemoryBarriers = &barrier});
+    commands.end();
+
+    const uint64_t point = m_timeline.submit(m_graphics_queue, vk::CommandBufferSubmitInfo{.commandBuffer = *commands});
+    m_resources.destroyBuffer(staging, point);
+    // The pool and its command buffer go when this returns.
+    m_timeline.wait(point);
+    return image;
+}
+
+// Destroys retired objects the GPU is done with, waits until it has finished
+// with the current frame slot's previous submission, so its command buffers,
+// per-frame buffers and transient descriptor sets can be reused, and returns
+// the slot index.
+uint32_t vgraphplay::gfx::System::beginFrame() {
+    m_deletion_queue.collect();
+    m_timeline.wait(m_frame_points[m_current_frame]);
+    m_command_pools[m_current_frame].reset();
+    m_frame_descriptors[m_current_frame].reset();
+    m_depth_prepass.collect(m_current_frame);
+    m_draw_constants.beginFrame(m_current_frame, m_camera);
+    m_draw_list.begin(m_current_frame);
+    m_render_graph.reset();
+    return m_current_frame;
+}
+
+// Builds the frame into the slot's command buffer: the draw list, then the
+// graph around it, which records everything.
+void vgraphplay::gfx::System::recordFrame(uint32_t frame, uint32_t image_index) {
+    // Set 0, the same for every draw: the frame's camera and the texture.
+    DescriptorSetKey key{m_pipelines.setLayout(m_unlit_instanced_program, 0)};
+    key.image(TEXTURE_BINDING, vk::DescriptorType::eCombinedImageSampler, m_resources.sampler(m_sampler), m_resources.imageView(m_texture));
+    const vk::DescriptorSet set = m_draw_constants.cameraSet(key, m_descriptor_cache);
+
+    const size_t listed = std::min<size_t>(m_objects.size(), MAX_DRAWS_PER_FRAME);
+    for (size_t i = 0; i < listed; ++i) {
+        const DrawItem item{
+            .mesh = &m_mesh,
+            .index_count = NUM_RECTANGLE_INDICES,
+            .first_index = 0,
+            .vertex_offset = 0,
+            .features = PipelineState::TEXTURED | PipelineState::VERTEX_COLOR,
+            .set = set,
+            .draw = m_objects[i],
+        };
+        DepthPrepass::addDraw(m_draw_list, item, m_camera.view);
     }
+    m_draw_list.build();
 
-    if (m_device == VK_NULL_HANDLE || m_command_pool == VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(error) << "Things have been initialized out of order. Cannot create command buffers.";
-        return false;
+    const RenderImageDesc color_desc{
+        .format = m_swapchain_format.format,
+        .extent = m_swapchain_extent,
+        .aspect = vk::ImageAspectFlagBits::eColor,
+    };
+    // Waits for the acquire semaphore at this stage, so that's where the
+    // image's first barrier starts.
+    const RenderResource color = m_render_graph.importImage("swapchain", m_swapchain_images[image_index], *m_swapchain_views[image_index], color_desc,
+                                                            vk::ImageLayout::eUndefined, vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+                                                            vk::ImageLayout::ePresentSrcKHR);
+    const RenderImageDesc depth_desc{
+        .format = m_depth_format,
+        .extent = m_swapchain_extent,
+        .aspect = m_depth_format == vk::Format::eD32Sfloat ? vk::ImageAspectFlags{vk::ImageAspectFlagBits::eDepth}
+                                                           : vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil,
+    };
+    const RenderResource depth = m_render_graph.createImage("depth", depth_desc);
+    m_depth_prepass.addPasses(m_render_graph, frame, color, depth, m_draw_list);
+
+    // Whatever didn't fit in the draw list goes on top, one draw at a time.
+    if (listed < m_objects.size()) {
+        const TargetsId targets = m_pipelines.addTargets(std::span{&color_desc.format, 1}, m_depth_format);
+        m_render_graph.addPass("overflow", [this, set, color, depth, listed, targets](const vk::raii::CommandBuffer &commands, const RenderGraph &graph) {
+            const vk::Extent2D extent = graph.imageDesc(color).extent;
+            const vk::RenderingAttachmentInfo color_attachment{
+                .imageView = graph.imageView(color),
+                .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+                .loadOp = vk::AttachmentLoadOp::eLoad,
+                .storeOp = vk::AttachmentStoreOp::eStore,
+            };
+            const vk::RenderingAttachmentInfo depth_attachment{
+                .imageView = graph.imageView(depth),
+                .imageLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
+                .loadOp = vk::AttachmentLoadOp::eLoad,
+                .storeOp = vk::AttachmentStoreOp::eStore,
+            };
+            commands.beginRendering(vk::RenderingInfo{
+                .renderArea = {.offset = {0, 0}, .extent = extent},
+                .layerCount = 1,
+                .colorAttachmentCount = 1,
+                .pColorAttachments = &color_attachment,
+                .pDepthAttachment = &depth_attachment,
+            });
+            commands.setViewport(0, vk::Viewport{
+                .x = 0.0f,
+                .y = 0.0f,
+                .width = static_cast<float>(extent.width),
+                .height = static_cast<float>(extent.height),
+                .minDepth = 0.0f,
+                .maxDepth = 1.0f,
+            });
+            commands.setScissor(0, vk::Rect2D{.offset = {0, 0}, .extent = extent});
+
+            const vk::PipelineLayout layout = m_pipelines.layout(m_unlit_program);
+            commands.bindPipeline(vk::PipelineBindPoint::eGraphics, m_pipelines.pipeline(PipelineKey{m_unlit_program, targets, PipelineState{}}));
+            commands.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, layout, 0, set, nullptr);
+            commands.bindVertexBuffers(0, m_mesh.vertices, vk::DeviceSize{0});
+            commands.bindIndexBuffer(m_mesh.indices, 0, m_mesh.index_type);
+            for (size_t i = listed; i < m_objects.size(); ++i) {
+                m_draw_constants.push(commands, layout, m_objects[i]);
+                commands.drawIndexed(NUM_RECTANGLE_INDICES, 1, 0, 0, 0);
+            }
+            commands.endRendering();
+        }).read(color, Access::ColorAttachment)
+          .write(color, Access::ColorAttachment)
+          .read(depth, Access::DepthAttachment)
+          .write(depth, Access::DepthAttachment);
     }
 
-    size_t num_buffers = m_swapchain_framebuffers.size();
-    m_command_buffers.resize(num_buffers);
+    m_render_graph.compile();
 
-    VkCommandBufferAllocateInfo cb_ai;
-    cb_ai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    cb_ai.pNext = nullptr;
-    cb_ai.commandPool = m_command_pool;
-    cb_ai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    cb_ai.commandBufferCount = static_cast<uint32_t>(num_buffers);
-
-    VkResult rslt = vkAllocateCommandBuffers(m_device, &cb_ai, m_command_buffers.data());
-    if (rslt == VK_SUCCESS) {
-        BOOST_LOG_TRIVIAL(trace) << "Allocated " << m_command_buffers.size() << " command buffers";
-        return true;
-    } else {
-        BOOST_LOG_TRIVIAL(error) << "Error creating command buffers " << rslt;
-        return false;
-    }
+    const vk::raii::CommandBuffer &commands = m_command_buffers[frame];
+    commands.begin(vk::CommandBufferBeginInfo{.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    m_render_graph.execute(commands);
+    commands.end();
 }
 
-void vgraphplay::gfx::System::cleanupCommandBuffers() {
-    if (m_command_buffers.size() > 0 &&
-        m_device != VK_NULL_HANDLE &&
-        m_command_pool != VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(trace) << "Freeing " << m_command_buffers.size() << " command buffers";
-        vkFreeCommandBuffers(m_device, m_command_pool, m_command_buffers.size(), m_command_buffers.data());
-        m_command_buffers.clear();
-    }
+// Records the timeline point signalled by the current frame's submission and
+// moves on to the next slot.
+void vgraphplay::gfx::System::endFrame(uint64_t point) {
+    m_frame_points[m_current_frame] = point;
+    m_current_frame = (m_current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
 }
 
-bool vgraphplay::gfx::System::recordCommandBuffers() {
-    for (unsigned int i = 0; i < m_command_buffers.size(); ++i) {
-        VkCommandBufferBeginInfo cb_bi;
-        cb_bi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        cb_bi.pNext = nullptr;
-        cb_bi.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-        cb_bi.pInheritanceInfo = nullptr;
-
-        VkResult rslt = vkBeginCommandBuffer(m_command_buffers[i], &cb_bi);
-        if (rslt == VK_SUCCESS) {
-            BOOST_LOG_TRIVIAL(trace) << "Beginning recording to command buffer " << m_command_buffers[i];
-        } else {
-            BOOST_LOG_TRIVIAL(error) << "Error beginning command buffer recording: " << rslt;
-            return false;
-        }
-
-        VkRenderPassBeginInfo rp_bi;
-        rp_bi.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        rp_bi.pNext = nullptr;
-        rp_bi.renderPass = m_render_pass;
-        rp_bi.framebuffer = m_swapchain_framebuffers[i];
-        rp_bi.renderArea.offset = { 0, 0 };
-        rp_bi.renderArea.extent = m_swapchain_extent;
-
-        std::array<VkClearValue, 2> clear_values{};
-        clear_values[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
-        clear_values[1].depthStencil = { 1.0f, 0 };
-        rp_bi.clearValueCount = clear_values.size();
-        rp_bi.pClearValues = clear_values.data();
-
-        VkBuffer vertex_buffers[] = {m_vertex_buffer};
-        VkDeviceSize offsets[] = {0};
-
-        vkCmdBeginRenderPass(m_command_buffers[i], &rp_bi, VK_SUBPASS_CONTENTS_INLINE);
-        vkCmdBindPipeline(m_command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
-        vkCmdBindVertexBuffers(m_command_buffers[i], 0, 1, vertex_buffers, offsets);
-        vkCmdBindIndexBuffer(m_command_buffers[i], m_index_buffer, 0, VK_INDEX_TYPE_UINT16);
-        vkCmdBindDescriptorSets(m_command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline_layout, 0, 1, &m_descriptor_sets[i], 0, nullptr);
-        vkCmdDrawIndexed(m_command_buffers[i], NUM_RECTANGLE_INDICES, 1, 0, 0, 0);
-        vkCmdEndRenderPass(m_command_buffers[i]);
-
-        rslt = vkEndCommandBuffer(m_command_buffers[i]);
-        if (rslt == VK_SUCCESS) {
-            BOOST_LOG_TRIVIAL(trace) << "Finished recording to command buffer " << m_command_buffers[i];
-        } else {
-            BOOST_LOG_TRIVIAL(trace) << "Error finishing command buffer recording: " << rslt;
-            return false;
-        }
-    }
-
-    return true;
-}
+void vgraphplay::gfx::System::drawFrame(const FramePacket &packet) {
+    m_camera = packet.camera;
+    packet.interpolate(std::chrono::steady_clock::now(), m_objects);
+    m_depth_prepass.setEnabled(packet.depth_prepass);
+    m_last_sequence = packet.sequence;
 
-uint32_t vgraphplay::gfx::System::chooseMemoryTypeIndex(uint32_t type_filter, VkMemoryPropertyFlags properties) {
-    VkPhysicalDeviceMemoryProperties mem_props;
-    vkGetPhysicalDeviceMemoryProperties(m_physical_device, &mem_props);
+    m_host_allocator.nextFrame();
+#if VGRAPHPLAY_VULKAN_API_STATS
+    ApiStats::nextFrame();
+#endif
 
-    for (uint32_t i = 0; i < mem_props.memoryTypeCount; ++i) {
-        if (type_filter & (1 << i) &&
-            (mem_props.memoryTypes[i].propertyFlags & properties) == properties)
-        {
-            return i;
+    if (m_framebuffer_resized) {
+        initSwapchain();
+        if (m_framebuffer_resized) {
+            return;
         }
     }
 
-    return std::numeric_limits<uint32_t>::max();
-}
-
-VkFormat vgraphplay::gfx::System::chooseFormat(const VkFormat *candidates, int num_candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
-    for (int i = 0; i < num_candidates; ++i) {
-        const VkFormat &format = candidates[i];
-        VkFormatProperties props;
-        vkGetPhysicalDeviceFormatProperties(m_physical_device, format, &props);
-
-        if (tiling == VK_IMAGE_TILING_LINEAR && (props.linearTilingFeatures & features) == features) {
-            return format;
-        } else if (tiling == VK_IMAGE_TILING_OPTIMAL && (props.optimalTilingFeatures & features) == features) {
-            return format;
+    // If the acquire fails, the slot is simply begun again next time.
+    const uint32_t frame = beginFrame();
+    uint32_t image_index = 0;
+    try {
+        auto [result, index] = m_swapchain.acquireNextImage(std::numeric_limits<uint64_t>::max(), *m_image_available[frame]);
+        if (result == vk::Result::eSuboptimalKHR) {
+            m_framebuffer_resized = true;
         }
+        image_index = index;
+    } catch (const vk::OutOfDateKHRError &) {
+        m_framebuffer_resized = true;
+        return;
     }
 
-    return VK_FORMAT_UNDEFINED;
-}
-
-bool vgraphplay::gfx::System::hasStencilComponent(VkFormat format) {
-    return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
-}
-
-bool vgraphplay::gfx::System::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags mem_props, VkBuffer &buffer, VkDeviceMemory &memory) {
-    if (m_device == VK_NULL_HANDLE) {
-        BOOST_LOG_TRIVIAL(error) << "Device has not been initialized. Cannot create buffer";
-        return false;
-    }
-
-    VkBufferCreateInfo buf_ci;
-    buf_ci.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    buf_ci.pNext = nullptr;
-    buf_ci.flags = 0;
-    buf_ci.size = size;
-    buf_ci.usage = usage;
-    buf_ci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    buf_ci.queueFamilyIndexCount = 0;
-    buf_ci.pQueueFamilyIndices = nullptr;
-
-    VkResult rslt = vkCreateBuffer(m_device, &buf_ci, nullptr, &buffer);
-    if (rslt == VK_SUCCESS) {
-        BOOST_LOG_TRIVIAL(trace) << "Created buffer: " << buffer;
-    } else {
-        BOOST_LOG_TRIVIAL(error) << "Error creating buffer " << rslt;
-        return false;
-    }
-
-    VkMemoryRequirements mem_reqs;
-    vkGetBufferMemoryRequirements(m_device, buffer, &mem_reqs);
-    uint32_t memory_type = chooseMemoryTypeIndex(mem_reqs.memoryTypeBits, mem_props);
-    if (memory_type == std::numeric_limits<uint32_t>::max()) {
-        BOOST_LOG_TRIVIAL(error) << "No suitable memory type for buffer";
-        return false;
-    }
-
-    VkMemoryAllocateInfo mem_ai;
-    mem_ai.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    mem_ai.pNext = nullptr;
-    mem_ai.allocationSize = mem_reqs.size;
-    mem_ai.memoryTypeIndex = memory_type;
-
-    rslt = vkAllocateMemory(m_device, &mem_ai, nullptr, &memory);
-    if (rslt == VK_SUCCESS) {
-        BOOST_LOG_TRIVIAL(trace) << "Allocated buffer memory: " << memory;
-    } else {
-        BOOST_LOG_TRIVIAL(error) << "Error allocating buffer memory " << rslt;
-        return false;
-    }
-
-    rslt = vkBindBufferMemory(m_device, buffer, memory, 0);
-    if (rslt == VK_SUCCESS) {
-        BOOST_LOG_TRIVIAL(trace) << "Bound memory allocation " << memory << " to buffer " << buffer;
-        return true;
-    } else {
-        BOOST_LOG_TRIVIAL(error) << "Error binding memory allocation to buffer " << rslt;
-        return false;
-    }
-}
-
-bool vgraphplay::gfx::System::createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage &image, VkDeviceMemory &memory) {
-    VkImageCreateInfo img_ci;
-    img_ci.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    img_ci.pNext = nullptr;
-    img_ci.flags = 0;
-    img_ci.imageType = VK_IMAGE_TYPE_2D;
-    img_ci.format = format;
-    img_ci.extent.width = width;
-    img_ci.extent.height = height;
-    img_ci.extent.depth = 1;
-    img_ci.mipLevels = 1;
-    img_ci.arrayLayers = 1;
-    img_ci.samples = VK_SAMPLE_COUNT_1_BIT;
-    img_ci.tiling = tiling;
-    img_ci.usage = usage;
-    img_ci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    img_ci.queueFamilyIndexCount = 0;
-    img_ci.pQueueFamilyIndices = nullptr;
-    img_ci.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-
-    VkResult rslt = vkCreateImage(m_device, &img_ci, nullptr, &image);
-    if (rslt == VK_SUCCESS) {
-        BOOST_LOG_TRIVIAL(trace) << "Created image: " << image;
-    } else {
-        BOOST_LOG_TRIVIAL(error) << "Unable to create image " << rslt;
-        return false;
-    }
-
-    VkMemoryRequirements mem_reqs;
-    vkGetImageMemoryRequirements(m_device, image, &mem_reqs);
-
-    VkMemoryAllocateInfo mem_ai;
-    mem_ai.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    mem_ai.pNext = nullptr;
-    mem_ai.memoryTypeIndex = chooseMemoryTypeIndex(mem_reqs.memoryTypeBits, properties);
-    mem_ai.allocationSize = mem_reqs.size;
-
-    rslt = vkAllocateMemory(m_device, &mem_ai, nullptr, &memory);
-    if (rslt == VK_SUCCESS) {
-        BOOST_LOG_TRIVIAL(trace) << "Allocated memory for image: " << memory;
-    } else {
-        BOOST_LOG_TRIVIAL(error) << "Unable to allocate memory for image " << rslt;
-        return false;
-    }
-
-    rslt = vkBindImageMemory(m_device, image, memory, 0);
-    if (rslt == VK_SUCCESS) {
-        BOOST_LOG_TRIVIAL(trace) << "Bound memory " << memory << " to image " << image;
-    } else {
-        BOOST_LOG_TRIVIAL(error) << "Unable to bind memory to image " << rslt;
-        return false;
-    }
-
-    return true;
-}
-
-VkImageView vgraphplay::gfx::System::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspect_mask) {
-    VkImageViewCreateInfo iv_ci;
-    iv_ci.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-    iv_ci.pNext = nullptr;
-    iv_ci.flags = 0;
-    iv_ci.image = image;
-    iv_ci.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    iv_ci.format = format;
-    iv_ci.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-    iv_ci.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-    iv_ci.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-    iv_ci.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
-    iv_ci.subresourceRange.aspectMask = aspect_mask;
-    iv_ci.subresourceRange.baseMipLevel = 0;
-    iv_ci.subresourceRange.levelCount = 1;
-    iv_ci.subresourceRange.baseArrayLayer = 0;
-    iv_ci.subresourceRange.layerCount = 1;
-
-    VkImageView iv_rv;
-    VkResult rslt = vkCreateImageView(m_device, &iv_ci, nullptr, &iv_rv);
-    if (rslt == VK_SUCCESS) {
-        BOOST_LOG_TRIVIAL(trace) << "Created image view: " << iv_rv;
-    } else {
-        BOOST_LOG_TRIVIAL(error) << "Error creating image view " << rslt;
-        return VK_NULL_HANDLE;
-    }
-
-    return iv_rv;
-}
-
-bool vgraphplay::gfx::System::copyBuffer(VkBuffer src, VkBuffer dst, VkDeviceSize size) {
-    VkBufferCopy region;
-    region.srcOffset = 0;
-    region.dstOffset = 0;
-    region.size = size;
-
-    VkCommandBuffer xfer_cb = beginOneTimeCommands();
-    if (xfer_cb == VK_NULL_HANDLE) {
-        return false;
-    }
-
-    vkCmdCopyBuffer(xfer_cb, src, dst, 1, &region);
-
-    return endOneTimeCommands(xfer_cb);
-}
-
-bool vgraphplay::gfx::System::copyBufferToImage(VkBuffer src, VkImage dst, uint32_t width, uint32_t height) {
-    VkCommandBuffer cb = beginOneTimeCommands();
-    if (cb == VK_NULL_HANDLE) {
-        return false;
-    }
-
-    VkBufferImageCopy bi_cp;
-    bi_cp.bufferOffset = 0;
-    bi_cp.bufferRowLength = 0;
-    bi_cp.bufferImageHeight = 0;
-    bi_cp.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    bi_cp.imageSubresource.mipLevel = 0;
-    bi_cp.imageSubresource.layerCount = 1;
-    bi_cp.imageSubresource.baseArrayLayer = 0;
-    bi_cp.imageOffset = { 0, 0, 0 };
-    bi_cp.imageExtent = { width, height, 1 };
-
-    vkCmdCopyBufferToImage(cb, src, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bi_cp);
-
-    return endOneTimeCommands(cb);
-}
-
-bool vgraphplay::gfx::System::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout) {
-    VkCommandBuffer cb = beginOneTimeCommands();
-    if (cb == VK_NULL_HANDLE) {
-        return false;
-    }
+    recordFrame(frame, image_index);
 
-    VkImageMemoryBarrier barrier;
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.pNext = nullptr;
-    barrier.oldLayout = old_layout;
-    barrier.newLayout = new_layout;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.image = image;
-    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
-
-    VkPipelineStageFlags src_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
-    VkPipelineStageFlags dst_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
-
-    if (new_layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-
-        if (hasStencilComponent(format)) {
-            barrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+    const vk::CommandBufferSubmitInfo command_info{.commandBuffer = *m_command_buffers[frame]};
+    const vk::SemaphoreSubmitInfo wait{
+        .semaphore = *m_image_available[frame],
+        .stageMask = vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+    };
+    const vk::SemaphoreSubmitInfo signal{
+        .semaphore = *m_render_finished[image_index],
+        .stageMask = vk::PipelineStageFlagBits2::eAllCommands,
+    };
+    endFrame(m_timeline.submit(m_graphics_queue, command_info, wait, signal));
+    ++m_frame_count;
+
+    const vk::PresentInfoKHR present_info{
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores = &*m_render_finished[image_index],
+        .swapchainCount = 1,
+        .pSwapchains = &*m_swapchain,
+        .pImageIndices = &image_index,
+    };
+    try {
+        if (m_graphics_queue.presentKHR(present_info) == vk::Result::eSuboptimalKHR) {
+            m_framebuffer_resized = true;
         }
+    } catch (const vk::OutOfDateKHRError &) {
+        m_framebuffer_resized = true;
     }
-
-    if (old_layout == VK_IMAGE_LAYOUT_UNDEFINED && new_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-        barrier.srcAccessMask = 0;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        src_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        dst_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    } else if (old_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && new_layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        src_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        dst_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    } else if (old_layout == VK_IMAGE_LAYOUT_UNDEFINED && new_layout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL) {
-        barrier.srcAccessMask = 0;
-        barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-        src_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        dst_stage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    }
-
-    vkCmdPipelineBarrier(cb, src_stage, dst_stage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-    return endOneTimeCommands(cb);
 }
 
-VkCommandBuffer vgraphplay::gfx::System::beginOneTimeCommands() {
-    VkCommandBufferAllocateInfo cb_ai;
-    cb_ai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    cb_ai.pNext = nullptr;
-    cb_ai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    cb_ai.commandPool = m_command_pool;
-    cb_ai.commandBufferCount = 1;
-
-    VkCommandBuffer cb_rv{VK_NULL_HANDLE};
-    VkResult rslt = vkAllocateCommandBuffers(m_device, &cb_ai, &cb_rv);
-    if (rslt == VK_SUCCESS) {
-        BOOST_LOG_TRIVIAL(trace) << "Allocated command buffer: " << cb_rv;
-    } else {
-        BOOST_LOG_TRIVIAL(error) << "Unable to allocate command buffer " << rslt;
-        return VK_NULL_HANDLE;
-    }
-
-    VkCommandBufferBeginInfo cb_bi;
-    cb_bi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    cb_bi.pNext = nullptr;
-    cb_bi.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    cb_bi.pInheritanceInfo = nullptr;
-
-    vkBeginCommandBuffer(cb_rv, &cb_bi);
-
-    return cb_rv;
-}
-
-bool vgraphplay::gfx::System::endOneTimeCommands(VkCommandBuffer commands) {
-    VkResult rslt = vkEndCommandBuffer(commands);
-    if (rslt != VK_SUCCESS) {
-        BOOST_LOG_TRIVIAL(error) << "Error ending recording to command buffer " << rslt;
-        return false;
-    }
-
-    VkSubmitInfo si;
-    si.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    si.pNext = nullptr;
-    si.waitSemaphoreCount = 0;
-    si.pWaitSemaphores = nullptr;
-    si.pWaitDstStageMask = nullptr;
-    si.commandBufferCount = 1;
-    si.pCommandBuffers = &commands;
-    si.signalSemaphoreCount = 0;
-    si.pSignalSemaphores = nullptr;
-
-    rslt = vkQueueSubmit(m_graphics_queue, 1, &si, VK_NULL_HANDLE);
-    if (rslt == VK_SUCCESS) {
-        BOOST_LOG_TRIVIAL(trace) << "Submitted command buffer " << commands;
-    } else {
-        BOOST_LOG_TRIVIAL(error) << "Failed to submit command buffer " << rslt;
-        return false;
-    }
-
-    vkQueueWaitIdle(m_graphics_queue);
-    if (rslt == VK_SUCCESS) {
-        BOOST_LOG_TRIVIAL(trace) << "Finished executing command buffer " << commands;
-    } else {
-        BOOST_LOG_TRIVIAL(error) << "Error waiting for command buffer to complete " << rslt;
-        return false;
-    }
-
-    vkFreeCommandBuffers(m_device, m_command_pool, 1, &commands);
-    return true;
-} */
-
-void vgraphplay::gfx::System::drawFrame() {
-    /* uint32_t image_index;
-
-    if (m_framebuffer_resized) {
-        recreateSwapchain();
-        m_framebuffer_resized = false;
-    }
-
-    VkResult rslt = vkAcquireNextImageKHR(m_device, m_swapchain, std::numeric_limits<uint64_t>::max(),
-                                          m_image_available_semaphore, VK_NULL_HANDLE, &image_index);
-
-    if (rslt == VK_ERROR_OUT_OF_DATE_KHR || rslt == VK_SUBOPTIMAL_KHR) {
-        recreateSwapchain();
-        return;
-    } else if (rslt != VK_SUCCESS) {
-        BOOST_LOG_TRIVIAL(error) << "Error acquiring next swapchain image: " << rslt;
-        return;
-    }
-
-    updateUniformBuffer(image_index);
-
-    VkPipelineStageFlags wait_stages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-    VkSubmitInfo si;
-    si.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    si.pNext = nullptr;
-    si.waitSemaphoreCount = 1;
-    si.pWaitSemaphores = &m_image_available_semaphore;
-    si.pWaitDstStageMask = wait_stages;
-    si.commandBufferCount = 1;
-    si.pCommandBuffers = &m_command_buffers[image_index];
-    si.signalSemaphoreCount = 1;
-    si.pSignalSemaphores = &m_render_finished_semaphore;
-
-    rslt = vkQueueSubmit(m_graphics_queue, 1, &si, VK_NULL_HANDLE);
-    if (rslt != VK_SUCCESS) {
-        BOOST_LOG_TRIVIAL(error) << "Error submitting draw command buffer: " << rslt;
-    }
-
-    VkPresentInfoKHR pi;
-    pi.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-    pi.pNext = nullptr;
-    pi.waitSemaphoreCount = 1;
-    pi.pWaitSemaphores = &m_render_finished_semaphore;
-    pi.swapchainCount = 1;
-    pi.pSwapchains = &m_swapchain;
-    pi.pImageIndices = &image_index;
-    pi.pResults = nullptr;
-
-    rslt = vkQueuePresentKHR(m_present_queue, &pi);
-    if (rslt != VK_SUCCESS) {
-        BOOST_LOG_TRIVIAL(error) << "Error submitting swapchain update: " << rslt;
-    } */
-}
-
-void vgraphplay::gfx::System::setFramebufferResized() {
-    // m_framebuffer_resized = true;
+vgraphplay::gfx::RenderStats vgraphplay::gfx::System::stats() const {
+    return RenderStats{
+        .frames = m_frame_count,
+        .last_sequence = m_last_sequence,
+        .overdraw = m_depth_prepass.stats(),
+        .unsorted_binds = m_draw_list.unsortedStats(),
+        .sorted_binds = m_draw_list.sortedStats(),
+        .host_allocations = m_host_allocator.stats(),
+    };
 }
 
-/* VkVertexInputBindingDescription vgraphplay::gfx::Vertex::bindingDescription() {
-    VkVertexInputBindingDescription desc;
-    desc.binding = 0;
-    desc.stride = sizeof(Vertex);
-    desc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-    return desc;
+void vgraphplay::gfx::System::setFramebufferSize(int width, int height) {
+    m_framebuffer_size = vk::Extent2D{
+        .width = static_cast<uint32_t>(std::max(width, 0)),
+        .height = static_cast<uint32_t>(std::max(height, 0)),
+    };
+    m_framebuffer_resized = true;
 }
 
-std::array<VkVertexInputAttributeDescription, 3> vgraphplay::gfx::Vertex::attributeDescription() {
-    std::array<VkVertexInputAttributeDescription, 3> descs{};
-
-    descs[0].binding = 0;
-    descs[0].location = 0;
-    descs[0].offset = offsetof(Vertex, pos);
-    descs[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-
-    descs[1].binding = 0;
-    descs[1].location = 1;
-    descs[1].offset = offsetof(Vertex, color);
-    descs[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-
-    descs[2].binding = 0;
-    descs[2].location = 2;
-    descs[2].offset = offsetof(Vertex, tex);
-    descs[2].format = VK_FORMAT_R32G32_SFLOAT;
-
-    return descs;
-} */
-
 bool hasExtension(std::vector<vk::ExtensionProperties> &all_extensions, const char *extension_name) {
     return std::ranges::any_of(
         all_extensions,
@@ -2304,6 +1043,9 @@ std::vector<const char *> buildInstanceExtensionList(vk::raii::Context &context,
 
 std::vector<const char *> buildInstanceLayerList(vk::raii::Context &context, bool debug) {
     std::vector<const char *> rv;
+    if (!debug) {
+        return rv;
+    }
 
     std::vector<vk::LayerProperties> all_layers = context.enumerateInstanceLayerProperties();
     std::vector<const char *> required_layers{
@@ -2319,4 +1061,19 @@ std::vector<const char *> buildInstanceLayerList(vk::raii::Context &context, boo
     }
     
     return rv;
-}
\ No newline at end of file
+}
+
+// A selector of all digits is a device index; anything else matches any
+// device with it in its name, ignoring case.
+bool deviceMatches(const std::string &selector, size_t index, const char *name) {
+    if (std::ranges::all_of(selector, [](unsigned char c) { return std::isdigit(c); })) {
+        return std::to_string(index) == selector;
+    }
+
+    auto lower = [](unsigned char c) { return static_cast<char>(std::tolower(c)); };
+    std::string haystack{name};
+    std::string needle{selector};
+    std::ranges::transform(haystack, haystack.begin(), lower);
+    std::ranges::transform(needle, needle.begin(), lower);
+    return haystack.find(needle) != std::string::npos;
+}
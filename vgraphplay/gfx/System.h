@@ -4,15 +4,36 @@
 #define _VGRAPHPLAY_VGRAPHPLAY_GFX_SYSTEM_H_
 
 #include <array>
+#include <span>
+#include <string>
+#include <string_view>
 #include <vector>
 #include <glm/mat4x4.hpp>
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
+#define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
 #include "../vulkan.h"
 
+#include "../AssetPack.h"
+#include "../JobSystem.h"
+#include "../RunConfig.h"
+#include "Bindless.h"
+#include "DeletionQueue.h"
+#include "DepthPrepass.h"
+#include "DescriptorAllocator.h"
+#include "DeviceProfile.h"
+#include "DrawConstants.h"
+#include "DrawList.h"
+#include "FramePacket.h"
+#include "HostAllocator.h"
+#include "LayoutCache.h"
+#include "PipelineCache.h"
+#include "RenderGraph.h"
 #include "Resource.h"
+#include "Resources.h"
+#include "Timeline.h"
 
 namespace vgraphplay {
     namespace gfx {
@@ -20,9 +41,6 @@ namespace vgraphplay {
             glm::vec3 pos;
             glm::vec3 color;
             glm::vec2 tex;
-
-            static VkVertexInputBindingDescription bindingDescription();
-            static std::array<VkVertexInputAttributeDescription, 3> attributeDescription();
         };
 
         struct Transormations {
@@ -31,159 +49,178 @@ namespace vgraphplay {
             glm::mat4x4 projection;
         };
 
-        // struct ChosenDeviceInfo {
-        //     vk::raii::PhysicalDevice dev;
-        //     uint32_t graphics_queue_family;
-        //     uint32_t present_queue_family;
-        // };
-
+        // The renderer. Each frame is one command buffer built through a
+        // RenderGraph: the swapchain image, a transient depth buffer, and
+        // DepthPrepass's passes over a DrawList of every object, sorted and
+        // batched, with the camera from DrawConstants. Objects past the
+        // draw list's capacity are drawn one at a time after it, with
+        // DrawConstants::push. The frame is submitted through the Timeline
+        // and presented from the graphics queue.
+        //
+        // The bindless program is registered but nothing draws with it
+        // yet, so BindlessTable is only set up.
         class System {
         public:
-            System(GLFWwindow *window, bool debug);
+            static const uint32_t MAX_FRAMES_IN_FLIGHT = 2;
+            static const uint32_t MAX_DRAWS_PER_FRAME = 16384;
+
+            // Validation and the debug messenger are on only in debug
+            // mode; config.device picks the physical device, if set;
+            // config.log_vulkan lists what the instance and devices
+            // support; config.device_cache keeps device profiles between
+            // runs; config.benchmark_devices ranks devices by measured fill
+            // rate; and config.track_allocations and config.command_arena
+            // set up the host allocator.
+            System(GLFWwindow *window, const RunConfig &config, JobSystem &jobs);
             ~System();
 
-            void drawFrame();
-            void setFramebufferResized();
+            // Once constructed, a System belongs to the render thread:
+            // these are the only calls to make, all from that thread.
+            // drawFrame() skips the frame while the window is minimized.
+            void drawFrame(const FramePacket &packet);
+            void setFramebufferSize(int width, int height);
+
+            // Overdraw from the last frame's counters, the last built draw
+            // list's binds and draw calls, one draw at a time in submission
+            // order vs. sorted and batched, and host allocations so far.
+            RenderStats stats() const;
 
         private:
+            void initAssets(const std::string &path);
             void initInstance();
             void initDebugMessenger();
+            void initSurface();
 
+            void initPhysicalDevice();
+            size_t choosePhysicalDevice(const std::vector<DeviceProfile> &profiles, const std::vector<bool> &presentable);
             void initDevice();
-            vk::raii::PhysicalDevice choosePhysicalDevice(const std::vector<vk::raii::PhysicalDevice> &devices /*, vk::SurfaceKHR &surface */);
-
-            /* bool initSurface();
-            void cleanupSurface();
-
-            bool initSwapchain();
-            void cleanupSwapchain();
-            VkSurfaceFormatKHR chooseSurfaceFormat(const std::vector<VkSurfaceFormatKHR> &formats);
-            VkPresentModeKHR choosePresentMode(const std::vector<VkPresentModeKHR> &modes);
-            VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR &surf_caps);
-            void recreateSwapchain();
-
-            bool initRenderPass();
-            void cleanupRenderPass();
-
-            bool initShaderModules();
-            void cleanupShaderModules();
-            VkShaderModule createShaderModule(const Resource &rsrc);
-
-            bool initPipelineLayout();
-            void cleanupPipelineLayout();
-
-            bool initDescriptorSetLayout();
-            void cleanupDescriptorSetLayout();
-
-            bool initPipeline();
-            void cleanupPipeline();
-
-            bool initSwapchainFramebuffers();
-            void cleanupSwapchainFramebuffers();
 
-            bool initSemaphores();
-            void cleanupSemaphores();
+            void initSwapchain();
+            vk::SurfaceFormatKHR chooseSurfaceFormat(const std::vector<vk::SurfaceFormatKHR> &formats) const;
+            vk::PresentModeKHR choosePresentMode(const std::vector<vk::PresentModeKHR> &modes) const;
+            vk::Extent2D chooseSwapExtent(const vk::SurfaceCapabilitiesKHR &surf_caps) const;
+            vk::Format chooseDepthFormat() const;
+            void initFrames();
 
-            bool initCommandPool();
-            void cleanupCommandPool();
+            void initPipelines();
 
-            bool initTextureImage();
-            bool initTextureImageView();
-            bool initTextureSampler();
-            void cleanupTextureImage();
-            void cleanupTextureImageView();
-            void cleanupTextureSampler();
+            void initScene();
+            ImageHandle loadTexture(std::string_view name);
+            ImageHandle uploadImage(const vk::ImageCreateInfo &image_ci, std::span<const unsigned char> data, std::span<const vk::BufferImageCopy> regions);
 
-            bool initVertexBuffer();
-            void cleanupVertexBuffer();
-
-            bool initIndexBuffer();
-            void cleanupIndexBuffer();
-
-            bool initUniformBuffers();
-            void cleanupUniformBuffers();
-            void updateUniformBuffer(uint32_t current_image);
-            bool initDescriptorPool();
-            void cleanupDescriptorPool();
-            bool initDescriptorSets();
-            void cleanupDescriptorSets();
-
-            bool initCommandBuffers();
-            void cleanupCommandBuffers();
-            bool recordCommandBuffers();
-
-            bool initDepthResources();
-            void cleanupDepthResources();
-            VkFormat chooseDepthFormat();
-
-            uint32_t chooseMemoryTypeIndex(uint32_t type_filter, VkMemoryPropertyFlags mem_props);
-            VkFormat chooseFormat(const VkFormat *candidates, int num_candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
-            bool hasStencilComponent(VkFormat format);
-
-            bool createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags mem_props, VkBuffer &buffer, VkDeviceMemory &memory);
-            bool createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage &image, VkDeviceMemory &memory);
-            VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspect_flags);
-
-            bool copyBuffer(VkBuffer src, VkBuffer dst, VkDeviceSize size);
-            bool copyBufferToImage(VkBuffer src, VkImage dst, uint32_t width, uint32_t height);
-            bool transitionImageLayout(VkImage image, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout);
-
-            VkCommandBuffer beginOneTimeCommands();
-            bool endOneTimeCommands(VkCommandBuffer commands); */
+            uint32_t beginFrame();
+            void recordFrame(uint32_t frame, uint32_t image_index);
+            void endFrame(uint64_t point);
 
             bool m_debug;
+            bool m_log_vulkan;
+            bool m_benchmark_devices;
+            std::string m_device_name;
+            std::string m_device_cache;
             GLFWwindow *m_window;
+            JobSystem *m_jobs;
+            AssetPack m_assets;
 
-            // Instance, device, and debug callback.
+            // Host memory for everything Vulkan, so it's declared first and
+            // goes last.
+            HostAllocator m_host_allocator;
+
+            // Instance, surface, device, and debug callback.
             vk::raii::Context m_context;
             vk::raii::Instance m_instance;
             vk::raii::DebugUtilsMessengerEXT m_debug_messenger;
+            vk::raii::SurfaceKHR m_surface;
             vk::raii::Device m_device;
             vk::raii::PhysicalDevice m_physical_device;
+            DeviceProfile m_device_profile;
 
-            // Command queues / buffers / pool.
+            // Frames are presented from the graphics queue, so only devices
+            // whose graphics family can present to the surface are used.
             uint32_t m_graphics_queue_family;
-            // uint32_t m_present_queue_family;
             vk::raii::Queue m_graphics_queue;
-            // vk::raii::Queue m_present_queue;
-            /* VkCommandPool m_command_pool;
-            std::vector<VkCommandBuffer> m_command_buffers;
-
-            // Draw data.
-            VkBuffer m_vertex_buffer, m_index_buffer;
-            std::vector<VkBuffer> m_uniform_buffers;
-            VkDeviceMemory m_vertex_buffer_memory, m_index_buffer_memory;
-            std::vector<VkDeviceMemory> m_uniform_buffers_memory;
-            VkImage m_texture_image;
-            VkDeviceMemory m_texture_image_memory;
-            VkImageView m_texture_image_view;
-            VkSampler m_texture_sampler;
-
-            // Presentation-related structures.
-            VkSurfaceKHR m_surface;
-            VkSwapchainKHR m_swapchain;
-            std::vector<VkImage> m_swapchain_images;
-            std::vector<VkImageView> m_swapchain_image_views;
-            VkSurfaceFormatKHR m_swapchain_format;
-            VkExtent2D m_swapchain_extent;
+
+            // The swapchain, rebuilt when the framebuffer size changes or
+            // presenting says it's out of date. m_framebuffer_size is only
+            // used where the surface leaves the extent up to us.
+            vk::raii::SwapchainKHR m_swapchain;
+            std::vector<vk::Image> m_swapchain_images;
+            std::vector<vk::raii::ImageView> m_swapchain_views;
+            vk::SurfaceFormatKHR m_swapchain_format;
+            vk::Extent2D m_swapchain_extent;
+            vk::Extent2D m_framebuffer_size;
             bool m_framebuffer_resized;
-            VkImage m_depth_image;
-            VkDeviceMemory m_depth_image_memory;
-            VkImageView m_depth_image_view;
-
-            // Pipeline-related structures.
-            VkShaderModule m_vertex_shader_module, m_fragment_shader_module;
-            VkPipelineLayout m_pipeline_layout;
-            VkDescriptorSetLayout m_descriptor_set_layout;
-            VkDescriptorPool m_descriptor_pool;
-            std::vector<VkDescriptorSet> m_descriptor_sets;
-            VkRenderPass m_render_pass;
-            VkPipeline m_pipeline;
-            std::vector<VkFramebuffer> m_swapchain_framebuffers;
-
-            // Semaphores.
-            VkSemaphore m_image_available_semaphore;
-            VkSemaphore m_render_finished_semaphore; */
+            vk::Format m_depth_format;
+
+            // GPU progress. Each frame slot's resources can be reused once
+            // the timeline reaches the point its last submission signalled.
+            Timeline m_timeline;
+            uint32_t m_current_frame;
+            uint64_t m_frame_count;
+            uint64_t m_last_sequence;
+            std::array<uint64_t, MAX_FRAMES_IN_FLIGHT> m_frame_points;
+
+            // Each frame slot records into the one command buffer from its
+            // own pool, which beginFrame() resets, and acquires with its own
+            // semaphore. Presents wait on one semaphore per swapchain image,
+            // since only acquiring an image again shows its present is done
+            // with it.
+            std::vector<vk::raii::CommandPool> m_command_pools;
+            std::vector<vk::raii::CommandBuffer> m_command_buffers;
+            std::vector<vk::raii::Semaphore> m_image_available;
+            std::vector<vk::raii::Semaphore> m_render_finished;
+
+            // Objects replaced or released while the GPU may still be using
+            // them. Declared after the device so it is emptied first.
+            DeletionQueue m_deletion_queue;
+
+            // Buffers, images, samplers and pipelines, by handle.
+            Resources m_resources;
+
+            // Descriptor sets. Long-lived sets come from m_descriptors and
+            // are shared through the cache; each frame slot also has a
+            // transient allocator that is reset when the slot is reused.
+            DescriptorAllocator m_descriptors;
+            DescriptorSetCache m_descriptor_cache;
+            std::vector<DescriptorAllocator> m_frame_descriptors;
+
+            // Every texture and material in one descriptor set, when the
+            // device supports descriptor indexing.
+            BindlessTable m_bindless;
+
+            // Pipeline layouts, built from the shaders' reflected interfaces.
+            LayoutCache m_layouts;
+
+            // Camera and per-draw transforms: a uniform buffer per frame, and
+            // push constants for draws that don't fit in the draw list.
+            CameraData m_camera;
+            std::vector<DrawData> m_objects; // Interpolated from the frame packet.
+            DrawConstants m_draw_constants;
+
+            // What every object is drawn with: one mesh, small enough to
+            // read from host-visible memory, and one texture.
+            BufferHandle m_vertex_buffer;
+            BufferHandle m_position_buffer;
+            BufferHandle m_index_buffer;
+            MeshBuffers m_mesh;
+            ImageHandle m_texture;
+            SamplerHandle m_sampler;
+
+            // Pipeline permutations, created the first time each one is
+            // drawn with.
+            PipelineCache m_pipelines;
+            ProgramId m_unlit_program;
+            ProgramId m_unlit_bindless_program; // 0 without bindless.
+            ProgramId m_unlit_instanced_program;
+            ProgramId m_depth_program;
+
+            // The frame's opaque draws, sorted and batched, drawn with an
+            // optional depth-only pre-pass.
+            DrawList m_draw_list;
+            DepthPrepass m_depth_prepass;
+
+            // The frame's passes, rebuilt every frame. Owns the transient
+            // attachments (e.g. depth), which alias where they can.
+            RenderGraph m_render_graph;
         };
     }
 }
@@ -0,0 +1,238 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../vulkan.h"
+
+#include "Texture.h"
+
+vgraphplay::gfx::CookedTexture::CookedTexture(const Resource &rsrc)
+    : m_data{rsrc.data()},
+      m_size{rsrc.size()},
+      m_header{nullptr},
+      m_mips{}
+{
+    if (m_size < sizeof(CookedTextureHeader)) {
+        throw std::runtime_error("Cooked texture is truncated");
+    }
+
+    m_header = reinterpret_cast<const CookedTextureHeader *>(m_data);
+    if (std::memcmp(m_header->magic, COOKED_TEXTURE_MAGIC, sizeof(COOKED_TEXTURE_MAGIC)) != 0) {
+        throw std::runtime_error("Not a cooked texture");
+    }
+
+    if (m_header->version != COOKED_TEXTURE_VERSION) {
+        throw std::runtime_error("Unsupported cooked texture version " + std::to_string(m_header->version));
+    }
+
+    if (m_header->format != CookedTextureFormat::BC1 && m_header->format != CookedTextureFormat::BC3) {
+        throw std::runtime_error("Unsupported cooked texture format");
+    }
+
+    if (m_header->width == 0 || m_header->height == 0) {
+        throw std::runtime_error("Cooked texture is empty");
+    }
+
+    // A full chain halves the larger side down to 1, so it's
+    // floor(log2(max(width, height))) + 1 levels long.
+    const uint32_t max_levels = static_cast<uint32_t>(std::bit_width(std::max(m_header->width, m_header->height)));
+    if (m_header->mip_levels == 0 || m_header->mip_levels > max_levels) {
+        throw std::runtime_error("Cooked texture has " + std::to_string(m_header->mip_levels) + " mip levels");
+    }
+
+    if (m_size < sizeof(CookedTextureHeader) + sizeof(CookedTextureMip) * m_header->mip_levels) {
+        throw std::runtime_error("Cooked texture mip table is truncated");
+    }
+
+    m_mips = std::span<const CookedTextureMip>{
+        reinterpret_cast<const CookedTextureMip *>(m_data + sizeof(CookedTextureHeader)),
+        m_header->mip_levels
+    };
+
+    // imageCreateInfo() goes by the header and copyRegions() by the mips,
+    // so they have to agree.
+    uint32_t width = m_header->width;
+    uint32_t height = m_header->height;
+    for (const auto &mip : m_mips) {
+        if (mip.width != width || mip.height != height) {
+            throw std::runtime_error("Cooked texture mip chain doesn't match its size");
+        }
+        width = std::max(width / 2, 1u);
+        height = std::max(height / 2, 1u);
+
+        if (mip.offset > m_size || mip.size > m_size - mip.offset ||
+            mip.size != cookedTextureMipSize(m_header->format, mip.width, mip.height)) {
+            throw std::runtime_error("Cooked texture mip data is out of range");
+        }
+    }
+}
+
+vk::Format vgraphplay::gfx::CookedTexture::format() const {
+    bool srgb = (m_header->flags & COOKED_TEXTURE_SRGB) != 0;
+    switch (m_header->format) {
+    case CookedTextureFormat::BC1:
+        return srgb ? vk::Format::eBc1RgbSrgbBlock : vk::Format::eBc1RgbUnormBlock;
+    case CookedTextureFormat::BC3:
+        return srgb ? vk::Format::eBc3SrgbBlock : vk::Format::eBc3UnormBlock;
+    }
+    return vk::Format::eUndefined;
+}
+
+vk::Format vgraphplay::gfx::CookedTexture::fallbackFormat() const {
+    bool srgb = (m_header->flags & COOKED_TEXTURE_SRGB) != 0;
+    return srgb ? vk::Format::eR8G8B8A8Srgb : vk::Format::eR8G8B8A8Unorm;
+}
+
+vk::Extent3D vgraphplay::gfx::CookedTexture::extent() const {
+    return vk::Extent3D{
+        .width = m_header->width,
+        .height = m_header->height,
+        .depth = 1,
+    };
+}
+
+vk::ImageCreateInfo vgraphplay::gfx::CookedTexture::imageCreateInfo(bool block_compressed) const {
+    return vk::ImageCreateInfo{
+        .imageType = vk::ImageType::e2D,
+        .format = block_compressed ? format() : fallbackFormat(),
+        .extent = extent(),
+        .mipLevels = m_header->mip_levels,
+        .arrayLayers = 1,
+        .samples = vk::SampleCountFlagBits::e1,
+        .tiling = vk::ImageTiling::eOptimal,
+        .usage = vk::ImageUsageFlagBits::eTransferDst | vk::ImageUsageFlagBits::eSampled,
+        .sharingMode = vk::SharingMode::eExclusive,
+        .initialLayout = vk::ImageLayout::eUndefined,
+    };
+}
+
+std::vector<vk::BufferImageCopy> vgraphplay::gfx::CookedTexture::copyRegions(vk::DeviceSize staging_offset, bool block_compressed) const {
+    std::vector<vk::BufferImageCopy> rv;
+    rv.reserve(m_mips.size());
+
+    vk::DeviceSize decoded_offset = 0;
+    for (uint32_t level = 0; level < m_mips.size(); ++level) {
+        const CookedTextureMip &mip = m_mips[level];
+        rv.push_back(vk::BufferImageCopy{
+            .bufferOffset = staging_offset + (block_compressed ? mip.offset : decoded_offset),
+            .bufferRowLength = 0,
+            .bufferImageHeight = 0,
+            .imageSubresource = {
+                .aspectMask = vk::ImageAspectFlagBits::eColor,
+                .mipLevel = level,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
+            .imageOffset = {0, 0, 0},
+            .imageExtent = {mip.width, mip.height, 1},
+        });
+        decoded_offset += static_cast<vk::DeviceSize>(mip.width) * mip.height * 4;
+    }
+
+    return rv;
+}
+
+// An RGB565 endpoint as 8-bit RGB.
+static void expand565(uint16_t c, unsigned char rgb[3]) {
+    rgb[0] = static_cast<unsigned char>(((c >> 11) & 0x1f) * 255 / 31);
+    rgb[1] = static_cast<unsigned char>(((c >> 5) & 0x3f) * 255 / 63);
+    rgb[2] = static_cast<unsigned char>((c & 0x1f) * 255 / 31);
+}
+
+// Decodes a BC1 color block to 16 RGBA texels, row by row. BC3's color
+// blocks always use the four-color mode. The image is made as BC1 RGB,
+// where the three-color mode's last index is opaque black rather than
+// transparent, so it is here too.
+static void decodeColorBlock(const unsigned char *block, bool four_color, unsigned char out[16][4]) {
+    const uint16_t c0 = static_cast<uint16_t>(block[0] | (block[1] << 8));
+    const uint16_t c1 = static_cast<uint16_t>(block[2] | (block[3] << 8));
+
+    unsigned char palette[4][4];
+    expand565(c0, palette[0]);
+    expand565(c1, palette[1]);
+    palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+    for (int i = 0; i < 3; ++i) {
+        if (four_color || c0 > c1) {
+            palette[2][i] = static_cast<unsigned char>((2 * palette[0][i] + palette[1][i]) / 3);
+            palette[3][i] = static_cast<unsigned char>((palette[0][i] + 2 * palette[1][i]) / 3);
+        } else {
+            palette[2][i] = static_cast<unsigned char>((palette[0][i] + palette[1][i]) / 2);
+            palette[3][i] = 0;
+        }
+    }
+
+    const uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | (static_cast<uint32_t>(block[7]) << 24);
+    for (int texel = 0; texel < 16; ++texel) {
+        std::memcpy(out[texel], palette[(indices >> (2 * texel)) & 3], 4);
+    }
+}
+
+// Decodes a BC3 alpha block into the alpha of 16 texels.
+static void decodeAlphaBlock(const unsigned char *block, unsigned char out[16][4]) {
+    const unsigned a0 = block[0];
+    const unsigned a1 = block[1];
+
+    unsigned char palette[8] = {static_cast<unsigned char>(a0), static_cast<unsigned char>(a1)};
+    if (a0 > a1) {
+        for (unsigned i = 1; i < 7; ++i) {
+            palette[i + 1] = static_cast<unsigned char>(((7 - i) * a0 + i * a1) / 7);
+        }
+    } else {
+        for (unsigned i = 1; i < 5; ++i) {
+            palette[i + 1] = static_cast<unsigned char>(((5 - i) * a0 + i * a1) / 5);
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+
+    uint64_t indices = 0;
+    for (int i = 0; i < 6; ++i) {
+        indices |= static_cast<uint64_t>(block[2 + i]) << (8 * i);
+    }
+    for (int texel = 0; texel < 16; ++texel) {
+        out[texel][3] = palette[(indices >> (3 * texel)) & 7];
+    }
+}
+
+std::vector<unsigned char> vgraphplay::gfx::CookedTexture::decode() const {
+    const bool bc3 = m_header->format == CookedTextureFormat::BC3;
+    const uint32_t block_bytes = cookedTextureBlockBytes(m_header->format);
+
+    size_t total = 0;
+    for (const CookedTextureMip &mip : m_mips) {
+        total += static_cast<size_t>(mip.width) * mip.height * 4;
+    }
+
+    std::vector<unsigned char> rv(total);
+    unsigned char *level = rv.data();
+    for (const CookedTextureMip &mip : m_mips) {
+        const unsigned char *block = m_data + mip.offset;
+        for (uint32_t by = 0; by < mip.height; by += 4) {
+            for (uint32_t bx = 0; bx < mip.width; bx += 4, block += block_bytes) {
+                unsigned char texels[16][4];
+                if (bc3) {
+                    decodeColorBlock(block + 8, true, texels);
+                    decodeAlphaBlock(block, texels);
+                } else {
+                    decodeColorBlock(block, false, texels);
+                }
+
+                // Blocks on the right and bottom edges can hang over the
+                // mip.
+                for (uint32_t y = 0; y < 4 && by + y < mip.height; ++y) {
+                    for (uint32_t x = 0; x < 4 && bx + x < mip.width; ++x) {
+                        std::memcpy(level + (static_cast<size_t>(by + y) * mip.width + bx + x) * 4, texels[y * 4 + x], 4);
+                    }
+                }
+            }
+        }
+        level += static_cast<size_t>(mip.width) * mip.height * 4;
+    }
+
+    return rv;
+}
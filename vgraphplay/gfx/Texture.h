@@ -0,0 +1,54 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_GFX_TEXTURE_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_GFX_TEXTURE_H_
+
+#include <span>
+#include <vector>
+
+#include "../vulkan.h"
+
+#include "Resource.h"
+#include "TextureFormat.h"
+
+namespace vgraphplay {
+    namespace gfx {
+        // A read-only view over a texture produced by the texture-cooker
+        // build step. Nothing is decoded or copied: the resource bytes are
+        // copied verbatim into a staging buffer, and copyRegions() describes
+        // where each mip lives in it.
+        //
+        // Devices without textureCompressionBC get the fallback instead:
+        // decode() expands the blocks to fallbackFormat() on the CPU, and
+        // the block_compressed = false variants describe that.
+        class CookedTexture {
+        public:
+            explicit CookedTexture(const Resource &rsrc);
+
+            vk::Format format() const;
+            vk::Format fallbackFormat() const;
+            vk::Extent3D extent() const;
+            uint32_t mipLevels() const { return m_header->mip_levels; }
+            std::span<const CookedTextureMip> mips() const { return m_mips; }
+
+            // The whole cooked file; upload this to the staging buffer.
+            const unsigned char *data() const { return m_data; }
+            vk::DeviceSize size() const { return m_size; }
+
+            // Every mip as fallbackFormat() texels, largest first, one after
+            // another; upload this to the staging buffer instead.
+            std::vector<unsigned char> decode() const;
+
+            vk::ImageCreateInfo imageCreateInfo(bool block_compressed = true) const;
+            std::vector<vk::BufferImageCopy> copyRegions(vk::DeviceSize staging_offset = 0, bool block_compressed = true) const;
+
+        private:
+            const unsigned char *m_data;
+            vk::DeviceSize m_size;
+            const CookedTextureHeader *m_header;
+            std::span<const CookedTextureMip> m_mips;
+        };
+    }
+}
+
+#endif
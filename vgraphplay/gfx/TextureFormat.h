@@ -0,0 +1,63 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_GFX_TEXTURE_FORMAT_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_GFX_TEXTURE_FORMAT_H_
+
+#include <cstdint>
+
+// On-disk layout of a cooked texture, shared between the texture-cooker
+// build tool and the runtime loader. This header must not pull in Vulkan,
+// since the cooker is built without it.
+//
+// A cooked texture is a CookedTextureHeader, followed immediately by
+// mip_levels CookedTextureMip records (largest first), followed by the
+// block-compressed payload. Mip offsets are relative to the start of the
+// file and are 16-byte aligned, so the whole file can be copied into a
+// staging buffer as-is and each mip copied to the image with no decode.
+
+namespace vgraphplay {
+    namespace gfx {
+        constexpr char COOKED_TEXTURE_MAGIC[4] = {'V', 'T', 'E', 'X'};
+        constexpr uint32_t COOKED_TEXTURE_VERSION = 1;
+
+        enum class CookedTextureFormat : uint32_t {
+            BC1 = 1, // 8 bytes per 4x4 block, opaque RGB.
+            BC3 = 3, // 16 bytes per 4x4 block, RGB + interpolated alpha.
+        };
+
+        enum CookedTextureFlags : uint32_t {
+            COOKED_TEXTURE_SRGB = 1 << 0,
+        };
+
+        struct CookedTextureHeader {
+            char magic[4];
+            uint32_t version;
+            CookedTextureFormat format;
+            uint32_t flags;
+            uint32_t width;
+            uint32_t height;
+            uint32_t mip_levels;
+            uint32_t reserved;
+        };
+
+        struct CookedTextureMip {
+            uint32_t width;
+            uint32_t height;
+            uint64_t offset;
+            uint64_t size;
+        };
+
+        static_assert(sizeof(CookedTextureHeader) == 32, "CookedTextureHeader layout changed");
+        static_assert(sizeof(CookedTextureMip) == 24, "CookedTextureMip layout changed");
+
+        constexpr uint32_t cookedTextureBlockBytes(CookedTextureFormat format) {
+            return format == CookedTextureFormat::BC1 ? 8 : 16;
+        }
+
+        constexpr uint64_t cookedTextureMipSize(CookedTextureFormat format, uint32_t width, uint32_t height) {
+            return static_cast<uint64_t>((width + 3) / 4) * ((height + 3) / 4) * cookedTextureBlockBytes(format);
+        }
+    }
+}
+
+#endif
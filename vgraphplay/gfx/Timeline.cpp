@@ -0,0 +1,207 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <boost/log/trivial.hpp>
+
+#include "Timeline.h"
+#include "HostAllocator.h"
+
+vgraphplay::gfx::Timeline::Timeline(std::nullptr_t)
+    : m_device{nullptr},
+      m_semaphore{nullptr},
+      m_mutex{},
+      m_next_point{1},
+      m_reserved{0},
+      m_completed{0},
+      m_callbacks{}
+{}
+
+vgraphplay::gfx::Timeline::Timeline(const vk::raii::Device &device)
+    : Timeline{nullptr}
+{
+    vk::StructureChain<vk::SemaphoreCreateInfo, vk::SemaphoreTypeCreateInfo> semaphore_ci = {
+        {},
+        {.semaphoreType = vk::SemaphoreType::eTimeline, .initialValue = 0},
+    };
+
+    m_device = &device;
+    m_semaphore = vk::raii::Semaphore(device, semaphore_ci.get<vk::SemaphoreCreateInfo>(), HostAllocator::callbacks());
+    BOOST_LOG_TRIVIAL(trace) << "Created timeline semaphore: " << *m_semaphore;
+}
+
+vgraphplay::gfx::Timeline::~Timeline() {}
+
+vgraphplay::gfx::Timeline::Timeline(Timeline &&other)
+    : Timeline{nullptr}
+{
+    *this = std::move(other);
+}
+
+vgraphplay::gfx::Timeline &vgraphplay::gfx::Timeline::operator=(Timeline &&other) {
+    if (this != &other) {
+        std::scoped_lock lock{m_mutex, other.m_mutex};
+        m_device = std::exchange(other.m_device, nullptr);
+        m_semaphore = std::move(other.m_semaphore);
+        m_next_point = std::exchange(other.m_next_point, 1);
+        m_reserved = std::exchange(other.m_reserved, 0);
+        m_completed = std::exchange(other.m_completed, 0);
+        m_callbacks = std::move(other.m_callbacks);
+        other.m_callbacks.clear();
+    }
+    return *this;
+}
+
+uint64_t vgraphplay::gfx::Timeline::submit(const vk::raii::Queue &queue,
+                                           vk::ArrayProxy<const vk::CommandBufferSubmitInfo> const &command_buffers,
+                                           vk::ArrayProxy<const vk::SemaphoreSubmitInfo> const &waits,
+                                           vk::ArrayProxy<const vk::SemaphoreSubmitInfo> const &signals) {
+    // The point is only taken once the submit succeeds, so a failed one
+    // doesn't leave lastSubmitted() on a point that never gets signalled.
+    // Holding the lock across it keeps points in submission order.
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (m_reserved != 0) {
+        throw std::runtime_error("Cannot submit to the timeline while point " + std::to_string(m_reserved) + " is reserved");
+    }
+    const uint64_t point = m_next_point;
+
+    std::vector<vk::SemaphoreSubmitInfo> all_signals{signals.begin(), signals.end()};
+    all_signals.push_back(vk::SemaphoreSubmitInfo{
+        .semaphore = *m_semaphore,
+        .value = point,
+        .stageMask = vk::PipelineStageFlagBits2::eAllCommands,
+    });
+
+    vk::SubmitInfo2 submit_info{
+        .waitSemaphoreInfoCount = waits.size(),
+        .pWaitSemaphoreInfos = waits.data(),
+        .commandBufferInfoCount = command_buffers.size(),
+        .pCommandBufferInfos = command_buffers.data(),
+        .signalSemaphoreInfoCount = static_cast<uint32_t>(all_signals.size()),
+        .pSignalSemaphoreInfos = all_signals.data(),
+    };
+
+    queue.submit2(submit_info);
+    m_next_point = point + 1;
+    return point;
+}
+
+vk::SemaphoreSubmitInfo vgraphplay::gfx::Timeline::reserve(vk::PipelineStageFlags2 stages) {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (m_reserved != 0) {
+        throw std::runtime_error("Timeline point " + std::to_string(m_reserved) + " is already reserved");
+    }
+    m_reserved = m_next_point;
+    return vk::SemaphoreSubmitInfo{
+        .semaphore = *m_semaphore,
+        .value = m_reserved,
+        .stageMask = stages,
+    };
+}
+
+void vgraphplay::gfx::Timeline::submitted(uint64_t point) {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (point == 0 || point != m_reserved) {
+        throw std::runtime_error("Timeline point " + std::to_string(point) + " isn't reserved");
+    }
+    m_next_point = point + 1;
+    m_reserved = 0;
+}
+
+void vgraphplay::gfx::Timeline::cancel(uint64_t point) {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (point == 0 || point != m_reserved) {
+        throw std::runtime_error("Timeline point " + std::to_string(point) + " isn't reserved");
+    }
+    m_reserved = 0;
+}
+
+vk::SemaphoreSubmitInfo vgraphplay::gfx::Timeline::waitInfo(uint64_t point, vk::PipelineStageFlags2 stages) const {
+    return vk::SemaphoreSubmitInfo{
+        .semaphore = *m_semaphore,
+        .value = point,
+        .stageMask = stages,
+    };
+}
+
+uint64_t vgraphplay::gfx::Timeline::lastSubmitted() const {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_next_point - 1;
+}
+
+uint64_t vgraphplay::gfx::Timeline::nextPoint() const {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_next_point;
+}
+
+uint64_t vgraphplay::gfx::Timeline::poll() {
+    uint64_t completed = m_semaphore.getCounterValue();
+    runCallbacks(completed);
+    return completed;
+}
+
+bool vgraphplay::gfx::Timeline::reached(uint64_t point) {
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        if (point <= m_completed) {
+            return true;
+        }
+    }
+    return point <= poll();
+}
+
+bool vgraphplay::gfx::Timeline::wait(uint64_t point, uint64_t timeout) {
+    if (reached(point)) {
+        return true;
+    }
+
+    vk::Semaphore semaphore = *m_semaphore;
+    vk::SemaphoreWaitInfo wait_info{
+        .semaphoreCount = 1,
+        .pSemaphores = &semaphore,
+        .pValues = &point,
+    };
+
+    if (m_device->waitSemaphores(wait_info, timeout) != vk::Result::eSuccess) {
+        return false;
+    }
+
+    runCallbacks(point);
+    return true;
+}
+
+void vgraphplay::gfx::Timeline::onComplete(uint64_t point, std::function<void()> callback) {
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        if (point > m_completed) {
+            m_callbacks.emplace(point, std::move(callback));
+            return;
+        }
+    }
+    callback();
+}
+
+void vgraphplay::gfx::Timeline::runCallbacks(uint64_t completed) {
+    std::vector<std::function<void()>> ready;
+
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        if (completed <= m_completed) {
+            return;
+        }
+        m_completed = completed;
+
+        auto end = m_callbacks.upper_bound(completed);
+        for (auto it = m_callbacks.begin(); it != end; ++it) {
+            ready.push_back(std::move(it->second));
+        }
+        m_callbacks.erase(m_callbacks.begin(), end);
+    }
+
+    // Run outside the lock, so callbacks can schedule more callbacks.
+    for (auto &callback : ready) {
+        callback();
+    }
+}
@@ -0,0 +1,99 @@
+// -*- mode: c++; c-basic-offset: 4; encoding: utf-8; -*-
+
+#ifndef _VGRAPHPLAY_VGRAPHPLAY_GFX_TIMELINE_H_
+#define _VGRAPHPLAY_VGRAPHPLAY_GFX_TIMELINE_H_
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "../vulkan.h"
+
+namespace vgraphplay {
+    namespace gfx {
+        // GPU/CPU synchronization built on a single timeline semaphore. Every
+        // submission made through the timeline signals the next point on it,
+        // so "has the GPU finished this work" becomes "has the semaphore
+        // reached this value". CPU code can wait on, poll, or attach a
+        // callback to any point instead of idling the queue or the device.
+        //
+        // Points are handed out in submission order, so reaching a point
+        // implies every earlier point has been reached as well.
+        class Timeline {
+        public:
+            Timeline(std::nullptr_t);
+            explicit Timeline(const vk::raii::Device &device);
+            ~Timeline();
+
+            Timeline(const Timeline &) = delete;
+            Timeline &operator=(const Timeline &) = delete;
+            Timeline(Timeline &&other);
+            Timeline &operator=(Timeline &&other);
+
+            const vk::raii::Semaphore &semaphore() const { return m_semaphore; }
+
+            // Submits the command buffers to the queue, signalling the next
+            // point on the timeline (in addition to any other signals) once
+            // they have finished executing, and returns that point. If the
+            // submit throws, no point is used up. Throws if a point is
+            // reserved, since signalling past it would leave it behind.
+            uint64_t submit(const vk::raii::Queue &queue,
+                            vk::ArrayProxy<const vk::CommandBufferSubmitInfo> const &command_buffers,
+                            vk::ArrayProxy<const vk::SemaphoreSubmitInfo> const &waits = {},
+                            vk::ArrayProxy<const vk::SemaphoreSubmitInfo> const &signals = {});
+
+            // For submissions built elsewhere (e.g. alongside a present):
+            // reserves the next point and returns the signal info for it.
+            // Signals have to climb, so until the submission carrying it is
+            // reported with submitted(), or given up with cancel(), nothing
+            // else may submit through the timeline or reserve; both throw
+            // if they try. A reserved point doesn't count as submitted.
+            vk::SemaphoreSubmitInfo reserve(vk::PipelineStageFlags2 stages = vk::PipelineStageFlagBits2::eAllCommands);
+            void submitted(uint64_t point);
+            void cancel(uint64_t point);
+
+            // A wait on this timeline, for making other submissions depend on
+            // a point without involving the CPU.
+            vk::SemaphoreSubmitInfo waitInfo(uint64_t point, vk::PipelineStageFlags2 stages = vk::PipelineStageFlagBits2::eAllCommands) const;
+
+            // The most recent point handed out; 0 if nothing was submitted.
+            uint64_t lastSubmitted() const;
+
+            // The point the next submission (or reservation) will signal, so
+            // the one that covers commands being recorded now.
+            uint64_t nextPoint() const;
+
+            // Reads the semaphore's current value and runs the callbacks of
+            // every point it has reached. Cheap enough to call every frame.
+            uint64_t poll();
+            bool reached(uint64_t point);
+
+            // Blocks until the GPU reaches the point or the timeout (in
+            // nanoseconds) expires; returns whether the point was reached.
+            bool wait(uint64_t point, uint64_t timeout = std::numeric_limits<uint64_t>::max());
+            bool waitIdle(uint64_t timeout = std::numeric_limits<uint64_t>::max()) { return wait(lastSubmitted(), timeout); }
+
+            // Runs the callback on the thread that first observes the point
+            // being reached (through poll(), reached() or wait()), or right
+            // away if it already has been.
+            void onComplete(uint64_t point, std::function<void()> callback);
+
+        private:
+            void runCallbacks(uint64_t completed);
+
+            const vk::raii::Device *m_device;
+            vk::raii::Semaphore m_semaphore;
+
+            mutable std::mutex m_mutex;
+            uint64_t m_next_point;
+            uint64_t m_reserved; // 0 if nothing is.
+            uint64_t m_completed;
+            std::multimap<uint64_t, std::function<void()>> m_callbacks;
+        };
+    }
+}
+
+#endif
@@ -3,6 +3,8 @@
 #include <memory>
 #include <print>
 
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
 #include <boost/log/trivial.hpp>
 
 #include "vulkan.h"
@@ -11,6 +13,9 @@
 #include <GLFW/glfw3.h>
 
 #include "Application.h"
+#include "Log.h"
+#include "PhaseTimer.h"
+#include "RunConfig.h"
 
 using namespace vgraphplay;
 
@@ -18,15 +23,38 @@ void initGLFW(int width, int height, const char *title, GLFWwindow **window);
 void handleGLFWError(int code, const char *desc);
 void bailout(const std::string &msg);
 
-const int WIDTH = 1024;
-const int HEIGHT = 768;
-
 int main(int argc, char **argv) {
+    RunConfig config;
+    try {
+        config = RunConfig::parse(argc, argv);
+    } catch (const std::exception &e) {
+        std::println(stderr, "{}\n", e.what());
+        RunConfig::printUsage(argv[0]);
+        return 1;
+    }
+    if (config.help) {
+        RunConfig::printUsage(argv[0]);
+        return 0;
+    }
+
+    // Trace logging is for debugging; the rest of the time only the
+    // records worth reading should get as far as formatting. (Levels
+    // below VGRAPHPLAY_LOG_LEVEL aren't even compiled in.)
+    const LogLevel level = config.mode == RunMode::Debug ? LogLevel::trace : LogLevel::info;
+    boost::log::core::get()->set_filter(boost::log::trivial::severity >= level);
+    Logger::setLevel(level);
+
+    BOOST_LOG_TRIVIAL(info) << "Running in " << config.modeName() << " mode";
+
+    PhaseTimer startup{"Startup"};
     GLFWwindow *window;
-    initGLFW(WIDTH, HEIGHT, "VGraphplay", &window);
+    initGLFW(config.width, config.height, "VGraphplay", &window);
+    startup.mark("window");
 
     try {
-        Application app{window, true};
+        Application app{window, config};
+        startup.mark("application");
+        startup.report();
         app.run();
     } catch (const std::exception &e) {
         std::println(stderr, "Error running application: {}", e.what());